@@ -32,6 +32,10 @@
 #define MAX_CH_PER_PORT 8
 #define TX_ADC_MAX 4
 #define SWR_NUM_PORTS	4
+/* Registers per swr_bulk_write() when restoring the register cache */
+#define WCD939X_RESTORE_BATCH 32
+/* reg_def[] marker for registers without a known reset value */
+#define WCD939X_REG_NO_DEFAULT 0xFFFF
 
 enum {
 	RX_CLK_9P6MHZ,
@@ -153,6 +157,10 @@ struct wcd939x_priv {
 	/* wcd to swr dmic notification */
 	bool notify_swr_dmic;
 	struct blocking_notifier_head notifier;
+	/* Hardware reset value per register, see wcd939x_regcache_restore() */
+	u16 *reg_def;
+	/* Duration of the last register cache restore */
+	u32 restore_time_us;
 };
 
 struct wcd939x_micbias_setting {
@@ -351,4 +359,5 @@ extern int wcd939x_mbhc_micb_adjust_voltage(struct snd_soc_component *component,
 extern int wcd939x_get_micb_vout_ctl_val(u32 micb_mv);
 extern int wcd939x_micbias_control(struct snd_soc_component *component,
 			int micb_num, int req, bool is_dapm);
+extern int wcd939x_regcache_restore(struct wcd939x_priv *wcd939x);
 #endif /* _WCD939X_INTERNAL_H */
@@ -2042,8 +2042,7 @@ static void wcd939x_surge_reset_routine(struct wcd_mbhc *mbhc)
 {
 	struct wcd939x_priv *wcd939x = snd_soc_component_get_drvdata(mbhc->component);
 
-	regcache_mark_dirty(wcd939x->regmap);
-	regcache_sync(wcd939x->regmap);
+	wcd939x_regcache_restore(wcd939x);
 }
 
 static void wcd939x_mbhc_zdet_leakage_resistance(struct wcd_mbhc *mbhc,
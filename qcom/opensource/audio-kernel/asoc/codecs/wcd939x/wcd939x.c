@@ -11,6 +11,7 @@
 #include <linux/delay.h>
 #include <linux/kernel.h>
 #include <linux/component.h>
+#include <linux/ktime.h>
 #include <linux/stringify.h>
 #include <linux/regulator/consumer.h>
 #include <sound/soc.h>
@@ -2692,6 +2693,101 @@ static int wcd939x_get_logical_addr(struct swr_device *swr_dev)
 	return 0;
 }
 
+static int wcd939x_regcache_flush(struct wcd939x_priv *wcd939x,
+				  struct reg_sequence *seq, int n)
+{
+	unsigned int cached;
+	int i, ret;
+
+	if (!n)
+		return 0;
+
+	/*
+	 * The batch goes out as one bus write under the regmap lock, so it
+	 * cannot interleave with other regmap writers. A writer that updated
+	 * one of these registers after it was read into the batch has left a
+	 * newer value in the cache; push that value again so it is not lost.
+	 */
+	ret = regmap_multi_reg_write_bypassed(wcd939x->regmap, seq, n);
+	if (ret) {
+		dev_err_ratelimited(wcd939x->dev,
+			"%s: bulk write of %d regs failed, ret %d\n",
+			__func__, n, ret);
+		return ret;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (regmap_read(wcd939x->regmap, seq[i].reg, &cached) ||
+		    cached == seq[i].def)
+			continue;
+		/* mask 0 forces the cached value out to the codec */
+		ret = regmap_write_bits(wcd939x->regmap, seq[i].reg, 0, 0);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+/*
+ * wcd939x_regcache_restore - push the register cache back to the codec
+ * @wcd939x: codec private data
+ *
+ * Used after the codec has been reset. Only writeable registers whose cached
+ * value differs from the hardware reset value are written, and they are
+ * queued into regmap_multi_reg_write_bypassed() batches of
+ * WCD939X_RESTORE_BATCH entries, each issued as a single swr_bulk_write(),
+ * rather than as one SoundWire write per register. Falls back to a
+ * full regcache_sync() if the reset values are unknown or a batch fails.
+ */
+int wcd939x_regcache_restore(struct wcd939x_priv *wcd939x)
+{
+	struct reg_sequence seq[WCD939X_RESTORE_BATCH];
+	unsigned int i, cached = 0, nr_regs = 0;
+	ktime_t start = ktime_get();
+	int n = 0, ret = 0;
+
+	if (!wcd939x->reg_def || !wcd939x->tx_swr_dev)
+		goto sync;
+
+	for (i = 1; i < WCD939X_NUM_REGISTERS; i++) {
+		unsigned int addr = WCD939X_BASE + 1 + i;
+
+		if (!wcd939x_regmap_config.writeable_reg(wcd939x->dev, addr) ||
+		    wcd939x_regmap_config.volatile_reg(wcd939x->dev, addr))
+			continue;
+		if (regmap_read(wcd939x->regmap, addr, &cached))
+			continue;
+		if (wcd939x->reg_def[i] == cached)
+			continue;
+
+		seq[n].reg = addr;
+		seq[n].def = cached;
+		seq[n].delay_us = 0;
+		nr_regs++;
+		if (++n == WCD939X_RESTORE_BATCH) {
+			ret = wcd939x_regcache_flush(wcd939x, seq, n);
+			if (ret)
+				goto sync;
+			n = 0;
+		}
+	}
+	ret = wcd939x_regcache_flush(wcd939x, seq, n);
+	if (ret)
+		goto sync;
+	goto done;
+
+sync:
+	regcache_mark_dirty(wcd939x->regmap);
+	ret = regcache_sync(wcd939x->regmap);
+	dev_dbg(wcd939x->dev, "%s: fell back to regcache_sync\n", __func__);
+done:
+	wcd939x->restore_time_us = ktime_us_delta(ktime_get(), start);
+	dev_dbg(wcd939x->dev, "%s: queued %u regs, took %u us, ret %d\n",
+		__func__, nr_regs, wcd939x->restore_time_us, ret);
+	return ret;
+}
+EXPORT_SYMBOL(wcd939x_regcache_restore);
+
 static bool get_usbc_hs_status(struct snd_soc_component *component,
 			struct wcd_mbhc_config *mbhc_cfg)
 {
@@ -2792,8 +2888,7 @@ static int wcd939x_event_notify(struct notifier_block *block,
 		wcd939x_get_logical_addr(wcd939x->rx_swr_dev);
 
 		wcd939x_init_reg(component);
-		regcache_mark_dirty(wcd939x->regmap);
-		regcache_sync(wcd939x->regmap);
+		wcd939x_regcache_restore(wcd939x);
 		/* Initialize MBHC module */
 		mbhc = &wcd939x->mbhc->wcd_mbhc;
 		ret = wcd939x_mbhc_post_ssr_init(wcd939x->mbhc, component);
@@ -5261,6 +5356,39 @@ static void wcd939x_update_regmap_cache(struct wcd939x_priv *wcd939x)
 	}
 }
 
+/*
+ * Record the hardware reset value of every register, including the
+ * version specific overrides, so a restore can skip registers that are
+ * still at their reset value.
+ */
+static void wcd939x_init_reg_defaults(struct wcd939x_priv *wcd939x)
+{
+	const struct reg_default *def = wcd939x_regmap_config.reg_defaults;
+	int i;
+
+	wcd939x->reg_def = devm_kcalloc(wcd939x->dev, WCD939X_NUM_REGISTERS,
+					sizeof(*wcd939x->reg_def), GFP_KERNEL);
+	if (!wcd939x->reg_def)
+		return;
+
+	for (i = 0; i < WCD939X_NUM_REGISTERS; i++)
+		wcd939x->reg_def[i] = WCD939X_REG_NO_DEFAULT;
+	for (i = 0; i < wcd939x_regmap_config.num_reg_defaults; i++)
+		wcd939x->reg_def[WCD939X_REG(def[i].reg)] = def[i].def;
+
+	if (wcd939x->version >= WCD939X_VERSION_1_1) {
+		for (i = 0; i < ARRAY_SIZE(reg_def_1_1); ++i)
+			wcd939x->reg_def[WCD939X_REG(reg_def_1_1[i].reg)] =
+							reg_def_1_1[i].def;
+	}
+
+	if (wcd939x->version == WCD939X_VERSION_2_0) {
+		for (i = 0; i < ARRAY_SIZE(reg_def_2_0); ++i)
+			wcd939x->reg_def[WCD939X_REG(reg_def_2_0[i].reg)] =
+							reg_def_2_0[i].def;
+	}
+}
+
 static int wcd939x_bind(struct device *dev)
 {
 	int ret = 0, i = 0;
@@ -5328,6 +5456,7 @@ static int wcd939x_bind(struct device *dev)
 		wcd_usbss_update_default_trim();
 #endif
 	wcd939x_update_regmap_cache(wcd939x);
+	wcd939x_init_reg_defaults(wcd939x);
 
 	/* Set all interupts as edge triggered */
 	for (i = 0; i < wcd939x_regmap_irq_chip.num_regs; i++)
@@ -27,6 +27,8 @@
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #include <linux/termios.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
 #include <ipc/gpr-lite.h>
 #include <dsp/spf-core.h>
 #include <dsp/msm_audio_ion.h>
@@ -53,6 +55,15 @@ static void *audio_pkt_ilctxt;
 static int audio_pkt_debug_mask;
 module_param_named(debug_mask, audio_pkt_debug_mask, int, 0664);
 
+/*
+ * When set, read() drains as many queued packets as fit in the user buffer,
+ * each one prefixed with its length as a u32, instead of returning a single
+ * packet per call. Read-only after load so the framing cannot change under
+ * a reader that already has the device open.
+ */
+static bool audio_pkt_batch_read;
+module_param_named(batch_read, audio_pkt_batch_read, bool, 0444);
+
 #define APM_CMD_SHARED_MEM_MAP_REGIONS		0x0100100C
 #define APM_MEMORY_MAP_BIT_MASK_IS_OFFSET_MODE	0x00000004UL
 enum {
@@ -79,6 +90,42 @@ do {									      \
 #define AUDPKT_DRIVER_NAME "aud_pasthru_adsp"
 #define CHANNEL_NAME "adsp_apps"
 #define MAX_PACKET_SIZE 4096
+/* small receive skbs are kept on a free list instead of being freed */
+#define AUDIO_PKT_RECYCLE_SKB_LEN 512
+#define AUDIO_PKT_RECYCLE_MAX 16
+
+struct audio_pkt_skb_cb {
+	ktime_t rx_time;
+	bool recycle;
+};
+
+#define AUDIO_PKT_SKB_CB(skb) ((struct audio_pkt_skb_cb *)(skb)->cb)
+
+/**
+ * struct audio_pkt_stats - receive/transmit counters of the audio pkt device
+ * @rx_pkts:		packets queued from the DSP
+ * @rx_dropped:		packets dropped for lack of an skb
+ * @rx_recycled:	packets received into a recycled skb
+ * @tx_pkts:		packets sent to the DSP
+ * @reads:		read() calls that returned data
+ * @read_pkts:		packets handed to userspace
+ * @queue_depth:	packets currently queued
+ * @max_queue_depth:	high-water mark of @queue_depth
+ * @total_latency_us:	sum of queue-to-user latencies
+ * @max_latency_us:	worst queue-to-user latency
+ */
+struct audio_pkt_stats {
+	u64 rx_pkts;
+	u64 rx_dropped;
+	u64 rx_recycled;
+	u64 tx_pkts;
+	u64 reads;
+	u64 read_pkts;
+	u32 queue_depth;
+	u32 max_queue_depth;
+	u64 total_latency_us;
+	u64 max_latency_us;
+};
 
 
 enum audio_pkt_state {
@@ -96,6 +143,10 @@ enum audio_pkt_state {
  * @queue_lock:	synchronization of @queue operations
  * @queue:	incoming message queue
  * @readq:	wait object for incoming queue
+ * @recycleq:	free list of small receive skbs
+ * @wbuf:	bounce buffer for outgoing packets, protected by @lock
+ * @stats:	packet counters, protected by @queue_lock
+ * @debugfs:	debugfs directory of the device
  * @dev_name:	/dev/@dev_name for audio_pkt device
  * @ch_name:	audio channel to match to
  * @audio_pkt_major: Major number of audio pkt driver
@@ -109,6 +160,10 @@ struct audio_pkt_device {
 	spinlock_t queue_lock;
 	struct sk_buff_head queue;
 	wait_queue_head_t readq;
+	struct sk_buff_head recycleq;
+	void *wbuf;
+	struct audio_pkt_stats stats;
+	struct dentry *debugfs;
 
 	char dev_name[20];
 	char ch_name[20];
@@ -159,6 +214,96 @@ struct audio_pkt_clnt_ch {
 	audio_pkt_clnt_cb_fn func;
 };
 
+static struct sk_buff *audio_pkt_alloc_skb(struct audio_pkt_device *audpkt_dev,
+					   uint16_t pkt_size, bool *recycled)
+{
+	struct sk_buff *skb;
+	bool recycle = pkt_size <= AUDIO_PKT_RECYCLE_SKB_LEN;
+
+	if (recycle) {
+		skb = skb_dequeue(&audpkt_dev->recycleq);
+		if (skb) {
+			*recycled = true;
+			return skb;
+		}
+	}
+
+	skb = alloc_skb(recycle ? AUDIO_PKT_RECYCLE_SKB_LEN : pkt_size,
+			GFP_ATOMIC);
+	if (skb)
+		AUDIO_PKT_SKB_CB(skb)->recycle = recycle;
+
+	return skb;
+}
+
+static void audio_pkt_free_skb(struct audio_pkt_device *audpkt_dev,
+			       struct sk_buff *skb)
+{
+#ifdef OPLUS_ARCH_EXTENDS
+	if (skb == gskb) {
+		// clear gskb
+		skb_reset_tail_pointer(gskb);
+		skb_trim(gskb, 0);
+		gskb_used = false;
+		return;
+	}
+#endif /* OPLUS_ARCH_EXTENDS */
+	if (AUDIO_PKT_SKB_CB(skb)->recycle &&
+	    skb_queue_len(&audpkt_dev->recycleq) < AUDIO_PKT_RECYCLE_MAX) {
+		skb_reset_tail_pointer(skb);
+		skb_trim(skb, 0);
+		skb_queue_tail(&audpkt_dev->recycleq, skb);
+		return;
+	}
+	kfree_skb(skb);
+}
+
+/* Drop all queued packets, caller holds queue_lock */
+static void audio_pkt_purge_queue_locked(struct audio_pkt_device *audpkt_dev)
+{
+	struct sk_buff *skb;
+
+	while (!skb_queue_empty(&audpkt_dev->queue)) {
+		skb = skb_dequeue(&audpkt_dev->queue);
+		audio_pkt_free_skb(audpkt_dev, skb);
+	}
+	audpkt_dev->stats.queue_depth = 0;
+}
+
+/* Dequeue the oldest packet, caller holds queue_lock */
+static struct sk_buff *audio_pkt_dequeue_locked(
+				struct audio_pkt_device *audpkt_dev)
+{
+	struct sk_buff *skb = skb_dequeue(&audpkt_dev->queue);
+
+	if (skb)
+		audpkt_dev->stats.queue_depth--;
+
+	return skb;
+}
+
+/* Put back a packet that did not fit, caller holds queue_lock */
+static void audio_pkt_requeue_locked(struct audio_pkt_device *audpkt_dev,
+				     struct sk_buff *skb)
+{
+	skb_queue_head(&audpkt_dev->queue, skb);
+	audpkt_dev->stats.queue_depth++;
+}
+
+/* Account a packet handed to userspace, caller holds queue_lock */
+static void audio_pkt_account_read_locked(struct audio_pkt_device *audpkt_dev,
+					  struct sk_buff *skb)
+{
+	struct audio_pkt_stats *stats = &audpkt_dev->stats;
+	u64 lat_us = ktime_us_delta(ktime_get(),
+				    AUDIO_PKT_SKB_CB(skb)->rx_time);
+
+	stats->read_pkts++;
+	stats->total_latency_us += lat_us;
+	if (lat_us > stats->max_latency_us)
+		stats->max_latency_us = lat_us;
+}
+
 /**
  * audio_pkt_open() - open() syscall for the audio_pkt device
  * inode:	Pointer to the inode structure.
@@ -190,7 +335,6 @@ int audio_pkt_release(struct inode *inode, struct file *file)
 	struct audio_pkt_priv *ap_priv = file->private_data;
 	struct audio_pkt_device *audpkt_dev = ap_priv->ap_dev;
 
-	struct sk_buff *skb;
 	unsigned long flags;
 
 	if ((!audpkt_dev)) {
@@ -202,21 +346,7 @@ int audio_pkt_release(struct inode *inode, struct file *file)
 	spin_lock_irqsave(&audpkt_dev->queue_lock, flags);
 
 	/* Discard all SKBs */
-	while (!skb_queue_empty(&audpkt_dev->queue)) {
-		skb = skb_dequeue(&audpkt_dev->queue);
-#ifndef OPLUS_ARCH_EXTENDS
-		kfree_skb(skb);
-#else /* OPLUS_ARCH_EXTENDS */
-		if (skb != gskb) {
-			kfree_skb(skb);
-		} else {
-			// clear gskb
-			skb_reset_tail_pointer(gskb);
-			skb_trim(gskb, 0);
-			gskb_used = false;
-		}
-#endif /* OPLUS_ARCH_EXTENDS */
-	}
+	audio_pkt_purge_queue_locked(audpkt_dev);
 	wake_up_interruptible(&audpkt_dev->readq);
 	spin_unlock_irqrestore(&audpkt_dev->queue_lock, flags);
 
@@ -232,7 +362,6 @@ static int audio_pkt_internal_release(struct platform_device *adev)
 {
 	struct audio_pkt_priv *ap_priv = platform_get_drvdata(adev);
 	struct audio_pkt_device *audpkt_dev = ap_priv->ap_dev;
-	struct sk_buff *skb;
 	unsigned long flags;
 
 	if ((!audpkt_dev)) {
@@ -243,21 +372,7 @@ static int audio_pkt_internal_release(struct platform_device *adev)
 	AUDIO_PKT_INFO("%s: for %s\n", __func__,audpkt_dev->ch_name);
 	spin_lock_irqsave(&audpkt_dev->queue_lock, flags);
 	/* Discard all SKBs */
-	while (!skb_queue_empty(&audpkt_dev->queue)) {
-		skb = skb_dequeue(&audpkt_dev->queue);
-#ifndef OPLUS_ARCH_EXTENDS
-		kfree_skb(skb);
-#else /* OPLUS_ARCH_EXTENDS */
-		if (skb != gskb) {
-			kfree_skb(skb);
-		} else {
-			// clear gskb
-			skb_reset_tail_pointer(gskb);
-			skb_trim(gskb, 0);
-			gskb_used = false;
-		}
-#endif /* OPLUS_ARCH_EXTENDS */
-	}
+	audio_pkt_purge_queue_locked(audpkt_dev);
 	spin_unlock_irqrestore(&audpkt_dev->queue_lock, flags);
 
 	wake_up_interruptible(&audpkt_dev->readq);
@@ -265,6 +380,45 @@ static int audio_pkt_internal_release(struct platform_device *adev)
 	return 0;
 }
 
+/*
+ * Copy @skb and as many further queued packets as fit into @buf, each one
+ * preceded by its length. A packet that does not fit is left at the head of
+ * the queue for the next read.
+ */
+static ssize_t audio_pkt_read_batch(struct audio_pkt_device *audpkt_dev,
+				    struct sk_buff *skb, char __user *buf,
+				    size_t count)
+{
+	unsigned long flags;
+	size_t used = 0;
+	uint32_t len;
+
+	while (skb) {
+		len = skb->len;
+		if (used + sizeof(len) + len > count) {
+			spin_lock_irqsave(&audpkt_dev->queue_lock, flags);
+			audio_pkt_requeue_locked(audpkt_dev, skb);
+			spin_unlock_irqrestore(&audpkt_dev->queue_lock, flags);
+			break;
+		}
+
+		if (copy_to_user(buf + used, &len, sizeof(len)) ||
+		    copy_to_user(buf + used + sizeof(len), skb->data, len)) {
+			audio_pkt_free_skb(audpkt_dev, skb);
+			return used ? used : -EFAULT;
+		}
+		used += sizeof(len) + len;
+
+		spin_lock_irqsave(&audpkt_dev->queue_lock, flags);
+		audio_pkt_account_read_locked(audpkt_dev, skb);
+		audio_pkt_free_skb(audpkt_dev, skb);
+		skb = audio_pkt_dequeue_locked(audpkt_dev);
+		spin_unlock_irqrestore(&audpkt_dev->queue_lock, flags);
+	}
+
+	return used ? used : -EMSGSIZE;
+}
+
 /**
  * audio_pkt_read() - read() syscall for the audio_pkt device
  * file:	Pointer to the file structure.
@@ -284,8 +438,7 @@ ssize_t audio_pkt_read(struct file *file, char __user *buf,
 
 	unsigned long flags;
 	struct sk_buff *skb;
-	int use;
-	uint32_t *temp;
+	ssize_t use;
 
 	if (!audpkt_dev) {
 		AUDIO_PKT_ERR("invalid device handle\n");
@@ -317,27 +470,25 @@ ssize_t audio_pkt_read(struct file *file, char __user *buf,
 		spin_lock_irqsave(&audpkt_dev->queue_lock, flags);
 	}
 
-	skb = skb_dequeue(&audpkt_dev->queue);
+	skb = audio_pkt_dequeue_locked(audpkt_dev);
+	if (skb)
+		audpkt_dev->stats.reads++;
 	spin_unlock_irqrestore(&audpkt_dev->queue_lock, flags);
 	if (!skb)
 		return -EFAULT;
 
+	if (audio_pkt_batch_read)
+		return audio_pkt_read_batch(audpkt_dev, skb, buf, count);
+
 	use = min_t(size_t, count, skb->len);
 	if (copy_to_user(buf, skb->data, use))
 		use = -EFAULT;
-	temp = (uint32_t *) skb->data;
-#ifndef OPLUS_ARCH_EXTENDS
-	kfree_skb(skb);
-#else /* OPLUS_ARCH_EXTENDS */
-	if (skb != gskb) {
-		kfree_skb(skb);
-	} else {
-		// clear gskb
-		skb_reset_tail_pointer(gskb);
-		skb_trim(gskb, 0);
-		gskb_used = false;
-	}
-#endif  /* OPLUS_ARCH_EXTENDS */
+
+	spin_lock_irqsave(&audpkt_dev->queue_lock, flags);
+	if (use >= 0)
+		audio_pkt_account_read_locked(audpkt_dev, skb);
+	audio_pkt_free_skb(audpkt_dev, skb);
+	spin_unlock_irqrestore(&audpkt_dev->queue_lock, flags);
 	return use;
 }
 
@@ -386,7 +537,7 @@ ssize_t audio_pkt_write(struct file *file, const char __user *buf,
 	struct audio_pkt_priv *ap_priv = NULL;
 	struct audio_pkt_device *audpkt_dev = NULL;
 	struct gpr_hdr *audpkt_hdr = NULL;
-	void *kbuf;
+	unsigned long flags;
 	int ret;
 
 	if (file == NULL || file->private_data == NULL || buf == NULL) {
@@ -414,52 +565,57 @@ ssize_t audio_pkt_write(struct file *file, const char __user *buf,
 		return  -EINVAL;
 	}
 
-	kbuf = memdup_user(buf, count);
-	if (IS_ERR(kbuf))
-		return PTR_ERR(kbuf);
+	if (count > MAX_PACKET_SIZE)
+		return -EINVAL;
 
-	audpkt_hdr = (struct gpr_hdr *) kbuf;
+	/* packets are staged in the preallocated wbuf, serialised by lock */
+	if (mutex_lock_interruptible(&audpkt_dev->lock))
+		return -ERESTARTSYS;
+
+	if (copy_from_user(audpkt_dev->wbuf, buf, count)) {
+		ret = -EFAULT;
+		goto unlock;
+	}
+
+	audpkt_hdr = (struct gpr_hdr *) audpkt_dev->wbuf;
 
 	/* validate packet size */
-	if ((count > MAX_PACKET_SIZE) || (count < GPR_PKT_GET_PACKET_BYTE_SIZE(audpkt_hdr->header)))
-	{
+	if (count < GPR_PKT_GET_PACKET_BYTE_SIZE(audpkt_hdr->header)) {
 		ret = -EINVAL;
-		goto free_kbuf;
+		goto unlock;
 	}
 
 	if (audpkt_hdr->opcode == APM_CMD_SHARED_MEM_MAP_REGIONS) {
 		if (count < sizeof(struct audio_gpr_pkt)) {
 			AUDIO_PKT_ERR("Invalid count %zu\n", count);
 			ret = -EINVAL;
-			goto free_kbuf;
+			goto unlock;
 		}
 		ret = audpkt_chk_and_update_physical_addr((struct audio_gpr_pkt *) audpkt_hdr);
 		if (ret < 0) {
 			AUDIO_PKT_ERR("Update Physical Address Failed -%d\n", ret);
-			goto free_kbuf;
+			goto unlock;
 		}
 	}
 
-	if (mutex_lock_interruptible(&audpkt_dev->lock)) {
-		ret = -ERESTARTSYS;
-		goto free_kbuf;
-	}
 	if (count < sizeof(struct gpr_pkt )) {
 		AUDIO_PKT_ERR("Invalid count %zu\n", count);
 		ret = -EINVAL;
-		mutex_unlock(&audpkt_dev->lock);
-		goto free_kbuf;
+		goto unlock;
 	}
-	ret = gpr_send_pkt(ap_priv->adev,(struct gpr_pkt *) kbuf);
+	ret = gpr_send_pkt(ap_priv->adev,(struct gpr_pkt *) audpkt_dev->wbuf);
 	if (ret < 0) {
 		AUDIO_PKT_ERR("APR Send Packet Failed ret -%d\n", ret);
 		if (ret == -ECONNRESET)
 			ret = -ENETRESET;
+	} else {
+		spin_lock_irqsave(&audpkt_dev->queue_lock, flags);
+		audpkt_dev->stats.tx_pkts++;
+		spin_unlock_irqrestore(&audpkt_dev->queue_lock, flags);
 	}
-	mutex_unlock(&audpkt_dev->lock);
 
-free_kbuf:
-	kfree(kbuf);
+unlock:
+	mutex_unlock(&audpkt_dev->lock);
 	return ret < 0 ? ret : count;
 }
 
@@ -496,6 +652,39 @@ static unsigned int audio_pkt_poll(struct file *file, poll_table *wait)
 	return mask;
 }
 
+static ssize_t audio_pkt_stats_read(struct file *file, char __user *ubuf,
+				    size_t count, loff_t *ppos)
+{
+	struct audio_pkt_device *audpkt_dev = file->private_data;
+	struct audio_pkt_stats stats;
+	unsigned long flags;
+	char buf[512];
+	int len;
+
+	spin_lock_irqsave(&audpkt_dev->queue_lock, flags);
+	stats = audpkt_dev->stats;
+	spin_unlock_irqrestore(&audpkt_dev->queue_lock, flags);
+
+	len = scnprintf(buf, sizeof(buf),
+			"rx_pkts: %llu\nrx_dropped: %llu\nrx_recycled: %llu\n"
+			"tx_pkts: %llu\nreads: %llu\nread_pkts: %llu\n"
+			"queue_depth: %u\nmax_queue_depth: %u\n"
+			"avg_latency_us: %llu\nmax_latency_us: %llu\n",
+			stats.rx_pkts, stats.rx_dropped, stats.rx_recycled,
+			stats.tx_pkts, stats.reads, stats.read_pkts,
+			stats.queue_depth, stats.max_queue_depth,
+			stats.read_pkts ?
+			div64_u64(stats.total_latency_us, stats.read_pkts) : 0,
+			stats.max_latency_us);
+
+	return simple_read_from_buffer(ubuf, count, ppos, buf, len);
+}
+
+static const struct file_operations audio_pkt_stats_fops = {
+	.open = simple_open,
+	.read = audio_pkt_stats_read,
+};
+
 static const struct file_operations audio_pkt_fops = {
 	.owner = THIS_MODULE,
 	.open = audio_pkt_open,
@@ -526,16 +715,21 @@ static int audio_pkt_srvc_callback(struct gpr_device *adev,
 #endif /* OPLUS_ARCH_EXTENDS */
 	struct gpr_hdr *hdr = (struct gpr_hdr *)data;
 	uint16_t hdr_size, pkt_size;
+	bool recycled = false;
 	hdr_size = GPR_PKT_GET_HEADER_BYTE_SIZE(hdr->header);
 	pkt_size = GPR_PKT_GET_PACKET_BYTE_SIZE(hdr->header);
 
     AUDIO_PKT_INFO("%s: header %d packet %d \n",
 		__func__,hdr_size, pkt_size);
 
-	skb = alloc_skb(pkt_size, GFP_ATOMIC);
+	skb = audio_pkt_alloc_skb(audpkt_dev, pkt_size, &recycled);
 #ifndef OPLUS_ARCH_EXTENDS
-	if (!skb)
+	if (!skb) {
+		spin_lock_irqsave(&audpkt_dev->queue_lock, flags);
+		audpkt_dev->stats.rx_dropped++;
+		spin_unlock_irqrestore(&audpkt_dev->queue_lock, flags);
 		return -ENOMEM;
+	}
 #else /* OPLUS_ARCH_EXTENDS */
 	if (!skb) {
 		AUDIO_PKT_ERR("alloc_skb failed, pkt_size = 0x%x, gskb_used = %d\n", pkt_size, gskb_used);
@@ -550,14 +744,23 @@ static int audio_pkt_srvc_callback(struct gpr_device *adev,
 
 	if (!skb) {
 		AUDIO_PKT_ERR("alloc_skb failed, pkt_size = 0x%x \n", pkt_size);
+		spin_lock_irqsave(&audpkt_dev->queue_lock, flags);
+		audpkt_dev->stats.rx_dropped++;
+		spin_unlock_irqrestore(&audpkt_dev->queue_lock, flags);
 		return -ENOMEM;
 	}
 #endif /* OPLUS_ARCH_EXTENDS */
 
 	skb_put_data(skb, data, pkt_size);
+	AUDIO_PKT_SKB_CB(skb)->rx_time = ktime_get();
 
 	spin_lock_irqsave(&audpkt_dev->queue_lock, flags);
 	skb_queue_tail(&audpkt_dev->queue, skb);
+	audpkt_dev->stats.rx_pkts++;
+	if (recycled)
+		audpkt_dev->stats.rx_recycled++;
+	if (++audpkt_dev->stats.queue_depth > audpkt_dev->stats.max_queue_depth)
+		audpkt_dev->stats.max_queue_depth = audpkt_dev->stats.queue_depth;
 	spin_unlock_irqrestore(&audpkt_dev->queue_lock, flags);
 
 	/* wake up any blocking processes, waiting for new data */
@@ -739,8 +942,15 @@ static int audio_pkt_platform_driver_probe(struct platform_device *pdev)
 
 	spin_lock_init(&audpkt_dev->queue_lock);
 	skb_queue_head_init(&audpkt_dev->queue);
+	skb_queue_head_init(&audpkt_dev->recycleq);
 	init_waitqueue_head(&audpkt_dev->readq);
 
+	audpkt_dev->wbuf = devm_kzalloc(&pdev->dev, MAX_PACKET_SIZE, GFP_KERNEL);
+	if (!audpkt_dev->wbuf) {
+		ret = -ENOMEM;
+		goto free_dev;
+	}
+
 	cdev_init(&audpkt_dev->cdev, &audio_pkt_fops);
 	audpkt_dev->cdev.owner = THIS_MODULE;
 
@@ -760,6 +970,12 @@ static int audio_pkt_platform_driver_probe(struct platform_device *pdev)
 	}
 
 	platform_set_drvdata(pdev, ap_priv);
+
+	audpkt_dev->debugfs = debugfs_create_dir(MODULE_NAME, NULL);
+	if (!IS_ERR_OR_NULL(audpkt_dev->debugfs))
+		debugfs_create_file("stats", 0444, audpkt_dev->debugfs,
+				    audpkt_dev, &audio_pkt_stats_fops);
+
 	AUDIO_PKT_INFO("Audio Packet Port Driver Initialized\n");
 
 	goto done;
@@ -798,6 +1014,8 @@ static int audio_pkt_platform_driver_remove(struct platform_device *adev)
 	audio_pkt_internal_release(adev);
 
 	if (audpkt_dev) {
+		debugfs_remove_recursive(audpkt_dev->debugfs);
+		skb_queue_purge(&audpkt_dev->recycleq);
 		cdev_del(&audpkt_dev->cdev);
 		device_destroy(audpkt_dev->audio_pkt_class,audpkt_dev->audio_pkt_major);
 		class_destroy(audpkt_dev->audio_pkt_class);
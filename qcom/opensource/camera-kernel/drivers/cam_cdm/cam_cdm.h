@@ -69,6 +69,7 @@
 
 /* BL_FIFO configurations*/
 #define CAM_CDM_BL_FIFO_LENGTH_MAX_DEFAULT 0x40
+#define CAM_CDM_SUBMIT_LAT_BUCKETS 16
 #define CAM_CDM_BL_FIFO_LENGTH_CFG_SHIFT 0x10
 #define CAM_CDM_BL_FIFO_FLUSH_SHIFT 0x3
 
@@ -494,6 +495,7 @@ struct cam_cdm_bl_cb_request_entry {
 	uint32_t client_hdl;
 	void *userdata;
 	uint32_t cookie;
+	uint64_t bl_seq;
 	struct list_head entry;
 };
 
@@ -503,7 +505,24 @@ struct cam_cdm_hw_intf_cmd_submit_bl {
 	struct cam_cdm_bl_request *data;
 };
 
-/* struct cam_cdm_bl_fifo - CDM hw memory struct */
+/**
+ * struct cam_cdm_bl_fifo - CDM hw memory struct
+ *
+ * @bl_complete:         completion signalled on BL done irq
+ * @work_queue:          workqueue for irq bottom half
+ * @bl_request_list:     list of submitted gen irq requests
+ * @fifo_lock:           lock protecting this fifo
+ * @bl_tag:              tag for the next BL
+ * @bl_depth:            number of BL entries in the fifo
+ * @last_bl_tag_done:    tag of the last gen irq BL completed
+ * @work_record:         number of bottom halves in flight
+ * @bl_submitted:        number of BLs committed to the fifo
+ * @bl_retired:          number of BLs known to be consumed by hw, updated
+ *                       from gen irq completions and pending count reads
+ * @credit_hits:         submissions that found credits without a hw read
+ * @credit_refills:      pending count reads on credit exhaustion
+ * @submit_lat_hist:     submission latency histogram, log2 us buckets
+ */
 struct cam_cdm_bl_fifo {
 	struct completion bl_complete;
 	struct workqueue_struct *work_queue;
@@ -513,6 +532,11 @@ struct cam_cdm_bl_fifo {
 	uint32_t bl_depth;
 	uint8_t last_bl_tag_done;
 	atomic_t work_record;
+	uint64_t bl_submitted;
+	uint64_t bl_retired;
+	uint64_t credit_hits;
+	uint64_t credit_refills;
+	uint64_t submit_lat_hist[CAM_CDM_SUBMIT_LAT_BUCKETS];
 };
 
 /**
@@ -18,6 +18,7 @@
 #include "cam_cdm.h"
 #include "cam_cdm_core_common.h"
 #include "cam_cdm_soc.h"
+#include "cam_cdm_util.h"
 #include "cam_io_util.h"
 #include "cam_cdm_hw_reg_1_0.h"
 #include "cam_cdm_hw_reg_1_1.h"
@@ -38,6 +39,13 @@
 #define CAM_CDM_FIFO_LEN_REG_TAG_SHIFT       24
 #define CAM_CDM_FIFO_LEN_REG_ARB_SHIFT       20
 
+/*
+ * CAM_CDM_COALESCE_* flags applied to mem handle BLs before they are
+ * submitted, 0 leaves the command buffers untouched
+ */
+static uint cam_cdm_coalesce_flags;
+module_param(cam_cdm_coalesce_flags, uint, 0644);
+
 static void cam_hw_cdm_work(struct work_struct *work);
 
 /* DT match table entry for all CDM variants*/
@@ -720,6 +728,39 @@ end:
 	return rc;
 }
 
+static inline uint32_t cam_hw_cdm_bl_fifo_credits(
+	struct cam_cdm_bl_fifo *bl_fifo)
+{
+	uint64_t in_flight = bl_fifo->bl_submitted - bl_fifo->bl_retired;
+
+	/* One slot is always kept free, same as the pending count check */
+	if (in_flight >= (bl_fifo->bl_depth - 1))
+		return 0;
+
+	return bl_fifo->bl_depth - 1 - in_flight;
+}
+
+static inline void cam_hw_cdm_bl_fifo_advance_tag(
+	struct cam_cdm_bl_fifo *bl_fifo)
+{
+	bl_fifo->bl_tag++;
+	bl_fifo->bl_tag %= (bl_fifo->bl_depth - 1);
+	bl_fifo->bl_submitted++;
+}
+
+static void cam_hw_cdm_update_submit_lat(
+	struct cam_cdm_bl_fifo *bl_fifo, ktime_t start)
+{
+	int bucket = 0;
+	s64 us = ktime_us_delta(ktime_get(), start);
+
+	if (us > 0)
+		bucket = min_t(int, ilog2(us) + 1,
+			CAM_CDM_SUBMIT_LAT_BUCKETS - 1);
+
+	bl_fifo->submit_lat_hist[bucket]++;
+}
+
 int cam_hw_cdm_wait_for_bl_fifo(
 		struct cam_hw_info *cdm_hw,
 		uint32_t            bl_count,
@@ -742,12 +783,30 @@ int cam_hw_cdm_wait_for_bl_fifo(
 
 	bl_fifo = &core->bl_fifo[fifo_idx];
 
+	/*
+	 * Credits are a lower bound on the free slots, so the pending count
+	 * is only read from hw once they are used up.
+	 */
+	available_bl_slots = cam_hw_cdm_bl_fifo_credits(bl_fifo);
+	if (available_bl_slots) {
+		bl_fifo->credit_hits++;
+		CAM_DBG(CAM_CDM, "BL credits available=%d requested=%d",
+			available_bl_slots, bl_count);
+		rc = available_bl_slots;
+		goto end;
+	}
+
 	do {
 		if (cam_hw_cdm_bl_fifo_pending_bl_rb_in_fifo(cdm_hw, fifo_idx, &pending_bl)) {
 			CAM_ERR(CAM_CDM, "Failed to read CDM pending BL's");
 			rc = -EIO;
 			break;
 		}
+		bl_fifo->credit_refills++;
+		if ((pending_bl <= bl_fifo->bl_submitted) &&
+			((bl_fifo->bl_submitted - pending_bl) > bl_fifo->bl_retired))
+			bl_fifo->bl_retired = bl_fifo->bl_submitted - pending_bl;
+
 		available_bl_slots = bl_fifo->bl_depth - pending_bl;
 		if (available_bl_slots < 0) {
 			CAM_ERR(CAM_CDM, "Invalid available slots %d:%d:%d",
@@ -885,6 +944,7 @@ int cam_hw_cdm_submit_gen_irq(
 	node->client_hdl = req->handle;
 	node->cookie = cdm_cmd->cookie;
 	node->bl_tag = core->bl_fifo[fifo_idx].bl_tag;
+	node->bl_seq = core->bl_fifo[fifo_idx].bl_submitted + 1;
 	node->userdata = cdm_cmd->userdata;
 	list_add_tail(&node->entry, &core->bl_fifo[fifo_idx].bl_request_list);
 
@@ -1007,10 +1067,49 @@ int cam_hw_cdm_submit_debug_gen_irq(
 	return rc;
 }
 
+static void cam_hw_cdm_coalesce_bl(struct cam_cdm_bl_cmd *bl_cmd,
+	uint32_t flags)
+{
+	uintptr_t cpu_addr = 0;
+	size_t buf_len = 0;
+	uint32_t new_len;
+	int rc;
+
+	rc = cam_mem_get_cpu_buf(bl_cmd->bl_addr.mem_handle, &cpu_addr,
+		&buf_len);
+	if (rc) {
+		CAM_DBG(CAM_CDM, "No CPU addr for hdl 0x%x, BL not coalesced",
+			bl_cmd->bl_addr.mem_handle);
+		return;
+	}
+
+	if ((buf_len < bl_cmd->offset) ||
+		((buf_len - bl_cmd->offset) < bl_cmd->len) ||
+		(bl_cmd->offset % 4) || (bl_cmd->len % 4))
+		goto put_cpu_buf;
+
+	rc = cam_cdm_util_coalesce_cmd_buf(
+		(uint32_t *)(cpu_addr + bl_cmd->offset), bl_cmd->len, flags,
+		&new_len);
+	if (rc) {
+		CAM_WARN(CAM_CDM, "Coalesce failed for hdl 0x%x rc: %d",
+			bl_cmd->bl_addr.mem_handle, rc);
+		goto put_cpu_buf;
+	}
+
+	CAM_DBG(CAM_CDM, "hdl 0x%x coalesced %u -> %u bytes",
+		bl_cmd->bl_addr.mem_handle, bl_cmd->len, new_len);
+	bl_cmd->len = new_len;
+
+put_cpu_buf:
+	cam_mem_put_cpu_buf(bl_cmd->bl_addr.mem_handle);
+}
+
 int cam_hw_cdm_submit_bl(struct cam_hw_info *cdm_hw,
 	struct cam_cdm_hw_intf_cmd_submit_bl *req,
 	struct cam_cdm_client *client)
 {
+	uint32_t coalesce_flags = READ_ONCE(cam_cdm_coalesce_flags);
 	unsigned int i;
 	int rc = 0;
 	struct cam_cdm_bl_request *cdm_cmd = req->data;
@@ -1018,6 +1117,7 @@ int cam_hw_cdm_submit_bl(struct cam_hw_info *cdm_hw,
 	struct cam_cdm_bl_fifo *bl_fifo = NULL;
 	uint32_t fifo_idx = 0;
 	int write_count = 0;
+	ktime_t start = ktime_get();
 
 	fifo_idx = CAM_CDM_GET_BLFIFO_IDX(client->handle);
 
@@ -1139,6 +1239,11 @@ int cam_hw_cdm_submit_bl(struct cam_hw_info *cdm_hw,
 			CAM_DBG(CAM_CDM, "Got the hwva: %pK, type: %u",
 				hw_vaddr_ptr, req->data->type);
 
+			if (coalesce_flags &&
+				(req->data->type == CAM_CDM_BL_CMD_TYPE_MEM_HANDLE))
+				cam_hw_cdm_coalesce_bl(&cdm_cmd->cmd[i],
+					coalesce_flags);
+
 			rc = cam_hw_cdm_bl_write(cdm_hw,
 				((uint32_t)hw_vaddr_ptr + cdm_cmd->cmd[i].offset),
 				(cdm_cmd->cmd[i].len - 1),
@@ -1164,8 +1269,7 @@ int cam_hw_cdm_submit_bl(struct cam_hw_info *cdm_hw,
 				core->bl_fifo[fifo_idx].bl_tag);
 
 			write_count--;
-			core->bl_fifo[fifo_idx].bl_tag++;
-			core->bl_fifo[fifo_idx].bl_tag %= (bl_fifo->bl_depth - 1);
+			cam_hw_cdm_bl_fifo_advance_tag(bl_fifo);
 
 			if (cdm_cmd->cmd[i].enable_debug_gen_irq) {
 				if (write_count == 0) {
@@ -1185,8 +1289,7 @@ int cam_hw_cdm_submit_bl(struct cam_hw_info *cdm_hw,
 						"Commit success for Dbg_GenIRQ_BL, Tag: %d",
 						core->bl_fifo[fifo_idx].bl_tag);
 					write_count--;
-					core->bl_fifo[fifo_idx].bl_tag++;
-					core->bl_fifo[fifo_idx].bl_tag %= (bl_fifo->bl_depth - 1);
+					cam_hw_cdm_bl_fifo_advance_tag(bl_fifo);
 				} else {
 					CAM_WARN(CAM_CDM,
 						"Failed in submitting the debug gen entry. rc: %d",
@@ -1217,8 +1320,7 @@ int cam_hw_cdm_submit_bl(struct cam_hw_info *cdm_hw,
 				if (!rc) {
 					CAM_DBG(CAM_CDM, "Commit success for GenIRQ_BL, Tag: %d",
 						core->bl_fifo[fifo_idx].bl_tag);
-					core->bl_fifo[fifo_idx].bl_tag++;
-					core->bl_fifo[fifo_idx].bl_tag %= (bl_fifo->bl_depth - 1);
+					cam_hw_cdm_bl_fifo_advance_tag(bl_fifo);
 				}
 			}
 		} else {
@@ -1230,6 +1332,7 @@ int cam_hw_cdm_submit_bl(struct cam_hw_info *cdm_hw,
 			break;
 		}
 	}
+	cam_hw_cdm_update_submit_lat(bl_fifo, start);
 	mutex_unlock(&client->lock);
 	mutex_unlock(&core->bl_fifo[fifo_idx].fifo_lock);
 
@@ -1287,6 +1390,8 @@ static void cam_hw_cdm_reset_cleanup(
 		}
 		core->bl_fifo[i].bl_tag = 0;
 		core->bl_fifo[i].last_bl_tag_done = -1;
+		core->bl_fifo[i].bl_submitted = 0;
+		core->bl_fifo[i].bl_retired = 0;
 		atomic_set(&core->bl_fifo[i].work_record, 0);
 	}
 }
@@ -1368,6 +1473,11 @@ static void cam_hw_cdm_work(struct work_struct *work)
 
 				list_del_init(&node->entry);
 				if (node->bl_tag == payload->irq_data) {
+					/* All BLs up to this gen irq are consumed */
+					if (node->bl_seq >
+						core->bl_fifo[fifo_idx].bl_retired)
+						core->bl_fifo[fifo_idx].bl_retired =
+							node->bl_seq;
 					kfree(node);
 					node = NULL;
 					break;
@@ -2021,6 +2131,8 @@ int cam_hw_cdm_init(void *hw_priv,
 	}
 	for (i = 0; i < cdm_core->offsets->reg_data->num_bl_fifo; i++) {
 		cdm_core->bl_fifo[i].last_bl_tag_done = -1;
+		cdm_core->bl_fifo[i].bl_submitted = 0;
+		cdm_core->bl_fifo[i].bl_retired = 0;
 		atomic_set(&cdm_core->bl_fifo[i].work_record, 0);
 	}
 
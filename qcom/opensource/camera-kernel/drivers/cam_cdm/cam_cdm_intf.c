@@ -10,6 +10,7 @@
 #include <linux/module.h>
 #include <linux/timer.h>
 #include <linux/kernel.h>
+#include <linux/seq_file.h>
 
 #include "cam_cdm_intf_api.h"
 #include "cam_cdm.h"
@@ -19,6 +20,8 @@
 #include "cam_cdm_core_common.h"
 #include "camera_main.h"
 
+#define CAM_CDM_COALESCE_TEST_MAX_ITER 10000
+
 static struct cam_cdm_intf_mgr cdm_mgr;
 static DEFINE_MUTEX(cam_cdm_mgr_lock);
 
@@ -671,6 +674,72 @@ static int cam_cdm_get_irq_line_test(void *data, u64 *val)
 DEFINE_DEBUGFS_ATTRIBUTE(cam_cdm_irq_line_test, cam_cdm_get_irq_line_test,
 	cam_cdm_set_irq_line_test, "%16llu");
 
+static int cam_cdm_set_coalesce_test(void *data, u64 val)
+{
+	/* The value written is the number of random streams to check */
+	return cam_cdm_util_coalesce_self_test(
+		clamp_t(u64, val, 1, CAM_CDM_COALESCE_TEST_MAX_ITER),
+		get_random_u32());
+}
+
+static int cam_cdm_get_coalesce_test(void *data, u64 *val)
+{
+	return 0;
+}
+
+DEFINE_DEBUGFS_ATTRIBUTE(cam_cdm_coalesce_test, cam_cdm_get_coalesce_test,
+	cam_cdm_set_coalesce_test, "%16llu");
+
+static int cam_cdm_bl_fifo_stats_show(struct seq_file *m, void *data)
+{
+	int i, j, k;
+	struct cam_hw_intf *hw_intf;
+	struct cam_hw_info *cdm_hw;
+	struct cam_cdm *core;
+	struct cam_cdm_bl_fifo *bl_fifo;
+
+	if (get_cdm_mgr_refcount()) {
+		CAM_ERR(CAM_CDM, "CDM intf mgr get refcount failed");
+		return -EPERM;
+	}
+	mutex_lock(&cam_cdm_mgr_lock);
+
+	seq_puts(m, "submit latency buckets: [0] <1us, [n] 2^(n-1)..2^n us\n");
+	for (i = 0; i < CAM_CDM_INTF_MGR_MAX_SUPPORTED_CDM; i++) {
+		hw_intf = cdm_mgr.nodes[i].device;
+		if (!hw_intf || (hw_intf->hw_type != CAM_HW_CDM))
+			continue;
+
+		cdm_hw = hw_intf->hw_priv;
+		core = (struct cam_cdm *)cdm_hw->core_info;
+
+		for (j = 0; j < core->offsets->reg_data->num_bl_fifo; j++) {
+			bl_fifo = &core->bl_fifo[j];
+			if (!bl_fifo->bl_depth)
+				continue;
+
+			mutex_lock(&bl_fifo->fifo_lock);
+			seq_printf(m,
+				"%s%u fifo%d: depth %u submitted %llu retired %llu credit_hits %llu credit_refills %llu\n",
+				cdm_hw->soc_info.label_name, cdm_hw->soc_info.index,
+				j, bl_fifo->bl_depth, bl_fifo->bl_submitted,
+				bl_fifo->bl_retired, bl_fifo->credit_hits,
+				bl_fifo->credit_refills);
+			seq_puts(m, "  submit_lat:");
+			for (k = 0; k < CAM_CDM_SUBMIT_LAT_BUCKETS; k++)
+				seq_printf(m, " %llu", bl_fifo->submit_lat_hist[k]);
+			seq_puts(m, "\n");
+			mutex_unlock(&bl_fifo->fifo_lock);
+		}
+	}
+
+	mutex_unlock(&cam_cdm_mgr_lock);
+	put_cdm_mgr_refcount();
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(cam_cdm_bl_fifo_stats);
+
 int cam_cdm_debugfs_init(struct cam_cdm_intf_mgr *mgr)
 {
 	struct dentry *dbgfileptr = NULL;
@@ -690,6 +759,12 @@ int cam_cdm_debugfs_init(struct cam_cdm_intf_mgr *mgr)
 	debugfs_create_file("test_irq_line", 0644,
 		mgr->dentry, NULL, &cam_cdm_irq_line_test);
 
+	debugfs_create_file("test_coalesce", 0644,
+		mgr->dentry, NULL, &cam_cdm_coalesce_test);
+
+	debugfs_create_file("bl_fifo_stats", 0444,
+		mgr->dentry, NULL, &cam_cdm_bl_fifo_stats_fops);
+
 	return 0;
 }
 
@@ -8,10 +8,13 @@
 #include <linux/kernel.h>
 #include <linux/errno.h>
 #include <linux/bug.h>
+#include <linux/sort.h>
+#include <linux/mm.h>
 
 #include "cam_cdm_intf_api.h"
 #include "cam_cdm_util.h"
 #include "cam_cdm.h"
+#include "cam_cdm_virtual.h"
 #include "cam_io_util.h"
 
 #define CAM_CDM_DWORD 4
@@ -25,6 +28,15 @@
 #define CAM_CDM_DMI_DATA_LO_OFFSET   12
 #define CAM_CDM_REG_RANDOM_CMD_WORDS 2
 
+#define CAM_CDM_COALESCE_MIN_RUN     3
+#define CAM_CDM_COALESCE_MAX_RUN     64
+
+#define CAM_CDM_COALESCE_TEST_BLOCKS     2
+#define CAM_CDM_COALESCE_TEST_BLOCK_SIZE 0x400
+#define CAM_CDM_COALESCE_TEST_CAM_BASE   0x00AC0000
+#define CAM_CDM_COALESCE_TEST_MAX_WORDS  1024
+#define CAM_CDM_COALESCE_TEST_MAX_CMD    16
+
 static unsigned int CDMCmdHeaderSizes[
 	CAM_CDM_CMD_PRIVATE_BASE + CAM_CDM_SW_CMD_COUNT] = {
 	0, /* UNUSED*/
@@ -441,6 +453,517 @@ uint32_t *cam_cdm_write_wait_prefetch_disable(
 	return pCmdBuffer;
 }
 
+/**
+ * struct cam_cdm_coalesce_write - Single register write seen by the coalescer
+ * @offset: Register offset
+ * @value:  Value written
+ * @idx:    Position of the write within its segment
+ * @live:   Write is not overwritten later in the segment
+ */
+struct cam_cdm_coalesce_write {
+	uint32_t offset;
+	uint32_t value;
+	uint32_t idx;
+	bool     live;
+};
+
+/**
+ * struct cam_cdm_coalesce_ctx - State of one coalescing pass
+ * @writes:      Register writes of the current segment
+ * @sorted:      Scratch copy of @writes used for dead write detection
+ * @num_writes:  Number of writes in the current segment
+ * @out:         Output command stream
+ * @out_words:   Words emitted to @out
+ * @max_words:   Size of @out in words
+ * @rand_hdr:    Header of the open REG_RANDOM command, NULL if none
+ * @flags:       CAM_CDM_COALESCE_* flags
+ * @num_dropped: Writes dropped as dead
+ * @num_merged:  Writes emitted as part of a REG_CONT run
+ */
+struct cam_cdm_coalesce_ctx {
+	struct cam_cdm_coalesce_write *writes;
+	struct cam_cdm_coalesce_write *sorted;
+	uint32_t  num_writes;
+	uint32_t *out;
+	uint32_t  out_words;
+	uint32_t  max_words;
+	struct cdm_regrandom_cmd *rand_hdr;
+	uint32_t  flags;
+	uint32_t  num_dropped;
+	uint32_t  num_merged;
+};
+
+static int cam_cdm_util_coalesce_cmp(const void *a, const void *b)
+{
+	const struct cam_cdm_coalesce_write *wa = a;
+	const struct cam_cdm_coalesce_write *wb = b;
+
+	if (wa->offset != wb->offset)
+		return (wa->offset < wb->offset) ? -1 : 1;
+
+	return (wa->idx < wb->idx) ? -1 : 1;
+}
+
+static int cam_cdm_util_coalesce_emit_random(
+	struct cam_cdm_coalesce_ctx *ctx, struct cam_cdm_coalesce_write *wr)
+{
+	if (ctx->rand_hdr && (ctx->rand_hdr->count == CAM_CMD_LENGTH_MASK))
+		ctx->rand_hdr = NULL;
+
+	if (!ctx->rand_hdr) {
+		if ((ctx->out_words + CDMCmdHeaderSizes[CAM_CDM_CMD_REG_RANDOM]) >
+			ctx->max_words)
+			return -ENOSPC;
+
+		ctx->rand_hdr = (struct cdm_regrandom_cmd *)
+			(ctx->out + ctx->out_words);
+		ctx->rand_hdr->count = 0;
+		ctx->rand_hdr->reserved = 0;
+		ctx->rand_hdr->cmd = CAM_CDM_CMD_REG_RANDOM;
+		ctx->out_words += CDMCmdHeaderSizes[CAM_CDM_CMD_REG_RANDOM];
+	}
+
+	if ((ctx->out_words + CAM_CDM_REG_RANDOM_CMD_WORDS) > ctx->max_words)
+		return -ENOSPC;
+
+	ctx->out[ctx->out_words++] = wr->offset;
+	ctx->out[ctx->out_words++] = wr->value;
+	ctx->rand_hdr->count++;
+
+	return 0;
+}
+
+static int cam_cdm_util_coalesce_emit_cont(
+	struct cam_cdm_coalesce_ctx *ctx, struct cam_cdm_coalesce_write **run,
+	uint32_t run_len)
+{
+	uint32_t i;
+	struct cdm_regcontinuous_cmd *hdr;
+
+	if ((ctx->out_words + cam_cdm_required_size_reg_continuous(run_len)) >
+		ctx->max_words)
+		return -ENOSPC;
+
+	hdr = (struct cdm_regcontinuous_cmd *)(ctx->out + ctx->out_words);
+	hdr->count = run_len;
+	hdr->reserved0 = 0;
+	hdr->cmd = CAM_CDM_CMD_REG_CONT;
+	hdr->offset = run[0]->offset;
+	hdr->reserved1 = 0;
+	ctx->out_words += CDMCmdHeaderSizes[CAM_CDM_CMD_REG_CONT];
+
+	for (i = 0; i < run_len; i++)
+		ctx->out[ctx->out_words++] = run[i]->value;
+
+	/* Keep later random writes behind this run */
+	ctx->rand_hdr = NULL;
+	ctx->num_merged += run_len;
+
+	return 0;
+}
+
+static int cam_cdm_util_coalesce_flush(struct cam_cdm_coalesce_ctx *ctx)
+{
+	struct cam_cdm_coalesce_write *run[CAM_CDM_COALESCE_MAX_RUN];
+	struct cam_cdm_coalesce_write *wr;
+	uint32_t i, j, run_len;
+	int rc;
+
+	if (!ctx->num_writes)
+		return 0;
+
+	for (i = 0; i < ctx->num_writes; i++)
+		ctx->writes[i].live = true;
+
+	/*
+	 * A write is dead if the same register is written again later in the
+	 * segment. Sorting by offset and then position leaves only the last
+	 * write of each register live.
+	 */
+	if (ctx->flags & CAM_CDM_COALESCE_DROP_DEAD) {
+		memcpy(ctx->sorted, ctx->writes,
+			ctx->num_writes * sizeof(*ctx->writes));
+		sort(ctx->sorted, ctx->num_writes, sizeof(*ctx->sorted),
+			cam_cdm_util_coalesce_cmp, NULL);
+		for (i = 0; i + 1 < ctx->num_writes; i++) {
+			if (ctx->sorted[i].offset == ctx->sorted[i + 1].offset) {
+				ctx->writes[ctx->sorted[i].idx].live = false;
+				ctx->num_dropped++;
+			}
+		}
+	}
+
+	/*
+	 * Emit in program order. Writes to ascending consecutive registers
+	 * become one REG_CONT once the run is long enough to be smaller than
+	 * the reg/value pairs, everything else goes out as REG_RANDOM.
+	 */
+	i = 0;
+	while (i < ctx->num_writes) {
+		wr = &ctx->writes[i++];
+		if (!wr->live)
+			continue;
+
+		run[0] = wr;
+		run_len = 1;
+		j = i;
+		if (ctx->flags & CAM_CDM_COALESCE_MERGE) {
+			while ((j < ctx->num_writes) &&
+				(run_len < CAM_CDM_COALESCE_MAX_RUN)) {
+				if (!ctx->writes[j].live) {
+					j++;
+					continue;
+				}
+				if (ctx->writes[j].offset !=
+					(run[run_len - 1]->offset + CAM_CDM_DWORD))
+					break;
+				run[run_len++] = &ctx->writes[j++];
+			}
+		}
+
+		if (run_len >= CAM_CDM_COALESCE_MIN_RUN) {
+			rc = cam_cdm_util_coalesce_emit_cont(ctx, run, run_len);
+			if (rc)
+				return rc;
+			i = j;
+			continue;
+		}
+
+		rc = cam_cdm_util_coalesce_emit_random(ctx, wr);
+		if (rc)
+			return rc;
+	}
+
+	ctx->num_writes = 0;
+	ctx->rand_hdr = NULL;
+
+	return 0;
+}
+
+int cam_cdm_util_coalesce_cmd_buf(uint32_t *cmd_buf, uint32_t cmd_buf_size,
+	uint32_t flags, uint32_t *new_size)
+{
+	struct cam_cdm_coalesce_ctx ctx = {0};
+	struct cdm_regcontinuous_cmd *reg_cont;
+	struct cdm_regrandom_cmd *reg_random;
+	struct cam_cdm_coalesce_write *wr;
+	uint32_t num_words, pos = 0, cmd_words, cmd, i;
+	int rc = 0;
+
+	if (!cmd_buf || !new_size || !cmd_buf_size ||
+		(cmd_buf_size % CAM_CDM_DWORD)) {
+		CAM_ERR(CAM_CDM, "Invalid args buf: %pK size: %u",
+			cmd_buf, cmd_buf_size);
+		return -EINVAL;
+	}
+
+	*new_size = cmd_buf_size;
+	num_words = cmd_buf_size / CAM_CDM_DWORD;
+
+	/* Every register write takes at least one word of the input */
+	ctx.writes = kvcalloc(2 * num_words, sizeof(*ctx.writes), GFP_KERNEL);
+	ctx.out = kvmalloc(cmd_buf_size, GFP_KERNEL);
+	if (!ctx.writes || !ctx.out) {
+		rc = -ENOMEM;
+		goto end;
+	}
+	ctx.sorted = ctx.writes + num_words;
+	ctx.max_words = num_words;
+	ctx.flags = flags;
+
+	while (pos < num_words) {
+		cmd = cmd_buf[pos] >> CAM_CDM_COMMAND_OFFSET;
+
+		switch (cmd) {
+		case CAM_CDM_CMD_REG_CONT:
+			reg_cont = (struct cdm_regcontinuous_cmd *)&cmd_buf[pos];
+			cmd_words = cam_cdm_required_size_reg_continuous(
+				reg_cont->count);
+			if (!cmd_words || ((pos + cmd_words) > num_words)) {
+				rc = -EINVAL;
+				goto end;
+			}
+
+			for (i = 0; i < reg_cont->count; i++) {
+				wr = &ctx.writes[ctx.num_writes];
+				wr->offset = reg_cont->offset + (i * CAM_CDM_DWORD);
+
+				/* A merged run could not encode it again */
+				if (wr->offset & ~CAM_CDM_REG_OFFSET_MASK) {
+					rc = -EOPNOTSUPP;
+					goto end;
+				}
+
+				wr->value = cmd_buf[pos +
+					CDMCmdHeaderSizes[CAM_CDM_CMD_REG_CONT] + i];
+				wr->idx = ctx.num_writes++;
+			}
+			pos += cmd_words;
+			continue;
+		case CAM_CDM_CMD_REG_RANDOM:
+			reg_random = (struct cdm_regrandom_cmd *)&cmd_buf[pos];
+			cmd_words = cam_cdm_required_size_reg_random(
+				reg_random->count);
+			if (!reg_random->count || ((pos + cmd_words) > num_words)) {
+				rc = -EINVAL;
+				goto end;
+			}
+
+			for (i = 0; i < reg_random->count; i++) {
+				uint32_t *pair = &cmd_buf[pos +
+					CDMCmdHeaderSizes[CAM_CDM_CMD_REG_RANDOM] +
+					(i * CAM_CDM_REG_RANDOM_CMD_WORDS)];
+
+				/* Leave streams using the upper offset bits alone */
+				if (pair[0] & ~CAM_CDM_REG_OFFSET_MASK) {
+					rc = -EOPNOTSUPP;
+					goto end;
+				}
+
+				wr = &ctx.writes[ctx.num_writes];
+				wr->offset = pair[0];
+				wr->value = pair[1];
+				wr->idx = ctx.num_writes++;
+			}
+			pos += cmd_words;
+			continue;
+		case CAM_CDM_CMD_DMI:
+		case CAM_CDM_CMD_DMI_32:
+		case CAM_CDM_CMD_DMI_64:
+		case CAM_CDM_CMD_BUFF_INDIRECT:
+		case CAM_CDM_CMD_GEN_IRQ:
+		case CAM_CDM_CMD_WAIT_EVENT:
+		case CAM_CDM_CMD_CHANGE_BASE:
+		case CAM_CDM_CMD_PERF_CTRL:
+		case CAM_CDM_CMD_COMP_WAIT:
+		case CAM_CDM_CLEAR_COMP_WAIT:
+		case CAM_CDM_WAIT_PREFETCH_DISABLE:
+			cmd_words = CDMCmdHeaderSizes[cmd];
+			break;
+		default:
+			rc = -EOPNOTSUPP;
+			goto end;
+		}
+
+		/* Any other command orders the writes around it */
+		if ((pos + cmd_words) > num_words) {
+			rc = -EINVAL;
+			goto end;
+		}
+
+		rc = cam_cdm_util_coalesce_flush(&ctx);
+		if (rc)
+			goto end;
+
+		if ((ctx.out_words + cmd_words) > ctx.max_words) {
+			rc = -ENOSPC;
+			goto end;
+		}
+
+		memcpy(ctx.out + ctx.out_words, &cmd_buf[pos],
+			cmd_words * CAM_CDM_DWORD);
+		ctx.out_words += cmd_words;
+		pos += cmd_words;
+	}
+
+	rc = cam_cdm_util_coalesce_flush(&ctx);
+	if (rc)
+		goto end;
+
+	if (ctx.out_words < num_words) {
+		memcpy(cmd_buf, ctx.out, ctx.out_words * CAM_CDM_DWORD);
+		*new_size = ctx.out_words * CAM_CDM_DWORD;
+	}
+
+	CAM_DBG(CAM_CDM, "Coalesced %u -> %u bytes, dropped: %u merged: %u",
+		cmd_buf_size, *new_size, ctx.num_dropped, ctx.num_merged);
+
+end:
+	/* Not worth it or not understood, the stream is left as is */
+	if ((rc == -ENOSPC) || (rc == -EOPNOTSUPP)) {
+		CAM_DBG(CAM_CDM, "Stream left unchanged rc: %d", rc);
+		rc = 0;
+	}
+
+	kvfree(ctx.out);
+	kvfree(ctx.writes);
+	return rc;
+}
+
+static uint32_t cam_cdm_util_coalesce_test_rand(uint32_t *state)
+{
+	/* xorshift32, the state must never be 0 */
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+
+	return *state;
+}
+
+static uint32_t cam_cdm_util_coalesce_test_offset(uint32_t *state,
+	uint32_t num_regs)
+{
+	uint32_t max_reg = (CAM_CDM_COALESCE_TEST_BLOCK_SIZE / CAM_CDM_DWORD) -
+		num_regs;
+
+	return (cam_cdm_util_coalesce_test_rand(state) % (max_reg + 1)) *
+		CAM_CDM_DWORD;
+}
+
+/*
+ * Random stream of base changes, REG_CONT and REG_RANDOM commands. Random
+ * offsets mostly follow the previous one so that merge runs show up, and
+ * the small blocks make the same registers get written again.
+ */
+static uint32_t cam_cdm_util_coalesce_test_gen(uint32_t *cmd_buf,
+	uint32_t *state)
+{
+	uint32_t pairs[2 * CAM_CDM_COALESCE_TEST_MAX_CMD];
+	uint32_t *cur = cmd_buf, *end = cmd_buf + CAM_CDM_COALESCE_TEST_MAX_WORDS;
+	uint32_t count, offset, i;
+
+	cur = cam_cdm_write_changebase(cur, CAM_CDM_COALESCE_TEST_CAM_BASE);
+
+	while ((end - cur) > (CAM_CDM_COALESCE_TEST_MAX_CMD * 2 + 2)) {
+		count = (cam_cdm_util_coalesce_test_rand(state) %
+			CAM_CDM_COALESCE_TEST_MAX_CMD) + 1;
+
+		switch (cam_cdm_util_coalesce_test_rand(state) % 8) {
+		case 0:
+			i = cam_cdm_util_coalesce_test_rand(state) %
+				CAM_CDM_COALESCE_TEST_BLOCKS;
+			cur = cam_cdm_write_changebase(cur,
+				CAM_CDM_COALESCE_TEST_CAM_BASE +
+				(i * CAM_CDM_COALESCE_TEST_BLOCK_SIZE));
+			break;
+		case 1:
+		case 2:
+			for (i = 0; i < count; i++)
+				pairs[i] = cam_cdm_util_coalesce_test_rand(state);
+			cur = cam_cdm_write_regcontinuous(cur,
+				cam_cdm_util_coalesce_test_offset(state, count),
+				count, pairs);
+			break;
+		default:
+			offset = cam_cdm_util_coalesce_test_offset(state, 1);
+			for (i = 0; i < count; i++) {
+				switch (cam_cdm_util_coalesce_test_rand(state) % 4) {
+				case 0:
+					offset = cam_cdm_util_coalesce_test_offset(
+						state, 1);
+					break;
+				case 1:
+					/* Write the same register again */
+					break;
+				default:
+					if (i)
+						offset += CAM_CDM_DWORD;
+					if (offset >= CAM_CDM_COALESCE_TEST_BLOCK_SIZE)
+						offset = 0;
+					break;
+				}
+				pairs[2 * i] = offset;
+				pairs[2 * i + 1] =
+					cam_cdm_util_coalesce_test_rand(state);
+			}
+			cur = cam_cdm_write_regrandom(cur, count, pairs);
+			break;
+		}
+	}
+
+	return (cur - cmd_buf) * CAM_CDM_DWORD;
+}
+
+int cam_cdm_util_coalesce_self_test(uint32_t iterations, uint32_t seed)
+{
+	static const uint32_t test_flags[] = {
+		CAM_CDM_COALESCE_MERGE,
+		CAM_CDM_COALESCE_DROP_DEAD,
+		CAM_CDM_COALESCE_MERGE | CAM_CDM_COALESCE_DROP_DEAD,
+	};
+	struct cam_soc_reg_map reg_map[CAM_CDM_COALESCE_TEST_BLOCKS];
+	struct cam_soc_reg_map *base_table[CAM_SOC_MAX_BLOCK] = {NULL};
+	uint32_t shadow_size = CAM_CDM_COALESCE_TEST_BLOCKS *
+		CAM_CDM_COALESCE_TEST_BLOCK_SIZE;
+	uint32_t buf_size = CAM_CDM_COALESCE_TEST_MAX_WORDS * CAM_CDM_DWORD;
+	uint32_t *stream = NULL, *cmd_buf = NULL;
+	uint8_t *shadow = NULL, *expected = NULL;
+	void __iomem *base;
+	uint32_t state = seed ? seed : 1;
+	uint32_t iter, i, size, new_size;
+	int rc = 0;
+
+	stream = kvzalloc(buf_size, GFP_KERNEL);
+	cmd_buf = kvzalloc(buf_size, GFP_KERNEL);
+	shadow = kvzalloc(shadow_size, GFP_KERNEL);
+	expected = kvzalloc(shadow_size, GFP_KERNEL);
+	if (!stream || !cmd_buf || !shadow || !expected) {
+		rc = -ENOMEM;
+		goto end;
+	}
+
+	/* Plain memory standing in for the register blocks */
+	for (i = 0; i < CAM_CDM_COALESCE_TEST_BLOCKS; i++) {
+		reg_map[i].mem_base = (void __force __iomem *)
+			(shadow + (i * CAM_CDM_COALESCE_TEST_BLOCK_SIZE));
+		reg_map[i].mem_cam_base = CAM_CDM_COALESCE_TEST_CAM_BASE +
+			(i * CAM_CDM_COALESCE_TEST_BLOCK_SIZE);
+		reg_map[i].size = CAM_CDM_COALESCE_TEST_BLOCK_SIZE;
+		base_table[i] = &reg_map[i];
+	}
+
+	for (iter = 0; iter < iterations; iter++) {
+		size = cam_cdm_util_coalesce_test_gen(stream, &state);
+
+		memset(shadow, 0, shadow_size);
+		base = NULL;
+		rc = cam_cdm_util_cmd_buf_write(&base, stream, size, base_table,
+			CAM_CDM_COALESCE_TEST_BLOCKS, 0);
+		if (rc)
+			goto end;
+		memcpy(expected, shadow, shadow_size);
+
+		for (i = 0; i < ARRAY_SIZE(test_flags); i++) {
+			memcpy(cmd_buf, stream, size);
+			rc = cam_cdm_util_coalesce_cmd_buf(cmd_buf, size,
+				test_flags[i], &new_size);
+			if (rc)
+				goto end;
+
+			memset(shadow, 0, shadow_size);
+			base = NULL;
+			rc = cam_cdm_util_cmd_buf_write(&base, cmd_buf, new_size,
+				base_table, CAM_CDM_COALESCE_TEST_BLOCKS, 0);
+			if (rc)
+				goto end;
+
+			if ((new_size > size) ||
+				memcmp(expected, shadow, shadow_size)) {
+				CAM_ERR(CAM_CDM,
+					"Mismatch seed: 0x%x iter: %u flags: 0x%x size: %u -> %u",
+					seed, iter, test_flags[i], size, new_size);
+				rc = -EINVAL;
+				goto end;
+			}
+
+			CAM_DBG(CAM_CDM, "iter: %u flags: 0x%x size: %u -> %u",
+				iter, test_flags[i], size, new_size);
+		}
+	}
+
+	CAM_INFO(CAM_CDM, "Coalesce self test passed, seed: 0x%x iterations: %u",
+		seed, iterations);
+
+end:
+	if (rc)
+		CAM_ERR(CAM_CDM, "Coalesce self test failed, seed: 0x%x rc: %d",
+			seed, rc);
+	kvfree(expected);
+	kvfree(shadow);
+	kvfree(cmd_buf);
+	kvfree(stream);
+	return rc;
+}
 
 struct cam_cdm_utils_ops CDM170_ops = {
 	.cdm_get_cmd_header_size              = cam_cdm_get_cmd_header_size,
@@ -466,6 +989,7 @@ struct cam_cdm_utils_ops CDM170_ops = {
 	.cdm_write_wait_comp_event            = cam_cdm_write_wait_comp_event,
 	.cdm_write_clear_comp_event           = cam_cdm_write_clear_comp_event,
 	.cdm_write_wait_prefetch_disable      = cam_cdm_write_wait_prefetch_disable,
+	.cdm_coalesce_cmd_buf                 = cam_cdm_util_coalesce_cmd_buf,
 };
 
 int cam_cdm_get_ioremap_from_base(uint32_t hw_base,
@@ -11,7 +11,12 @@
 #define CAM_CDM_CMD_TAG_MAX_LEN 128
 #define CAM_CDM_COMMAND_OFFSET  24
 
+/* Coalescer flags */
+#define CAM_CDM_COALESCE_MERGE      BIT(0)
+#define CAM_CDM_COALESCE_DROP_DEAD  BIT(1)
+
 #include <linux/types.h>
+#include <linux/bits.h>
 
 enum cam_cdm_command {
 	CAM_CDM_CMD_UNUSED = 0x0,
@@ -135,6 +140,13 @@ enum cam_cdm_command {
  *      @pCmdBuffer: Pointer to command buffer
  *      @mask1: This value decides which comp events to clear (0 - 31).
  *      @mask2: This value decides which comp events to clear (32 - 65).
+ *
+ * @cdm_coalesce_cmd_buf: Rewrites the register writes of a command buffer
+ *                        in place, see cam_cdm_util_coalesce_cmd_buf().
+ *      @cmd_buf: Pointer to command buffer
+ *      @cmd_buf_size: Size of the command buffer in bytes
+ *      @flags: CAM_CDM_COALESCE_* flags
+ *      @new_size: Size of the rewritten command buffer in bytes
  */
 struct cam_cdm_utils_ops {
 uint32_t (*cdm_get_cmd_header_size)(unsigned int command);
@@ -198,6 +210,11 @@ uint32_t *(*cdm_write_wait_prefetch_disable)(
 	uint32_t  id,
 	uint32_t  mask1,
 	uint32_t  mask2);
+int (*cdm_coalesce_cmd_buf)(
+	uint32_t *cmd_buf,
+	uint32_t  cmd_buf_size,
+	uint32_t  flags,
+	uint32_t *new_size);
 };
 
 /**
@@ -267,5 +284,45 @@ void cam_cdm_util_dump_cmd_buf(
 int cam_cdm_util_dump_cmd_bufs_v2(
 	struct cam_cdm_cmd_buf_dump_info *dump_info);
 
+/**
+ * cam_cdm_util_coalesce_cmd_buf()
+ *
+ * @brief:        Optional pass over a command buffer before submission.
+ *                Register writes between two non register write commands
+ *                form a segment. With CAM_CDM_COALESCE_MERGE, runs of
+ *                writes to ascending consecutive registers are emitted as
+ *                REG_CONT. With CAM_CDM_COALESCE_DROP_DEAD, writes
+ *                overwritten later in the same segment are dropped; only
+ *                use it on streams without side effect registers (trigger,
+ *                FIFO or write-to-clear), e.g. IQ configuration.
+ *                The final register state is unchanged and the order of
+ *                the remaining writes is kept. The buffer is left as is if
+ *                the result would not be smaller or a command is unknown.
+ *
+ * @cmd_buf:      Command buffer, rewritten in place
+ * @cmd_buf_size: Size of the command buffer in bytes
+ * @flags:        CAM_CDM_COALESCE_* flags
+ * @new_size:     Size of the command buffer in bytes after the pass
+ *
+ * return 0 on success, negative on malformed buffer or allocation failure
+ */
+int cam_cdm_util_coalesce_cmd_buf(uint32_t *cmd_buf, uint32_t cmd_buf_size,
+	uint32_t flags, uint32_t *new_size);
+
+/**
+ * cam_cdm_util_coalesce_self_test()
+ *
+ * @brief:        Runs random REG_CONT, REG_RANDOM and CHANGE_BASE streams
+ *                through cam_cdm_util_cmd_buf_write() into memory backed
+ *                register blocks, before and after each coalesce mode, and
+ *                checks that the final register state is the same.
+ *
+ * @iterations:   Number of random streams
+ * @seed:         Seed of the stream generator, reported on mismatch
+ *
+ * return 0 on success, negative on mismatch or failure
+ */
+int cam_cdm_util_coalesce_self_test(uint32_t iterations, uint32_t seed);
+
 
 #endif /* _CAM_CDM_UTIL_H_ */
@@ -111,6 +111,13 @@ static const struct file_operations session_info = {
 	.write = session_info_write,
 };
 
+static int workq_latency_show(struct seq_file *m, void *data)
+{
+	cam_req_mgr_workq_latency_show(m);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(workq_latency);
+
 static struct dentry *debugfs_root;
 int cam_req_mgr_debug_register(struct cam_req_mgr_core_device *core_dev)
 {
@@ -137,6 +144,8 @@ int cam_req_mgr_debug_register(struct cam_req_mgr_core_device *core_dev)
 		debugfs_root, &core_dev->recovery_on_apply_fail);
 	debugfs_create_u32("delay_detect_count", 0644, debugfs_root,
 		&cam_debug_mgr_delay_detect);
+	debugfs_create_file("workq_latency", 0444, debugfs_root,
+		NULL, &workq_latency_fops);
 end:
 	return rc;
 }
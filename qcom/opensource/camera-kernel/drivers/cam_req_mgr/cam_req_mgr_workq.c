@@ -28,6 +28,23 @@ struct sched_param {
 		spin_unlock_bh(&(workq)->lock_bh); \
 }
 
+#define WORKQ_ACQUIRE_FREE_LOCK(workq, flags) {\
+	if ((workq)->in_irq) \
+		spin_lock_irqsave(&(workq)->task.free_lock, (flags)); \
+	else \
+		spin_lock_bh(&(workq)->task.free_lock); \
+}
+
+#define WORKQ_RELEASE_FREE_LOCK(workq, flags) {\
+	if ((workq)->in_irq) \
+		spin_unlock_irqrestore(&(workq)->task.free_lock, (flags)); \
+	else	\
+		spin_unlock_bh(&(workq)->task.free_lock); \
+}
+
+static atomic64_t cam_req_mgr_workq_lat_hist[CRM_TASK_PRIORITY_MAX]
+	[CAM_WORKQ_LAT_BUCKETS];
+
 #ifdef OPLUS_FEATURE_CAMERA_COMMON
 static int cam_req_mgr_thread(void *data)
 {
@@ -60,25 +77,22 @@ struct crm_workq_task *cam_req_mgr_workq_get_task(
 	struct cam_req_mgr_core_workq *workq)
 {
 	struct crm_workq_task *task = NULL;
+	struct llist_node *node;
 	unsigned long flags = 0;
 
 	if (!workq)
 		return NULL;
 
-	WORKQ_ACQUIRE_LOCK(workq, flags);
-	if (list_empty(&workq->task.empty_head))
-		goto end;
+	/* llist_del_first() needs its callers serialized, pushes do not */
+	WORKQ_ACQUIRE_FREE_LOCK(workq, flags);
+	node = llist_del_first(&workq->task.free_list);
+	WORKQ_RELEASE_FREE_LOCK(workq, flags);
 
-	task = list_first_entry(&workq->task.empty_head,
-		struct crm_workq_task, entry);
-	if (task) {
+	if (node) {
+		task = llist_entry(node, struct crm_workq_task, free_node);
 		atomic_sub(1, &workq->task.free_cnt);
-		list_del_init(&task->entry);
 	}
 
-end:
-	WORKQ_RELEASE_LOCK(workq, flags);
-
 	return task;
 }
 
@@ -86,17 +100,42 @@ static void cam_req_mgr_workq_put_task(struct crm_workq_task *task)
 {
 	struct cam_req_mgr_core_workq *workq =
 		(struct cam_req_mgr_core_workq *)task->parent;
-	unsigned long flags = 0;
 
 	list_del_init(&task->entry);
 	task->cancel = 0;
 	task->process_cb = NULL;
 	task->priv = NULL;
-	WORKQ_ACQUIRE_LOCK(workq, flags);
-	list_add_tail(&task->entry,
-		&workq->task.empty_head);
 	atomic_add(1, &workq->task.free_cnt);
-	WORKQ_RELEASE_LOCK(workq, flags);
+	llist_add(&task->free_node, &workq->task.free_list);
+}
+
+static void cam_req_mgr_workq_record_latency(int32_t prio, ktime_t delay)
+{
+	s64 us = ktime_to_us(delay);
+	int bucket = 0;
+
+	if (us > 0)
+		bucket = min_t(int, ilog2(us) + 1, CAM_WORKQ_LAT_BUCKETS - 1);
+
+	atomic64_inc(&cam_req_mgr_workq_lat_hist[prio][bucket]);
+}
+
+void cam_req_mgr_workq_latency_show(struct seq_file *m)
+{
+	int i, j;
+
+	seq_puts(m, "prio");
+	for (j = 0; j < CAM_WORKQ_LAT_BUCKETS; j++)
+		seq_printf(m, " <%luus", 1UL << j);
+	seq_puts(m, "\n");
+
+	for (i = 0; i < CRM_TASK_PRIORITY_MAX; i++) {
+		seq_printf(m, "%4d", i);
+		for (j = 0; j < CAM_WORKQ_LAT_BUCKETS; j++)
+			seq_printf(m, " %lld",
+				atomic64_read(&cam_req_mgr_workq_lat_hist[i][j]));
+		seq_puts(m, "\n");
+	}
 }
 
 void cam_req_mgr_workq_flush(struct cam_req_mgr_core_workq *workq)
@@ -132,12 +171,15 @@ static int cam_req_mgr_process_task(struct crm_workq_task *task)
 /**
  * cam_req_mgr_process_workq() - main loop handling
  * @w: workqueue task pointer
+ *
+ * Picks the highest non-empty priority again after every task, so a
+ * priority 0 task enqueued while lower priority work drains runs next.
  */
 void cam_req_mgr_process_workq(struct work_struct *w)
 {
 	struct cam_req_mgr_core_workq *workq = NULL;
 	struct crm_workq_task         *task;
-	int32_t                        i = CRM_TASK_PRIORITY_0;
+	int32_t                        i;
 	unsigned long                  flags = 0;
 	ktime_t                        sched_start_time;
 	void                          *cb = NULL;
@@ -149,33 +191,36 @@ void cam_req_mgr_process_workq(struct work_struct *w)
 	workq = (struct cam_req_mgr_core_workq *)
 		container_of(w, struct cam_req_mgr_core_workq, work);
 
-	while (i < CRM_TASK_PRIORITY_MAX) {
-		WORKQ_ACQUIRE_LOCK(workq, flags);
-		while (!list_empty(&workq->task.process_head[i])) {
-			task = list_first_entry(&workq->task.process_head[i],
-				struct crm_workq_task, entry);
-			cb = (void *)task->process_cb;
-			cam_common_util_thread_switch_delay_detect(
-				workq->workq_name, "schedule", cb,
-				task->task_scheduled_ts,
-				CAM_WORKQ_SCHEDULE_TIME_THRESHOLD);
-			sched_start_time = ktime_get();
-			atomic_sub(1, &workq->task.pending_cnt);
-			list_del_init(&task->entry);
-			WORKQ_RELEASE_LOCK(workq, flags);
-			if (!unlikely(atomic_read(&workq->flush)))
-				cam_req_mgr_process_task(task);
-			cam_common_util_thread_switch_delay_detect(
-				workq->workq_name, "execution", cb,
-				sched_start_time,
-				CAM_WORKQ_SCHEDULE_TIME_THRESHOLD);
-			CAM_DBG(CAM_CRM, "processed task %pK free_cnt %d",
-				task, atomic_read(&workq->task.free_cnt));
-			WORKQ_ACQUIRE_LOCK(workq, flags);
-		}
+	WORKQ_ACQUIRE_LOCK(workq, flags);
+	while (workq->task.prio_mask) {
+		i = __ffs(workq->task.prio_mask);
+		task = list_first_entry(&workq->task.process_head[i],
+			struct crm_workq_task, entry);
+		list_del_init(&task->entry);
+		if (list_empty(&workq->task.process_head[i]))
+			clear_bit(i, &workq->task.prio_mask);
+		atomic_sub(1, &workq->task.pending_cnt);
 		WORKQ_RELEASE_LOCK(workq, flags);
-		i++;
+
+		cb = (void *)task->process_cb;
+		cam_common_util_thread_switch_delay_detect(
+			workq->workq_name, "schedule", cb,
+			task->task_scheduled_ts,
+			CAM_WORKQ_SCHEDULE_TIME_THRESHOLD);
+		sched_start_time = ktime_get();
+		cam_req_mgr_workq_record_latency(i,
+			ktime_sub(sched_start_time, task->task_scheduled_ts));
+		if (!unlikely(atomic_read(&workq->flush)))
+			cam_req_mgr_process_task(task);
+		cam_common_util_thread_switch_delay_detect(
+			workq->workq_name, "execution", cb,
+			sched_start_time,
+			CAM_WORKQ_SCHEDULE_TIME_THRESHOLD);
+		CAM_DBG(CAM_CRM, "processed task %pK free_cnt %d",
+			task, atomic_read(&workq->task.free_cnt));
+		WORKQ_ACQUIRE_LOCK(workq, flags);
 	}
+	WORKQ_RELEASE_LOCK(workq, flags);
 }
 
 int cam_req_mgr_workq_enqueue_task(struct crm_workq_task *task,
@@ -214,6 +259,7 @@ int cam_req_mgr_workq_enqueue_task(struct crm_workq_task *task,
 
 	list_add_tail(&task->entry,
 		&workq->task.process_head[task->priority]);
+	set_bit(task->priority, &workq->task.prio_mask);
 
 	atomic_add(1, &workq->task.pending_cnt);
 	CAM_DBG(CAM_CRM, "enq task %pK pending_cnt %d",
@@ -302,7 +348,9 @@ int cam_req_mgr_workq_create(char *name, int32_t num_tasks,
 		atomic_set(&crm_workq->task.free_cnt, 0);
 		for (i = CRM_TASK_PRIORITY_0; i < CRM_TASK_PRIORITY_MAX; i++)
 			INIT_LIST_HEAD(&crm_workq->task.process_head[i]);
-		INIT_LIST_HEAD(&crm_workq->task.empty_head);
+		crm_workq->task.prio_mask = 0;
+		spin_lock_init(&crm_workq->task.free_lock);
+		init_llist_head(&crm_workq->task.free_list);
 		atomic_set(&crm_workq->flush, 0);
 		crm_workq->in_irq = in_irq;
 		crm_workq->task.num_task = num_tasks;
@@ -365,9 +413,10 @@ void cam_req_mgr_workq_destroy(struct cam_req_mgr_core_workq **crm_workq)
 		kfree(workq->task.pool);
 
 		/* Leave lists in stable state after freeing pool */
-		INIT_LIST_HEAD(&workq->task.empty_head);
+		init_llist_head(&workq->task.free_list);
 		for (i = 0; i < CRM_TASK_PRIORITY_MAX; i++)
 			INIT_LIST_HEAD(&workq->task.process_head[i]);
+		workq->task.prio_mask = 0;
 		*crm_workq = NULL;
 		WORKQ_RELEASE_LOCK(workq, flags);
 		kfree(workq);
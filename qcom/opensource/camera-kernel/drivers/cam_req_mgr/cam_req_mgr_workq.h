@@ -14,6 +14,8 @@
 #include <linux/workqueue.h>
 #include <linux/slab.h>
 #include <linux/timer.h>
+#include <linux/llist.h>
+#include <linux/seq_file.h>
 
 /* Threshold for scheduling delay in ms */
 #define CAM_WORKQ_SCHEDULE_TIME_THRESHOLD   5
@@ -31,6 +33,9 @@
  */
 #define CAM_WORKQ_FLAG_SERIAL                    (1 << 1)
 
+/* Log2 microsecond buckets for enqueue to execute latency */
+#define CAM_WORKQ_LAT_BUCKETS                    16
+
 /* Task priorities, lower the number higher the priority*/
 enum crm_task_priority {
 	CRM_TASK_PRIORITY_0,
@@ -51,7 +56,8 @@ enum crm_workq_context {
  * @process_cb       : registered callback called by workq when task enqueued is
  *                     ready for processing in workq thread context
  * @parent           : workq's parent is link which is enqqueing taks to this workq
- * @entry            : list head of this list entry is worker's empty_head
+ * @entry            : list entry in one of the worker's process_head lists
+ * @free_node        : node in the worker's free task stack
  * @cancel           : if caller has got free task from pool but wants to abort
  *                     or put back without using it
  * @priv             : when task is enqueuer caller can attach priv along which
@@ -66,6 +72,7 @@ struct crm_workq_task {
 	int32_t                  (*process_cb)(void *priv, void *data);
 	void                      *parent;
 	struct list_head           entry;
+	struct llist_node          free_node;
 	uint8_t                    cancel;
 	void                      *priv;
 	ktime_t                    task_scheduled_ts;
@@ -83,8 +90,10 @@ struct crm_workq_task {
  * @lock        : Current task's lock handle
  * @pending_cnt : # of tasks left in queue
  * @free_cnt    : # of free/available tasks
- * @process_head:
- * @empty_head  : list  head of available taska which can be used
+ * @process_head: per priority lists of enqueued tasks
+ * @prio_mask   : bit set for every non-empty process_head, under lock_bh
+ * @free_lock   : serializes pops from free_list, pushes are lock free
+ * @free_list   : stack of available tasks which can be used
  *                or acquired in order to enqueue a task to workq
  * @pool        : pool of tasks used for handling events in workq context
  * @num_task    : size of tasks pool
@@ -105,7 +114,9 @@ struct cam_req_mgr_core_workq {
 		atomic_t               free_cnt;
 
 		struct list_head       process_head[CRM_TASK_PRIORITY_MAX];
-		struct list_head       empty_head;
+		unsigned long          prio_mask;
+		spinlock_t             free_lock;
+		struct llist_head      free_list;
 		struct crm_workq_task *pool;
 		uint32_t               num_task;
 	} task;
@@ -185,6 +196,13 @@ int cam_req_mgr_workq_enqueue_task(struct crm_workq_task *task,
 struct crm_workq_task *cam_req_mgr_workq_get_task(
 	struct cam_req_mgr_core_workq *workq);
 
+/**
+ * cam_req_mgr_workq_latency_show()
+ * @brief: Print enqueue to execute latency histograms of all workqs
+ * @m    : seq_file to print into
+ */
+void cam_req_mgr_workq_latency_show(struct seq_file *m);
+
 /**
  * cam_req_mgr_workq_flush()
  * @brief: Flushes the work queue. Function will sleep until any active task is complete.
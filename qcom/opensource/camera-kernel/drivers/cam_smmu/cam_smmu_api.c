@@ -16,6 +16,9 @@
 #include <linux/workqueue.h>
 #include <linux/genalloc.h>
 #include <linux/debugfs.h>
+#include <linux/hashtable.h>
+#include <linux/rbtree.h>
+#include <linux/sizes.h>
 
 #include <soc/qcom/secure_buffer.h>
 
@@ -42,6 +45,7 @@
 
 #define CAM_SMMU_MONITOR_MAX_ENTRIES   100
 #define CAM_SMMU_BUF_TRACKING_POOL     600
+#define CAM_SMMU_BUF_HASH_BITS         6
 #define CAM_SMMU_INC_MONITOR_HEAD(head, ret) \
 	div_u64_rem(atomic64_add_return(1, head),\
 	CAM_SMMU_MONITOR_MAX_ENTRIES, (ret))
@@ -193,8 +197,12 @@ struct cam_context_bank_info {
 	struct cam_smmu_multi_region_info device_region;
 	struct cam_smmu_multi_region_info qdss_info;
 
+	/* Lists keep mapping order for dumps, lookups go through the indexes */
 	struct list_head smmu_buf_list;
 	struct list_head smmu_buf_kernel_list;
+	struct rb_root iova_tree;
+	DECLARE_HASHTABLE(fd_hash, CAM_SMMU_BUF_HASH_BITS);
+	DECLARE_HASHTABLE(dma_buf_hash, CAM_SMMU_BUF_HASH_BITS);
 	struct mutex lock;
 	int handle;
 	enum cam_smmu_ops_param state;
@@ -256,6 +264,8 @@ struct cam_dma_buff_info {
 	struct kref ref_count;
 	dma_addr_t paddr;
 	struct list_head list;
+	struct rb_node iova_node;
+	struct hlist_node hash_node;
 	int ion_fd;
 	unsigned long i_ino;
 	size_t len;
@@ -810,47 +820,163 @@ static void cam_smmu_print_table(void)
 	}
 }
 
+static inline unsigned long cam_smmu_fd_hash_key(int ion_fd,
+	unsigned long i_ino)
+{
+	return i_ino ^ (unsigned long)ion_fd;
+}
+
+/*
+ * Index a mapping by IOVA and by fd/i_ino (user list) or dma_buf (kernel
+ * list). IOVA ranges of a context bank never overlap, so an rbtree keyed
+ * by start address answers containment and nearest-range queries.
+ */
+static void cam_smmu_index_add_mapping(struct cam_context_bank_info *cb_info,
+	struct cam_dma_buff_info *mapping, bool kernel_buf)
+{
+	struct rb_node **new, *parent = NULL;
+	struct cam_dma_buff_info *cur;
+
+	if (kernel_buf) {
+		RB_CLEAR_NODE(&mapping->iova_node);
+		hash_add(cb_info->dma_buf_hash, &mapping->hash_node,
+			(unsigned long)mapping->buf);
+		return;
+	}
+
+	new = &cb_info->iova_tree.rb_node;
+	while (*new) {
+		parent = *new;
+		cur = rb_entry(parent, struct cam_dma_buff_info, iova_node);
+		if (mapping->paddr < cur->paddr)
+			new = &parent->rb_left;
+		else
+			new = &parent->rb_right;
+	}
+	rb_link_node(&mapping->iova_node, parent, new);
+	rb_insert_color(&mapping->iova_node, &cb_info->iova_tree);
+
+	hash_add(cb_info->fd_hash, &mapping->hash_node,
+		cam_smmu_fd_hash_key(mapping->ion_fd, mapping->i_ino));
+}
+
+static void cam_smmu_index_del_mapping(struct cam_context_bank_info *cb_info,
+	struct cam_dma_buff_info *mapping)
+{
+	if (!RB_EMPTY_NODE(&mapping->iova_node)) {
+		rb_erase(&mapping->iova_node, &cb_info->iova_tree);
+		RB_CLEAR_NODE(&mapping->iova_node);
+	}
+	hash_del(&mapping->hash_node);
+}
+
+/* Last user mapping starting at or below addr */
+static struct cam_dma_buff_info *cam_smmu_iova_floor(
+	struct cam_context_bank_info *cb_info, unsigned long addr)
+{
+	struct rb_node *node = cb_info->iova_tree.rb_node;
+	struct cam_dma_buff_info *cur, *floor = NULL;
+
+	while (node) {
+		cur = rb_entry(node, struct cam_dma_buff_info, iova_node);
+		if ((unsigned long)cur->paddr <= addr) {
+			floor = cur;
+			node = node->rb_right;
+		} else {
+			node = node->rb_left;
+		}
+	}
+
+	return floor;
+}
+
+static struct cam_dma_buff_info *cam_smmu_find_user_mapping(
+	struct cam_context_bank_info *cb_info, int ion_fd, unsigned long i_ino)
+{
+	struct cam_dma_buff_info *mapping;
+
+	hash_for_each_possible(cb_info->fd_hash, mapping,
+		hash_node, cam_smmu_fd_hash_key(ion_fd, i_ino)) {
+		if ((mapping->ion_fd == ion_fd) && (mapping->i_ino == i_ino))
+			return mapping;
+	}
+
+	return NULL;
+}
+
+static struct cam_dma_buff_info *cam_smmu_find_kernel_mapping(
+	struct cam_context_bank_info *cb_info, struct dma_buf *buf)
+{
+	struct cam_dma_buff_info *mapping;
+
+	hash_for_each_possible(cb_info->dma_buf_hash, mapping,
+		hash_node, (unsigned long)buf) {
+		if (mapping->buf == buf)
+			return mapping;
+	}
+
+	return NULL;
+}
+
+/*
+ * User mapping containing addr (end inclusive), else the nearer of the two
+ * mappings around it. *contained tells which of the two was found.
+ */
+static struct cam_dma_buff_info *cam_smmu_closest_mapping(
+	struct cam_context_bank_info *cb_info, unsigned long addr,
+	bool *contained)
+{
+	struct cam_dma_buff_info *closest_mapping, *next_mapping = NULL;
+	struct rb_node *next;
+
+	*contained = false;
+	closest_mapping = cam_smmu_iova_floor(cb_info, addr);
+	if (closest_mapping) {
+		if (addr <= (unsigned long)closest_mapping->paddr +
+			closest_mapping->len) {
+			*contained = true;
+			return closest_mapping;
+		}
+		next = rb_next(&closest_mapping->iova_node);
+	} else {
+		next = rb_first(&cb_info->iova_tree);
+	}
+
+	/* Not inside any range, pick the nearer of the two neighbours */
+	if (next)
+		next_mapping = rb_entry(next, struct cam_dma_buff_info, iova_node);
+
+	if (next_mapping && (!closest_mapping ||
+		((unsigned long)next_mapping->paddr - addr) <
+		(addr - ((unsigned long)closest_mapping->paddr +
+		closest_mapping->len) - 1)))
+		closest_mapping = next_mapping;
+
+	return closest_mapping;
+}
+
 static uint32_t cam_smmu_find_closest_mapping(int idx, void *vaddr, bool *in_map_region)
 {
-	struct cam_dma_buff_info *mapping, *closest_mapping =  NULL;
+	struct cam_dma_buff_info *closest_mapping;
 	unsigned long start_addr, end_addr, current_addr;
 	uint32_t buf_info = 0;
-
-	long delta = 0, lowest_delta = 0;
+	bool contained;
 
 	current_addr = (unsigned long)vaddr;
 	*in_map_region = false;
-	list_for_each_entry(mapping,
-			&iommu_cb_set.cb_info[idx].smmu_buf_list, list) {
-		start_addr = (unsigned long)mapping->paddr;
-		end_addr = (unsigned long)mapping->paddr + mapping->len;
-
-		if (start_addr <= current_addr && current_addr <= end_addr) {
-			closest_mapping = mapping;
-			CAM_INFO(CAM_SMMU,
-				"Found va 0x%lx in:0x%lx-0x%lx, fd %d i_ino %lu cb:%s",
-				current_addr, start_addr,
-				end_addr, mapping->ion_fd, mapping->i_ino,
-				iommu_cb_set.cb_info[idx].name[0]);
-			goto end;
-		} else {
-			if (start_addr > current_addr)
-				delta =  start_addr - current_addr;
-			else
-				delta = current_addr - end_addr - 1;
-
-			if (delta < lowest_delta || lowest_delta == 0) {
-				lowest_delta = delta;
-				closest_mapping = mapping;
-			}
-			CAM_DBG(CAM_SMMU,
-				"approx va %lx not in range: %lx-%lx fd = %0x i_ino %lu",
-				current_addr, start_addr,
-				end_addr, mapping->ion_fd, mapping->i_ino);
-		}
+
+	closest_mapping = cam_smmu_closest_mapping(&iommu_cb_set.cb_info[idx],
+		current_addr, &contained);
+	if (contained) {
+		start_addr = (unsigned long)closest_mapping->paddr;
+		end_addr = (unsigned long)closest_mapping->paddr + closest_mapping->len;
+		CAM_INFO(CAM_SMMU,
+			"Found va 0x%lx in:0x%lx-0x%lx, fd %d i_ino %lu cb:%s",
+			current_addr, start_addr,
+			end_addr, closest_mapping->ion_fd, closest_mapping->i_ino,
+			iommu_cb_set.cb_info[idx].name[0]);
 	}
 
-end:
 	if (closest_mapping) {
 		buf_info = closest_mapping->ion_fd;
 		start_addr = (unsigned long)closest_mapping->paddr;
@@ -858,9 +984,9 @@ end:
 		if (start_addr <= current_addr && current_addr < end_addr)
 			*in_map_region = true;
 		CAM_INFO(CAM_SMMU,
-			"Faulting addr 0x%lx closest map fd %d i_ino %lu %llu-%llu 0x%lx-0x%lx buf=%pK",
+			"Faulting addr 0x%lx closest map fd %d i_ino %lu %llu 0x%lx-0x%lx buf=%pK",
 			current_addr, closest_mapping->ion_fd, closest_mapping->i_ino,
-			mapping->len, closest_mapping->len,
+			closest_mapping->len,
 			(unsigned long)closest_mapping->paddr,
 			(unsigned long)closest_mapping->paddr + closest_mapping->len,
 			closest_mapping->buf);
@@ -1124,6 +1250,9 @@ void cam_smmu_reset_iommu_table(enum cam_smmu_init_dir ops)
 		iommu_cb_set.cb_info[i].handle = HANDLE_INIT;
 		INIT_LIST_HEAD(&iommu_cb_set.cb_info[i].smmu_buf_list);
 		INIT_LIST_HEAD(&iommu_cb_set.cb_info[i].smmu_buf_kernel_list);
+		iommu_cb_set.cb_info[i].iova_tree = RB_ROOT;
+		hash_init(iommu_cb_set.cb_info[i].fd_hash);
+		hash_init(iommu_cb_set.cb_info[i].dma_buf_hash);
 		iommu_cb_set.cb_info[i].state = CAM_SMMU_DETACH;
 		iommu_cb_set.cb_info[i].dev = NULL;
 		iommu_cb_set.cb_info[i].cb_count = 0;
@@ -1377,13 +1506,11 @@ static struct cam_dma_buff_info *cam_smmu_find_mapping_by_virt_address(int idx,
 {
 	struct cam_dma_buff_info *mapping;
 
-	list_for_each_entry(mapping, &iommu_cb_set.cb_info[idx].smmu_buf_list,
-			list) {
-		if (mapping->paddr == virt_addr) {
-			CAM_DBG(CAM_SMMU, "Found virtual address %lx",
-				 (unsigned long)virt_addr);
-			return mapping;
-		}
+	mapping = cam_smmu_iova_floor(&iommu_cb_set.cb_info[idx], (unsigned long)virt_addr);
+	if (mapping && (mapping->paddr == virt_addr)) {
+		CAM_DBG(CAM_SMMU, "Found virtual address %lx",
+			 (unsigned long)virt_addr);
+		return mapping;
 	}
 
 	CAM_ERR(CAM_SMMU, "Error: Cannot find virtual address %lx by index %d",
@@ -1404,13 +1531,10 @@ static struct cam_dma_buff_info *cam_smmu_find_mapping_by_ion_index(int idx,
 
 	i_ino = file_inode(dmabuf->file)->i_ino;
 
-	list_for_each_entry(mapping,
-			&iommu_cb_set.cb_info[idx].smmu_buf_list,
-			list) {
-		if ((mapping->ion_fd == ion_fd) && (mapping->i_ino == i_ino)) {
-			CAM_DBG(CAM_SMMU, "find ion_fd %d i_ino %lu", ion_fd, i_ino);
-			return mapping;
-		}
+	mapping = cam_smmu_find_user_mapping(&iommu_cb_set.cb_info[idx], ion_fd, i_ino);
+	if (mapping) {
+		CAM_DBG(CAM_SMMU, "find ion_fd %d i_ino %lu", ion_fd, i_ino);
+		return mapping;
 	}
 
 	CAM_ERR(CAM_SMMU, "Error: Cannot find entry by index %d, fd %d i_ino %lu",
@@ -1429,13 +1553,10 @@ static struct cam_dma_buff_info *cam_smmu_find_mapping_by_dma_buf(int idx,
 		return NULL;
 	}
 
-	list_for_each_entry(mapping,
-			&iommu_cb_set.cb_info[idx].smmu_buf_kernel_list,
-			list) {
-		if (mapping->buf == buf) {
-			CAM_DBG(CAM_SMMU, "find dma_buf %pK", buf);
-			return mapping;
-		}
+	mapping = cam_smmu_find_kernel_mapping(&iommu_cb_set.cb_info[idx], buf);
+	if (mapping) {
+		CAM_DBG(CAM_SMMU, "find dma_buf %pK", buf);
+		return mapping;
 	}
 
 	CAM_ERR(CAM_SMMU, "Error: Cannot find entry by index %d", idx);
@@ -2857,6 +2978,7 @@ static int cam_smmu_map_buffer_and_add_to_list(int idx, int ion_fd,
 	/* add to the list */
 	list_add(&mapping_info->list,
 		&iommu_cb_set.cb_info[idx].smmu_buf_list);
+	cam_smmu_index_add_mapping(&iommu_cb_set.cb_info[idx], mapping_info, false);
 
 	CAM_DBG(CAM_SMMU, "fd %d i_ino %lu dmabuf %pK", ion_fd, mapping_info->i_ino, buf);
 
@@ -2889,6 +3011,7 @@ static int cam_smmu_map_kernel_buffer_and_add_to_list(int idx,
 	/* add to the list */
 	list_add(&mapping_info->list,
 		&iommu_cb_set.cb_info[idx].smmu_buf_kernel_list);
+	cam_smmu_index_add_mapping(&iommu_cb_set.cb_info[idx], mapping_info, true);
 
 	CAM_DBG(CAM_SMMU, "fd %d i_ino %lu dmabuf %pK",
 		mapping_info->ion_fd, mapping_info->i_ino, buf);
@@ -2983,6 +3106,7 @@ static int cam_smmu_unmap_buf_and_remove_from_list(
 	mapping_info->buf = NULL;
 
 	list_del_init(&mapping_info->list);
+	cam_smmu_index_del_mapping(&iommu_cb_set.cb_info[idx], mapping_info);
 
 	/* free one buffer */
 	kfree(mapping_info);
@@ -3047,16 +3171,14 @@ static enum cam_smmu_buf_state cam_smmu_check_fd_in_list(int idx,
 
 	i_ino = file_inode(dmabuf->file)->i_ino;
 
-	list_for_each_entry(mapping,
-		&iommu_cb_set.cb_info[idx].smmu_buf_list, list) {
-		if ((mapping->ion_fd == ion_fd) && (mapping->i_ino == i_ino)) {
-			*paddr_ptr = mapping->paddr;
-			*len_ptr = mapping->len;
-			*ts_mapping = &mapping->ts;
-			*inode = i_ino;
-			*ref_count = &mapping->ref_count;
-			return CAM_SMMU_BUFF_EXIST;
-		}
+	mapping = cam_smmu_find_user_mapping(&iommu_cb_set.cb_info[idx], ion_fd, i_ino);
+	if (mapping) {
+		*paddr_ptr = mapping->paddr;
+		*len_ptr = mapping->len;
+		*ts_mapping = &mapping->ts;
+		*inode = i_ino;
+		*ref_count = &mapping->ref_count;
+		return CAM_SMMU_BUFF_EXIST;
 	}
 
 	return CAM_SMMU_BUFF_NOT_EXIST;
@@ -3071,16 +3193,14 @@ static enum cam_smmu_buf_state cam_smmu_user_reuse_fd_in_list(int idx,
 
 	i_ino = file_inode(dmabuf->file)->i_ino;
 
-	list_for_each_entry(mapping,
-		&iommu_cb_set.cb_info[idx].smmu_buf_list, list) {
-		if ((mapping->ion_fd == ion_fd) && (mapping->i_ino == i_ino)) {
-			*paddr_ptr = mapping->paddr;
-			*len_ptr = mapping->len;
-			*ts_mapping = &mapping->ts;
-			mapping->map_count++;
-			*ref_count = &mapping->ref_count;
-			return CAM_SMMU_BUFF_EXIST;
-		}
+	mapping = cam_smmu_find_user_mapping(&iommu_cb_set.cb_info[idx], ion_fd, i_ino);
+	if (mapping) {
+		*paddr_ptr = mapping->paddr;
+		*len_ptr = mapping->len;
+		*ts_mapping = &mapping->ts;
+		mapping->map_count++;
+		*ref_count = &mapping->ref_count;
+		return CAM_SMMU_BUFF_EXIST;
 	}
 
 	return CAM_SMMU_BUFF_NOT_EXIST;
@@ -3091,13 +3211,11 @@ static enum cam_smmu_buf_state cam_smmu_check_dma_buf_in_list(int idx,
 {
 	struct cam_dma_buff_info *mapping;
 
-	list_for_each_entry(mapping,
-		&iommu_cb_set.cb_info[idx].smmu_buf_kernel_list, list) {
-		if (mapping->buf == buf) {
-			*paddr_ptr = mapping->paddr;
-			*len_ptr = mapping->len;
-			return CAM_SMMU_BUFF_EXIST;
-		}
+	mapping = cam_smmu_find_kernel_mapping(&iommu_cb_set.cb_info[idx], buf);
+	if (mapping) {
+		*paddr_ptr = mapping->paddr;
+		*len_ptr = mapping->len;
+		return CAM_SMMU_BUFF_EXIST;
 	}
 
 	return CAM_SMMU_BUFF_NOT_EXIST;
@@ -3317,6 +3435,7 @@ static int cam_smmu_alloc_scratch_buffer_add_to_list(int idx,
 		mapping_info->len, mapping_info->phys_len);
 
 	list_add(&mapping_info->list, &iommu_cb_set.cb_info[idx].smmu_buf_list);
+	cam_smmu_index_add_mapping(&iommu_cb_set.cb_info[idx], mapping_info, false);
 
 	*virt_addr = (dma_addr_t)iova;
 
@@ -3378,6 +3497,7 @@ static int cam_smmu_free_scratch_buffer_remove_from_list(
 	sg_free_table(mapping_info->table);
 	kfree(mapping_info->table);
 	list_del_init(&mapping_info->list);
+	cam_smmu_index_del_mapping(&iommu_cb_set.cb_info[idx], mapping_info);
 
 	kfree(mapping_info);
 	mapping_info = NULL;
@@ -5488,6 +5608,261 @@ static int cam_smmu_get_fatal_pf_mask(void *data, u64 *val)
 DEFINE_DEBUGFS_ATTRIBUTE(cam_smmu_fatal_pf_mask,
 	cam_smmu_get_fatal_pf_mask, cam_smmu_set_fatal_pf_mask, "%16llu");
 
+#define CAM_SMMU_INDEX_TEST_MAPPINGS  256
+#define CAM_SMMU_INDEX_TEST_QUERIES   1024
+#define CAM_SMMU_INDEX_TEST_MAX_ITER  64
+#define CAM_SMMU_INDEX_TEST_IOVA_BASE 0x10000000UL
+
+static uint32_t cam_smmu_index_test_rand(uint32_t *state)
+{
+	/* xorshift32, the state must never be 0 */
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+
+	return *state;
+}
+
+/* Distance from addr to a mapping, 0 if addr is inside it (end inclusive) */
+static unsigned long cam_smmu_index_test_delta(
+	struct cam_dma_buff_info *mapping, unsigned long addr)
+{
+	unsigned long start = (unsigned long)mapping->paddr;
+	unsigned long end = start + mapping->len;
+
+	if (addr < start)
+		return start - addr;
+	if (addr > end)
+		return addr - end - 1;
+
+	return 0;
+}
+
+/* Lookups the way they were done before the indexes: walk the lists */
+static struct cam_dma_buff_info *cam_smmu_index_test_linear_closest(
+	struct cam_context_bank_info *cb_info, unsigned long addr,
+	unsigned long *lowest_delta)
+{
+	struct cam_dma_buff_info *mapping, *closest = NULL;
+	unsigned long delta;
+
+	list_for_each_entry(mapping, &cb_info->smmu_buf_list, list) {
+		delta = cam_smmu_index_test_delta(mapping, addr);
+		if (!closest || (delta < *lowest_delta)) {
+			closest = mapping;
+			*lowest_delta = delta;
+		}
+	}
+
+	return closest;
+}
+
+static int cam_smmu_index_test_check(struct cam_context_bank_info *cb_info,
+	struct cam_dma_buff_info *mappings, uint32_t *state)
+{
+	struct cam_dma_buff_info *mapping, *found, *expected;
+	unsigned long addr, span, lowest_delta = 0;
+	int ion_fd;
+	unsigned long i_ino;
+	uint32_t q, i;
+	bool contained;
+
+	span = (unsigned long)mappings[CAM_SMMU_INDEX_TEST_MAPPINGS - 1].paddr +
+		mappings[CAM_SMMU_INDEX_TEST_MAPPINGS - 1].len -
+		CAM_SMMU_INDEX_TEST_IOVA_BASE;
+
+	for (q = 0; q < CAM_SMMU_INDEX_TEST_QUERIES; q++) {
+		i = cam_smmu_index_test_rand(state) % CAM_SMMU_INDEX_TEST_MAPPINGS;
+
+		/* Exact IOVA, the same as cam_smmu_find_mapping_by_virt_address */
+		addr = (unsigned long)mappings[i].paddr;
+		if (cam_smmu_index_test_rand(state) & 1)
+			addr += cam_smmu_index_test_rand(state) % 8;
+		expected = NULL;
+		list_for_each_entry(mapping, &cb_info->smmu_buf_list, list) {
+			if ((unsigned long)mapping->paddr == addr) {
+				expected = mapping;
+				break;
+			}
+		}
+		found = cam_smmu_iova_floor(cb_info, addr);
+		if (found && ((unsigned long)found->paddr != addr))
+			found = NULL;
+		if (found != expected) {
+			CAM_ERR(CAM_SMMU, "IOVA 0x%lx index %pK list %pK",
+				addr, found, expected);
+			return -EINVAL;
+		}
+
+		/* fd and i_ino, including pairs that were never mapped */
+		ion_fd = mappings[i].ion_fd;
+		i_ino = mappings[i].i_ino;
+		if (cam_smmu_index_test_rand(state) & 1)
+			ion_fd += 1 + (cam_smmu_index_test_rand(state) % 4);
+		expected = NULL;
+		list_for_each_entry(mapping, &cb_info->smmu_buf_list, list) {
+			if ((mapping->ion_fd == ion_fd) && (mapping->i_ino == i_ino)) {
+				expected = mapping;
+				break;
+			}
+		}
+		found = cam_smmu_find_user_mapping(cb_info, ion_fd, i_ino);
+		if (found != expected) {
+			CAM_ERR(CAM_SMMU, "fd %d i_ino %lu index %pK list %pK",
+				ion_fd, i_ino, found, expected);
+			return -EINVAL;
+		}
+
+		/* dma_buf of a kernel mapping */
+		expected = NULL;
+		list_for_each_entry(mapping, &cb_info->smmu_buf_kernel_list, list) {
+			if (mapping->buf == mappings[i].buf) {
+				expected = mapping;
+				break;
+			}
+		}
+		found = cam_smmu_find_kernel_mapping(cb_info, mappings[i].buf);
+		if (found != expected) {
+			CAM_ERR(CAM_SMMU, "dma_buf %pK index %pK list %pK",
+				mappings[i].buf, found, expected);
+			return -EINVAL;
+		}
+
+		/*
+		 * Closest mapping to a fault address. Neighbours at the same
+		 * distance are equally right, so compare distances.
+		 */
+		addr = CAM_SMMU_INDEX_TEST_IOVA_BASE - SZ_64K +
+			(cam_smmu_index_test_rand(state) % (span + SZ_128K));
+		expected = cam_smmu_index_test_linear_closest(cb_info, addr,
+			&lowest_delta);
+		found = cam_smmu_closest_mapping(cb_info, addr, &contained);
+		if ((!found != !expected) || (found &&
+			((cam_smmu_index_test_delta(found, addr) != lowest_delta) ||
+			(contained != !lowest_delta)))) {
+			CAM_ERR(CAM_SMMU,
+				"Closest to 0x%lx index %pK list %pK delta %lu contained %d",
+				addr, found, expected, lowest_delta, contained);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Map random, non overlapping (possibly adjacent) user and kernel buffers
+ * into a scratch context bank in random order, and check every indexed
+ * lookup against a walk of the mapping lists. Half of the mappings are then
+ * removed and the lookups are checked again.
+ */
+static int cam_smmu_index_self_test(uint32_t iterations, uint32_t seed)
+{
+	struct cam_context_bank_info *cb_info;
+	struct cam_dma_buff_info *mappings, *kmappings;
+	uint32_t state = seed ? seed : 1;
+	uint32_t iter, i, j, tmp;
+	uint32_t *order;
+	unsigned long iova;
+	int rc = 0;
+
+	cb_info = kvzalloc(sizeof(*cb_info), GFP_KERNEL);
+	mappings = kvcalloc(CAM_SMMU_INDEX_TEST_MAPPINGS, sizeof(*mappings),
+		GFP_KERNEL);
+	kmappings = kvcalloc(CAM_SMMU_INDEX_TEST_MAPPINGS, sizeof(*kmappings),
+		GFP_KERNEL);
+	order = kvcalloc(CAM_SMMU_INDEX_TEST_MAPPINGS, sizeof(*order),
+		GFP_KERNEL);
+	if (!cb_info || !mappings || !kmappings || !order) {
+		rc = -ENOMEM;
+		goto end;
+	}
+
+	for (iter = 0; (iter < iterations) && !rc; iter++) {
+		INIT_LIST_HEAD(&cb_info->smmu_buf_list);
+		INIT_LIST_HEAD(&cb_info->smmu_buf_kernel_list);
+		cb_info->iova_tree = RB_ROOT;
+		hash_init(cb_info->fd_hash);
+		hash_init(cb_info->dma_buf_hash);
+
+		iova = CAM_SMMU_INDEX_TEST_IOVA_BASE;
+		for (i = 0; i < CAM_SMMU_INDEX_TEST_MAPPINGS; i++) {
+			/* Gaps of 0 make adjacent ranges */
+			iova += (cam_smmu_index_test_rand(&state) % 4) * SZ_4K;
+			mappings[i].paddr = iova;
+			mappings[i].len = ((cam_smmu_index_test_rand(&state) % 16) +
+				1) * SZ_4K;
+			iova += mappings[i].len;
+
+			/* Few fds with several inodes each collide in the hash */
+			mappings[i].ion_fd = i % 32;
+			mappings[i].i_ino = 1000 + (i / 32);
+			mappings[i].buf = (struct dma_buf *)&kmappings[i];
+			kmappings[i].buf = mappings[i].buf;
+			order[i] = i;
+		}
+
+		for (i = CAM_SMMU_INDEX_TEST_MAPPINGS - 1; i > 0; i--) {
+			j = cam_smmu_index_test_rand(&state) % (i + 1);
+			tmp = order[i];
+			order[i] = order[j];
+			order[j] = tmp;
+		}
+
+		for (i = 0; i < CAM_SMMU_INDEX_TEST_MAPPINGS; i++) {
+			list_add(&mappings[order[i]].list, &cb_info->smmu_buf_list);
+			cam_smmu_index_add_mapping(cb_info, &mappings[order[i]], false);
+			list_add(&kmappings[order[i]].list,
+				&cb_info->smmu_buf_kernel_list);
+			cam_smmu_index_add_mapping(cb_info, &kmappings[order[i]], true);
+		}
+
+		rc = cam_smmu_index_test_check(cb_info, mappings, &state);
+		if (rc)
+			break;
+
+		/* Unmap every other mapping, in the shuffled order */
+		for (i = 0; i < CAM_SMMU_INDEX_TEST_MAPPINGS; i += 2) {
+			list_del_init(&mappings[order[i]].list);
+			cam_smmu_index_del_mapping(cb_info, &mappings[order[i]]);
+			list_del_init(&kmappings[order[i]].list);
+			cam_smmu_index_del_mapping(cb_info, &kmappings[order[i]]);
+		}
+
+		rc = cam_smmu_index_test_check(cb_info, mappings, &state);
+	}
+
+	if (rc)
+		CAM_ERR(CAM_SMMU, "Index self test failed seed: 0x%x iter: %u",
+			seed, iter);
+	else
+		CAM_INFO(CAM_SMMU, "Index self test passed %u iterations",
+			iterations);
+
+end:
+	kvfree(order);
+	kvfree(kmappings);
+	kvfree(mappings);
+	kvfree(cb_info);
+	return rc;
+}
+
+static int cam_smmu_set_index_test(void *data, u64 val)
+{
+	/* The value written is the number of random mapping sets to check */
+	return cam_smmu_index_self_test(
+		clamp_t(u64, val, 1, CAM_SMMU_INDEX_TEST_MAX_ITER),
+		get_random_u32());
+}
+
+static int cam_smmu_get_index_test(void *data, u64 *val)
+{
+	return 0;
+}
+
+DEFINE_DEBUGFS_ATTRIBUTE(cam_smmu_index_test,
+	cam_smmu_get_index_test, cam_smmu_set_index_test, "%16llu");
+
 static int cam_smmu_create_debug_fs(void)
 {
 	int rc = 0;
@@ -5513,6 +5888,8 @@ static int cam_smmu_create_debug_fs(void)
 		iommu_cb_set.debug_cfg.dentry, NULL, &cam_smmu_fatal_pf_mask);
 	debugfs_create_bool("disable_buf_tracking", 0644,
 		iommu_cb_set.debug_cfg.dentry, &iommu_cb_set.debug_cfg.disable_buf_tracking);
+	debugfs_create_file("test_buf_index", 0644,
+		iommu_cb_set.debug_cfg.dentry, NULL, &cam_smmu_index_test);
 
 end:
 	return rc;
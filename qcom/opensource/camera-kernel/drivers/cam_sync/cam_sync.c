@@ -10,6 +10,7 @@
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #if IS_REACHABLE(CONFIG_MSM_GLOBAL_SYNX) || IS_ENABLED(CONFIG_TARGET_SYNX_ENABLE)
 #include <synx_api.h>
 #endif
@@ -48,6 +49,24 @@ static void cam_sync_print_fence_table(void)
 	}
 }
 
+static void cam_sync_update_lat(struct cam_sync_lat_stats *stats,
+	ktime_t start)
+{
+	s64 lat_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	s64 max_ns = atomic64_read(&stats->max_ns);
+
+	atomic64_inc(&stats->count);
+	atomic64_add(lat_ns, &stats->total_ns);
+
+	while (lat_ns > max_ns) {
+		s64 old_ns = atomic64_cmpxchg(&stats->max_ns, max_ns, lat_ns);
+
+		if (old_ns == max_ns)
+			break;
+		max_ns = old_ns;
+	}
+}
+
 static int cam_sync_create_util(
 	int32_t *sync_obj, const char *name,
 	struct cam_dma_fence_create_sync_obj_payload *dma_sync_create_info,
@@ -57,9 +76,10 @@ static int cam_sync_create_util(
 	long idx;
 	bool bit;
 	struct sync_table_row *row = NULL;
+	ktime_t start = ktime_get();
 
 	do {
-		idx = find_first_zero_bit(sync_dev->bitmap, CAM_SYNC_MAX_OBJS);
+		idx = cam_sync_util_find_free_row(sync_dev);
 		if (idx >= CAM_SYNC_MAX_OBJS) {
 			CAM_ERR(CAM_SYNC,
 				"Error: Unable to create sync idx = %d sync name = %s reached max!",
@@ -131,6 +151,7 @@ static int cam_sync_create_util(
 
 end:
 	spin_unlock_bh(&sync_dev->row_spinlocks[idx]);
+	cam_sync_update_lat(&sync_dev->create_lat, start);
 	return rc;
 }
 
@@ -310,7 +331,8 @@ static inline int cam_sync_signal_dma_fence_util(
 }
 
 static void cam_sync_signal_parent_util(int32_t status,
-	uint32_t event_cause, struct list_head *parents_list)
+	uint32_t event_cause, struct list_head *parents_list,
+	struct list_head *cb_list)
 {
 	int rc;
 	struct sync_table_row *parent_row = NULL;
@@ -341,7 +363,7 @@ static void cam_sync_signal_parent_util(int32_t status,
 		if (!parent_row->remaining)
 			cam_sync_util_dispatch_signaled_cb(
 				parent_info->sync_id, parent_row->state,
-				event_cause);
+				event_cause, cb_list);
 
 		if (test_bit(CAM_GENERIC_FENCE_TYPE_SYNC_OBJ,
 			&cam_sync_monitor_mask))
@@ -392,7 +414,8 @@ static int cam_sync_signal_validate_util(
 	return 0;
 }
 
-int cam_sync_signal(int32_t sync_obj, uint32_t status, uint32_t event_cause)
+static int cam_sync_signal_util(int32_t sync_obj, uint32_t status,
+	uint32_t event_cause, struct list_head *cb_list)
 {
 	struct sync_table_row *row = NULL;
 	struct list_head parents_list;
@@ -461,7 +484,8 @@ int cam_sync_signal(int32_t sync_obj, uint32_t status, uint32_t event_cause)
 	}
 #endif
 
-	cam_sync_util_dispatch_signaled_cb(sync_obj, status, event_cause);
+	cam_sync_util_dispatch_signaled_cb(sync_obj, status, event_cause,
+		cb_list);
 
 	/* copy parent list to local and release child lock */
 	INIT_LIST_HEAD(&parents_list);
@@ -476,7 +500,8 @@ int cam_sync_signal(int32_t sync_obj, uint32_t status, uint32_t event_cause)
 	if (list_empty(&parents_list))
 		return 0;
 
-	cam_sync_signal_parent_util(status, event_cause, &parents_list);
+	cam_sync_signal_parent_util(status, event_cause, &parents_list,
+		cb_list);
 
 	return 0;
 
@@ -486,6 +511,90 @@ monitor_dump:
 	return rc;
 }
 
+int cam_sync_signal(int32_t sync_obj, uint32_t status, uint32_t event_cause)
+{
+	int rc;
+	ktime_t start = ktime_get();
+
+	rc = cam_sync_signal_util(sync_obj, status, event_cause, NULL);
+	if (!rc)
+		cam_sync_update_lat(&sync_dev->signal_lat, start);
+
+	return rc;
+}
+
+int cam_sync_signal_batch(struct cam_sync_signal *signals,
+	uint32_t num_signals, uint32_t event_cause)
+{
+	int rc = 0, signal_rc;
+	uint32_t i;
+	ktime_t start;
+	struct list_head *cb_list = NULL;
+	struct sync_callback_batch *batch;
+	struct sync_callback_info *sync_cb, *temp_sync_cb;
+
+	if (!signals || !num_signals) {
+		CAM_ERR(CAM_SYNC, "Invalid batch signals: %pK num: %u",
+			signals, num_signals);
+		return -EINVAL;
+	}
+
+	/*
+	 * Collect the kernel callbacks of every object in the batch and
+	 * dispatch them from a single work item, instead of queueing one
+	 * work per callback. Fall back to per callback dispatch if the
+	 * batch can not be allocated.
+	 */
+	batch = kzalloc(sizeof(*batch), GFP_ATOMIC);
+	if (batch) {
+		INIT_LIST_HEAD(&batch->cb_list);
+		INIT_WORK(&batch->cb_dispatch_work,
+			cam_sync_util_cb_batch_dispatch);
+		cb_list = &batch->cb_list;
+	}
+
+	for (i = 0; i < num_signals; i++) {
+		start = ktime_get();
+		signal_rc = cam_sync_signal_util(signals[i].sync_obj,
+			signals[i].sync_state, event_cause, cb_list);
+		if (signal_rc) {
+			CAM_ERR(CAM_SYNC,
+				"Failed to signal sync_obj: %d in batch idx: %u rc: %d",
+				signals[i].sync_obj, i, signal_rc);
+			if (!rc)
+				rc = signal_rc;
+			continue;
+		}
+
+		cam_sync_update_lat(&sync_dev->signal_lat, start);
+	}
+
+	if (!batch)
+		return rc;
+
+	if (list_empty(&batch->cb_list)) {
+		kfree(batch);
+		return rc;
+	}
+
+	if (trigger_cb_without_switch) {
+		list_for_each_entry_safe(sync_cb, temp_sync_cb,
+			&batch->cb_list, list) {
+			list_del_init(&sync_cb->list);
+			sync_cb->callback_func(sync_cb->sync_obj,
+				sync_cb->status, sync_cb->cb_data);
+			kfree(sync_cb);
+		}
+		kfree(batch);
+		return rc;
+	}
+
+	batch->workq_scheduled_ts = ktime_get();
+	queue_work(sync_dev->work_queue, &batch->cb_dispatch_work);
+
+	return rc;
+}
+
 int cam_sync_merge(int32_t *sync_obj, uint32_t num_objs, int32_t *merged_obj)
 {
 	int rc, i;
@@ -517,7 +626,7 @@ int cam_sync_merge(int32_t *sync_obj, uint32_t num_objs, int32_t *merged_obj)
 		}
 	}
 	do {
-		idx = find_first_zero_bit(sync_dev->bitmap, CAM_SYNC_MAX_OBJS);
+		idx = cam_sync_util_find_free_row(sync_dev);
 		if (idx >= CAM_SYNC_MAX_OBJS)
 			return -ENOMEM;
 		bit = test_and_set_bit(idx, sync_dev->bitmap);
@@ -1043,7 +1152,7 @@ static int cam_sync_dma_fence_cb(
 
 	row->state = status;
 
-	cam_sync_util_dispatch_signaled_cb(sync_obj, status, 0);
+	cam_sync_util_dispatch_signaled_cb(sync_obj, status, 0, NULL);
 
 	INIT_LIST_HEAD(&parents_list);
 	list_splice_init(&row->parents_list, &parents_list);
@@ -1052,7 +1161,7 @@ static int cam_sync_dma_fence_cb(
 	if (list_empty(&parents_list))
 		return 0;
 
-	cam_sync_signal_parent_util(status, 0x0, &parents_list);
+	cam_sync_signal_parent_util(status, 0x0, &parents_list, NULL);
 	return 0;
 
 end:
@@ -1119,7 +1228,8 @@ static int cam_sync_synx_obj_cb(int32_t sync_obj,
 
 	row->state = signal_sync_obj->status;
 
-	cam_sync_util_dispatch_signaled_cb(sync_obj, signal_sync_obj->status, 0);
+	cam_sync_util_dispatch_signaled_cb(sync_obj, signal_sync_obj->status, 0,
+		NULL);
 
 	INIT_LIST_HEAD(&parents_list);
 	list_splice_init(&row->parents_list, &parents_list);
@@ -1128,7 +1238,8 @@ static int cam_sync_synx_obj_cb(int32_t sync_obj,
 	if (list_empty(&parents_list))
 		return 0;
 
-	cam_sync_signal_parent_util(signal_sync_obj->status, 0x0, &parents_list);
+	cam_sync_signal_parent_util(signal_sync_obj->status, 0x0, &parents_list,
+		NULL);
 	CAM_DBG(CAM_SYNC,
 		"Successfully signaled sync obj = %d with status = %d via synx obj = %d signal callback",
 		sync_obj, signal_sync_obj->status, signal_sync_obj->synx_obj);
@@ -2248,6 +2359,57 @@ static int cam_generic_fence_handle_sync_release(
 	return rc;
 }
 
+static int cam_generic_fence_handle_sync_signal(
+	struct cam_generic_fence_cmd_args *fence_cmd_args)
+{
+	int32_t rc, i;
+	struct cam_generic_fence_signal_info *fence_signal_info;
+	struct cam_sync_signal *sync_signal_info;
+
+	rc = cam_generic_fence_validate_signal_input_info_util(
+		CAM_GENERIC_FENCE_TYPE_SYNC_OBJ, fence_cmd_args,
+		&fence_signal_info, (void **)&sync_signal_info);
+	if (rc || !fence_signal_info || !sync_signal_info) {
+		CAM_ERR(CAM_SYNC,
+			"Fence input signal info validation failed rc: %d fence_input_info: %pK sync_signal_info: %pK",
+			rc, fence_signal_info, sync_signal_info);
+		return -EINVAL;
+	}
+
+	/* need to get ref for UMD signaled fences */
+	for (i = 0; i < fence_signal_info->num_fences_requested; i++) {
+		fence_signal_info->num_fences_processed++;
+
+		rc = cam_sync_get_obj_ref(sync_signal_info[i].sync_obj);
+		if (rc) {
+			CAM_ERR(CAM_SYNC,
+				"Cannot signal an uninitialized sync_obj: %d rc: %d",
+				sync_signal_info[i].sync_obj, rc);
+			break;
+		}
+	}
+
+	if (i) {
+		int signal_rc = cam_sync_signal_batch(sync_signal_info, i,
+			CAM_SYNC_COMMON_SYNC_SIGNAL_EVENT);
+
+		if (!rc)
+			rc = signal_rc;
+	}
+
+	if (copy_to_user(u64_to_user_ptr(fence_cmd_args->input_handle),
+		fence_signal_info, sizeof(struct cam_generic_fence_signal_info))) {
+		rc = -EFAULT;
+		CAM_ERR(CAM_SYNC, "copy to user failed hdl: %d size: 0x%x",
+			fence_cmd_args->input_handle,
+			sizeof(struct cam_generic_fence_signal_info));
+	}
+
+	cam_generic_fence_free_signal_input_info_util(&fence_signal_info,
+		(void **)&sync_signal_info);
+	return rc;
+}
+
 static int cam_generic_fence_process_sync_obj_cmd(
 	uint32_t id,
 	struct cam_generic_fence_cmd_args *fence_cmd_args)
@@ -2261,6 +2423,9 @@ static int cam_generic_fence_process_sync_obj_cmd(
 	case CAM_GENERIC_FENCE_RELEASE:
 		rc = cam_generic_fence_handle_sync_release(fence_cmd_args);
 		break;
+	case CAM_GENERIC_FENCE_SIGNAL:
+		rc = cam_generic_fence_handle_sync_signal(fence_cmd_args);
+		break;
 	default:
 		CAM_ERR(CAM_SYNC, "IOCTL cmd: %u not supported for sync object", id);
 		break;
@@ -2659,6 +2824,26 @@ static void cam_sync_init_entity(struct sync_device *sync_dev)
 }
 #endif
 
+static void cam_sync_print_lat(struct seq_file *m, const char *name,
+	struct cam_sync_lat_stats *stats)
+{
+	s64 count = atomic64_read(&stats->count);
+	s64 total_ns = atomic64_read(&stats->total_ns);
+
+	seq_printf(m, "%-8s count: %lld avg_ns: %lld max_ns: %lld\n", name,
+		count, count ? div64_s64(total_ns, count) : 0,
+		atomic64_read(&stats->max_ns));
+}
+
+static int cam_sync_latency_show(struct seq_file *m, void *data)
+{
+	cam_sync_print_lat(m, "create", &sync_dev->create_lat);
+	cam_sync_print_lat(m, "signal", &sync_dev->signal_lat);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(cam_sync_latency);
+
 static int cam_sync_create_debugfs(void)
 {
 	int rc;
@@ -2680,6 +2865,9 @@ static int cam_sync_create_debugfs(void)
 
 	debugfs_create_ulong("cam_sync_monitor_mask", 0644,
 		sync_dev->dentry, &cam_sync_monitor_mask);
+
+	debugfs_create_file("latency", 0444,
+		sync_dev->dentry, NULL, &cam_sync_latency_fops);
 end:
 	return rc;
 }
@@ -2831,6 +3019,7 @@ static int cam_sync_component_bind(struct device *dev,
 	 * always
 	 */
 	set_bit(0, sync_dev->bitmap);
+	sync_dev->alloc_hint = 1;
 
 	sync_dev->work_queue = alloc_workqueue(CAM_SYNC_WORKQUEUE_NAME,
 		WQ_HIGHPRI | WQ_UNBOUND, 1);
@@ -89,6 +89,23 @@ int cam_sync_deregister_callback(sync_callback cb_func,
  */
 int cam_sync_signal(int32_t sync_obj, uint32_t status, uint32_t evt_param);
 
+/**
+ * @brief: Signals an array of sync objects
+ *
+ * Each object is signaled as with cam_sync_signal(), but the kernel
+ * callbacks of all objects in the batch are dispatched together from a
+ * single work item once every object has been signaled. An object that
+ * fails to signal does not stop the rest of the batch.
+ *
+ * @param signals     : Array of sync object and status pairs
+ * @param num_signals : Number of entries in the array
+ * @param evt_param   : Event parameter
+ *
+ * @return Status of operation. First error hit in the batch, zero otherwise.
+ */
+int cam_sync_signal_batch(struct cam_sync_signal *signals,
+	uint32_t num_signals, uint32_t evt_param);
+
 /**
  * @brief: Merges multiple sync objects
  *
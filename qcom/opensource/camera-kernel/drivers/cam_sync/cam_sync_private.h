@@ -148,6 +148,20 @@ struct sync_callback_info {
 	struct list_head list;
 };
 
+/**
+ * struct sync_callback_batch - Kernel callbacks collected while signaling
+ * a batch of sync objects, dispatched together from one work item
+ *
+ * @cb_list            : List of struct sync_callback_info to be invoked
+ * @workq_scheduled_ts : workqueue scheduled timestamp
+ * @cb_dispatch_work   : Work representing the batch dispatch
+ */
+struct sync_callback_batch {
+	struct list_head cb_list;
+	ktime_t workq_scheduled_ts;
+	struct work_struct cb_dispatch_work;
+};
+
 /**
  * struct sync_user_payload - Single node of information about a user space
  * payload registered from user space
@@ -340,6 +354,19 @@ struct cam_signalable_info {
 	struct list_head list;
 };
 
+/**
+ * struct cam_sync_lat_stats - Latency counters for a sync operation
+ *
+ * @count    : Number of operations accounted
+ * @total_ns : Sum of operation latencies in ns
+ * @max_ns   : Worst operation latency in ns
+ */
+struct cam_sync_lat_stats {
+	atomic64_t count;
+	atomic64_t total_ns;
+	atomic64_t max_ns;
+};
+
 /**
  * struct sync_device - Internal struct to book keep sync driver details
  *
@@ -353,7 +380,10 @@ struct cam_signalable_info {
  * @work_queue      : Work queue used for dispatching kernel callbacks
  * @cam_sync_eventq : Event queue used to dispatch user payloads to user space
  * @bitmap          : Bitmap representation of all sync objects
+ * @alloc_hint      : Row index the next free row search starts from
  * @mon_data        : Objects monitor data
+ * @create_lat      : Sync object create latency counters
+ * @signal_lat      : Sync object signal latency counters
  * @params          : Parameters for synx call back registration
  * @version         : version support
  */
@@ -369,7 +399,10 @@ struct sync_device {
 	struct v4l2_fh *cam_sync_eventq;
 	spinlock_t cam_sync_eventq_lock;
 	DECLARE_BITMAP(bitmap, CAM_SYNC_MAX_OBJS);
+	unsigned int alloc_hint;
 	struct cam_generic_fence_monitor_data **mon_data;
+	struct cam_sync_lat_stats create_lat;
+	struct cam_sync_lat_stats signal_lat;
 #if IS_REACHABLE(CONFIG_MSM_GLOBAL_SYNX)
 	struct synx_register_params params;
 #endif
@@ -303,6 +303,31 @@ void cam_sync_dump_monitor_array(struct sync_table_row *row)
 	cam_generic_fence_dump_monitor_array(&obj_info);
 }
 
+long cam_sync_util_find_free_row(struct sync_device *sync_dev)
+{
+	unsigned int hint = READ_ONCE(sync_dev->alloc_hint);
+	long idx = CAM_SYNC_MAX_OBJS;
+
+	/*
+	 * Next-fit: rows are mostly released in allocation order, so the
+	 * region right after the last allocation is the likeliest to be free.
+	 * This avoids rescanning the busy low part of the bitmap on every
+	 * create and delays reuse of a just released handle.
+	 */
+	if (hint < CAM_SYNC_MAX_OBJS)
+		idx = find_next_zero_bit(sync_dev->bitmap,
+			CAM_SYNC_MAX_OBJS, hint);
+
+	if (idx >= CAM_SYNC_MAX_OBJS)
+		idx = find_next_zero_bit(sync_dev->bitmap,
+			CAM_SYNC_MAX_OBJS, 1);
+
+	if (idx < CAM_SYNC_MAX_OBJS)
+		WRITE_ONCE(sync_dev->alloc_hint, idx + 1);
+
+	return idx;
+}
+
 int cam_sync_util_find_and_set_empty_row(struct sync_device *sync_dev,
 	long *idx)
 {
@@ -310,7 +335,7 @@ int cam_sync_util_find_and_set_empty_row(struct sync_device *sync_dev,
 
 	mutex_lock(&sync_dev->table_lock);
 
-	*idx = find_first_zero_bit(sync_dev->bitmap, CAM_SYNC_MAX_OBJS);
+	*idx = cam_sync_util_find_free_row(sync_dev);
 
 	if (*idx < CAM_SYNC_MAX_OBJS)
 		set_bit(*idx, sync_dev->bitmap);
@@ -645,8 +670,31 @@ void cam_sync_util_cb_dispatch(struct work_struct *cb_dispatch_work)
 	kfree(cb_info);
 }
 
+void cam_sync_util_cb_batch_dispatch(struct work_struct *cb_dispatch_work)
+{
+	struct sync_callback_batch *batch = container_of(cb_dispatch_work,
+		struct sync_callback_batch,
+		cb_dispatch_work);
+	struct sync_callback_info *cb_info, *temp_cb_info;
+
+	cam_common_util_thread_switch_delay_detect(
+		"cam_sync_workq", "schedule", cam_sync_util_cb_batch_dispatch,
+		batch->workq_scheduled_ts,
+		CAM_WORKQ_SCHEDULE_TIME_THRESHOLD);
+
+	list_for_each_entry_safe(cb_info, temp_cb_info,
+		&batch->cb_list, list) {
+		list_del_init(&cb_info->list);
+		cb_info->callback_func(cb_info->sync_obj, cb_info->status,
+			cb_info->cb_data);
+		kfree(cb_info);
+	}
+
+	kfree(batch);
+}
+
 void cam_sync_util_dispatch_signaled_cb(int32_t sync_obj,
-	uint32_t status, uint32_t event_cause)
+	uint32_t status, uint32_t event_cause, struct list_head *cb_list)
 {
 	struct sync_callback_info  *sync_cb;
 	struct sync_user_payload   *payload_info;
@@ -672,6 +720,11 @@ void cam_sync_util_dispatch_signaled_cb(int32_t sync_obj,
 			cam_generic_fence_update_monitor_array(sync_obj,
 				&sync_dev->table_lock, sync_dev->mon_data,
 				CAM_FENCE_OP_UNREGISTER_ON_SIGNAL);
+		if (cb_list) {
+			list_add_tail(&sync_cb->list, cb_list);
+			continue;
+		}
+		sync_cb->workq_scheduled_ts = ktime_get();
 		queue_work(sync_dev->work_queue,
 			&sync_cb->cb_dispatch_work);
 	}
@@ -49,6 +49,19 @@ struct cam_sync_check_for_synx_release {
 	bool sync_created_with_synx;
 };
 
+/**
+ * @brief: Finds the next free row in the sync table, searching from the
+ * row after the last allocation and wrapping around once
+ *
+ * The bit is not set, callers claim the row with test_and_set_bit() and
+ * retry on a lost race.
+ *
+ * @param sync_dev : Pointer to the sync device instance
+ *
+ * @return Free row index, CAM_SYNC_MAX_OBJS if the table is full
+ */
+long cam_sync_util_find_free_row(struct sync_device *sync_dev);
+
 /**
  * @brief: Finds an empty row in the sync table and sets its corresponding bit
  * in the bit array
@@ -117,17 +130,29 @@ int cam_sync_init_group_object(struct sync_table_row *table,
  */
 void cam_sync_util_cb_dispatch(struct work_struct *cb_dispatch_work);
 
+/**
+ * @brief: Function to dispatch a batch of kernel callbacks collected
+ *         while signaling multiple sync objects
+ *
+ * @param cb_dispatch_work : Pointer to the work_struct of the batch
+ *
+ * @return None
+ */
+void cam_sync_util_cb_batch_dispatch(struct work_struct *cb_dispatch_work);
+
 /**
  * @brief: Function to dispatch callbacks for a signaled sync object
  *
  * @sync_obj    : Sync object that is signaled
  * @status      : Status of the signaled object
  * @evt_param   : Event paramaeter
+ * @cb_list     : If not NULL, kernel callbacks are moved to this list for
+ *                the caller to dispatch instead of being queued one by one
  *
  * @return None
  */
 void cam_sync_util_dispatch_signaled_cb(int32_t sync_obj,
-	uint32_t status, uint32_t evt_param);
+	uint32_t status, uint32_t evt_param, struct list_head *cb_list);
 
 /**
  * @brief: Function to send V4L event to user space
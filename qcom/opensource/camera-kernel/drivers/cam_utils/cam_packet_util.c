@@ -6,13 +6,16 @@
 
 #include <linux/types.h>
 #include <linux/slab.h>
+#include <linux/hash.h>
 
 #include "cam_mem_mgr.h"
 #include "cam_packet_util.h"
 #include "cam_debug_util.h"
 #include "cam_common_util.h"
 
-#define CAM_UNIQUE_SRC_HDL_MAX 50
+#define CAM_UNIQUE_SRC_HDL_MAX 64
+#define CAM_UNIQUE_SRC_HDL_BITS 6
+#define CAM_PATCH_DST_HDL_MAX 8
 #define CAM_PRESIL_UNIQUE_HDL_MAX 50
 
 struct cam_patch_unique_src_buf_tbl {
@@ -22,6 +25,12 @@ struct cam_patch_unique_src_buf_tbl {
 	uint32_t      flags;
 };
 
+struct cam_patch_dst_buf_tbl {
+	int32_t       hdl;
+	uintptr_t     cpu_addr;
+	size_t        buf_len;
+};
+
 int cam_packet_util_get_packet_addr(struct cam_packet **packet,
 	uint64_t packet_handle, uint32_t offset)
 {
@@ -343,13 +352,16 @@ static int cam_packet_util_get_patch_iova(
 	int32_t hdl, uint32_t buf_hdl, dma_addr_t *iova,
 	size_t *buf_size, uint32_t *flags, struct list_head *mapped_io_list)
 {
-	int idx = 0;
+	int idx = 0, probe;
 	int rc = 0;
 	size_t src_buf_size;
 	dma_addr_t iova_addr;
 	bool is_found = false;
 
-	for (idx = 0; idx < CAM_UNIQUE_SRC_HDL_MAX; idx++) {
+	/* Open addressing on the handle hash, linear probing */
+	idx = hash_32(buf_hdl, CAM_UNIQUE_SRC_HDL_BITS);
+	for (probe = 0; probe < CAM_UNIQUE_SRC_HDL_MAX; probe++,
+		idx = (idx + 1) & (CAM_UNIQUE_SRC_HDL_MAX - 1)) {
 		if (buf_hdl == tbl[idx].hdl) {
 			CAM_DBG(CAM_UTIL,
 				"Matched entry for src_buf_hdl: 0x%x with src_hdl[%d]: 0x%x",
@@ -381,7 +393,7 @@ static int cam_packet_util_get_patch_iova(
 			return rc;
 		}
 		/* Update the table entry with unique src buf handle */
-		if (idx < CAM_UNIQUE_SRC_HDL_MAX && tbl[idx].hdl == 0) {
+		if (probe < CAM_UNIQUE_SRC_HDL_MAX && tbl[idx].hdl == 0) {
 			tbl[idx].buf_size = src_buf_size;
 			tbl[idx].iova = iova_addr;
 			tbl[idx].hdl = buf_hdl;
@@ -397,6 +409,56 @@ static int cam_packet_util_get_patch_iova(
 	return rc;
 }
 
+static void cam_packet_util_put_patch_dst(
+	struct cam_patch_dst_buf_tbl *tbl, int *num_dst)
+{
+	int idx;
+
+	for (idx = 0; idx < *num_dst; idx++)
+		cam_mem_put_cpu_buf(tbl[idx].hdl);
+
+	*num_dst = 0;
+}
+
+/*
+ * Patches usually target a handful of command buffers, so keep every dst
+ * buffer acquired for the whole packet instead of a get/put per patch.
+ */
+static int cam_packet_util_get_patch_dst(
+	struct cam_patch_dst_buf_tbl *tbl, int *num_dst,
+	int32_t buf_hdl, uintptr_t *cpu_addr, size_t *buf_len)
+{
+	int idx;
+	int rc;
+
+	for (idx = 0; idx < *num_dst; idx++) {
+		if (tbl[idx].hdl == buf_hdl) {
+			*cpu_addr = tbl[idx].cpu_addr;
+			*buf_len = tbl[idx].buf_len;
+			return 0;
+		}
+	}
+
+	if (*num_dst == CAM_PATCH_DST_HDL_MAX)
+		cam_packet_util_put_patch_dst(tbl, num_dst);
+
+	rc = cam_mem_get_cpu_buf(buf_hdl, cpu_addr, buf_len);
+	if (rc < 0)
+		return rc;
+
+	if (!*cpu_addr || (*buf_len == 0)) {
+		cam_mem_put_cpu_buf(buf_hdl);
+		return -EINVAL;
+	}
+
+	idx = (*num_dst)++;
+	tbl[idx].hdl = buf_hdl;
+	tbl[idx].cpu_addr = *cpu_addr;
+	tbl[idx].buf_len = *buf_len;
+
+	return 0;
+}
+
 int cam_packet_util_process_patches(struct cam_packet *packet,
 	struct list_head *mapped_io_list, int32_t iommu_hdl, int32_t sec_mmu_hdl,
 	bool exp_mem)
@@ -412,8 +474,10 @@ int cam_packet_util_process_patches(struct cam_packet *packet,
 	int        rc = 0;
 	uint32_t   flags = 0;
 	int32_t hdl;
+	int        num_dst = 0;
 	struct cam_patch_unique_src_buf_tbl
 		tbl[CAM_UNIQUE_SRC_HDL_MAX];
+	struct cam_patch_dst_buf_tbl dst_tbl[CAM_PATCH_DST_HDL_MAX];
 
 	memset(tbl, 0, CAM_UNIQUE_SRC_HDL_MAX *
 		sizeof(struct cam_patch_unique_src_buf_tbl));
@@ -437,23 +501,24 @@ int cam_packet_util_process_patches(struct cam_packet *packet,
 			CAM_ERR(CAM_UTIL,
 				"get_iova failed for patch[%d], src_buf_hdl: 0x%x: rc: %d",
 				i, patch_desc[i].src_buf_hdl, rc);
-			return rc;
+			goto put_dst;
 		}
 
 		if ((size_t)patch_desc[i].src_offset >= src_buf_size) {
 			CAM_ERR(CAM_UTIL,
 				"Invalid src buf patch offset: patch:src_offset: 0x%x, src_buf_size: %zu",
 				patch_desc[i].src_offset, src_buf_size);
-			return -EINVAL;
+			rc = -EINVAL;
+			goto put_dst;
 		}
 
 		temp = iova_addr;
 
-		rc = cam_mem_get_cpu_buf(patch_desc[i].dst_buf_hdl,
-			&cpu_addr, &dst_buf_len);
-		if (rc < 0 || !cpu_addr || (dst_buf_len == 0)) {
+		rc = cam_packet_util_get_patch_dst(dst_tbl, &num_dst,
+			patch_desc[i].dst_buf_hdl, &cpu_addr, &dst_buf_len);
+		if (rc) {
 			CAM_ERR(CAM_UTIL, "unable to get dst buf address");
-			return rc;
+			goto put_dst;
 		}
 		dst_cpu_addr = (uint32_t *)cpu_addr;
 
@@ -466,8 +531,8 @@ int cam_packet_util_process_patches(struct cam_packet *packet,
 			(size_t)patch_desc[i].dst_offset)) {
 			CAM_ERR(CAM_UTIL,
 				"Invalid dst buf patch offset");
-			cam_mem_put_cpu_buf((int32_t)patch_desc[i].dst_buf_hdl);
-			return -EINVAL;
+			rc = -EINVAL;
+			goto put_dst;
 		}
 
 		dst_cpu_addr = (uint32_t *)((uint8_t *)dst_cpu_addr +
@@ -496,9 +561,10 @@ int cam_packet_util_process_patches(struct cam_packet *packet,
 			CAM_BOOL_TO_YESNO(flags & CAM_MEM_FLAG_HW_SHARED_ACCESS),
 			CAM_BOOL_TO_YESNO(flags & CAM_MEM_FLAG_CMD_BUF_TYPE),
 			CAM_BOOL_TO_YESNO(flags & CAM_MEM_FLAG_HW_AND_CDM_OR_SHARED));
-		cam_mem_put_cpu_buf((int32_t)patch_desc[i].dst_buf_hdl);
 	}
 
+put_dst:
+	cam_packet_util_put_patch_dst(dst_tbl, &num_dst);
 	return rc;
 }
 
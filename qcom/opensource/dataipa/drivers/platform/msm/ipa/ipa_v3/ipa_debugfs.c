@@ -1640,6 +1640,7 @@ static ssize_t ipa3_read_page_recycle_stats(struct file *file,
 {
 	int nbytes;
 	int cnt = 0, i = 0, k = 0;
+	struct ipa3_page_recycle_stats *stats;
 
 	nbytes = scnprintf(
 		dbg_buff, IPA_MAX_MSG_LEN,
@@ -1671,6 +1672,24 @@ static ssize_t ipa3_read_page_recycle_stats(struct file *file,
 
 	cnt += nbytes;
 
+	for (k = 0; k < 2; k++) {
+		stats = &ipa3_ctx->stats.page_recycle_stats[k];
+		nbytes = scnprintf(
+			dbg_buff + cnt, IPA_MAX_MSG_LEN - cnt,
+			"%s   : Ready list hits =%llu recycle hit rate =%llu%%\n"
+			"%s   : Time to reuse avg =%lluus max =%lluus\n",
+			k ? "DEF " : "COAL", stats->ready_hit,
+			stats->total_replenished ?
+			div64_u64(stats->page_recycled * 100,
+				stats->total_replenished) : 0,
+			k ? "DEF " : "COAL",
+			stats->page_recycled ?
+			div64_u64(stats->reuse_time_total_us,
+				stats->page_recycled) : 0,
+			stats->reuse_time_max_us);
+		cnt += nbytes;
+	}
+
 	for (k = 0; k < 2; k++) {
 		for (i = 0; i < ipa3_ctx->page_poll_threshold; i++) {
 			nbytes = scnprintf(
@@ -101,6 +101,9 @@
 
 #define IPA_EOT_THRESH 32
 
+/* In-flight pages checked by the sort tasklet per run */
+#define IPA_PAGE_SORT_BUDGET 64
+
 #define IPA_QMAP_ID_BYTE 0
 
 #define IPA_MEM_ALLOC_RETRY 5
@@ -1383,41 +1386,61 @@ static void ipa3_schd_freepage_work(struct work_struct *work)
 	tasklet_schedule(&sys->tasklet_find_freepage);
 }
 
+/*
+ * Walk at most IPA_PAGE_SORT_BUDGET in-flight pages per run. Free pages
+ * move to the ready list, pages still held by the stack rotate to the
+ * tail so the next run starts with ones not checked yet. Only a full
+ * pass over the pool without a free page falls back to the delayed work.
+ */
 static void ipa3_tasklet_find_freepage(unsigned long data)
 {
 	struct ipa3_sys_context *sys;
+	struct ipa3_page_repl_ctx *repl;
 	struct ipa3_rx_pkt_wrapper *rx_pkt = NULL;
 	struct ipa3_rx_pkt_wrapper *tmp = NULL;
 	struct page *cur_page;
 	int found_free_page = 0;
-	struct list_head temp_head;
+	u32 scanned = 0;
+	struct list_head busy_head;
 
 	sys = (struct ipa3_sys_context *)data;
 
 	if(sys->page_recycle_repl == NULL)
 		return;
-	INIT_LIST_HEAD(&temp_head);
+	repl = sys->page_recycle_repl;
+	INIT_LIST_HEAD(&busy_head);
 	spin_lock_bh(&sys->common_sys->spinlock);
-	list_for_each_entry_safe(rx_pkt, tmp,
-		&sys->page_recycle_repl->page_repl_head, link) {
+	list_for_each_entry_safe(rx_pkt, tmp, &repl->page_repl_head, link) {
+		if (scanned == IPA_PAGE_SORT_BUDGET)
+			break;
+		scanned++;
 		cur_page = rx_pkt->page_data.page;
 		if (page_ref_count(cur_page) == 1) {
 			/* Found a free page. */
-			list_del_init(&rx_pkt->link);
-			list_add(&rx_pkt->link, &temp_head);
+			list_move_tail(&rx_pkt->link, &repl->ready_head);
 			found_free_page++;
+		} else {
+			list_move_tail(&rx_pkt->link, &busy_head);
 		}
 	}
-	if (!found_free_page) {
+	list_splice_tail(&busy_head, &repl->page_repl_head);
+	repl->sort_scanned += scanned;
+
+	if (!found_free_page && repl->sort_scanned < repl->capacity &&
+		scanned == IPA_PAGE_SORT_BUDGET) {
+		/* Part of the pool is not checked yet, continue right away */
+		tasklet_schedule(&sys->tasklet_find_freepage);
+	} else if (!found_free_page) {
 		/*Not found free page rescheduling tasklet after 2msec*/
 		IPADBG_LOW("Scheduling WQ not found free pages\n");
+		repl->sort_scanned = 0;
 		++ipa3_ctx->stats.num_of_times_wq_reschd;
 		queue_delayed_work(sys->freepage_wq,
 				&sys->freepage_work,
 				msecs_to_jiffies(ipa3_ctx->page_wq_reschd_time));
 	} else {
 		/*Allow to use pre-allocated buffers*/
-		list_splice(&temp_head, &sys->page_recycle_repl->page_repl_head);
+		repl->sort_scanned = 0;
 		ipa3_ctx->stats.page_recycle_cnt_in_tasklet += found_free_page;
 		IPADBG_LOW("found free pages count = %d\n", found_free_page);
 		ipa3_ctx->free_page_task_scheduled = false;
@@ -1764,6 +1787,7 @@ int ipa_setup_sys_pipe(struct ipa_sys_connect_params *sys_in, u32 *clnt_hdl)
 				IPADBG("Page repl capacity for client:%d, value:%d\n",
 						   sys_in->client, ep->sys->page_recycle_repl->capacity);
 				INIT_LIST_HEAD(&ep->sys->page_recycle_repl->page_repl_head);
+				INIT_LIST_HEAD(&ep->sys->page_recycle_repl->ready_head);
 				INIT_DELAYED_WORK(&ep->sys->freepage_work, ipa3_schd_freepage_work);
 				tasklet_init(&ep->sys->tasklet_find_freepage,
 					ipa3_tasklet_find_freepage, (unsigned long) ep->sys);
@@ -2816,8 +2840,9 @@ static void ipa3_replenish_rx_page_cache(struct ipa3_sys_context *sys)
 		}
 		INIT_LIST_HEAD(&rx_pkt->link);
 		rx_pkt->sys = sys;
+		rx_pkt->recycle_time = ktime_get();
 		list_add_tail(&rx_pkt->link,
-			&sys->page_recycle_repl->page_repl_head);
+			&sys->page_recycle_repl->ready_head);
 	}
 	atomic_set(&sys->common_sys->page_avilable, 1);
 
@@ -2888,6 +2913,29 @@ static inline void __trigger_repl_work(struct ipa3_sys_context *sys)
 	}
 }
 
+/*
+ * Put a page only referenced by IPA back on the ready list. Caller holds
+ * the common_sys spinlock.
+ */
+static inline void ipa3_page_recycle_ready(struct ipa3_rx_pkt_wrapper *rx_pkt)
+{
+	rx_pkt->recycle_time = ktime_get();
+	list_add(&rx_pkt->link, &rx_pkt->sys->page_recycle_repl->ready_head);
+	atomic_set(&rx_pkt->sys->common_sys->page_avilable, 1);
+}
+
+static void ipa3_page_recycle_account(struct ipa3_rx_pkt_wrapper *rx_pkt,
+	u32 stats_i)
+{
+	struct ipa3_page_recycle_stats *stats =
+		&ipa3_ctx->stats.page_recycle_stats[stats_i];
+	u64 reuse_us = ktime_us_delta(ktime_get(), rx_pkt->recycle_time);
+
+	stats->reuse_time_total_us += reuse_us;
+	if (reuse_us > stats->reuse_time_max_us)
+		stats->reuse_time_max_us = reuse_us;
+}
+
 static struct ipa3_rx_pkt_wrapper * ipa3_get_free_page
 (
 	struct ipa3_sys_context *sys,
@@ -2901,6 +2949,13 @@ static struct ipa3_rx_pkt_wrapper * ipa3_get_free_page
 	u8 LOOP_THRESHOLD = ipa3_ctx->page_poll_threshold;
 
 	spin_lock_bh(&sys->common_sys->spinlock);
+	rx_pkt = list_first_entry_or_null(&sys->page_recycle_repl->ready_head,
+		struct ipa3_rx_pkt_wrapper, link);
+	if (rx_pkt) {
+		++ipa3_ctx->stats.page_recycle_stats[stats_i].ready_hit;
+		goto found;
+	}
+	/* Only the oldest in-flight pages are worth checking here. */
 	list_for_each_entry_safe(rx_pkt, tmp,
 		&sys->page_recycle_repl->page_repl_head, link) {
 		if (i == LOOP_THRESHOLD)
@@ -2908,12 +2963,8 @@ static struct ipa3_rx_pkt_wrapper * ipa3_get_free_page
 		cur_page = rx_pkt->page_data.page;
 		if (page_ref_count(cur_page) == 1) {
 			/* Found a free page. */
-			page_ref_inc(cur_page);
-			list_del_init(&rx_pkt->link);
 			++ipa3_ctx->stats.page_recycle_cnt[stats_i][i];
-			sys->common_sys->napi_sort_page_thrshld_cnt = 0;
-			spin_unlock_bh(&sys->common_sys->spinlock);
-			return rx_pkt;
+			goto found;
 		}
 		i++;
 	}
@@ -2944,6 +2995,14 @@ static struct ipa3_rx_pkt_wrapper * ipa3_get_free_page
 			spin_unlock(&ipa3_ctx->notifier_lock);
 	}
 	return NULL;
+
+found:
+	page_ref_inc(rx_pkt->page_data.page);
+	list_del_init(&rx_pkt->link);
+	sys->common_sys->napi_sort_page_thrshld_cnt = 0;
+	spin_unlock_bh(&sys->common_sys->spinlock);
+	ipa3_page_recycle_account(rx_pkt, stats_i);
+	return rx_pkt;
 }
 
 int ipa_register_notifier(void *fn_ptr)
@@ -3786,9 +3845,7 @@ static void free_rx_page(void *chan_user_data, void *xfer_user_data)
 		list_del_init(&rx_pkt->link);
 		page_ref_dec(rx_pkt->page_data.page);
 		spin_lock_bh(&rx_pkt->sys->common_sys->spinlock);
-		/* Add the element to head. */
-		list_add(&rx_pkt->link,
-			&rx_pkt->sys->page_recycle_repl->page_repl_head);
+		ipa3_page_recycle_ready(rx_pkt);
 		spin_unlock_bh(&rx_pkt->sys->common_sys->spinlock);
 	} else {
 		dma_unmap_page(ipa3_ctx->pdev, rx_pkt->page_data.dma_addr,
@@ -5440,9 +5497,7 @@ static struct sk_buff *handle_page_completion(struct gsi_chan_xfer_notify
 		if (!rx_page.is_tmp_alloc) {
 			init_page_count(rx_page.page);
 			spin_lock_bh(&rx_pkt->sys->common_sys->spinlock);
-			/* Add the element to head. */
-			list_add(&rx_pkt->link,
-				&rx_pkt->sys->page_recycle_repl->page_repl_head);
+			ipa3_page_recycle_ready(rx_pkt);
 			spin_unlock_bh(&rx_pkt->sys->common_sys->spinlock);
 		} else {
 			dma_unmap_page(ipa3_ctx->pdev, rx_page.dma_addr,
@@ -5472,9 +5527,7 @@ static struct sk_buff *handle_page_completion(struct gsi_chan_xfer_notify
 				if (!rx_page.is_tmp_alloc) {
 					init_page_count(rx_page.page);
 					spin_lock_bh(&rx_pkt->sys->common_sys->spinlock);
-					/* Add the element to head. */
-					list_add(&rx_pkt->link,
-						&rx_pkt->sys->page_recycle_repl->page_repl_head);
+					ipa3_page_recycle_ready(rx_pkt);
 					spin_unlock_bh(&rx_pkt->sys->common_sys->spinlock);
 				} else {
 					dma_unmap_page(ipa3_ctx->pdev, rx_page.dma_addr,
@@ -5496,7 +5549,8 @@ static struct sk_buff *handle_page_completion(struct gsi_chan_xfer_notify
 					rx_pkt->len, DMA_FROM_DEVICE);
 			} else {
 				spin_lock_bh(&rx_pkt->sys->common_sys->spinlock);
-				/* Add the element back to tail. */
+				/* Add the element back to in-flight tail. */
+				rx_pkt->recycle_time = ktime_get();
 				list_add_tail(&rx_pkt->link,
 					&rx_pkt->sys->page_recycle_repl->page_repl_head);
 				spin_unlock_bh(&rx_pkt->sys->common_sys->spinlock);
@@ -1189,10 +1189,21 @@ struct ipa3_repl_ctx {
 	atomic_t pending;
 };
 
+/**
+ * struct ipa3_page_repl_ctx - RX page recycle pool
+ * @page_repl_head: pages handed to the network stack, oldest first
+ * @ready_head: pages only referenced by IPA, ready for replenish
+ * @capacity: number of pages in the pool
+ * @pending: replenish pending flag
+ * @sort_scanned: in-flight entries checked by the sort tasklet since it
+ *	last found a free page
+ */
 struct ipa3_page_repl_ctx {
 	struct list_head page_repl_head;
+	struct list_head ready_head;
 	u32 capacity;
 	atomic_t pending;
+	u32 sort_scanned;
 };
 
 /**
@@ -1397,6 +1408,7 @@ struct ipa3_rx_pkt_wrapper {
 	u32 data_len;
 	struct work_struct work;
 	struct ipa3_sys_context *sys;
+	ktime_t recycle_time;
 };
 
 /**
@@ -1592,6 +1604,9 @@ struct ipa3_page_recycle_stats {
 	u64 total_replenished;
 	u64 page_recycled;
 	u64 tmp_alloc;
+	u64 ready_hit;
+	u64 reuse_time_total_us;
+	u64 reuse_time_max_us;
 };
 
 struct ipa3_cache_recycle_stats {
@@ -871,6 +871,7 @@ static int __init rmnet_init(void)
 	}
 
 	rmnet_core_genl_init();
+	rmnet_map_tx_agg_debugfs_init();
 
 	try_module_get(THIS_MODULE);
 	return rc;
@@ -882,6 +883,7 @@ static void __exit rmnet_exit(void)
 	rtnl_link_unregister(&rmnet_link_ops);
 	rmnet_ll_exit();
 	rmnet_core_genl_deinit();
+	rmnet_map_tx_agg_debugfs_exit();
 
 	module_put(THIS_MODULE);
 }
@@ -57,6 +57,8 @@ struct rmnet_endpoint {
 struct rmnet_agg_stats {
 	u64 ul_agg_reuse;
 	u64 ul_agg_alloc;
+	u64 ul_agg_chain;
+	u64 ul_agg_bypass;
 };
 
 struct rmnet_port_priv_stats {
@@ -95,8 +97,11 @@ enum {
 
 struct rmnet_aggregation_state {
 	struct rmnet_egress_agg_params params;
-	struct timespec64 agg_time;
-	struct timespec64 agg_last;
+	/* Monotonic ns: start of the open aggregate, last packet arrival */
+	u64 agg_time;
+	u64 agg_last;
+	/* EWMA of packet inter-arrival time in ns */
+	u64 agg_gap_ewma;
 	struct hrtimer hrtimer;
 	struct work_struct agg_wq;
 	/* Protect aggregation related elements */
@@ -106,6 +111,9 @@ struct rmnet_aggregation_state {
 	int agg_state;
 	u8 agg_count;
 	u8 agg_size_order;
+	/* Open aggregate chains packets on frag_list instead of copying */
+	bool agg_chain;
+	struct sk_buff *agg_tail;
 	struct list_head agg_list;
 	struct rmnet_agg_page *agg_head;
 	struct rmnet_agg_stats *stats;
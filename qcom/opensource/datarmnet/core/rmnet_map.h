@@ -301,6 +301,8 @@ void rmnet_map_tx_aggregate(struct sk_buff *skb, struct rmnet_port *port,
 			    bool low_latency);
 void rmnet_map_tx_aggregate_init(struct rmnet_port *port);
 void rmnet_map_tx_aggregate_exit(struct rmnet_port *port);
+void rmnet_map_tx_agg_debugfs_init(void);
+void rmnet_map_tx_agg_debugfs_exit(void);
 void rmnet_map_update_ul_agg_config(struct rmnet_aggregation_state *state,
 				    u16 size, u8 count, u8 features, u32 time);
 void rmnet_map_dl_hdr_notify_v2(struct rmnet_port *port,
@@ -15,6 +15,7 @@
  */
 
 #include <linux/netdevice.h>
+#include <linux/debugfs.h>
 #include <linux/ip.h>
 #include <linux/ipv6.h>
 #include <net/ip6_checksum.h>
@@ -29,6 +30,9 @@
 #define RMNET_MAP_DEAGGR_SPACING  64
 #define RMNET_MAP_DEAGGR_HEADROOM (RMNET_MAP_DEAGGR_SPACING / 2)
 #define RMNET_PAGE_COUNT 384
+#define RMNET_AGG_EWMA_SHIFT 3
+#define RMNET_AGG_FLUSH_MIN_NS 100000ULL
+#define RMNET_AGG_REPLAY_PKTS 1024
 
 struct rmnet_map_coal_metadata {
 	void *ip_header;
@@ -1275,7 +1279,7 @@ static void rmnet_map_flush_tx_packet_work(struct work_struct *work)
 			skb = state->agg_skb;
 			state->agg_skb = NULL;
 			state->agg_count = 0;
-			memset(&state->agg_time, 0, sizeof(state->agg_time));
+			state->agg_time = 0;
 		}
 		state->agg_state = 0;
 	}
@@ -1460,27 +1464,138 @@ void rmnet_map_send_agg_skb(struct rmnet_aggregation_state *state)
 	/* Reset the aggregation state */
 	state->agg_skb = NULL;
 	state->agg_count = 0;
-	memset(&state->agg_time, 0, sizeof(state->agg_time));
+	state->agg_time = 0;
 	state->agg_state = 0;
 	state->send_agg_skb(agg_skb);
 	spin_unlock_bh(&state->agg_lock);
 	hrtimer_cancel(&state->hrtimer);
 }
 
+/* Chain packets on frag_list instead of copying them when the transport
+ * takes such skbs. Only the default state goes through dev_queue_xmit(),
+ * which still linearizes for devices without NETIF_F_FRAGLIST.
+ */
+static bool rmnet_map_tx_agg_can_chain(struct rmnet_aggregation_state *state,
+				       struct sk_buff *skb)
+{
+	return state->send_agg_skb == dev_queue_xmit &&
+	       (skb->dev->features & NETIF_F_FRAGLIST) &&
+	       !skb_has_frag_list(skb);
+}
+
+static struct sk_buff *rmnet_map_build_chain_skb(void)
+{
+	struct sk_buff *skb;
+
+	skb = alloc_skb(0, GFP_ATOMIC);
+	if (skb)
+		skb->ip_summed = CHECKSUM_NONE;
+
+	return skb;
+}
+
+/* Packets keep their own socket ownership. Their length and truesize are
+ * added to the aggregate head so it accounts for the memory it carries.
+ */
+static void rmnet_map_chain_skb(struct rmnet_aggregation_state *state,
+				struct sk_buff *skb)
+{
+	struct sk_buff *head = state->agg_skb;
+
+	skb->next = NULL;
+	if (!skb_shinfo(head)->frag_list)
+		skb_shinfo(head)->frag_list = skb;
+	else
+		state->agg_tail->next = skb;
+
+	state->agg_tail = skb;
+	head->len += skb->len;
+	head->data_len += skb->len;
+	head->truesize += skb->truesize;
+	state->stats->ul_agg_chain++;
+}
+
+static void rmnet_map_tx_agg_add(struct rmnet_aggregation_state *state,
+				 struct sk_buff *skb)
+{
+	if (state->agg_chain) {
+		rmnet_map_chain_skb(state, skb);
+		return;
+	}
+
+	rmnet_map_linearize_copy(state->agg_skb, skb);
+	dev_consume_skb_any(skb);
+}
+
+static bool rmnet_map_tx_agg_full(struct rmnet_aggregation_state *state,
+				  struct sk_buff *skb)
+{
+	if (state->agg_chain)
+		return !rmnet_map_tx_agg_can_chain(state, skb) ||
+		       state->agg_skb->len + skb->len > state->params.agg_size;
+
+	return skb->len > skb_tailroom(state->agg_skb);
+}
+
+/* Time an open aggregate may wait for more packets. Scale it with the
+ * observed inter-arrival time so a slowing flow is flushed early instead
+ * of always sitting out rmnet_agg_time_limit.
+ */
+static u64 rmnet_map_tx_agg_flush_ns(struct rmnet_aggregation_state *state)
+{
+	u64 limit = state->agg_gap_ewma << 2;
+
+	return clamp_t(u64, limit, RMNET_AGG_FLUSH_MIN_NS,
+		       rmnet_agg_time_limit);
+}
+
+/* The flush timer must not outlast the adaptive deadline either, or a
+ * slowing flow still waits the full configured agg_time for its flush.
+ */
+static u64 rmnet_map_tx_agg_timer_ns(struct rmnet_aggregation_state *state)
+{
+	return min_t(u64, state->params.agg_time,
+		     rmnet_map_tx_agg_flush_ns(state));
+}
+
+/* Account a packet arriving at @now. Returns the gap since the last one */
+static u64 rmnet_map_tx_agg_gap(struct rmnet_aggregation_state *state,
+				u64 now)
+{
+	u64 gap = min_t(u64, now - state->agg_last, rmnet_agg_bypass_time);
+
+	state->agg_last = now;
+	state->agg_gap_ewma = state->agg_gap_ewma -
+			      (state->agg_gap_ewma >> RMNET_AGG_EWMA_SHIFT) +
+			      (gap >> RMNET_AGG_EWMA_SHIFT);
+	return gap;
+}
+
+/* Check to see if we should agg first. If the traffic is very sparse, or
+ * arrives on average slower than an aggregate may stay open, aggregating
+ * only adds latency.
+ */
+static bool rmnet_map_tx_agg_bypass(struct rmnet_aggregation_state *state,
+				    u64 gap, int size)
+{
+	return gap >= rmnet_agg_bypass_time ||
+	       state->agg_gap_ewma > rmnet_agg_time_limit || size <= 0;
+}
+
 void rmnet_map_tx_aggregate(struct sk_buff *skb, struct rmnet_port *port,
 			    bool low_latency)
 {
 	struct rmnet_aggregation_state *state;
-	struct timespec64 diff, last;
+	u64 now, gap;
 	int size;
 
 	state = &port->agg_state[(low_latency) ? RMNET_LL_AGG_STATE :
 						 RMNET_DEFAULT_AGG_STATE];
 
-new_packet:
+	/* Sample under the lock so concurrent senders see monotonic stamps */
 	spin_lock_bh(&state->agg_lock);
-	memcpy(&last, &state->agg_last, sizeof(last));
-	ktime_get_real_ts64(&state->agg_last);
+	now = ktime_get_ns();
+	gap = rmnet_map_tx_agg_gap(state, now);
 
 	if ((port->data_format & RMNET_EGRESS_FORMAT_PRIORITY) &&
 	    (RMNET_LLM(skb->priority) || RMNET_APS_LLB(skb->priority))) {
@@ -1492,59 +1607,58 @@ new_packet:
 		return;
 	}
 
+new_packet:
 	if (!state->agg_skb) {
-		/* Check to see if we should agg first. If the traffic is very
-		 * sparse, don't aggregate. We will need to tune this later
-		 */
-		diff = timespec64_sub(state->agg_last, last);
 		size = state->params.agg_size - skb->len;
 
-		if (diff.tv_sec > 0 || diff.tv_nsec > rmnet_agg_bypass_time ||
-		    size <= 0) {
+		if (rmnet_map_tx_agg_bypass(state, gap, size)) {
+			state->stats->ul_agg_bypass++;
 			skb->protocol = htons(ETH_P_MAP);
 			state->send_agg_skb(skb);
 			spin_unlock_bh(&state->agg_lock);
 			return;
 		}
 
-		state->agg_skb = rmnet_map_build_skb(state);
+		state->agg_chain = rmnet_map_tx_agg_can_chain(state, skb);
+		if (state->agg_chain)
+			state->agg_skb = rmnet_map_build_chain_skb();
+		else
+			state->agg_skb = rmnet_map_build_skb(state);
 		if (!state->agg_skb) {
 			state->agg_skb = NULL;
 			state->agg_count = 0;
-			memset(&state->agg_time, 0, sizeof(state->agg_time));
+			state->agg_time = 0;
 			skb->protocol = htons(ETH_P_MAP);
 			state->send_agg_skb(skb);
 			spin_unlock_bh(&state->agg_lock);
 			return;
 		}
 
-		rmnet_map_linearize_copy(state->agg_skb, skb);
 		state->agg_skb->dev = skb->dev;
 		state->agg_skb->protocol = htons(ETH_P_MAP);
+		rmnet_map_tx_agg_add(state, skb);
 		state->agg_count = 1;
-		ktime_get_real_ts64(&state->agg_time);
-		dev_consume_skb_any(skb);
+		state->agg_time = now;
 		goto schedule;
 	}
-	diff = timespec64_sub(state->agg_last, state->agg_time);
-	size = skb_tailroom(state->agg_skb);
 
-	if (skb->len > size ||
+	if (rmnet_map_tx_agg_full(state, skb) ||
 	    state->agg_count >= state->params.agg_count ||
-	    diff.tv_sec > 0 || diff.tv_nsec > rmnet_agg_time_limit) {
+	    now - state->agg_time > rmnet_map_tx_agg_flush_ns(state)) {
 		rmnet_map_send_agg_skb(state);
+		spin_lock_bh(&state->agg_lock);
+		now = ktime_get_ns();
 		goto new_packet;
 	}
 
-	rmnet_map_linearize_copy(state->agg_skb, skb);
+	rmnet_map_tx_agg_add(state, skb);
 	state->agg_count++;
-	dev_consume_skb_any(skb);
 
 schedule:
 	if (state->agg_state != -EINPROGRESS) {
 		state->agg_state = -EINPROGRESS;
 		hrtimer_start(&state->hrtimer,
-			      ns_to_ktime(state->params.agg_time),
+			      ns_to_ktime(rmnet_map_tx_agg_timer_ns(state)),
 			      HRTIMER_MODE_REL);
 	}
 	spin_unlock_bh(&state->agg_lock);
@@ -1630,8 +1744,7 @@ void rmnet_map_tx_aggregate_exit(struct rmnet_port *port)
 				kfree_skb(state->agg_skb);
 				state->agg_skb = NULL;
 				state->agg_count = 0;
-				memset(&state->agg_time, 0,
-				       sizeof(state->agg_time));
+				state->agg_time = 0;
 			}
 
 			state->agg_state = 0;
@@ -1669,7 +1782,7 @@ void rmnet_map_tx_qmap_cmd(struct sk_buff *qmap_skb, u8 ch, bool flush)
 		agg_skb = state->agg_skb;
 		state->agg_skb = NULL;
 		state->agg_count = 0;
-		memset(&state->agg_time, 0, sizeof(state->agg_time));
+		state->agg_time = 0;
 		state->agg_state = 0;
 		state->send_agg_skb(agg_skb);
 		spin_unlock_bh(&state->agg_lock);
@@ -1718,3 +1831,153 @@ int rmnet_map_add_tso_header(struct sk_buff *skb, struct rmnet_port *port,
 
 	return 0;
 }
+
+/* UL aggregation replay
+ *
+ * Replays a synthetic arrival trace through the same gap, bypass and flush
+ * helpers rmnet_map_tx_aggregate() uses, with the flush timer armed the way
+ * the data path arms it. A dense burst must aggregate, a slowing flow must
+ * never hold a packet past rmnet_agg_time_limit, and sparse traffic must
+ * end up bypassing aggregation.
+ */
+struct rmnet_agg_replay {
+	u64 max_wait;
+	u32 bypassed;
+	u32 aggregated;
+	u32 flushes;
+};
+
+static u64 rmnet_agg_replay_gap(int i)
+{
+	/* 64 packets 50us apart, then slowing to 2ms, then 20ms apart */
+	if (i < 64)
+		return 50000;
+	if (i < 512)
+		return 100000 + (i - 64) * 4242ULL;
+	return 20000000;
+}
+
+static void rmnet_agg_replay_flush(struct rmnet_aggregation_state *state,
+				   struct rmnet_agg_replay *res, u64 now,
+				   u64 first)
+{
+	res->max_wait = max_t(u64, res->max_wait, now - first);
+	res->flushes++;
+	state->agg_count = 0;
+	state->agg_time = 0;
+}
+
+static int rmnet_agg_replay_run(void)
+{
+	struct rmnet_aggregation_state *state;
+	struct rmnet_agg_replay res = {};
+	u64 now = 0, deadline = 0, first = 0, gap, timer;
+	u32 dense_bypassed = 0, sparse_bypassed = 0;
+	int i, rc = 0;
+
+	state = kzalloc(sizeof(*state), GFP_KERNEL);
+	if (!state)
+		return -ENOMEM;
+
+	/* Defaults from rmnet_map_tx_aggregate_init() */
+	state->params.agg_count = 20;
+	state->params.agg_time = 3000000;
+	state->params.agg_size = PAGE_SIZE - 1;
+
+	for (i = 0; i < RMNET_AGG_REPLAY_PKTS; i++) {
+		now += rmnet_agg_replay_gap(i);
+
+		/* Flush timer fired before this packet arrived */
+		if (state->agg_count && now >= deadline)
+			rmnet_agg_replay_flush(state, &res, deadline, first);
+
+		gap = rmnet_map_tx_agg_gap(state, now);
+
+		if (state->agg_count &&
+		    (state->agg_count >= state->params.agg_count ||
+		     now - state->agg_time > rmnet_map_tx_agg_flush_ns(state)))
+			rmnet_agg_replay_flush(state, &res, now, first);
+
+		if (state->agg_count) {
+			state->agg_count++;
+			res.aggregated++;
+			continue;
+		}
+
+		if (rmnet_map_tx_agg_bypass(state, gap, 1)) {
+			res.bypassed++;
+			if (i < 64)
+				dense_bypassed++;
+			else if (i >= RMNET_AGG_REPLAY_PKTS - 64)
+				sparse_bypassed++;
+			continue;
+		}
+
+		timer = rmnet_map_tx_agg_timer_ns(state);
+		if (timer > state->params.agg_time ||
+		    timer > rmnet_agg_time_limit) {
+			pr_err("rmnet: agg replay: pkt %d timer %llu ns\n", i,
+			       timer);
+			rc = -EINVAL;
+		}
+
+		state->agg_count = 1;
+		state->agg_time = now;
+		first = now;
+		deadline = now + timer;
+		res.aggregated++;
+	}
+
+	if (state->agg_count)
+		rmnet_agg_replay_flush(state, &res, deadline, first);
+
+	pr_info("rmnet: agg replay: %u aggregated %u bypassed %u flushes, max wait %llu ns\n",
+		res.aggregated, res.bypassed, res.flushes, res.max_wait);
+
+	if (dense_bypassed) {
+		pr_err("rmnet: agg replay: %u dense packets bypassed\n",
+		       dense_bypassed);
+		rc = -EINVAL;
+	}
+
+	if (sparse_bypassed != 64) {
+		pr_err("rmnet: agg replay: %u of 64 sparse packets bypassed\n",
+		       sparse_bypassed);
+		rc = -EINVAL;
+	}
+
+	if (res.max_wait > rmnet_agg_time_limit) {
+		pr_err("rmnet: agg replay: packet held %llu ns\n",
+		       res.max_wait);
+		rc = -EINVAL;
+	}
+
+	kfree(state);
+	return rc;
+}
+
+static int rmnet_agg_replay_set(void *data, u64 val)
+{
+	return rmnet_agg_replay_run();
+}
+
+DEFINE_DEBUGFS_ATTRIBUTE(rmnet_agg_replay_fops, NULL, rmnet_agg_replay_set,
+			 "%llu\n");
+
+static struct dentry *rmnet_map_dbgfs_dir;
+
+void rmnet_map_tx_agg_debugfs_init(void)
+{
+	rmnet_map_dbgfs_dir = debugfs_create_dir("rmnet_core", NULL);
+	if (IS_ERR_OR_NULL(rmnet_map_dbgfs_dir))
+		return;
+
+	debugfs_create_file("agg_replay", 0200, rmnet_map_dbgfs_dir, NULL,
+			    &rmnet_agg_replay_fops);
+}
+
+void rmnet_map_tx_agg_debugfs_exit(void)
+{
+	debugfs_remove_recursive(rmnet_map_dbgfs_dir);
+	rmnet_map_dbgfs_dir = NULL;
+}
@@ -10,6 +10,8 @@
 #include <linux/errno.h>
 #include <linux/mutex.h>
 #include <linux/sort.h>
+#include <linux/pm_runtime.h>
+#include <linux/random.h>
 #include <linux/clk.h>
 #include <linux/bitmap.h>
 #include <linux/sde_rsc.h>
@@ -25,6 +27,8 @@
 
 #define SDE_PERF_MODE_STRING_SIZE	128
 #define SDE_PERF_THRESHOLD_HIGH_MIN     12800000
+#define SDE_PERF_DECAY_REPLAY_MAX_ITER	10000
+#define SDE_PERF_DECAY_REPLAY_COMMITS	64
 
 #define GET_H32(val) (val >> 32)
 #define GET_L32(val) (val & 0xffffffff)
@@ -890,6 +894,7 @@ void sde_core_perf_crtc_release_bw(struct drm_crtc *crtc)
 
 	/* Release the bandwidth */
 	if (kms->perf.enable_bw_release) {
+		sde_core_perf_crtc_decay_cancel(crtc);
 		trace_sde_cmd_release_bw(crtc->base.id);
 		SDE_DEBUG("Release BW crtc=%d\n", crtc->base.id);
 		for (i = 0; i < SDE_POWER_HANDLE_DBUS_ID_MAX; i++) {
@@ -935,6 +940,7 @@ static u64 _sde_core_perf_get_core_clk_rate(struct sde_kms *kms)
 	struct drm_crtc *tmp_crtc;
 	struct sde_crtc *sde_crtc;
 	u64 tmp_rate;
+	bool powered_on = false;
 
 	drm_for_each_crtc(tmp_crtc, kms->dev) {
 		if (_sde_core_perf_crtc_is_power_on(tmp_crtc)) {
@@ -944,11 +950,14 @@ static u64 _sde_core_perf_get_core_clk_rate(struct sde_kms *kms)
 			tmp_rate = sde_crtc->cur_perf.core_clk_rate;
 
 			clk_rate = max(tmp_rate, clk_rate);
-
-			clk_rate = clk_round_rate(kms->perf.core_clk, clk_rate);
+			powered_on = true;
 		}
 	}
 
+	/* rounding is monotonic, so rounding the max once is sufficient */
+	if (powered_on)
+		clk_rate = clk_round_rate(kms->perf.core_clk, clk_rate);
+
 	if (kms->perf.perf_tune.mode == SDE_PERF_MODE_FIXED)
 		clk_rate = max(kms->perf.fix_core_clk_rate, clk_rate);
 
@@ -957,14 +966,153 @@ static u64 _sde_core_perf_get_core_clk_rate(struct sde_kms *kms)
 	return clk_rate;
 }
 
+static bool _sde_core_perf_params_lower(struct sde_core_perf_params *old,
+		struct sde_core_perf_params *new)
+{
+	int i;
+
+	for (i = 0; i < SDE_POWER_HANDLE_DBUS_ID_MAX; i++) {
+		if (new->bw_ctl[i] < old->bw_ctl[i] ||
+				new->max_per_pipe_ib[i] < old->max_per_pipe_ib[i])
+			return true;
+	}
+
+	return new->core_clk_rate && new->core_clk_rate < old->core_clk_rate;
+}
+
+static void _sde_core_perf_params_max(struct sde_core_perf_params *dst,
+		struct sde_core_perf_params *src)
+{
+	int i;
+
+	for (i = 0; i < SDE_POWER_HANDLE_DBUS_ID_MAX; i++) {
+		dst->bw_ctl[i] = max(dst->bw_ctl[i], src->bw_ctl[i]);
+		dst->max_per_pipe_ib[i] = max(dst->max_per_pipe_ib[i],
+				src->max_per_pipe_ib[i]);
+	}
+	dst->core_clk_rate = max(dst->core_clk_rate, src->core_clk_rate);
+}
+
+static u32 _sde_core_perf_decay_delay_ms(u32 decay_frames, u32 decay_ms,
+		u32 fps)
+{
+	return decay_ms ? decay_ms :
+			decay_frames * DIV_ROUND_UP(1000, fps ? fps : 60);
+}
+
+/**
+ * _sde_core_perf_decay_step - advance the down-vote decay window
+ * @decay: Pointer to the crtc decay state
+ * @cur: Pointer to the params currently voted
+ * @params_changed: true if called before kickoff with new parameters
+ * @new: in: requested perf params, out: params to vote with
+ * @decay_frames: commits a lower vote must be requested for, 0 to ignore
+ * @decay_ms: time a lower vote must be requested for, 0 to ignore
+ * @now: current time in ns
+ * @stats: Pointer to the churn counters to update
+ * @arm: set to true when a new window opens and the expiry work is needed
+ * return: true if the down-vote must be deferred
+ */
+static bool _sde_core_perf_decay_step(struct sde_core_perf_decay *decay,
+		struct sde_core_perf_params *cur, int params_changed,
+		struct sde_core_perf_params **new, u32 decay_frames,
+		u32 decay_ms, u64 now, struct sde_core_perf_stats *stats,
+		bool *arm)
+{
+	bool expired;
+
+	*arm = false;
+
+	if (!decay_frames && !decay_ms) {
+		decay->pending = false;
+		return false;
+	}
+
+	if (params_changed) {
+		if (decay->pending)
+			_sde_core_perf_params_max(&decay->max, *new);
+		return false;
+	}
+
+	if (!_sde_core_perf_params_lower(cur, *new)) {
+		decay->pending = false;
+		return false;
+	}
+
+	if (!decay->pending) {
+		decay->pending = true;
+		decay->frames = 0;
+		decay->start_ns = now;
+		memcpy(&decay->max, *new, sizeof(decay->max));
+		*arm = true;
+	} else {
+		_sde_core_perf_params_max(&decay->max, *new);
+	}
+	decay->frames++;
+
+	expired = (decay_frames && decay->frames >= decay_frames) ||
+			(decay_ms && (now - decay->start_ns) >=
+			 (u64)decay_ms * NSEC_PER_MSEC);
+	if (!expired) {
+		stats->down_deferred++;
+		return true;
+	}
+
+	decay->pending = false;
+	stats->down_expired++;
+	*new = &decay->max;
+
+	return false;
+}
+
+/**
+ * _sde_core_perf_crtc_decay - hold back down-votes until they persist
+ * @kms: Pointer to sde kms
+ * @crtc: Pointer to crtc
+ * @params_changed: true if called before kickoff with new parameters
+ * @new: in: requested perf params, out: params to vote with
+ *
+ * Lowering the vote at the end of every commit and raising it again on the
+ * next one churns clock and ICC votes on content that alternates between
+ * heavy and simple frames. A lower vote is applied only after it has been
+ * requested for decay_frames commits or for decay_ms, and then at the
+ * highest level requested by any commit within that window so frames still
+ * in flight stay covered.
+ * return: true if the down-vote must be deferred
+ */
+static bool _sde_core_perf_crtc_decay(struct sde_kms *kms,
+		struct drm_crtc *crtc, int params_changed,
+		struct sde_core_perf_params **new)
+{
+	struct sde_crtc *sde_crtc = to_sde_crtc(crtc);
+	struct msm_drm_private *priv = kms->dev->dev_private;
+	u32 delay_ms;
+	bool deferred, arm;
+
+	deferred = _sde_core_perf_decay_step(&sde_crtc->perf_decay,
+			&sde_crtc->cur_perf, params_changed, new,
+			kms->perf.decay_frames, kms->perf.decay_ms,
+			ktime_get_ns(), &kms->perf.stats, &arm);
+
+	/* apply the down-vote even if no further commit arrives */
+	if (arm) {
+		delay_ms = _sde_core_perf_decay_delay_ms(kms->perf.decay_frames,
+				kms->perf.decay_ms, sde_crtc_get_fps_mode(crtc));
+		kthread_mod_delayed_work(&priv->disp_thread[crtc->index].worker,
+				&sde_crtc->perf_decay_work,
+				msecs_to_jiffies(delay_ms));
+	}
+
+	return deferred;
+}
+
 static void _sde_core_perf_crtc_update_check(struct drm_crtc *crtc,
-		int params_changed,
+		int params_changed, struct sde_core_perf_params *new,
 		int *update_bus, int *update_clk)
 {
 	struct sde_kms *kms = _sde_crtc_get_kms(crtc);
 	struct sde_crtc *sde_crtc = to_sde_crtc(crtc);
 	struct sde_core_perf_params *old = &sde_crtc->cur_perf;
-	struct sde_core_perf_params *new = &sde_crtc->new_perf;
 	int i;
 
 	if (!kms)
@@ -1037,10 +1185,10 @@ static void _sde_core_perf_crtc_update_check(struct drm_crtc *crtc,
 	}
 }
 
-void sde_core_perf_crtc_update(struct drm_crtc *crtc,
-		int params_changed, bool stop_req)
+static void _sde_core_perf_crtc_update(struct drm_crtc *crtc,
+		int params_changed, bool stop_req, bool decay_expired)
 {
-	struct sde_core_perf_params *new, *old;
+	struct sde_core_perf_params *new, *old, *vote;
 	int update_bus = 0, update_clk = 0;
 	u64 clk_rate = 0;
 	struct sde_crtc *sde_crtc;
@@ -1048,6 +1196,7 @@ void sde_core_perf_crtc_update(struct drm_crtc *crtc,
 	int ret, i;
 	struct msm_drm_private *priv;
 	struct sde_kms *kms;
+	bool mode_changed;
 
 	if (!crtc) {
 		SDE_ERROR("invalid crtc\n");
@@ -1068,6 +1217,17 @@ void sde_core_perf_crtc_update(struct drm_crtc *crtc,
 
 	mutex_lock(&sde_core_perf_lock);
 
+	if (decay_expired) {
+		/* a commit may have applied or cancelled it in the meantime */
+		if (!sde_crtc->perf_decay.pending ||
+				!_sde_core_perf_crtc_is_power_on(crtc)) {
+			mutex_unlock(&sde_core_perf_lock);
+			return;
+		}
+		sde_crtc->perf_decay.pending = false;
+		kms->perf.stats.down_expired++;
+	}
+
 	/*
 	 * cache the performance numbers in the crtc prior to the
 	 * crtc kickoff, so the same numbers are used during the
@@ -1081,7 +1241,8 @@ void sde_core_perf_crtc_update(struct drm_crtc *crtc,
 	new = &sde_crtc->new_perf;
 
 	/* avoid the voting in fence error case when there is decrease in BW vote */
-	if (!params_changed && !stop_req && sde_crtc->handle_fence_error_bw_update) {
+	if (!params_changed && !stop_req && !decay_expired &&
+			sde_crtc->handle_fence_error_bw_update) {
 		new = &sde_crtc->cur_perf;
 		SDE_EVT32(kms->dev, params_changed, stop_req,
 			sde_crtc->handle_fence_error_bw_update);
@@ -1089,13 +1250,21 @@ void sde_core_perf_crtc_update(struct drm_crtc *crtc,
 		sde_crtc->handle_fence_error_bw_update = false;
 	}
 
+	mode_changed = kms->perf.perf_tune.mode_changed;
 	if (_sde_core_perf_crtc_is_power_on(crtc) && !stop_req) {
-		_sde_core_perf_crtc_update_check(crtc, params_changed,
-				&update_bus, &update_clk);
+		vote = decay_expired ? &sde_crtc->perf_decay.max : new;
+		if (!decay_expired && _sde_core_perf_crtc_decay(kms, crtc,
+				params_changed, &vote))
+			SDE_EVT32(DRMID(crtc), sde_crtc->perf_decay.frames,
+					SDE_EVTLOG_FUNC_CASE1);
+		else
+			_sde_core_perf_crtc_update_check(crtc, params_changed,
+					vote, &update_bus, &update_clk);
 	} else {
 		SDE_DEBUG("crtc=%d disable\n", crtc->base.id);
 		memset(old, 0, sizeof(*old));
 		memset(new, 0, sizeof(*new));
+		sde_crtc->perf_decay.pending = false;
 		update_bus = ~0;
 		update_clk = 1;
 	}
@@ -1110,8 +1279,10 @@ void sde_core_perf_crtc_update(struct drm_crtc *crtc,
 		update_bus, update_clk, params_changed);
 
 	for (i = 0; i < SDE_POWER_HANDLE_DBUS_ID_MAX; i++) {
-		if (update_bus & BIT(i))
+		if (update_bus & BIT(i)) {
 			_sde_core_perf_crtc_update_bus(kms, crtc, i);
+			kms->perf.stats.bus_updates++;
+		}
 	}
 
 	if (kms->perf.bw_vote_mode == DISP_RSC_MODE &&
@@ -1127,6 +1298,12 @@ void sde_core_perf_crtc_update(struct drm_crtc *crtc,
 	 */
 	if (update_clk) {
 		clk_rate = _sde_core_perf_get_core_clk_rate(kms);
+		if (clk_rate == kms->perf.core_clk_rate && !stop_req &&
+				!mode_changed) {
+			kms->perf.stats.clk_skipped++;
+			mutex_unlock(&sde_core_perf_lock);
+			return;
+		}
 
 		SDE_EVT32(kms->dev, stop_req, clk_rate, params_changed,
 			old->core_clk_rate, new->core_clk_rate);
@@ -1140,12 +1317,61 @@ void sde_core_perf_crtc_update(struct drm_crtc *crtc,
 		}
 
 		kms->perf.core_clk_rate = clk_rate;
+		kms->perf.stats.clk_updates++;
 		SDE_DEBUG("update clk rate = %lld HZ\n", clk_rate);
 	}
 	mutex_unlock(&sde_core_perf_lock);
 
 }
 
+void sde_core_perf_crtc_update(struct drm_crtc *crtc,
+		int params_changed, bool stop_req)
+{
+	_sde_core_perf_crtc_update(crtc, params_changed, stop_req, false);
+}
+
+void sde_core_perf_crtc_decay_work(struct kthread_work *work)
+{
+	struct sde_crtc *sde_crtc = container_of(work, struct sde_crtc,
+			perf_decay_work.work);
+	struct drm_crtc *crtc = &sde_crtc->base;
+
+	/*
+	 * Only vote while the resources are already held by a client; once
+	 * they are released the bus and clock votes are dropped anyway and the
+	 * next commit starts a fresh window.
+	 */
+	if (pm_runtime_get_if_in_use(crtc->dev->dev) <= 0) {
+		SDE_EVT32(DRMID(crtc), sde_crtc->perf_decay.frames,
+				SDE_EVTLOG_FUNC_CASE1);
+		mutex_lock(&sde_core_perf_lock);
+		sde_crtc->perf_decay.pending = false;
+		mutex_unlock(&sde_core_perf_lock);
+		return;
+	}
+
+	_sde_core_perf_crtc_update(crtc, 0, false, true);
+
+	pm_runtime_put_sync(crtc->dev->dev);
+}
+
+void sde_core_perf_crtc_decay_cancel(struct drm_crtc *crtc)
+{
+	struct sde_crtc *sde_crtc;
+
+	if (!crtc) {
+		SDE_ERROR("invalid crtc\n");
+		return;
+	}
+
+	sde_crtc = to_sde_crtc(crtc);
+	kthread_cancel_delayed_work_sync(&sde_crtc->perf_decay_work);
+
+	mutex_lock(&sde_core_perf_lock);
+	sde_crtc->perf_decay.pending = false;
+	mutex_unlock(&sde_core_perf_lock);
+}
+
 #if IS_ENABLED(CONFIG_DEBUG_FS)
 
 static ssize_t _sde_core_perf_threshold_high_write(struct file *file,
@@ -1370,6 +1596,232 @@ static ssize_t _sde_core_perf_mmrm_read(struct file *file,
 	return len;
 }
 
+static u32 _sde_core_perf_replay_rand(u32 *state)
+{
+	/* xorshift32, the state must never be 0 */
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+
+	return *state;
+}
+
+static void _sde_core_perf_replay_params(struct sde_core_perf_params *params,
+		u32 level)
+{
+	int i;
+
+	memset(params, 0, sizeof(*params));
+	for (i = 0; i < SDE_POWER_HANDLE_DBUS_ID_MAX; i++) {
+		params->bw_ctl[i] = (u64)level * (i + 1) * 100000000ULL;
+		params->max_per_pipe_ib[i] = (u64)level * 200000000ULL;
+	}
+	params->core_clk_rate = (u64)level * 100000000ULL;
+}
+
+/* true if every vote in @a is at least as high as the one in @b */
+static bool _sde_core_perf_replay_covers(struct sde_core_perf_params *a,
+		struct sde_core_perf_params *b)
+{
+	int i;
+
+	for (i = 0; i < SDE_POWER_HANDLE_DBUS_ID_MAX; i++) {
+		if (a->bw_ctl[i] < b->bw_ctl[i] ||
+				a->max_per_pipe_ib[i] < b->max_per_pipe_ib[i])
+			return false;
+	}
+
+	return a->core_clk_rate >= b->core_clk_rate;
+}
+
+/* model of _sde_core_perf_crtc_update_check() without rsc and perf tune */
+static u32 _sde_core_perf_replay_vote(struct sde_core_perf_params *cur,
+		struct sde_core_perf_params *vote, int params_changed)
+{
+	u32 updates = 0;
+	int i;
+
+	for (i = 0; i < SDE_POWER_HANDLE_DBUS_ID_MAX; i++) {
+		if ((params_changed &&
+				(vote->bw_ctl[i] > cur->bw_ctl[i] ||
+				 vote->max_per_pipe_ib[i] >
+				 cur->max_per_pipe_ib[i])) ||
+				(!params_changed &&
+				(vote->bw_ctl[i] < cur->bw_ctl[i] ||
+				 vote->max_per_pipe_ib[i] <
+				 cur->max_per_pipe_ib[i]))) {
+			cur->bw_ctl[i] = vote->bw_ctl[i];
+			cur->max_per_pipe_ib[i] = vote->max_per_pipe_ib[i];
+			updates++;
+		}
+	}
+
+	if ((params_changed && vote->core_clk_rate > cur->core_clk_rate) ||
+			(!params_changed && vote->core_clk_rate &&
+			 vote->core_clk_rate < cur->core_clk_rate)) {
+		cur->core_clk_rate = vote->core_clk_rate;
+		updates++;
+	}
+
+	return updates;
+}
+
+/**
+ * _sde_core_perf_decay_replay - replay random commit sequences through the
+ *	decay window and check the resulting votes
+ * @decay_frames: decay window in commits
+ * @decay_ms: decay window in ms
+ * @seed: non-zero prng seed
+ * @votes: incremented by the number of votes sent
+ * @legacy_votes: incremented by the number of votes sent without decay
+ * return: 0 if every vote held, -EINVAL otherwise
+ *
+ * Each commit raises the vote before kickoff and asks for a down-vote once
+ * it completes, as _sde_core_perf_crtc_update() does. Time advances by a
+ * random frame period and the expiry work is run when its delay elapses
+ * between two commits. The vote must cover the running commit at all times,
+ * an expired window must apply the highest vote requested within it, and a
+ * lower vote may be held for at most decay_frames commits or decay_ms.
+ */
+static int _sde_core_perf_decay_replay(u32 decay_frames, u32 decay_ms,
+		u32 seed, u64 *votes, u64 *legacy_votes)
+{
+	struct sde_core_perf_params cur, legacy, req, win_max, *vote;
+	struct sde_core_perf_decay decay;
+	struct sde_core_perf_stats stats;
+	u64 now = NSEC_PER_SEC, deadline = 0, period;
+	u32 state = seed, commit, held = 0;
+	bool deferred, arm, armed = false;
+
+	memset(&cur, 0, sizeof(cur));
+	memset(&legacy, 0, sizeof(legacy));
+	memset(&win_max, 0, sizeof(win_max));
+	memset(&decay, 0, sizeof(decay));
+	memset(&stats, 0, sizeof(stats));
+
+	for (commit = 0; commit < SDE_PERF_DECAY_REPLAY_COMMITS; commit++) {
+		period = (8 + _sde_core_perf_replay_rand(&state) % 26) *
+				NSEC_PER_MSEC;
+
+		/* the expiry work runs if no commit arrived in time */
+		if (armed && now + period >= deadline) {
+			armed = false;
+			if (decay.pending) {
+				decay.pending = false;
+				held = 0;
+				if (!_sde_core_perf_replay_covers(&decay.max,
+						&win_max))
+					return -EINVAL;
+				*votes += _sde_core_perf_replay_vote(&cur,
+						&decay.max, 0);
+			}
+		}
+		now += period;
+
+		_sde_core_perf_replay_params(&req,
+				1 + _sde_core_perf_replay_rand(&state) % 4);
+
+		/* before kickoff */
+		vote = &req;
+		deferred = _sde_core_perf_decay_step(&decay, &cur, 1, &vote,
+				decay_frames, decay_ms, now, &stats, &arm);
+		if (deferred || arm || vote != &req)
+			return -EINVAL;
+		if (decay.pending)
+			_sde_core_perf_params_max(&win_max, &req);
+		*votes += _sde_core_perf_replay_vote(&cur, vote, 1);
+		*legacy_votes += _sde_core_perf_replay_vote(&legacy, &req, 1);
+		if (!_sde_core_perf_replay_covers(&cur, &req))
+			return -EINVAL;
+
+		/* on completion */
+		vote = &req;
+		deferred = _sde_core_perf_decay_step(&decay, &cur, 0, &vote,
+				decay_frames, decay_ms, now, &stats, &arm);
+		if (arm) {
+			memcpy(&win_max, &req, sizeof(win_max));
+			deadline = now + (u64)_sde_core_perf_decay_delay_ms(
+					decay_frames, decay_ms, 0) *
+					NSEC_PER_MSEC;
+			armed = true;
+		} else if (decay.pending || vote == &decay.max) {
+			_sde_core_perf_params_max(&win_max, &req);
+		}
+		*legacy_votes += _sde_core_perf_replay_vote(&legacy, &req, 0);
+
+		if (deferred) {
+			if (!decay_frames && !decay_ms)
+				return -EINVAL;
+			held++;
+			if ((decay_frames && held >= decay_frames) ||
+					(decay_ms && now - decay.start_ns >=
+					 (u64)decay_ms * NSEC_PER_MSEC))
+				return -EINVAL;
+			continue;
+		}
+
+		held = 0;
+		if (vote == &decay.max &&
+				!_sde_core_perf_replay_covers(vote, &win_max))
+			return -EINVAL;
+		*votes += _sde_core_perf_replay_vote(&cur, vote, 0);
+		if (!_sde_core_perf_replay_covers(&cur, &req))
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+static ssize_t _sde_core_perf_decay_replay_write(struct file *file,
+		    const char __user *user_buf, size_t count, loff_t *ppos)
+{
+	struct sde_core_perf *perf = file->private_data;
+	u64 votes = 0, legacy_votes = 0;
+	u32 iterations = 0, iter, seed;
+	char buf[10];
+	int rc;
+
+	if (!perf)
+		return -ENODEV;
+
+	if (count >= sizeof(buf))
+		return -EFAULT;
+
+	if (copy_from_user(buf, user_buf, count))
+		return -EFAULT;
+
+	buf[count] = 0;	/* end of string */
+
+	if (kstrtouint(buf, 0, &iterations))
+		return -EFAULT;
+
+	iterations = clamp_t(u32, iterations, 1,
+			SDE_PERF_DECAY_REPLAY_MAX_ITER);
+
+	for (iter = 0; iter < iterations; iter++) {
+		seed = get_random_u32() | 1;
+		/* the tunables of the iteration come from the seed as well */
+		rc = _sde_core_perf_decay_replay(seed % 5,
+				(seed >> 8) % 3 ? 0 : 20 + (seed >> 16) % 80,
+				seed, &votes, &legacy_votes);
+		if (rc) {
+			SDE_ERROR("decay replay failed seed:0x%x iter:%u\n",
+					seed, iter);
+			return rc;
+		}
+	}
+
+	SDE_INFO("decay replay passed iter:%u votes:%llu legacy_votes:%llu\n",
+			iterations, votes, legacy_votes);
+
+	return count;
+}
+
+static const struct file_operations sde_core_perf_decay_replay_fops = {
+	.open = simple_open,
+	.write = _sde_core_perf_decay_replay_write,
+};
+
 static const struct file_operations sde_core_perf_threshold_high_fops = {
 	.open = simple_open,
 	.read = _sde_core_perf_threshold_high_read,
@@ -1445,6 +1897,22 @@ int sde_core_perf_debugfs_init(struct sde_core_perf *perf,
 			&perf->fix_core_ab_vote);
 	debugfs_create_u32("sys_cache_enable", 0600, perf->debugfs_root,
 			&perf->sys_cache_enabled);
+	debugfs_create_u32("decay_frames", 0600, perf->debugfs_root,
+			&perf->decay_frames);
+	debugfs_create_u32("decay_ms", 0600, perf->debugfs_root,
+			&perf->decay_ms);
+	debugfs_create_file("decay_replay", 0200, perf->debugfs_root,
+			perf, &sde_core_perf_decay_replay_fops);
+	debugfs_create_u64("stats_bus_updates", 0400, perf->debugfs_root,
+			&perf->stats.bus_updates);
+	debugfs_create_u64("stats_clk_updates", 0400, perf->debugfs_root,
+			&perf->stats.clk_updates);
+	debugfs_create_u64("stats_clk_skipped", 0400, perf->debugfs_root,
+			&perf->stats.clk_skipped);
+	debugfs_create_u64("stats_down_deferred", 0400, perf->debugfs_root,
+			&perf->stats.down_deferred);
+	debugfs_create_u64("stats_down_expired", 0400, perf->debugfs_root,
+			&perf->stats.down_expired);
 
 	debugfs_create_u32("uidle_perf_cnt", 0600, perf->debugfs_root,
 			&sde_kms->catalog->uidle_cfg.debugfs_perf);
@@ -1525,6 +1993,7 @@ int sde_core_perf_init(struct sde_core_perf *perf,
 		perf->max_core_clk_rate = SDE_PERF_DEFAULT_MAX_CORE_CLK_RATE;
 	}
 	perf->sys_cache_enabled = 0xffffffff;
+	perf->decay_frames = SDE_PERF_DEFAULT_DECAY_FRAMES;
 
 	return 0;
 
@@ -9,6 +9,7 @@
 
 #include <linux/types.h>
 #include <linux/dcache.h>
+#include <linux/kthread.h>
 #include <linux/mutex.h>
 #include <drm/drm_crtc.h>
 #include <linux/soc/qcom/llcc-qcom.h>
@@ -17,6 +18,7 @@
 #include "sde_power_handle.h"
 
 #define SDE_PERF_DEFAULT_MAX_CORE_CLK_RATE	320000000
+#define SDE_PERF_DEFAULT_DECAY_FRAMES		3
 
 /**
  *  uidle performance counters mode
@@ -44,6 +46,36 @@ struct sde_core_perf_params {
 	bool llcc_active[SDE_SYS_CACHE_MAX];
 };
 
+/**
+ * struct sde_core_perf_decay - deferred down-vote state of a crtc
+ * @pending: a lower clock/bandwidth vote is being held back
+ * @frames: number of completed commits that requested the lower vote
+ * @start_ns: time the lower vote was first requested
+ * @max: highest vote requested by any commit while pending
+ */
+struct sde_core_perf_decay {
+	bool pending;
+	u32 frames;
+	u64 start_ns;
+	struct sde_core_perf_params max;
+};
+
+/**
+ * struct sde_core_perf_stats - clock and bandwidth vote churn counters
+ * @bus_updates: bus votes sent on commit
+ * @clk_updates: core clock rate changes
+ * @clk_skipped: core clock updates skipped as the rate was unchanged
+ * @down_deferred: down-votes held back by the decay window
+ * @down_expired: held down-votes applied once the decay window expired
+ */
+struct sde_core_perf_stats {
+	u64 bus_updates;
+	u64 clk_updates;
+	u64 clk_skipped;
+	u64 down_deferred;
+	u64 down_expired;
+};
+
 /**
  * struct sde_core_perf_tune - definition of performance tuning control
  * @mode: performance mode
@@ -80,6 +112,9 @@ struct sde_core_perf_tune {
  * @uidle_enabled: indicates if uidle is already enabled
  * @core_clk_reserve_rate: reserve core clk rate for built-in display
  * @sys_cache_enabled: override system cache enable state
+ * @decay_frames: commits a lower vote must persist for before it is applied
+ * @decay_ms: time a lower vote must persist for before it is applied
+ * @stats: vote churn counters
  */
 struct sde_core_perf {
 	struct drm_device *dev;
@@ -102,6 +137,9 @@ struct sde_core_perf {
 	bool uidle_enabled;
 	u64 core_clk_reserve_rate;
 	u32 sys_cache_enabled;
+	u32 decay_frames;
+	u32 decay_ms;
+	struct sde_core_perf_stats stats;
 };
 
 /**
@@ -143,6 +181,20 @@ int sde_core_perf_crtc_check(struct drm_crtc *crtc,
 void sde_core_perf_crtc_update(struct drm_crtc *crtc,
 		int params_changed, bool stop_req);
 
+/**
+ * sde_core_perf_crtc_decay_work - apply a held back down-vote once the decay
+ *	window has expired without further commits
+ * @work: Pointer to the crtc perf_decay_work
+ */
+void sde_core_perf_crtc_decay_work(struct kthread_work *work);
+
+/**
+ * sde_core_perf_crtc_decay_cancel - cancel the decay work of the given crtc
+ *	and drop any held back down-vote
+ * @crtc: Pointer to crtc
+ */
+void sde_core_perf_crtc_decay_cancel(struct drm_crtc *crtc);
+
 /**
  * sde_core_perf_crtc_release_bw - release bandwidth of the given crtc
  * @crtc: Pointer to crtc
@@ -359,6 +359,8 @@ enum sde_crtc_hw_fence_flags {
  * @src_bpp         : source bpp used to calculate compression ratio
  * @target_bpp      : target bpp used to calculate compression ratio
  * @static_cache_read_work: delayed worker to transition cache state to read
+ * @perf_decay      : deferred clock/bandwidth down-vote state
+ * @perf_decay_work : delayed worker to apply a deferred down-vote
  * @cache_state     : Current static image cache state
  * @cache_type      : Current static image cache type to use
  * @dspp_blob_info  : blob containing dspp hw capability information
@@ -475,6 +477,8 @@ struct sde_crtc {
 	int target_bpp;
 
 	struct kthread_delayed_work static_cache_read_work;
+	struct sde_core_perf_decay perf_decay;
+	struct kthread_delayed_work perf_decay_work;
 	enum sde_sys_cache_state cache_state;
 	enum sde_sys_cache_type cache_type;
 
@@ -2742,6 +2742,9 @@ static int _sde_encoder_rc_idle(struct drm_encoder *drm_enc,
 		if (priv->event_thread[crtc_id].thread)
 			kthread_flush_worker(&priv->event_thread[crtc_id].worker);
 
+		/* the decay work must not vote once the resources are off */
+		sde_core_perf_crtc_decay_cancel(crtc);
+
 		/* disable all the clks and resources */
 		_sde_encoder_update_rsc_client(drm_enc, false);
 		_sde_encoder_resource_control_helper(drm_enc, false);
@@ -4,6 +4,8 @@
  * Copyright (c) 2017-2021, The Linux Foundation. All rights reserved.
  */
 
+#include <linux/debugfs.h>
+#include <linux/jhash.h>
 #include <drm/msm_drm_pp.h>
 #include "sde_reg_dma.h"
 #include "sde_hw_reg_dma_v1_color_proc.h"
@@ -150,6 +152,51 @@ static struct sde_reg_dma_buffer
 	*sspp_buf[SDE_SSPP_RECT_MAX][REG_DMA_FEATURES_MAX][SSPP_MAX];
 static struct sde_reg_dma_buffer *ltm_buf[REG_DMA_FEATURES_MAX][LTM_MAX];
 
+/**
+ * struct reg_dmav1_dspp_cache - describes the payload held in a dspp_buf
+ * @hash: jhash of the feature blob the buffer was encoded from
+ * @len: length of the feature blob
+ * @blk: LUTDMA block mask the buffer was encoded for
+ * @num_of_mixers: number of mixers the buffer was encoded for
+ * @extra: feature state outside of the blob that the encoding depends on
+ * @valid: buffer still holds the encoded payload described above
+ */
+struct reg_dmav1_dspp_cache {
+	u32 hash;
+	u32 len;
+	u32 blk;
+	u32 num_of_mixers;
+	u32 extra;
+	bool valid;
+};
+
+/**
+ * struct reg_dmav1_dspp_cache_entry - cache state of a dspp_buf
+ * @key: description of the payload held in the buffer
+ * @blob: copy of the feature blob, compared on a hash match
+ * @blob_size: allocated size of @blob
+ * @snapshot: copy of the buffer taken on a hit when verifying
+ * @snapshot_size: allocated size of @snapshot
+ * @snapshot_len: bytes held in @snapshot, 0 if no comparison is pending
+ */
+struct reg_dmav1_dspp_cache_entry {
+	struct reg_dmav1_dspp_cache key;
+	void *blob;
+	u32 blob_size;
+	void *snapshot;
+	u32 snapshot_size;
+	u32 snapshot_len;
+};
+
+static struct reg_dmav1_dspp_cache_entry
+	dspp_cache[REG_DMA_FEATURES_MAX][DSPP_MAX];
+static u64 dspp_cache_hits;
+static u64 dspp_cache_misses;
+static u64 dspp_cache_verified;
+static u64 dspp_cache_mismatches;
+static bool dspp_cache_disable;
+static bool dspp_cache_verify;
+
 static u32 feature_map[SDE_DSPP_MAX] = {
 	[SDE_DSPP_VLUT] = VLUT,
 	[SDE_DSPP_GAMUT] = GAMUT,
@@ -525,6 +572,131 @@ static int reg_dma_dspp_check(struct sde_hw_dspp *ctx, void *cfg,
 	return 0;
 }
 
+static void _reg_dmav1_reset_dspp_buf(struct sde_hw_reg_dma_ops *dma_ops,
+		enum sde_reg_dma_features feature, enum sde_dspp idx)
+{
+	dspp_cache[feature][idx].key.valid = false;
+	dma_ops->reset_reg_dma_buf(dspp_buf[feature][idx]);
+}
+
+static void *_reg_dmav1_dspp_cache_grow(void **buf, u32 *size, u32 len)
+{
+	if (*buf && *size >= len)
+		return *buf;
+
+	kvfree(*buf);
+	*buf = kvmalloc(len, GFP_KERNEL);
+	*size = *buf ? len : 0;
+
+	return *buf;
+}
+
+static void _reg_dmav1_dspp_cache_free(struct reg_dmav1_dspp_cache_entry *entry)
+{
+	kvfree(entry->blob);
+	kvfree(entry->snapshot);
+	memset(entry, 0, sizeof(*entry));
+}
+
+/*
+ * Returns true if dspp_buf[feature][idx] already holds the payload that
+ * would be encoded for hw_cfg, in which case the caller can kick it off
+ * again as is. A hash match is confirmed against the stored copy of the
+ * blob. The lookup key is returned in @key so the caller can record it
+ * once a freshly encoded buffer has been kicked off.
+ *
+ * With verification enabled a hit snapshots the buffer and returns false,
+ * so the caller rebuilds it and _reg_dmav1_dspp_cache_store() compares the
+ * fresh payload with the cached one.
+ */
+static bool _reg_dmav1_dspp_cache_lookup(enum sde_dspp idx,
+		enum sde_reg_dma_features feature, struct sde_hw_cp_cfg *hw_cfg,
+		u32 blk, u32 num_of_mixers, u32 extra,
+		struct reg_dmav1_dspp_cache *key)
+{
+	struct reg_dmav1_dspp_cache_entry *entry = &dspp_cache[feature][idx];
+	struct sde_reg_dma_buffer *buf = dspp_buf[feature][idx];
+
+	key->hash = jhash(hw_cfg->payload, hw_cfg->len, extra);
+	key->len = hw_cfg->len;
+	key->blk = blk;
+	key->num_of_mixers = num_of_mixers;
+	key->extra = extra;
+	key->valid = true;
+	entry->snapshot_len = 0;
+
+	if (dspp_cache_disable || !entry->key.valid ||
+			entry->key.hash != key->hash ||
+			entry->key.len != key->len ||
+			entry->key.blk != key->blk ||
+			entry->key.num_of_mixers != key->num_of_mixers ||
+			entry->key.extra != key->extra ||
+			memcmp(entry->blob, hw_cfg->payload, key->len)) {
+		dspp_cache_misses++;
+		return false;
+	}
+
+	if (dspp_cache_verify && buf->index &&
+			_reg_dmav1_dspp_cache_grow(&entry->snapshot,
+			&entry->snapshot_size, buf->index)) {
+		memcpy(entry->snapshot, buf->vaddr, buf->index);
+		entry->snapshot_len = buf->index;
+		return false;
+	}
+
+	dspp_cache_hits++;
+	SDE_EVT32(idx, feature, key->hash, blk);
+	return true;
+}
+
+static void _reg_dmav1_dspp_cache_store(enum sde_dspp idx,
+		enum sde_reg_dma_features feature, struct sde_hw_cp_cfg *hw_cfg,
+		struct reg_dmav1_dspp_cache *key)
+{
+	struct reg_dmav1_dspp_cache_entry *entry = &dspp_cache[feature][idx];
+	struct sde_reg_dma_buffer *buf = dspp_buf[feature][idx];
+
+	if (entry->snapshot_len) {
+		dspp_cache_verified++;
+		if (buf->index != entry->snapshot_len ||
+				memcmp(buf->vaddr, entry->snapshot,
+				entry->snapshot_len)) {
+			dspp_cache_mismatches++;
+			DRM_ERROR("cached payload mismatch dspp %d feature %d len %u/%u\n",
+					idx, feature, entry->snapshot_len,
+					buf->index);
+			SDE_EVT32(idx, feature, entry->snapshot_len,
+					buf->index, SDE_EVTLOG_ERROR);
+		}
+		entry->snapshot_len = 0;
+	}
+
+	if (!_reg_dmav1_dspp_cache_grow(&entry->blob, &entry->blob_size,
+			key->len)) {
+		entry->key.valid = false;
+		return;
+	}
+
+	memcpy(entry->blob, hw_cfg->payload, key->len);
+	entry->key = *key;
+}
+
+void reg_dmav1_dspp_cache_debugfs_init(struct dentry *parent)
+{
+	struct dentry *root;
+
+	root = debugfs_create_dir("reg_dma_dspp_cache", parent);
+	if (IS_ERR_OR_NULL(root))
+		return;
+
+	debugfs_create_u64("hits", 0400, root, &dspp_cache_hits);
+	debugfs_create_u64("misses", 0400, root, &dspp_cache_misses);
+	debugfs_create_bool("disable", 0600, root, &dspp_cache_disable);
+	debugfs_create_bool("verify", 0600, root, &dspp_cache_verify);
+	debugfs_create_u64("verified", 0400, root, &dspp_cache_verified);
+	debugfs_create_u64("mismatches", 0400, root, &dspp_cache_mismatches);
+}
+
 static int _reg_dma_init_dspp_feature_buf(int feature, enum sde_dspp idx)
 {
 	int rc = 0;
@@ -677,6 +849,7 @@ void reg_dmav1_setup_dspp_vlutv18(struct sde_hw_dspp *ctx, void *cfg)
 	struct sde_hw_reg_dma_ops *dma_ops;
 	struct sde_hw_ctl *ctl = NULL;
 	struct sde_hw_dspp *dspp_list[DSPP_MAX];
+	struct reg_dmav1_dspp_cache key;
 	u32 *data = NULL;
 	int i, j, rc = 0;
 	u32 index, num_of_mixers, blk = 0;
@@ -724,7 +897,11 @@ void reg_dmav1_setup_dspp_vlutv18(struct sde_hw_dspp *ctx, void *cfg)
 	}
 
 	dma_ops = sde_reg_dma_get_ops();
-	dma_ops->reset_reg_dma_buf(dspp_buf[VLUT][ctx->idx]);
+	if (_reg_dmav1_dspp_cache_lookup(ctx->idx, VLUT, hw_cfg, blk,
+			num_of_mixers, 0, &key))
+		goto kickoff;
+
+	_reg_dmav1_reset_dspp_buf(dma_ops, VLUT, ctx->idx);
 
 	REG_DMA_INIT_OPS(dma_write_cfg, blk, VLUT, dspp_buf[VLUT][ctx->idx]);
 
@@ -773,6 +950,7 @@ void reg_dmav1_setup_dspp_vlutv18(struct sde_hw_dspp *ctx, void *cfg)
 		goto exit;
 	}
 
+kickoff:
 	REG_DMA_SETUP_KICKOFF(kick_off, hw_cfg->ctl, dspp_buf[VLUT][ctx->idx],
 	    REG_DMA_WRITE, DMA_CTL_QUEUE0, WRITE_IMMEDIATE, VLUT);
 	LOG_FEATURE_ON;
@@ -781,6 +959,7 @@ void reg_dmav1_setup_dspp_vlutv18(struct sde_hw_dspp *ctx, void *cfg)
 		DRM_ERROR("failed to kick off ret %d\n", rc);
 		goto exit;
 	}
+	_reg_dmav1_dspp_cache_store(ctx->idx, VLUT, hw_cfg, &key);
 
 exit:
 	kvfree(data);
@@ -875,7 +1054,7 @@ static void dspp_3d_gamutv4_off(struct sde_hw_dspp *ctx, void *cfg)
 	}
 
 	dma_ops = sde_reg_dma_get_ops();
-	dma_ops->reset_reg_dma_buf(dspp_buf[GAMUT][ctx->idx]);
+	_reg_dmav1_reset_dspp_buf(dma_ops, GAMUT, ctx->idx);
 
 	REG_DMA_INIT_OPS(dma_write_cfg, blk, GAMUT, dspp_buf[GAMUT][ctx->idx]);
 
@@ -913,6 +1092,7 @@ static void reg_dmav1_setup_dspp_3d_gamutv4_common(struct sde_hw_dspp *ctx,
 	u32 *scale_data;
 	struct sde_reg_dma_setup_ops_cfg dma_write_cfg;
 	struct sde_hw_reg_dma_ops *dma_ops;
+	struct reg_dmav1_dspp_cache key;
 	int rc;
 	u32 num_of_mixers, blk = 0;
 
@@ -950,8 +1130,13 @@ static void reg_dmav1_setup_dspp_3d_gamutv4_common(struct sde_hw_dspp *ctx,
 		return;
 	}
 
+	/* table selection toggles with the current opmode, key on it too */
 	dma_ops = sde_reg_dma_get_ops();
-	dma_ops->reset_reg_dma_buf(dspp_buf[GAMUT][ctx->idx]);
+	if (_reg_dmav1_dspp_cache_lookup(ctx->idx, GAMUT, hw_cfg, blk,
+			num_of_mixers, op_mode, &key))
+		goto kickoff;
+
+	_reg_dmav1_reset_dspp_buf(dma_ops, GAMUT, ctx->idx);
 
 	REG_DMA_INIT_OPS(dma_write_cfg, blk, GAMUT, dspp_buf[GAMUT][ctx->idx]);
 
@@ -1014,12 +1199,15 @@ static void reg_dmav1_setup_dspp_3d_gamutv4_common(struct sde_hw_dspp *ctx,
 		return;
 	}
 
+kickoff:
 	REG_DMA_SETUP_KICKOFF(kick_off, hw_cfg->ctl, dspp_buf[GAMUT][ctx->idx],
 			REG_DMA_WRITE, DMA_CTL_QUEUE0, WRITE_IMMEDIATE, GAMUT);
 	LOG_FEATURE_ON;
 	rc = dma_ops->kick_off(&kick_off);
 	if (rc)
 		DRM_ERROR("failed to kick off ret %d\n", rc);
+	else
+		_reg_dmav1_dspp_cache_store(ctx->idx, GAMUT, hw_cfg, &key);
 }
 
 void reg_dmav1_setup_dspp_3d_gamutv4(struct sde_hw_dspp *ctx, void *cfg)
@@ -1086,6 +1274,7 @@ void reg_dmav1_setup_dspp_gcv18(struct sde_hw_dspp *ctx, void *cfg)
 	u32 reg;
 	u32 *addr[GC_TBL_NUM];
 	u32 num_of_mixers, blk = 0;
+	struct reg_dmav1_dspp_cache key;
 
 	rc = reg_dma_dspp_check(ctx, cfg, GC);
 	if (rc)
@@ -1115,7 +1304,11 @@ void reg_dmav1_setup_dspp_gcv18(struct sde_hw_dspp *ctx, void *cfg)
 
 	lut_cfg = hw_cfg->payload;
 	dma_ops = sde_reg_dma_get_ops();
-	dma_ops->reset_reg_dma_buf(dspp_buf[GC][ctx->idx]);
+	if (_reg_dmav1_dspp_cache_lookup(ctx->idx, GC, hw_cfg, blk,
+			num_of_mixers, 0, &key))
+		goto kickoff;
+
+	_reg_dmav1_reset_dspp_buf(dma_ops, GC, ctx->idx);
 
 	REG_DMA_INIT_OPS(dma_write_cfg, blk, GC, dspp_buf[GC][ctx->idx]);
 
@@ -1174,6 +1367,7 @@ void reg_dmav1_setup_dspp_gcv18(struct sde_hw_dspp *ctx, void *cfg)
 		return;
 	}
 
+kickoff:
 	REG_DMA_SETUP_KICKOFF(kick_off, hw_cfg->ctl, dspp_buf[GC][ctx->idx],
 			REG_DMA_WRITE, DMA_CTL_QUEUE0, WRITE_IMMEDIATE, GC);
 	LOG_FEATURE_ON;
@@ -1182,6 +1376,7 @@ void reg_dmav1_setup_dspp_gcv18(struct sde_hw_dspp *ctx, void *cfg)
 		DRM_ERROR("failed to kick off ret %d\n", rc);
 		return;
 	}
+	_reg_dmav1_dspp_cache_store(ctx->idx, GC, hw_cfg, &key);
 }
 
 static void _dspp_igcv31_off(struct sde_hw_dspp *ctx, void *cfg)
@@ -1204,7 +1399,7 @@ static void _dspp_igcv31_off(struct sde_hw_dspp *ctx, void *cfg)
 	}
 
 	dma_ops = sde_reg_dma_get_ops();
-	dma_ops->reset_reg_dma_buf(dspp_buf[IGC][ctx->idx]);
+	_reg_dmav1_reset_dspp_buf(dma_ops, IGC, ctx->idx);
 
 	REG_DMA_INIT_OPS(dma_write_cfg, blk, IGC, dspp_buf[IGC][ctx->idx]);
 
@@ -1245,6 +1440,7 @@ void reg_dmav1_setup_dspp_igcv31(struct sde_hw_dspp *ctx, void *cfg)
 	u32 offset = 0;
 	u32 reg;
 	u32 index, num_of_mixers, dspp_sel, blk = 0;
+	struct reg_dmav1_dspp_cache key;
 
 	rc = reg_dma_dspp_check(ctx, cfg, IGC);
 	if (rc)
@@ -1284,7 +1480,11 @@ void reg_dmav1_setup_dspp_igcv31(struct sde_hw_dspp *ctx, void *cfg)
 	lut_cfg = hw_cfg->payload;
 
 	dma_ops = sde_reg_dma_get_ops();
-	dma_ops->reset_reg_dma_buf(dspp_buf[IGC][ctx->idx]);
+	if (_reg_dmav1_dspp_cache_lookup(ctx->idx, IGC, hw_cfg, blk,
+			num_of_mixers, 0, &key))
+		goto kickoff;
+
+	_reg_dmav1_reset_dspp_buf(dma_ops, IGC, ctx->idx);
 
 	REG_DMA_INIT_OPS(dma_write_cfg, DSPP_IGC, IGC, dspp_buf[IGC][ctx->idx]);
 
@@ -1353,12 +1553,15 @@ void reg_dmav1_setup_dspp_igcv31(struct sde_hw_dspp *ctx, void *cfg)
 		return;
 	}
 
+kickoff:
 	REG_DMA_SETUP_KICKOFF(kick_off, hw_cfg->ctl, dspp_buf[IGC][ctx->idx],
 			REG_DMA_WRITE, DMA_CTL_QUEUE0, WRITE_IMMEDIATE, IGC);
 	LOG_FEATURE_ON;
 	rc = dma_ops->kick_off(&kick_off);
 	if (rc)
 		DRM_ERROR("failed to kick off ret %d\n", rc);
+	else
+		_reg_dmav1_dspp_cache_store(ctx->idx, IGC, hw_cfg, &key);
 }
 
 int reg_dmav1_setup_rc_pu_configv1(struct sde_hw_dspp *ctx, void *cfg)
@@ -1675,7 +1878,7 @@ static void _dspp_pcc_common_off(struct sde_hw_dspp *ctx, void *cfg)
 	}
 
 	dma_ops = sde_reg_dma_get_ops();
-	dma_ops->reset_reg_dma_buf(dspp_buf[PCC][ctx->idx]);
+	_reg_dmav1_reset_dspp_buf(dma_ops, PCC, ctx->idx);
 
 	REG_DMA_INIT_OPS(dma_write_cfg, blk, PCC, dspp_buf[PCC][ctx->idx]);
 
@@ -1711,6 +1914,7 @@ void reg_dmav1_setup_dspp_pcc_common(struct sde_hw_dspp *ctx, void *cfg)
 	struct sde_reg_dma_setup_ops_cfg dma_write_cfg;
 	struct drm_msm_pcc *pcc_cfg;
 	struct drm_msm_pcc_coeff *coeffs = NULL;
+	struct reg_dmav1_dspp_cache key;
 	u32 *data = NULL;
 	int rc, i = 0;
 	u32 reg = 0;
@@ -1744,7 +1948,11 @@ void reg_dmav1_setup_dspp_pcc_common(struct sde_hw_dspp *ctx, void *cfg)
 
 	pcc_cfg = hw_cfg->payload;
 	dma_ops = sde_reg_dma_get_ops();
-	dma_ops->reset_reg_dma_buf(dspp_buf[PCC][ctx->idx]);
+	if (_reg_dmav1_dspp_cache_lookup(ctx->idx, PCC, hw_cfg, blk,
+			num_of_mixers, 0, &key))
+		goto kickoff;
+
+	_reg_dmav1_reset_dspp_buf(dma_ops, PCC, ctx->idx);
 
 	REG_DMA_INIT_OPS(dma_write_cfg, blk, PCC, dspp_buf[PCC][ctx->idx]);
 
@@ -1818,12 +2026,15 @@ void reg_dmav1_setup_dspp_pcc_common(struct sde_hw_dspp *ctx, void *cfg)
 		goto exit;
 	}
 
+kickoff:
 	REG_DMA_SETUP_KICKOFF(kick_off, hw_cfg->ctl, dspp_buf[PCC][ctx->idx],
 			REG_DMA_WRITE, DMA_CTL_QUEUE0, WRITE_IMMEDIATE, PCC);
 	LOG_FEATURE_ON;
 	rc = dma_ops->kick_off(&kick_off);
 	if (rc)
 		DRM_ERROR("failed to kick off ret %d\n", rc);
+	else
+		_reg_dmav1_dspp_cache_store(ctx->idx, PCC, hw_cfg, &key);
 
 exit:
 	kvfree(data);
@@ -1862,6 +2073,7 @@ void reg_dmav1_setup_dspp_pa_hsicv17(struct sde_hw_dspp *ctx, void *cfg)
 	struct sde_reg_dma_setup_ops_cfg dma_write_cfg;
 	struct drm_msm_pa_hsic *hsic_cfg;
 	struct sde_hw_dspp *dspp_list[DSPP_MAX];
+	struct reg_dmav1_dspp_cache key;
 	u32 reg = 0, opcode = 0, local_opcode = 0;
 	int rc, i;
 	u32 num_of_mixers, blk = 0;
@@ -1910,7 +2122,11 @@ void reg_dmav1_setup_dspp_pa_hsicv17(struct sde_hw_dspp *ctx, void *cfg)
 	hsic_cfg = hw_cfg->payload;
 
 	dma_ops = sde_reg_dma_get_ops();
-	dma_ops->reset_reg_dma_buf(dspp_buf[HSIC][ctx->idx]);
+	if (_reg_dmav1_dspp_cache_lookup(ctx->idx, HSIC, hw_cfg, blk,
+			num_of_mixers, 0, &key))
+		goto kickoff;
+
+	_reg_dmav1_reset_dspp_buf(dma_ops, HSIC, ctx->idx);
 
 	REG_DMA_INIT_OPS(dma_write_cfg, blk, HSIC, dspp_buf[HSIC][ctx->idx]);
 
@@ -2004,12 +2220,15 @@ void reg_dmav1_setup_dspp_pa_hsicv17(struct sde_hw_dspp *ctx, void *cfg)
 		}
 	}
 
+kickoff:
 	REG_DMA_SETUP_KICKOFF(kick_off, hw_cfg->ctl, dspp_buf[HSIC][ctx->idx],
 			REG_DMA_WRITE, DMA_CTL_QUEUE0, WRITE_IMMEDIATE, HSIC);
 	LOG_FEATURE_ON;
 	rc = dma_ops->kick_off(&kick_off);
 	if (rc)
 		DRM_ERROR("failed to kick off ret %d\n", rc);
+	else
+		_reg_dmav1_dspp_cache_store(ctx->idx, HSIC, hw_cfg, &key);
 }
 
 static int reg_dma_validate_sixzone_config(struct sde_hw_dspp *ctx, void *cfg,
@@ -2392,6 +2611,7 @@ int reg_dmav1_deinit_dspp_ops(enum sde_dspp idx)
 	}
 
 	for (i = 0; i < REG_DMA_FEATURES_MAX; i++) {
+		_reg_dmav1_dspp_cache_free(&dspp_cache[i][idx]);
 		if (!dspp_buf[i][idx])
 			continue;
 		dma_ops->dealloc_reg_dma(dspp_buf[i][idx]);
@@ -4777,7 +4997,7 @@ static void _dspp_igcv4_off(struct sde_hw_dspp *ctx, void *cfg)
 	}
 
 	dma_ops = sde_reg_dma_get_ops();
-	dma_ops->reset_reg_dma_buf(dspp_buf[IGC][ctx->idx]);
+	_reg_dmav1_reset_dspp_buf(dma_ops, IGC, ctx->idx);
 
 	REG_DMA_INIT_OPS(dma_write_cfg, blk, IGC, dspp_buf[IGC][ctx->idx]);
 
@@ -4842,7 +5062,7 @@ void reg_dmav2_setup_dspp_igcv4(struct sde_hw_dspp *ctx, void *cfg)
 	lut_cfg = hw_cfg->payload;
 
 	dma_ops = sde_reg_dma_get_ops();
-	dma_ops->reset_reg_dma_buf(dspp_buf[IGC][ctx->idx]);
+	_reg_dmav1_reset_dspp_buf(dma_ops, IGC, ctx->idx);
 
 	REG_DMA_INIT_OPS(dma_write_cfg, blk, IGC, dspp_buf[IGC][ctx->idx]);
 
@@ -4942,7 +5162,7 @@ static void dspp_3d_gamutv43_off(struct sde_hw_dspp *ctx, void *cfg)
 	}
 
 	dma_ops = sde_reg_dma_get_ops();
-	dma_ops->reset_reg_dma_buf(dspp_buf[GAMUT][ctx->idx]);
+	_reg_dmav1_reset_dspp_buf(dma_ops, GAMUT, ctx->idx);
 
 	REG_DMA_INIT_OPS(dma_write_cfg, blk, GAMUT, dspp_buf[GAMUT][ctx->idx]);
 
@@ -5023,7 +5243,7 @@ void reg_dmav2_setup_dspp_3d_gamutv43(struct sde_hw_dspp *ctx, void *cfg)
 	op_mode |= GAMUT_EN;
 
 	dma_ops = sde_reg_dma_get_ops();
-	dma_ops->reset_reg_dma_buf(dspp_buf[GAMUT][ctx->idx]);
+	_reg_dmav1_reset_dspp_buf(dma_ops, GAMUT, ctx->idx);
 
 	REG_DMA_INIT_OPS(dma_write_cfg, blk, GAMUT, dspp_buf[GAMUT][ctx->idx]);
 
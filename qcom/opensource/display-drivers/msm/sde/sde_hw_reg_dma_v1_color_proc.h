@@ -12,6 +12,8 @@
 #include "sde_hw_dspp.h"
 #include "sde_hw_sspp.h"
 
+struct dentry;
+
 /**
  * reg_dmav1_init_dspp_op_v4() - initialize the dspp feature op for sde v4
  *                               using reg dma v1.
@@ -136,6 +138,13 @@ void reg_dmav1_setup_dspp_memcol_protv17(struct sde_hw_dspp *ctx, void *cfg);
  */
 int reg_dmav1_deinit_dspp_ops(enum sde_dspp idx);
 
+/**
+ * reg_dmav1_dspp_cache_debugfs_init() - expose the dspp feature payload
+ *                                       cache counters and controls.
+ * @parent: debugfs parent directory
+ */
+void reg_dmav1_dspp_cache_debugfs_init(struct dentry *parent);
+
 /**
  * reg_dmav1_init_sspp_op_v4() - initialize the sspp feature op for sde v4
  * @feature: sspp feature
@@ -52,6 +52,7 @@
 #include "sde_crtc.h"
 #include "sde_color_processing.h"
 #include "sde_reg_dma.h"
+#include "sde_hw_reg_dma_v1_color_proc.h"
 #include "sde_connector.h"
 #include "sde_vm.h"
 #include "sde_fence.h"
@@ -178,6 +179,7 @@ static int _sde_debugfs_init(struct sde_kms *sde_kms)
 		return rc;
 	}
 	sde_rm_debugfs_init(&sde_kms->rm, debugfs_root);
+	reg_dmav1_dspp_cache_debugfs_init(debugfs_root);
 
 	if (sde_kms->catalog->qdss_count)
 		debugfs_create_u32("qdss", 0600, debugfs_root,
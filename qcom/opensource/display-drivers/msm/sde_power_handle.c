@@ -334,11 +334,13 @@ static int _sde_power_data_bus_set_quota(
 
 	pdbus->curr_val.ab = in_ab_quota;
 	pdbus->curr_val.ib = in_ib_quota;
+	pdbus->curr_val_valid = true;
 
 	SDE_ATRACE_END("msm_bus_scale_req");
 
 	return rc;
 err:
+	pdbus->curr_val_valid = false;
 	for (; i >= 0; --i)
 		if (pdbus->data_bus_hdl[i])
 			icc_set_bw(pdbus->data_bus_hdl[i],
@@ -355,6 +357,7 @@ err:
 int sde_power_data_bus_set_quota(struct sde_power_handle *phandle,
 	u32 bus_id, u64 ab_quota, u64 ib_quota)
 {
+	struct sde_power_data_bus_handle *pdbus;
 	int rc = 0;
 	u32 paths;
 
@@ -370,8 +373,14 @@ int sde_power_data_bus_set_quota(struct sde_power_handle *phandle,
 	trace_sde_perf_update_bus(bus_id, ab_quota, ib_quota, paths);
 
 	mutex_lock(&phandle->phandle_lock);
-	rc = _sde_power_data_bus_set_quota(&phandle->data_bus_handle[bus_id],
-			ab_quota, ib_quota);
+	pdbus = &phandle->data_bus_handle[bus_id];
+	/* skip the icc calls if the same vote is already in place */
+	if (pdbus->curr_val_valid && pdbus->curr_val.ib == ib_quota &&
+			pdbus->curr_val.ab == div_u64(ab_quota, paths)) {
+		mutex_unlock(&phandle->phandle_lock);
+		goto skip_vote;
+	}
+	rc = _sde_power_data_bus_set_quota(pdbus, ab_quota, ib_quota);
 	mutex_unlock(&phandle->phandle_lock);
 
 skip_vote:
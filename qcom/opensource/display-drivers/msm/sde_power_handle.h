@@ -108,11 +108,13 @@ struct sde_power_bus_scaling_data {
  * struct sde_power_data_handle: power handle struct for data bus
  * @data_bus_hdl: current data bus handle
  * @curr_val : save the current bus value
+ * @curr_val_valid: curr_val matches what was last voted on all paths
  * @data_paths_cnt: number of rt data path ports
  */
 struct sde_power_data_bus_handle {
 	struct icc_path *data_bus_hdl[DATA_BUS_PATH_MAX];
 	struct sde_power_bus_scaling_data curr_val;
+	bool curr_val_valid;
 	u32 data_paths_cnt;
 	bool bus_active_only;
 };
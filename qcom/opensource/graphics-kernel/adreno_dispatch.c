@@ -4,6 +4,7 @@
  * Copyright (c) 2022-2024 Qualcomm Innovation Center, Inc. All rights reserved.
  */
 
+#include <linux/debugfs.h>
 #include <linux/slab.h>
 #include <linux/sysfs.h>
 #include <soc/qcom/msm_performance.h>
@@ -53,8 +54,14 @@ unsigned int adreno_drawobj_timeout = 2000;
 /* Interval for reading and comparing fault detection registers */
 static unsigned int _fault_timer_interval = 200;
 
-/* Use a kmem cache to speed up allocations for dispatcher jobs */
-static struct kmem_cache *jobs_cache;
+/*
+ * Deficit round robin quantum for each priority level, in drawobjs per
+ * dispatch cycle. Higher priorities get a bigger share of the ringbuffer
+ * but lower priorities are always served within a cycle.
+ */
+static unsigned int _dispatcher_prio_weight[16] = {
+	16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1,
+};
 
 #define DRAWQUEUE_RB(_drawqueue) \
 	((struct adreno_ringbuffer *) \
@@ -431,6 +438,34 @@ static inline int adreno_dispatcher_requeue_cmdobj(
 	return 0;
 }
 
+/*
+ * Put the context on the pending list for its priority unless it is already
+ * on one. The list node is embedded in the context and the
+ * ADRENO_CONTEXT_DISPATCH_QUEUED bit makes sure it is used once, so this is
+ * safe to call from atomic context. The pending list holds a reference to the
+ * context. Return false if that reference could not be taken.
+ */
+static bool _dispatcher_add_context(struct adreno_dispatcher *dispatcher,
+		struct adreno_context *drawctxt)
+{
+	if (test_and_set_bit(ADRENO_CONTEXT_DISPATCH_QUEUED,
+			&drawctxt->base.priv))
+		return true;
+
+	if (!_kgsl_context_get(&drawctxt->base)) {
+		clear_bit(ADRENO_CONTEXT_DISPATCH_QUEUED, &drawctxt->base.priv);
+		return false;
+	}
+
+	drawctxt->dispatch_time = ktime_get();
+
+	trace_dispatch_queue_context(drawctxt);
+	llist_add(&drawctxt->dispatch_node,
+		&dispatcher->jobs[drawctxt->base.priority]);
+
+	return true;
+}
+
 /**
  * dispatcher_queue_context() - Queue a context in the dispatcher pending list
  * @dispatcher: Pointer to the adreno dispatcher struct
@@ -441,27 +476,11 @@ static inline int adreno_dispatcher_requeue_cmdobj(
 static int dispatcher_queue_context(struct adreno_device *adreno_dev,
 		struct adreno_context *drawctxt)
 {
-	struct adreno_dispatcher *dispatcher = &adreno_dev->dispatcher;
-	struct adreno_dispatch_job *job;
-
 	/* Refuse to queue a detached context */
 	if (kgsl_context_detached(&drawctxt->base))
 		return 0;
 
-	if (!_kgsl_context_get(&drawctxt->base))
-		return 0;
-
-	/* This function can be called in an atomic context */
-	job = kmem_cache_alloc(jobs_cache, GFP_ATOMIC);
-	if (!job) {
-		kgsl_context_put(&drawctxt->base);
-		return -ENOMEM;
-	}
-
-	job->drawctxt = drawctxt;
-
-	trace_dispatch_queue_context(drawctxt);
-	llist_add(&job->node, &dispatcher->jobs[drawctxt->base.priority]);
+	_dispatcher_add_context(&adreno_dev->dispatcher, drawctxt);
 
 	return 0;
 }
@@ -777,89 +796,146 @@ static bool adreno_gpu_stopped(struct adreno_device *adreno_dev)
 	return (adreno_gpu_fault(adreno_dev) || adreno_gpu_halt(adreno_dev));
 }
 
-static void dispatcher_handle_jobs_list(struct adreno_device *adreno_dev,
-		int id, unsigned long *map, struct llist_node *list)
+/* Put a context that the dispatcher still owns back on a pending list */
+static void _dispatcher_requeue_context(struct adreno_context *drawctxt,
+		struct llist_head *list)
+{
+	drawctxt->dispatch_time = ktime_get();
+	llist_add(&drawctxt->dispatch_node, list);
+}
+
+/* Record how long a context waited on the pending list of its priority */
+static void _dispatcher_account_wait(struct adreno_dispatcher *dispatcher,
+		int id, struct adreno_context *drawctxt)
+{
+	u64 us = ktime_us_delta(ktime_get(), drawctxt->dispatch_time);
+	u32 bucket = min_t(u32, fls64(us), ADRENO_DISPATCH_WAIT_BUCKETS - 1);
+
+	dispatcher->wait_hist[id][bucket]++;
+}
+
+/*
+ * Walk a list of pending contexts for priority level @id. Each context sends
+ * up to a burst of drawobjs and the level is charged for what was sent. Once
+ * the level has used up its deficit round robin credit the remaining contexts
+ * are deferred to the requeue list so that lower priority levels get their
+ * share of this cycle. Return true if any context was deferred that way.
+ */
+static bool dispatcher_handle_jobs_list(struct adreno_device *adreno_dev,
+		int id, struct llist_node *list)
 {
 	struct adreno_dispatcher *dispatcher = &adreno_dev->dispatcher;
-	struct adreno_dispatch_job *job, *next;
+	struct adreno_context *drawctxt, *next;
+	bool deferred = false;
 
 	if (!list)
-		return;
+		return false;
 
 	/* Reverse the order so the oldest context is considered first */
 	list = llist_reverse_order(list);
 
-	llist_for_each_entry_safe(job, next, list, node) {
+	llist_for_each_entry_safe(drawctxt, next, list, dispatch_node) {
 		int ret;
 
-		if (kgsl_context_is_bad(&job->drawctxt->base)) {
-			kgsl_context_put(&job->drawctxt->base);
-			kmem_cache_free(jobs_cache, job);
+		/*
+		 * If gpu is in fault or dispatcher is halted, add back the
+		 * contexts so that they are processed after recovery or when
+		 * dispatcher is resumed.
+		 */
+		if (adreno_gpu_stopped(adreno_dev)) {
+			llist_add(&drawctxt->dispatch_node, &dispatcher->jobs[id]);
 			continue;
 		}
 
-		/*
-		 * Due to the nature of the lockless queue the same context
-		 * might have multiple jobs on the list. We allow this so we
-		 * don't have to query the list on the producer side but on the
-		 * consumer side we only want each context to be considered
-		 * once. Use a bitmap to remember which contexts we've already
-		 * seen and quietly discard duplicate jobs
-		 */
-		if (test_and_set_bit(job->drawctxt->base.id, map)) {
-			kgsl_context_put(&job->drawctxt->base);
-			kmem_cache_free(jobs_cache, job);
+		/* This level has used up its share of the cycle */
+		if (dispatcher->deficit[id] <= 0) {
+			llist_add(&drawctxt->dispatch_node,
+				&dispatcher->requeue[id]);
+			deferred = true;
 			continue;
 		}
 
+		_dispatcher_account_wait(dispatcher, id, drawctxt);
+
 		/*
-		 * If gpu is in fault or dispatcher is halted, add back the jobs
-		 * so that they are processed after recovery or when dispatcher
-		 * is resumed.
+		 * Let the context be queued again from here on so that new
+		 * submissions that race with this pass are not lost. The
+		 * next pointer was already read so the node can be reused.
 		 */
-		if (adreno_gpu_stopped(adreno_dev)) {
-			llist_add(&job->node, &dispatcher->jobs[id]);
+		clear_bit(ADRENO_CONTEXT_DISPATCH_QUEUED, &drawctxt->base.priv);
+		smp_mb__after_atomic();
+
+		if (kgsl_context_is_bad(&drawctxt->base)) {
+			kgsl_context_put(&drawctxt->base);
 			continue;
 		}
 
-		ret = dispatcher_context_sendcmds(adreno_dev, job->drawctxt);
+		ret = dispatcher_context_sendcmds(adreno_dev, drawctxt);
 
 		/*
 		 * If the context had nothing queued or the context has been
-		 * destroyed then drop the job
+		 * destroyed then drop it
 		 */
 		if (!ret || ret == -ENOENT) {
-			kgsl_context_put(&job->drawctxt->base);
-			kmem_cache_free(jobs_cache, job);
+			kgsl_context_put(&drawctxt->base);
 			continue;
 		}
 
+		if (ret > 0)
+			dispatcher->deficit[id] -= ret;
+
 		/*
-		 * If the ringbuffer is full then requeue the job to be
+		 * A new submission may have queued the context again in the
+		 * meantime, in which case that reference is the one that
+		 * stays on the list.
+		 */
+		if (test_and_set_bit(ADRENO_CONTEXT_DISPATCH_QUEUED,
+				&drawctxt->base.priv)) {
+			kgsl_context_put(&drawctxt->base);
+			continue;
+		}
+
+		/*
+		 * If the ringbuffer is full then requeue the context to be
 		 * considered first next time. Otherwise the context
 		 * either successfully submmitted to the GPU or another error
 		 * happened and it should go back on the regular queue
 		 */
 		if (ret == -EBUSY)
-			llist_add(&job->node, &dispatcher->requeue[id]);
+			_dispatcher_requeue_context(drawctxt,
+				&dispatcher->requeue[id]);
 		else
-			llist_add(&job->node, &dispatcher->jobs[id]);
+			_dispatcher_requeue_context(drawctxt,
+				&dispatcher->jobs[id]);
 	}
+
+	return deferred;
 }
 
-static void dispatcher_handle_jobs(struct adreno_device *adreno_dev, int id)
+static bool dispatcher_handle_jobs(struct adreno_device *adreno_dev, int id)
 {
 	struct adreno_dispatcher *dispatcher = &adreno_dev->dispatcher;
-	unsigned long map[BITS_TO_LONGS(KGSL_MEMSTORE_MAX)];
 	struct llist_node *requeue, *jobs;
-
-	memset(map, 0, sizeof(map));
+	int weight = _dispatcher_prio_weight[id];
+	bool deferred;
 
 	requeue = llist_del_all(&dispatcher->requeue[id]);
 	jobs = llist_del_all(&dispatcher->jobs[id]);
 
-	dispatcher_handle_jobs_list(adreno_dev, id, map, requeue);
-	dispatcher_handle_jobs_list(adreno_dev, id, map, jobs);
+	/* An idle level does not bank credit */
+	if (!requeue && !jobs) {
+		dispatcher->deficit[id] = 0;
+		return false;
+	}
+
+	/* Cap the credit a level that cannot make progress can build up */
+	dispatcher->deficit[id] = min(dispatcher->deficit[id] + weight,
+		2 * weight);
+
+	deferred = dispatcher_handle_jobs_list(adreno_dev, id, requeue);
+	deferred |= dispatcher_handle_jobs_list(adreno_dev, id, jobs);
+
+	return deferred;
 }
 
 /**
@@ -872,6 +948,7 @@ static void dispatcher_handle_jobs(struct adreno_device *adreno_dev, int id)
 static void _adreno_dispatcher_issuecmds(struct adreno_device *adreno_dev)
 {
 	struct adreno_dispatcher *dispatcher = &adreno_dev->dispatcher;
+	bool deferred = false;
 	int i;
 
 	/* Leave early if the dispatcher isn't in a happy state */
@@ -879,7 +956,11 @@ static void _adreno_dispatcher_issuecmds(struct adreno_device *adreno_dev)
 		return;
 
 	for (i = 0; i < ARRAY_SIZE(dispatcher->jobs); i++)
-		dispatcher_handle_jobs(adreno_dev, i);
+		deferred |= dispatcher_handle_jobs(adreno_dev, i);
+
+	/* Come back for the contexts that ran out of credit this cycle */
+	if (deferred)
+		adreno_dispatcher_schedule(KGSL_DEVICE(adreno_dev));
 }
 
 /* Update the dispatcher timers */
@@ -1197,7 +1278,6 @@ static int adreno_dispatcher_queue_cmds(struct kgsl_device_private *dev_priv,
 	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
 	struct adreno_context *drawctxt = ADRENO_CONTEXT(context);
 	struct adreno_dispatcher_drawqueue *dispatch_q;
-	struct adreno_dispatch_job *job;
 	int ret;
 	unsigned int i, user_ts;
 
@@ -1221,18 +1301,11 @@ static int adreno_dispatcher_queue_cmds(struct kgsl_device_private *dev_priv,
 	/* wait for the suspend gate */
 	wait_for_completion(&device->halt_gate);
 
-	job = kmem_cache_alloc(jobs_cache, GFP_KERNEL);
-	if (!job)
-		return -ENOMEM;
-
-	job->drawctxt = drawctxt;
-
 	spin_lock(&drawctxt->lock);
 
 	ret = _check_context_state_to_queue_cmds(drawctxt, count);
 	if (ret) {
 		spin_unlock(&drawctxt->lock);
-		kmem_cache_free(jobs_cache, job);
 		return ret;
 	}
 
@@ -1250,7 +1323,6 @@ static int adreno_dispatcher_queue_cmds(struct kgsl_device_private *dev_priv,
 		 */
 		if (timestamp_cmp(drawctxt->timestamp, user_ts) >= 0) {
 			spin_unlock(&drawctxt->lock);
-			kmem_cache_free(jobs_cache, job);
 			return -ERANGE;
 		}
 	}
@@ -1263,7 +1335,6 @@ static int adreno_dispatcher_queue_cmds(struct kgsl_device_private *dev_priv,
 				drawobj[i], timestamp, user_ts);
 			if (ret) {
 				spin_unlock(&drawctxt->lock);
-				kmem_cache_free(jobs_cache, job);
 			}
 
 			if (ret == 1)
@@ -1276,7 +1347,6 @@ static int adreno_dispatcher_queue_cmds(struct kgsl_device_private *dev_priv,
 				drawobj[i], timestamp, user_ts);
 			if (ret) {
 				spin_unlock(&drawctxt->lock);
-				kmem_cache_free(jobs_cache, job);
 				return ret;
 			}
 			break;
@@ -1288,7 +1358,6 @@ static int adreno_dispatcher_queue_cmds(struct kgsl_device_private *dev_priv,
 				timestamp, user_ts);
 			if (ret) {
 				spin_unlock(&drawctxt->lock);
-				kmem_cache_free(jobs_cache, job);
 				return ret;
 			}
 			break;
@@ -1297,7 +1366,6 @@ static int adreno_dispatcher_queue_cmds(struct kgsl_device_private *dev_priv,
 			break;
 		default:
 			spin_unlock(&drawctxt->lock);
-			kmem_cache_free(jobs_cache, job);
 			return -EINVAL;
 		}
 
@@ -1310,14 +1378,8 @@ static int adreno_dispatcher_queue_cmds(struct kgsl_device_private *dev_priv,
 	spin_unlock(&drawctxt->lock);
 
 	/* Add the context to the dispatcher pending list */
-	if (_kgsl_context_get(&drawctxt->base)) {
-		trace_dispatch_queue_context(drawctxt);
-		llist_add(&job->node,
-			&adreno_dev->dispatcher.jobs[drawctxt->base.priority]);
-	} else {
-		kmem_cache_free(jobs_cache, job);
+	if (!_dispatcher_add_context(&adreno_dev->dispatcher, drawctxt))
 		goto done;
-	}
 
 	adreno_dispatcher_schedule(device);
 done:
@@ -2576,7 +2638,8 @@ static void adreno_dispatcher_close(struct adreno_device *adreno_dev)
 
 	kobject_put(&dispatcher->kobj);
 
-	kmem_cache_destroy(jobs_cache);
+	debugfs_remove(dispatcher->debugfs);
+	dispatcher->debugfs = NULL;
 
 	clear_bit(ADRENO_DISPATCHER_INIT, &dispatcher->priv);
 }
@@ -2656,7 +2719,53 @@ static DISPATCHER_UINT_ATTR(fault_throttle_time, 0644, 0,
 static DISPATCHER_UINT_ATTR(fault_throttle_burst, 0644, 0,
 	_fault_throttle_burst);
 
+static ssize_t _show_prio_weights(struct adreno_dispatcher *dispatcher,
+		struct dispatcher_attribute *attr, char *buf)
+{
+	int i, len = 0;
+
+	for (i = 0; i < ARRAY_SIZE(_dispatcher_prio_weight); i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%u%c",
+			_dispatcher_prio_weight[i],
+			i == ARRAY_SIZE(_dispatcher_prio_weight) - 1 ? '\n' : ' ');
+
+	return len;
+}
+
+/* Takes one weight per priority level, highest priority first */
+static ssize_t _store_prio_weights(struct adreno_dispatcher *dispatcher,
+		struct dispatcher_attribute *attr, const char *buf,
+		size_t size)
+{
+	unsigned int val[ARRAY_SIZE(_dispatcher_prio_weight)];
+	int i, n;
+
+	n = sscanf(buf, "%u %u %u %u %u %u %u %u %u %u %u %u %u %u %u %u",
+		&val[0], &val[1], &val[2], &val[3], &val[4], &val[5],
+		&val[6], &val[7], &val[8], &val[9], &val[10], &val[11],
+		&val[12], &val[13], &val[14], &val[15]);
+	if (n != ARRAY_SIZE(val))
+		return -EINVAL;
+
+	for (i = 0; i < ARRAY_SIZE(val); i++)
+		if (!val[i] || val[i] > ADRENO_DISPATCH_DRAWQUEUE_SIZE)
+			return -EINVAL;
+
+	mutex_lock(&dispatcher->mutex);
+	memcpy(_dispatcher_prio_weight, val, sizeof(val));
+	mutex_unlock(&dispatcher->mutex);
+
+	return size;
+}
+
+static struct dispatcher_attribute dispatcher_attr_prio_weights = {
+	.attr = { .name = "prio_weights", .mode = 0644 },
+	.show = _show_prio_weights,
+	.store = _store_prio_weights,
+};
+
 static struct attribute *dispatcher_attrs[] = {
+	&dispatcher_attr_prio_weights.attr,
 	&dispatcher_attr_inflight.attr,
 	&dispatcher_attr_inflight_low_latency.attr,
 	&dispatcher_attr_context_drawqueue_size.attr,
@@ -2698,6 +2807,25 @@ static ssize_t dispatcher_sysfs_store(struct kobject *kobj,
 	return ret;
 }
 
+static int dispatch_wait_show(struct seq_file *s, void *unused)
+{
+	struct adreno_dispatcher *dispatcher = s->private;
+	int i, j;
+
+	seq_puts(s, "prio: queue wait histogram, bucket n counts waits < 2^n us\n");
+
+	for (i = 0; i < ARRAY_SIZE(dispatcher->wait_hist); i++) {
+		seq_printf(s, "%2d:", i);
+		for (j = 0; j < ADRENO_DISPATCH_WAIT_BUCKETS; j++)
+			seq_printf(s, " %u", READ_ONCE(dispatcher->wait_hist[i][j]));
+		seq_puts(s, "\n");
+	}
+
+	return 0;
+}
+
+DEFINE_SHOW_ATTRIBUTE(dispatch_wait);
+
 static const struct sysfs_ops dispatcher_sysfs_ops = {
 	.show = dispatcher_sysfs_show,
 	.store = dispatcher_sysfs_store
@@ -2754,13 +2882,16 @@ int adreno_dispatcher_init(struct adreno_device *adreno_dev)
 	init_completion(&dispatcher->idle_gate);
 	complete_all(&dispatcher->idle_gate);
 
-	jobs_cache = KMEM_CACHE(adreno_dispatch_job, 0);
-
 	for (i = 0; i < ARRAY_SIZE(dispatcher->jobs); i++) {
 		init_llist_head(&dispatcher->jobs[i]);
 		init_llist_head(&dispatcher->requeue[i]);
+		dispatcher->deficit[i] = 0;
 	}
 
+	if (!IS_ERR_OR_NULL(device->d_debugfs))
+		dispatcher->debugfs = debugfs_create_file("dispatch_wait", 0444,
+			device->d_debugfs, dispatcher, &dispatch_wait_fops);
+
 	adreno_set_dispatch_ops(adreno_dev, &swsched_ops);
 
 	sched_set_fifo(dispatcher->worker->task);
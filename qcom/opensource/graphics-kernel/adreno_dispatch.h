@@ -22,6 +22,9 @@ extern unsigned int adreno_drawobj_timeout;
 
 #define DRAWQUEUE_NEXT(_i, _s) (((_i) + 1) % (_s))
 
+/* Number of log2 microsecond buckets in the queue wait histograms */
+#define ADRENO_DISPATCH_WAIT_BUCKETS 16
+
 /**
  * struct adreno_dispatcher_drawqueue - List of commands for a RB level
  * @cmd_q: List of command obj's submitted to dispatcher
@@ -74,10 +77,19 @@ struct adreno_dispatcher {
 	struct timer_list fault_timer;
 	unsigned int inflight;
 	atomic_t fault;
-	/** @jobs - Array of dispatch job lists for each priority level */
+	/** @jobs - Array of pending context lists for each priority level */
 	struct llist_head jobs[16];
-	/** @requeue - Array of lists for dispatch jobs that got requeued */
+	/** @requeue - Array of lists for pending contexts that got requeued */
 	struct llist_head requeue[16];
+	/** @deficit: Deficit round robin credit of each priority level */
+	int deficit[16];
+	/**
+	 * @wait_hist: Per priority histogram of the time contexts waited on a
+	 * pending list, in log2 microsecond buckets
+	 */
+	u32 wait_hist[16][ADRENO_DISPATCH_WAIT_BUCKETS];
+	/** @debugfs: debugfs node for @wait_hist */
+	struct dentry *debugfs;
 	struct kthread_work work;
 	struct kobject kobj;
 	struct completion idle_gate;
@@ -88,6 +88,10 @@ struct adreno_context {
 	u32 hw_fence_count;
 	/** @syncobj_timestamp: Timestamp to check whether GMU has consumed a syncobj */
 	u32 syncobj_timestamp;
+	/** @dispatch_node: Node on the dispatcher pending list for this priority */
+	struct llist_node dispatch_node;
+	/** @dispatch_time: Time this context was put on the dispatcher pending list */
+	ktime_t dispatch_time;
 };
 
 /* Flag definitions for flag field in adreno_context */
@@ -104,6 +108,7 @@ struct adreno_context {
  * @ADRENO_CONTEXT_SKIP_CMD - Context's drawobj's skipped during
 	fault tolerance.
  * @ADRENO_CONTEXT_FENCE_LOG - Dump fences on this context.
+ * @ADRENO_CONTEXT_DISPATCH_QUEUED - Context is on a dispatcher pending list.
  */
 enum adreno_context_priv {
 	ADRENO_CONTEXT_FAULT = KGSL_CONTEXT_PRIV_DEVICE_SPECIFIC,
@@ -113,6 +118,7 @@ enum adreno_context_priv {
 	ADRENO_CONTEXT_FORCE_PREAMBLE,
 	ADRENO_CONTEXT_SKIP_CMD,
 	ADRENO_CONTEXT_FENCE_LOG,
+	ADRENO_CONTEXT_DISPATCH_QUEUED,
 };
 
 struct kgsl_context *adreno_drawctxt_create(
@@ -37,6 +37,7 @@
 #include "kgsl_reclaim.h"
 #include "kgsl_sync.h"
 #include "kgsl_sysfs.h"
+#include "kgsl_timeline.h"
 #include "kgsl_trace.h"
 
 #if IS_ENABLED(CONFIG_OPLUS_FEATURE_MM_OSVELTE)
@@ -5312,6 +5313,7 @@ int kgsl_device_platform_probe(struct kgsl_device *device)
 	spin_lock_init(&device->timelines_lock);
 
 	kgsl_device_debugfs_init(device);
+	kgsl_timeline_debugfs_init(device);
 
 	dma_set_coherent_mask(&pdev->dev, KGSL_DMA_BIT_MASK);
 
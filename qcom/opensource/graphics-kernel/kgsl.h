@@ -377,7 +377,7 @@ typedef void (*kgsl_event_func)(struct kgsl_device *, struct kgsl_event_group *,
  * @timestamp: Timestamp for the event to expire
  * @func: Callback function for the event when it expires
  * @priv: Private data passed to the callback function
- * @node: List node for the kgsl_event_group list
+ * @node: List node for the kgsl_event_group list, sorted by @timestamp
  * @created: Jiffies when the event was created
  * @work: kthread_work struct for dispatching the callback
  * @result: KGSL event result type to pass to the callback
@@ -403,8 +403,9 @@ typedef int (*readtimestamp_func)(struct kgsl_device *, void *,
  * struct event_group - A list of GPU events
  * @context: Pointer to the active context for the events
  * @lock: Spinlock for protecting the list
- * @events: List of active GPU events
+ * @events: List of active GPU events in timestamp order
  * @group: Node for the master group list
+ * @active: Node for the device list of groups with pending events
  * @processed: Last processed timestamp
  * @name: String name for the group (for the debugfs file)
  * @readtimestamp: Function pointer to read a timestamp
@@ -415,6 +416,7 @@ struct kgsl_event_group {
 	spinlock_t lock;
 	struct list_head events;
 	struct list_head group;
+	struct list_head active;
 	unsigned int processed;
 	char name[64];
 	readtimestamp_func readtimestamp;
@@ -93,6 +93,8 @@ DEFINE_DEBUGFS_ATTRIBUTE(_reserved_fops,
 					kgsl_pool_reserved_get, NULL, "%llu\n");
 DEFINE_DEBUGFS_ATTRIBUTE(_page_count_fops,
 					kgsl_pool_page_count_get, NULL, "%llu\n");
+DEFINE_DEBUGFS_ATTRIBUTE(_clean_count_fops,
+					kgsl_pool_clean_count_get, NULL, "%llu\n");
 
 void kgsl_pool_init_debugfs(struct dentry *pool_debugfs,
 					char *name, void *pool)
@@ -119,6 +121,12 @@ void kgsl_pool_init_debugfs(struct dentry *pool_debugfs,
 
 	WARN((IS_ERR_OR_NULL(dentry)),
 		"Unable to create 'count' file for %s\n", name);
+
+	dentry = debugfs_create_file("clean", 0444,
+		pool_debugfs, pool, &_clean_count_fops);
+
+	WARN((IS_ERR_OR_NULL(dentry)),
+		"Unable to create 'clean' file for %s\n", name);
 }
 
 void kgsl_device_debugfs_init(struct kgsl_device *device)
@@ -300,6 +300,14 @@ struct kgsl_device {
 	struct list_head event_groups;
 	/** @event_groups_lock: A R/W lock for the events group list */
 	rwlock_t event_groups_lock;
+	/** @event_groups_active: Event groups that have pending events */
+	struct list_head event_groups_active;
+	/** @event_active_lock: Spinlock for the active event groups list */
+	spinlock_t event_active_lock;
+	/** @event_groups_busy: Set while a caller walks the active event groups */
+	bool event_groups_busy;
+	/** @event_groups_rerun: Set when another caller found the walk busy */
+	bool event_groups_rerun;
 	/** @speed_bin: Speed bin for the GPU device if applicable */
 	u32 speed_bin;
 	/** @soc_code: Identifier containing product and feature code */
@@ -67,6 +67,42 @@ static bool _do_process_group(unsigned int processed, unsigned int cur)
 	return true;
 }
 
+/*
+ * Put the group on the device active list if it still has pending events,
+ * or take it off otherwise. Must be called with the group lock held.
+ */
+static void _update_active_group(struct kgsl_device *device,
+		struct kgsl_event_group *group)
+{
+	spin_lock(&device->event_active_lock);
+	if (list_empty(&group->events))
+		list_del_init(&group->active);
+	else if (list_empty(&group->active))
+		list_add_tail(&group->active, &device->event_groups_active);
+	spin_unlock(&device->event_active_lock);
+}
+
+/*
+ * Insert the event into the group list keeping it sorted by timestamp. New
+ * events almost always carry the newest timestamp, so walk from the tail.
+ * Pending timestamps all lie within KGSL_TIMESTAMP_WINDOW of each other, so
+ * timestamp_cmp() gives a consistent order across a rollover.
+ */
+static void _add_event_sorted(struct kgsl_event_group *group,
+		struct kgsl_event *event)
+{
+	struct kgsl_event *pos;
+
+	list_for_each_entry_reverse(pos, &group->events, node) {
+		if (timestamp_cmp(pos->timestamp, event->timestamp) <= 0) {
+			list_add(&event->node, &pos->node);
+			return;
+		}
+	}
+
+	list_add(&event->node, &group->events);
+}
+
 static void _process_event_group(struct kgsl_device *device,
 		struct kgsl_event_group *group, bool flush)
 {
@@ -81,10 +117,15 @@ static void _process_event_group(struct kgsl_device *device,
 
 	/*
 	 * Sanity check to be sure that we aren't racing with the context
-	 * getting destroyed
+	 * getting destroyed. The caller may already have taken the group off
+	 * the active list, so put it back if it still has events pending.
 	 */
-	if (WARN_ON(context != NULL && !_kgsl_context_get(context)))
+	if (WARN_ON(context != NULL && !_kgsl_context_get(context))) {
+		spin_lock(&group->lock);
+		_update_active_group(device, group);
+		spin_unlock(&group->lock);
 		return;
+	}
 
 	spin_lock(&group->lock);
 
@@ -94,17 +135,20 @@ static void _process_event_group(struct kgsl_device *device,
 	if (!flush && !_do_process_group(group->processed, timestamp))
 		goto out;
 
+	/* The list is sorted, so stop at the first event still pending */
 	list_for_each_entry_safe(event, tmp, &group->events, node) {
 		if (timestamp_cmp(event->timestamp, timestamp) <= 0)
 			signal_event(device, event, KGSL_EVENT_RETIRED);
 		else if (flush)
 			signal_event(device, event, KGSL_EVENT_CANCELLED);
-
+		else
+			break;
 	}
 
 	group->processed = timestamp;
 
 out:
+	_update_active_group(device, group);
 	spin_unlock(&group->lock);
 	kgsl_context_put(context);
 }
@@ -147,10 +191,15 @@ void kgsl_cancel_events_timestamp(struct kgsl_device *device,
 	spin_lock(&group->lock);
 
 	list_for_each_entry_safe(event, tmp, &group->events, node) {
-		if (timestamp_cmp(timestamp, event->timestamp) == 0)
+		int cmp = timestamp_cmp(event->timestamp, timestamp);
+
+		if (cmp > 0)
+			break;
+		if (cmp == 0)
 			signal_event(device, event, KGSL_EVENT_CANCELLED);
 	}
 
+	_update_active_group(device, group);
 	spin_unlock(&group->lock);
 }
 
@@ -169,6 +218,7 @@ void kgsl_cancel_events(struct kgsl_device *device,
 	list_for_each_entry_safe(event, tmp, &group->events, node)
 		signal_event(device, event, KGSL_EVENT_CANCELLED);
 
+	_update_active_group(device, group);
 	spin_unlock(&group->lock);
 }
 
@@ -189,6 +239,9 @@ void kgsl_cancel_event(struct kgsl_device *device,
 	spin_lock(&group->lock);
 
 	list_for_each_entry_safe(event, tmp, &group->events, node) {
+		if (timestamp_cmp(event->timestamp, timestamp) > 0)
+			break;
+
 		if (timestamp == event->timestamp && func == event->func &&
 			event->priv == priv) {
 			signal_event(device, event, KGSL_EVENT_CANCELLED);
@@ -196,6 +249,7 @@ void kgsl_cancel_event(struct kgsl_device *device,
 		}
 	}
 
+	_update_active_group(device, group);
 	spin_unlock(&group->lock);
 }
 
@@ -216,6 +270,9 @@ bool kgsl_event_pending(struct kgsl_device *device,
 
 	spin_lock(&group->lock);
 	list_for_each_entry(event, &group->events, node) {
+		if (timestamp_cmp(event->timestamp, timestamp) > 0)
+			break;
+
 		if (timestamp == event->timestamp && func == event->func &&
 			event->priv == priv) {
 			result = true;
@@ -296,20 +353,58 @@ int kgsl_add_event(struct kgsl_device *device, struct kgsl_event_group *group,
 	}
 
 	/* Add the event to the group list */
-	list_add_tail(&event->node, &group->events);
+	_add_event_sorted(group, event);
+	_update_active_group(device, group);
 
 	spin_unlock(&group->lock);
 
 	return 0;
 }
 
+/*
+ * Only groups that have pending events are visited. Each group is taken off
+ * the active list before it is processed and put back by
+ * _process_event_group() if it still has events left. The read lock keeps
+ * the groups from being deleted in the meantime.
+ *
+ * One caller walks the groups at a time. A caller that finds the walk in
+ * progress cannot see the groups taken off the list, so it asks the walker
+ * to go over them again instead; a timestamp that retired after the walker
+ * read it is then not left behind until some later event.
+ */
 void kgsl_process_event_groups(struct kgsl_device *device)
 {
 	struct kgsl_event_group *group;
+	LIST_HEAD(active);
 
 	read_lock(&device->event_groups_lock);
-	list_for_each_entry(group, &device->event_groups, group)
-		_process_event_group(device, group, false);
+	spin_lock(&device->event_active_lock);
+
+	if (device->event_groups_busy) {
+		device->event_groups_rerun = true;
+		goto out;
+	}
+	device->event_groups_busy = true;
+
+	do {
+		device->event_groups_rerun = false;
+		list_splice_init(&device->event_groups_active, &active);
+
+		while (!list_empty(&active)) {
+			group = list_first_entry(&active,
+				struct kgsl_event_group, active);
+			list_del_init(&group->active);
+			spin_unlock(&device->event_active_lock);
+
+			_process_event_group(device, group, false);
+
+			spin_lock(&device->event_active_lock);
+		}
+	} while (device->event_groups_rerun);
+
+	device->event_groups_busy = false;
+out:
+	spin_unlock(&device->event_active_lock);
 	read_unlock(&device->event_groups_lock);
 }
 
@@ -325,6 +420,9 @@ void kgsl_del_event_group(struct kgsl_device *device,
 
 	write_lock(&device->event_groups_lock);
 	list_del(&group->group);
+	spin_lock(&device->event_active_lock);
+	list_del_init(&group->active);
+	spin_unlock(&device->event_active_lock);
 	write_unlock(&device->event_groups_lock);
 }
 
@@ -339,6 +437,7 @@ void kgsl_add_event_group(struct kgsl_device *device,
 
 	spin_lock_init(&group->lock);
 	INIT_LIST_HEAD(&group->events);
+	INIT_LIST_HEAD(&group->active);
 
 	group->context = context;
 	group->readtimestamp = readtimestamp;
@@ -399,6 +498,145 @@ static int events_show(struct seq_file *s, void *unused)
 
 DEFINE_SHOW_ATTRIBUTE(events);
 
+#define KGSL_EVENTS_TEST_GROUPS 4
+#define KGSL_EVENTS_TEST_ITERS 256
+
+struct kgsl_events_test_group {
+	struct kgsl_event_group group;
+	unsigned int queued;
+	unsigned int retired;
+};
+
+struct kgsl_events_test {
+	struct kgsl_events_test_group groups[KGSL_EVENTS_TEST_GROUPS];
+	atomic_t fired;
+};
+
+static int _events_test_readtimestamp(struct kgsl_device *device,
+		void *priv, enum kgsl_timestamp_type type,
+		unsigned int *timestamp)
+{
+	struct kgsl_events_test_group *tgroup = priv;
+
+	if (type == KGSL_TIMESTAMP_RETIRED)
+		*timestamp = READ_ONCE(tgroup->retired);
+	else
+		*timestamp = READ_ONCE(tgroup->queued);
+
+	return 0;
+}
+
+static void _events_test_func(struct kgsl_device *device,
+		struct kgsl_event_group *group, void *priv, int result)
+{
+	struct kgsl_events_test *test = priv;
+
+	if (result == KGSL_EVENT_RETIRED)
+		atomic_inc(&test->fired);
+}
+
+/* Stands in for a second path, e.g. the dispatcher, processing events */
+static int _events_test_thread(void *data)
+{
+	struct kgsl_device *device = data;
+
+	while (!kthread_should_stop()) {
+		kgsl_process_event_groups(device);
+		cond_resched();
+	}
+
+	return 0;
+}
+
+/*
+ * Retire events while another thread keeps walking the event groups of a
+ * private device. Once both callers are done, every retired event must have
+ * fired, whichever of them ended up seeing the new timestamps.
+ */
+static int kgsl_events_concurrency_test(void)
+{
+	struct kgsl_events_test *test;
+	struct kgsl_device *device;
+	struct task_struct *thread;
+	unsigned int iter;
+	int i, ret = 0;
+
+	test = kzalloc(sizeof(*test), GFP_KERNEL);
+	device = kzalloc(sizeof(*device), GFP_KERNEL);
+	if (!test || !device) {
+		ret = -ENOMEM;
+		goto free;
+	}
+
+	INIT_LIST_HEAD(&device->event_groups);
+	rwlock_init(&device->event_groups_lock);
+	INIT_LIST_HEAD(&device->event_groups_active);
+	spin_lock_init(&device->event_active_lock);
+
+	device->events_worker = kthread_create_worker(0, "kgsl-events-test");
+	if (IS_ERR(device->events_worker)) {
+		ret = PTR_ERR(device->events_worker);
+		goto free;
+	}
+
+	for (i = 0; i < KGSL_EVENTS_TEST_GROUPS; i++)
+		kgsl_add_event_group(device, &test->groups[i].group, NULL,
+			_events_test_readtimestamp, &test->groups[i],
+			"events-test-%d", i);
+
+	for (iter = 1; iter <= KGSL_EVENTS_TEST_ITERS && !ret; iter++) {
+		thread = kthread_run(_events_test_thread, device,
+			"kgsl-events-test");
+		if (IS_ERR(thread)) {
+			ret = PTR_ERR(thread);
+			break;
+		}
+
+		for (i = 0; i < KGSL_EVENTS_TEST_GROUPS && !ret; i++) {
+			WRITE_ONCE(test->groups[i].queued, iter);
+			ret = kgsl_add_event(device, &test->groups[i].group,
+				iter, _events_test_func, test);
+		}
+
+		/* retire them while the other thread walks the groups */
+		for (i = 0; i < KGSL_EVENTS_TEST_GROUPS; i++)
+			WRITE_ONCE(test->groups[i].retired, iter);
+		kgsl_process_event_groups(device);
+
+		kthread_stop(thread);
+		kthread_flush_worker(device->events_worker);
+
+		if (!ret && atomic_read(&test->fired) !=
+				iter * KGSL_EVENTS_TEST_GROUPS) {
+			pr_err("kgsl: events test: iter %u fired %d of %u\n",
+				iter, atomic_read(&test->fired),
+				iter * KGSL_EVENTS_TEST_GROUPS);
+			ret = -EINVAL;
+		}
+	}
+
+	for (i = 0; i < KGSL_EVENTS_TEST_GROUPS; i++)
+		kgsl_cancel_events(device, &test->groups[i].group);
+	kthread_flush_worker(device->events_worker);
+	kgsl_device_events_remove(device);
+	kthread_destroy_worker(device->events_worker);
+
+	if (!ret)
+		pr_info("kgsl: events test: %u iterations passed\n",
+			KGSL_EVENTS_TEST_ITERS);
+free:
+	kfree(device);
+	kfree(test);
+	return ret;
+}
+
+static int _events_test_set(void *data, u64 val)
+{
+	return kgsl_events_concurrency_test();
+}
+
+DEFINE_DEBUGFS_ATTRIBUTE(_events_test_fops, NULL, _events_test_set, "%llu\n");
+
 void kgsl_device_events_remove(struct kgsl_device *device)
 {
 	struct kgsl_event_group *group, *tmp;
@@ -407,6 +645,9 @@ void kgsl_device_events_remove(struct kgsl_device *device)
 	list_for_each_entry_safe(group, tmp, &device->event_groups, group) {
 		WARN_ON(!list_empty(&group->events));
 		list_del(&group->group);
+		spin_lock(&device->event_active_lock);
+		list_del_init(&group->active);
+		spin_unlock(&device->event_active_lock);
 	}
 	write_unlock(&device->event_groups_lock);
 }
@@ -415,9 +656,15 @@ void kgsl_device_events_probe(struct kgsl_device *device)
 {
 	INIT_LIST_HEAD(&device->event_groups);
 	rwlock_init(&device->event_groups_lock);
+	INIT_LIST_HEAD(&device->event_groups_active);
+	spin_lock_init(&device->event_active_lock);
+	device->event_groups_busy = false;
+	device->event_groups_rerun = false;
 
 	debugfs_create_file("events", 0444, device->d_debugfs, device,
 		&events_fops);
+	debugfs_create_file("events_test", 0200, device->d_debugfs, device,
+		&_events_test_fops);
 }
 
 /**
@@ -9,8 +9,10 @@
 #include <linux/highmem.h>
 #include <linux/mempool.h>
 #include <linux/of.h>
+#include <linux/percpu.h>
 #include <linux/scatterlist.h>
 #include <linux/version.h>
+#include <linux/workqueue.h>
 
 #include "kgsl_debugfs.h"
 #include "kgsl_device.h"
@@ -18,6 +20,23 @@
 #include "kgsl_sharedmem.h"
 #include "kgsl_trace.h"
 
+/* Maximum number of clean pages held in a per-CPU magazine */
+#define KGSL_POOL_MAG_PAGES 16
+/* Largest pool order that gets per-CPU magazines */
+#define KGSL_POOL_MAG_MAX_ORDER 4
+
+/**
+ * struct kgsl_pool_magazine - Per-CPU cache of clean pages for a pool
+ * @lock: Protects the magazine against a drain from another CPU
+ * @count: Number of pages in @pages
+ * @pages: Zeroed and synced pages ready to be handed out
+ */
+struct kgsl_pool_magazine {
+	spinlock_t lock;
+	unsigned int count;
+	struct page *pages[KGSL_POOL_MAG_PAGES];
+};
+
 #ifdef CONFIG_QCOM_KGSL_SORT_POOL
 
 struct kgsl_pool_page_entry {
@@ -38,6 +57,12 @@ static struct kmem_cache *addr_page_cache;
  * @mempool: Mempool to pre-allocate tracking structs for pages in this pool
  * @debug_root: Pointer to the debugfs root for this pool
  * @max_pages: Limit on number of pages this pool can hold
+ * @clean_list: Pages already zeroed and synced, counted in @page_count
+ * @clean_count: Number of pages in @clean_list
+ * @clean_target: Number of clean pages the refill worker tries to keep
+ * @mags: Per-CPU magazines of clean pages, NULL if the pool has none
+ * @mag_size: Number of pages a magazine is refilled with
+ * @mag_pages: Number of pages currently held in all magazines
  */
 struct kgsl_page_pool {
 	unsigned int pool_order;
@@ -48,6 +73,12 @@ struct kgsl_page_pool {
 	mempool_t *mempool;
 	struct dentry *debug_root;
 	unsigned int max_pages;
+	struct list_head clean_list;
+	unsigned int clean_count;
+	unsigned int clean_target;
+	struct kgsl_pool_magazine __percpu *mags;
+	unsigned int mag_size;
+	atomic_t mag_pages;
 };
 
 static void *_pool_entry_alloc(gfp_t gfp_mask, void *arg)
@@ -159,6 +190,12 @@ static void kgsl_destroy_page_pool(struct kgsl_page_pool *pool)
  * @page_list: List of pages held/reserved in this pool
  * @debug_root: Pointer to the debugfs root for this pool
  * @max_pages: Limit on number of pages this pool can hold
+ * @clean_list: Pages already zeroed and synced, counted in @page_count
+ * @clean_count: Number of pages in @clean_list
+ * @clean_target: Number of clean pages the refill worker tries to keep
+ * @mags: Per-CPU magazines of clean pages, NULL if the pool has none
+ * @mag_size: Number of pages a magazine is refilled with
+ * @mag_pages: Number of pages currently held in all magazines
  */
 struct kgsl_page_pool {
 	unsigned int pool_order;
@@ -168,6 +205,12 @@ struct kgsl_page_pool {
 	struct list_head page_list;
 	struct dentry *debug_root;
 	unsigned int max_pages;
+	struct list_head clean_list;
+	unsigned int clean_count;
+	unsigned int clean_target;
+	struct kgsl_pool_magazine __percpu *mags;
+	unsigned int mag_size;
+	atomic_t mag_pages;
 };
 
 static int
@@ -228,6 +271,13 @@ static void kgsl_destroy_page_pool(struct kgsl_page_pool *pool)
 static struct kgsl_page_pool kgsl_pools[6];
 static int kgsl_num_pools;
 static int kgsl_pool_max_pages;
+/* Device the pages on the clean lists have been synced for */
+static struct device *kgsl_pool_dev;
+/* Time of the last shrinker scan, the refill worker backs off after it */
+static unsigned long kgsl_pool_shrink_jiffies;
+
+static void kgsl_pool_refill_worker(struct work_struct *work);
+static DECLARE_WORK(kgsl_pool_refill_work, kgsl_pool_refill_worker);
 
 /* Return the index of the pool for the specified order */
 static int kgsl_get_pool_index(int order)
@@ -251,6 +301,69 @@ _kgsl_get_pool_from_order(int order)
 	return index >= 0 ? &kgsl_pools[index] : NULL;
 }
 
+/* Add a zeroed and synced page to the clean list, caller holds list_lock */
+static void
+__kgsl_pool_add_clean_page(struct kgsl_page_pool *pool, struct page *p)
+{
+	list_add(&p->lru, &pool->clean_list);
+	pool->clean_count++;
+
+	/*
+	 * page_count may be read without the list_lock held. Use WRITE_ONCE
+	 * to avoid compiler optimizations that may break consistency.
+	 */
+	ASSERT_EXCLUSIVE_WRITER(pool->page_count);
+	WRITE_ONCE(pool->page_count, pool->page_count + 1);
+}
+
+/* Take a page off the clean list, caller holds list_lock */
+static struct page *
+__kgsl_pool_get_clean_page(struct kgsl_page_pool *pool)
+{
+	struct page *p;
+
+	p = list_first_entry_or_null(&pool->clean_list, struct page, lru);
+	if (p) {
+		list_del(&p->lru);
+		pool->clean_count--;
+
+		/*
+		 * page_count may be read without the list_lock held. Use
+		 * WRITE_ONCE to avoid compiler optimizations that may break
+		 * consistency.
+		 */
+		ASSERT_EXCLUSIVE_WRITER(pool->page_count);
+		WRITE_ONCE(pool->page_count, pool->page_count - 1);
+	}
+
+	return p;
+}
+
+/* Account for a page that has been handed out of the pool */
+static void _kgsl_pool_page_taken(struct kgsl_page_pool *pool, struct page *p)
+{
+	/* Use READ_ONCE to read page_count without holding list_lock */
+	trace_kgsl_pool_get_page(pool->pool_order, READ_ONCE(pool->page_count));
+	mod_node_page_state(page_pgdat(p), NR_KERNEL_MISC_RECLAIMABLE,
+			-(1 << pool->pool_order));
+}
+
+/* Return true if pages on the clean lists can be used as is for @dev */
+static bool kgsl_pool_clean_ok(struct device *dev)
+{
+	return !dev || dev == READ_ONCE(kgsl_pool_dev);
+}
+
+/* Wake the refill worker if the pool is running short of clean pages */
+static void kgsl_pool_kick_refill(struct kgsl_page_pool *pool)
+{
+	if (!READ_ONCE(kgsl_pool_dev))
+		return;
+
+	if (READ_ONCE(pool->clean_count) < pool->clean_target / 2)
+		queue_work(system_unbound_wq, &kgsl_pool_refill_work);
+}
+
 /* Add a page to specified pool */
 static void
 _kgsl_pool_add_page(struct kgsl_page_pool *pool, struct page *p)
@@ -287,14 +400,107 @@ _kgsl_pool_get_page(struct kgsl_page_pool *pool)
 
 	spin_lock(&pool->list_lock);
 	p = __kgsl_pool_get_page(pool);
+	if (p == NULL)
+		p = __kgsl_pool_get_clean_page(pool);
 	spin_unlock(&pool->list_lock);
-	if (p != NULL) {
-		/* Use READ_ONCE to read page_count without holding list_lock */
-		trace_kgsl_pool_get_page(pool->pool_order,
-				READ_ONCE(pool->page_count));
-		mod_node_page_state(page_pgdat(p), NR_KERNEL_MISC_RECLAIMABLE,
-				-(1 << pool->pool_order));
+	if (p != NULL)
+		_kgsl_pool_page_taken(pool, p);
+	return p;
+}
+
+/*
+ * Hand out a clean page from this CPU's magazine. An empty magazine is
+ * refilled from the clean list in a single list_lock round trip.
+ */
+static struct page *
+kgsl_pool_mag_get_page(struct kgsl_page_pool *pool)
+{
+	struct kgsl_pool_magazine *mag;
+	struct page *p = NULL;
+
+	mag = get_cpu_ptr(pool->mags);
+	spin_lock(&mag->lock);
+
+	if (!mag->count) {
+		spin_lock(&pool->list_lock);
+		while (mag->count < pool->mag_size) {
+			struct page *page = __kgsl_pool_get_clean_page(pool);
+
+			if (!page)
+				break;
+			mag->pages[mag->count++] = page;
+		}
+		spin_unlock(&pool->list_lock);
+		atomic_add(mag->count, &pool->mag_pages);
+	}
+
+	if (mag->count) {
+		p = mag->pages[--mag->count];
+		atomic_dec(&pool->mag_pages);
+	}
+
+	spin_unlock(&mag->lock);
+	put_cpu_ptr(pool->mags);
+
+	return p;
+}
+
+/* Give the pages held in every magazine back to the pool clean list */
+static void kgsl_pool_drain_mags(struct kgsl_page_pool *pool)
+{
+	int cpu;
+
+	if (!pool->mags)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct kgsl_pool_magazine *mag = per_cpu_ptr(pool->mags, cpu);
+
+		spin_lock(&mag->lock);
+		if (mag->count) {
+			atomic_sub(mag->count, &pool->mag_pages);
+			spin_lock(&pool->list_lock);
+			while (mag->count)
+				__kgsl_pool_add_clean_page(pool,
+					mag->pages[--mag->count]);
+			spin_unlock(&pool->list_lock);
+		}
+		spin_unlock(&mag->lock);
+	}
+}
+
+/*
+ * Returns a page from specified pool for an allocation. Pages that are
+ * already zeroed and synced for @dev are preferred and @clean is set when
+ * one is returned, otherwise the caller has to zero the page.
+ */
+static struct page *
+_kgsl_pool_get_alloc_page(struct kgsl_page_pool *pool, struct device *dev,
+		bool *clean)
+{
+	struct page *p = NULL;
+
+	*clean = kgsl_pool_clean_ok(dev);
+
+	if (*clean && pool->mags) {
+		p = kgsl_pool_mag_get_page(pool);
+		if (p != NULL)
+			goto done;
 	}
+
+	spin_lock(&pool->list_lock);
+	if (*clean)
+		p = __kgsl_pool_get_clean_page(pool);
+	if (p == NULL) {
+		*clean = false;
+		p = __kgsl_pool_get_page(pool);
+	}
+	spin_unlock(&pool->list_lock);
+
+	if (p == NULL)
+		return NULL;
+done:
+	_kgsl_pool_page_taken(pool, p);
 	return p;
 }
 
@@ -309,6 +515,8 @@ int kgsl_pool_size_total(void)
 		spin_lock(&kgsl_pool->list_lock);
 		total += kgsl_pool->page_count * (1 << kgsl_pool->pool_order);
 		spin_unlock(&kgsl_pool->list_lock);
+		total += atomic_read(&kgsl_pool->mag_pages) <<
+				kgsl_pool->pool_order;
 	}
 
 	return total;
@@ -328,6 +536,7 @@ static unsigned long kgsl_pool_size_nonreserved(void)
 			total += (pool->page_count - pool->reserved_pages) *
 					(1 << pool->pool_order);
 		spin_unlock(&pool->list_lock);
+		total += atomic_read(&pool->mag_pages) << pool->pool_order;
 	}
 
 	return total;
@@ -350,14 +559,11 @@ _kgsl_pool_get_nonreserved_page(struct kgsl_page_pool *pool)
 	}
 
 	p = __kgsl_pool_get_page(pool);
+	if (p == NULL)
+		p = __kgsl_pool_get_clean_page(pool);
 	spin_unlock(&pool->list_lock);
-	if (p != NULL) {
-		/* Use READ_ONCE to read page_count without holding list_lock */
-		trace_kgsl_pool_get_page(pool->pool_order,
-					READ_ONCE(pool->page_count));
-		mod_node_page_state(page_pgdat(p), NR_KERNEL_MISC_RECLAIMABLE,
-				-(1 << pool->pool_order));
-	}
+	if (p != NULL)
+		_kgsl_pool_page_taken(pool, p);
 	return p;
 }
 
@@ -410,6 +616,10 @@ kgsl_pool_reduce(int target_pages, bool exit)
 	int i, ret;
 	unsigned long pcount = 0;
 
+	/* Magazine pages go back to the pools so they can be released too */
+	for (i = 0; i < kgsl_num_pools; i++)
+		kgsl_pool_drain_mags(&kgsl_pools[i]);
+
 	for (i = (kgsl_num_pools - 1); i >= 0; i--) {
 		if (target_pages <= 0)
 			return pcount;
@@ -481,6 +691,69 @@ u32 kgsl_get_page_size(size_t size, unsigned int align)
 	return PAGE_SIZE;
 }
 
+/* Remember the device clean pages get synced for */
+static void kgsl_pool_set_dev(struct device *dev)
+{
+	if (dev && !READ_ONCE(kgsl_pool_dev))
+		cmpxchg(&kgsl_pool_dev, NULL, dev);
+}
+
+int kgsl_pool_alloc_pages(int page_size, struct page **pages,
+			unsigned int pages_len, unsigned int count,
+			struct device *dev)
+{
+	struct kgsl_page_pool *pool;
+	unsigned int npages = page_size >> PAGE_SHIFT;
+	unsigned int i, j, nr_clean = 0;
+	int order = get_order(page_size);
+	bool clean_ok = kgsl_pool_clean_ok(dev);
+
+	pool = _kgsl_get_pool_from_order(order);
+	/* Use READ_ONCE to read page_count without holding list_lock */
+	if (!pool || !npages || !READ_ONCE(pool->page_count))
+		return 0;
+
+	kgsl_pool_set_dev(dev);
+	count = min_t(unsigned int, count, pages_len / npages);
+
+	/*
+	 * Clean pages are taken first, so the first nr_clean entries are
+	 * ready to use and only the rest need zeroing.
+	 */
+	spin_lock(&pool->list_lock);
+	for (i = 0; i < count; i++) {
+		struct page *p = NULL;
+
+		if (clean_ok)
+			p = __kgsl_pool_get_clean_page(pool);
+		if (p)
+			nr_clean++;
+		else
+			p = __kgsl_pool_get_page(pool);
+		if (!p)
+			break;
+
+		pages[i * npages] = p;
+	}
+	spin_unlock(&pool->list_lock);
+
+	count = i;
+	for (i = 0; i < count; i++) {
+		struct page *p = pages[i * npages];
+
+		_kgsl_pool_page_taken(pool, p);
+		if (i >= nr_clean)
+			kgsl_zero_page(p, order, dev);
+
+		for (j = 1; j < npages; j++)
+			pages[i * npages + j] = nth_page(p, j);
+	}
+
+	kgsl_pool_kick_refill(pool);
+
+	return count * npages;
+}
+
 int kgsl_pool_alloc_page(int *page_size, struct page **pages,
 			unsigned int pages_len, unsigned int *align,
 			struct device *dev)
@@ -493,6 +766,7 @@ int kgsl_pool_alloc_page(int *page_size, struct page **pages,
 	int order = get_order(*page_size);
 	int pool_idx;
 	size_t size = 0;
+	bool clean = false;
 
 	if ((pages == NULL) || pages_len < (*page_size >> PAGE_SHIFT))
 		return -EINVAL;
@@ -537,7 +811,9 @@ int kgsl_pool_alloc_page(int *page_size, struct page **pages,
 	}
 
 	pool_idx = kgsl_get_pool_index(order);
-	page = _kgsl_pool_get_page(pool);
+	kgsl_pool_set_dev(dev);
+	page = _kgsl_pool_get_alloc_page(pool, dev, &clean);
+	kgsl_pool_kick_refill(pool);
 
 	/* Allocate a new page if not allocated from pool */
 	if (page == NULL) {
@@ -558,7 +834,8 @@ int kgsl_pool_alloc_page(int *page_size, struct page **pages,
 	}
 
 done:
-	kgsl_zero_page(page, order, dev);
+	if (!clean)
+		kgsl_zero_page(page, order, dev);
 
 	for (j = 0; j < (*page_size >> PAGE_SHIFT); j++) {
 		p = nth_page(page, j);
@@ -591,6 +868,7 @@ void kgsl_pool_free_page(struct page *page)
 		/* Use READ_ONCE to read page_count without holding list_lock */
 		if (pool && (READ_ONCE(pool->page_count) < pool->max_pages)) {
 			_kgsl_pool_add_page(pool, page);
+			kgsl_pool_kick_refill(pool);
 			return;
 		}
 	}
@@ -600,14 +878,80 @@ void kgsl_pool_free_page(struct page *page)
 	trace_kgsl_pool_free_page(page_order);
 }
 
+/*
+ * Keep clean_target zeroed and synced pages on each pool clean list so
+ * that allocations do not have to clear pages inline. Dirty pooled pages
+ * are cleaned first; the pool is only grown from the system when it has
+ * none left and the shrinker has not asked for memory recently.
+ */
+static void kgsl_pool_refill_worker(struct work_struct *work)
+{
+	struct device *dev = READ_ONCE(kgsl_pool_dev);
+	int i;
+
+	for (i = 0; i < kgsl_num_pools; i++) {
+		struct kgsl_page_pool *pool = &kgsl_pools[i];
+
+		while (READ_ONCE(pool->clean_count) < pool->clean_target) {
+			struct page *p;
+
+			spin_lock(&pool->list_lock);
+			p = __kgsl_pool_get_page(pool);
+			spin_unlock(&pool->list_lock);
+
+			if (p == NULL) {
+				if (time_before(jiffies,
+					READ_ONCE(kgsl_pool_shrink_jiffies) + HZ))
+					break;
+
+				if (READ_ONCE(pool->page_count) >=
+						pool->max_pages)
+					break;
+
+				if (kgsl_pool_max_pages && (kgsl_pool_size_total() >=
+						kgsl_pool_max_pages))
+					break;
+
+				p = alloc_pages(kgsl_gfp_mask(pool->pool_order) |
+					__GFP_NORETRY | __GFP_NOWARN,
+					pool->pool_order);
+				if (p == NULL)
+					break;
+
+				trace_kgsl_pool_alloc_page_system(pool->pool_order);
+				mod_node_page_state(page_pgdat(p),
+					NR_KERNEL_MISC_RECLAIMABLE,
+					(1 << pool->pool_order));
+			}
+
+			kgsl_zero_page(p, pool->pool_order, dev);
+
+			spin_lock(&pool->list_lock);
+			__kgsl_pool_add_clean_page(pool, p);
+			spin_unlock(&pool->list_lock);
+
+			/* Use READ_ONCE to read page_count without holding list_lock */
+			trace_kgsl_pool_add_page(pool->pool_order,
+				READ_ONCE(pool->page_count));
+
+			cond_resched();
+		}
+	}
+}
+
 /* Functions for the shrinker */
 
 static unsigned long
 kgsl_pool_shrink_scan_objects(struct shrinker *shrinker,
 					struct shrink_control *sc)
 {
+	unsigned long pcount;
+
+	/* Hold off the refill worker while the system is reclaiming */
+	WRITE_ONCE(kgsl_pool_shrink_jiffies, jiffies);
+
 	/* sc->nr_to_scan represents number of pages to be removed*/
-	unsigned long pcount = kgsl_pool_reduce(sc->nr_to_scan, false);
+	pcount = kgsl_pool_reduce(sc->nr_to_scan, false);
 
 	/* If pools are exhausted return SHRINK_STOP */
 	return pcount ? pcount : SHRINK_STOP;
@@ -649,6 +993,40 @@ int kgsl_pool_page_count_get(void *data, u64 *val)
 	return 0;
 }
 
+int kgsl_pool_clean_count_get(void *data, u64 *val)
+{
+	struct kgsl_page_pool *pool = data;
+
+	*val = (u64) READ_ONCE(pool->clean_count) +
+			atomic_read(&pool->mag_pages);
+	return 0;
+}
+
+static void kgsl_pool_init_mags(struct kgsl_page_pool *pool,
+		struct device_node *node)
+{
+	int cpu;
+
+	/* Keep the reserved pages clean unless asked for a different amount */
+	if (of_property_read_u32(node, "qcom,mempool-clean-pages",
+			&pool->clean_target))
+		pool->clean_target = pool->reserved_pages;
+
+	pool->clean_target = min_t(u32, pool->clean_target, pool->max_pages);
+
+	if (pool->pool_order > KGSL_POOL_MAG_MAX_ORDER || !pool->clean_target)
+		return;
+
+	pool->mags = alloc_percpu(struct kgsl_pool_magazine);
+	if (!pool->mags)
+		return;
+
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu_ptr(pool->mags, cpu)->lock);
+
+	pool->mag_size = max_t(u32, KGSL_POOL_MAG_PAGES >> pool->pool_order, 1);
+}
+
 static void kgsl_pool_reserve_pages(struct kgsl_page_pool *pool,
 		struct device_node *node)
 {
@@ -704,8 +1082,10 @@ static int kgsl_of_parse_mempool(struct kgsl_page_pool *pool,
 
 	spin_lock_init(&pool->list_lock);
 	kgsl_pool_list_init(pool);
+	INIT_LIST_HEAD(&pool->clean_list);
 
 	kgsl_pool_reserve_pages(pool, node);
+	kgsl_pool_init_mags(pool, node);
 
 	snprintf(name, sizeof(name), "%d_order", (pool->pool_order));
 	kgsl_pool_init_debugfs(pool->debug_root, name, (void *) pool);
@@ -753,6 +1133,8 @@ void kgsl_exit_page_pools(void)
 {
 	int i;
 
+	cancel_work_sync(&kgsl_pool_refill_work);
+
 	/* Release all pages in pools, if any.*/
 	kgsl_pool_reduce(INT_MAX, true);
 
@@ -760,8 +1142,10 @@ void kgsl_exit_page_pools(void)
 	unregister_shrinker(&kgsl_pool_shrinker);
 
 	/* Destroy helper structures */
-	for (i = 0; i < kgsl_num_pools; i++)
+	for (i = 0; i < kgsl_num_pools; i++) {
 		kgsl_destroy_page_pool(&kgsl_pools[i]);
+		free_percpu(kgsl_pools[i].mags);
+	}
 
 	/* Destroy the kmem cache */
 	kgsl_pool_cache_destroy();
@@ -34,6 +34,18 @@ static inline int kgsl_pool_reserved_get(void *data, u64 *val)
 	return 0;
 }
 
+static inline int kgsl_pool_clean_count_get(void *data, u64 *val)
+{
+	return 0;
+}
+
+static inline int kgsl_pool_alloc_pages(int page_size, struct page **pages,
+			unsigned int pages_len, unsigned int count,
+			struct device *dev)
+{
+	return 0;
+}
+
 static inline int kgsl_pool_size_total(void)
 {
 	return 0;
@@ -68,6 +80,24 @@ int kgsl_pool_alloc_page(int *page_size, struct page **pages,
 			unsigned int pages_len, unsigned int *align,
 			struct device *dev);
 
+/**
+ * kgsl_pool_alloc_pages - Allocate several pooled pages of the same size
+ * @page_size: Size of each page
+ * @pages: pointer to hold list of pages, split into PAGE_SIZE entries
+ * @pages_len: Length of array pages
+ * @count: Number of @page_size pages wanted
+ * @dev: Device the pages are synced for
+ *
+ * Take up to @count pages from the pool in a single lock round trip,
+ * preferring pages that are already zeroed. Only pages held by the pool are
+ * returned, the caller falls back to kgsl_pool_alloc_page() for the rest.
+ *
+ * Return number of entries filled in @pages
+ */
+int kgsl_pool_alloc_pages(int page_size, struct page **pages,
+			unsigned int pages_len, unsigned int count,
+			struct device *dev);
+
 /**
  * kgsl_pool_free_pages - Free pages in an pages array
  * @pages: pointer to an array of page structs
@@ -82,6 +112,7 @@ void kgsl_pool_free_pages(struct page **pages, unsigned int page_count);
 /* Debugfs node functions */
 int kgsl_pool_reserved_get(void *data, u64 *val);
 int kgsl_pool_page_count_get(void *data, u64 *val);
+int kgsl_pool_clean_count_get(void *data, u64 *val);
 
 /**
  * kgsl_pool_size_total - Return the number of pages in all kgsl page pools
@@ -1313,7 +1313,24 @@ static int _kgsl_alloc_pages(struct kgsl_memdesc *memdesc,
 	page_size = kgsl_get_page_size(len, align);
 
 	while (len) {
-		int ret = kgsl_alloc_page(memdesc, &page_size, &local[count],
+		int ret = 0;
+
+		/* Take as many pooled pages of this size as possible at once */
+		if (len > page_size && !fatal_signal_pending(current))
+			ret = kgsl_pool_alloc_pages(page_size, &local[count],
+				npages, div_u64(len, page_size), memdesc->dev);
+
+		if (ret > 0) {
+			count += ret;
+			memdesc->page_count += ret;
+			npages -= ret;
+			len -= (u64)ret << PAGE_SHIFT;
+
+			page_size = kgsl_get_page_size(len, align);
+			continue;
+		}
+
+		ret = kgsl_alloc_page(memdesc, &page_size, &local[count],
 			npages, &align, count);
 
 		if (ret == -EAGAIN)
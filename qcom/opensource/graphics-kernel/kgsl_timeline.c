@@ -4,10 +4,12 @@
  * Copyright (c) 2022 Qualcomm Innovation Center, Inc. All rights reserved.
  */
 
+#include <linux/debugfs.h>
 #include <linux/dma-fence.h>
 #include <linux/file.h>
 #include <linux/list.h>
 #include <linux/kref.h>
+#include <linux/seq_file.h>
 #include <linux/sync_file.h>
 
 #include "kgsl_device.h"
@@ -170,18 +172,18 @@ static void timeline_fence_release(struct dma_fence *fence)
 {
 	struct kgsl_timeline_fence *f = to_timeline_fence(fence);
 	struct kgsl_timeline *timeline = f->timeline;
-	struct kgsl_timeline_fence *cur, *temp;
 	unsigned long flags;
 
 	spin_lock_irqsave(&timeline->fence_lock, flags);
 
-	/* If the fence is still on the active list, remove it */
-	list_for_each_entry_safe(cur, temp, &timeline->fences, node) {
-		if (f != cur)
-			continue;
-
+	/*
+	 * If the fence is still on the active list, remove it. Signaled fences
+	 * are taken off the list with a reference held, so an empty node here
+	 * means the fence was never added or has already been removed.
+	 */
+	if (!list_empty(&f->node)) {
 		list_del_init(&f->node);
-		break;
+		timeline->fence_count--;
 	}
 	spin_unlock_irqrestore(&timeline->fence_lock, flags);
 	trace_kgsl_timeline_fence_release(f->timeline->id, fence->seqno);
@@ -246,15 +248,19 @@ static void kgsl_timeline_add_fence(struct kgsl_timeline *timeline,
 	unsigned long flags;
 
 	spin_lock_irqsave(&timeline->fence_lock, flags);
-	list_for_each_entry(entry, &timeline->fences, node) {
-		if (fence->base.seqno < entry->base.seqno) {
-			list_add_tail(&fence->node, &entry->node);
-			spin_unlock_irqrestore(&timeline->fence_lock, flags);
-			return;
-		}
+
+	/*
+	 * Keep the list sorted by seqno. Fences are almost always created for
+	 * increasing seqnos so walk from the tail, which makes the common case
+	 * a plain append.
+	 */
+	list_for_each_entry_reverse(entry, &timeline->fences, node) {
+		if (entry->base.seqno <= fence->base.seqno)
+			break;
 	}
+	list_add(&fence->node, &entry->node);
+	timeline->fence_count++;
 
-	list_add_tail(&fence->node, &timeline->fences);
 	spin_unlock_irqrestore(&timeline->fence_lock, flags);
 }
 
@@ -285,6 +291,7 @@ void kgsl_timeline_signal(struct kgsl_timeline *timeline, u64 seqno)
 	struct kgsl_timeline_fence *fence, *tmp;
 	struct kgsl_timeline_event *event, *tmp_event;
 	struct list_head temp;
+	u32 scanned = 0;
 
 	INIT_LIST_HEAD(&temp);
 
@@ -306,13 +313,27 @@ void kgsl_timeline_signal(struct kgsl_timeline *timeline, u64 seqno)
 	}
 
 	spin_lock(&timeline->fence_lock);
-	list_for_each_entry_safe(fence, tmp, &timeline->fences, node)
-		if (timeline_fence_signaled(&fence->base) &&
-				kref_get_unless_zero(&fence->base.refcount))
-			list_move(&fence->node, &temp);
+	list_for_each_entry_safe(fence, tmp, &timeline->fences, node) {
+		scanned++;
+
+		/* List is sorted by seqno */
+		if (!timeline_fence_signaled(&fence->base))
+			break;
+
+		/* Fences on their way to release are removed by the release */
+		if (kref_get_unless_zero(&fence->base.refcount)) {
+			list_move_tail(&fence->node, &temp);
+			timeline->fence_count--;
+		}
+	}
 	spin_unlock(&timeline->fence_lock);
 
+	timeline->signal_count++;
+	timeline->scan_total += scanned;
+	timeline->scan_max = max(timeline->scan_max, scanned);
+
 	list_for_each_entry_safe(fence, tmp, &temp, node) {
+		list_del_init(&fence->node);
 		dma_fence_signal_locked(&fence->base);
 		dma_fence_put(&fence->base);
 	}
@@ -606,10 +627,13 @@ long kgsl_ioctl_timeline_destroy(struct kgsl_device_private *dev_priv,
 		if (!kref_get_unless_zero(&fence->base.refcount))
 			list_del_init(&fence->node);
 	list_replace_init(&timeline->fences, &temp);
+	timeline->fence_count = 0;
 	spin_unlock(&timeline->fence_lock);
 
 	spin_lock_irq(&timeline->lock);
 	list_for_each_entry_safe(fence, tmp, &temp, node) {
+		/* Unlink so a later release does not touch the stack list */
+		list_del_init(&fence->node);
 		dma_fence_set_error(&fence->base, -ENOENT);
 		dma_fence_signal_locked(&fence->base);
 		dma_fence_put(&fence->base);
@@ -620,3 +644,39 @@ long kgsl_ioctl_timeline_destroy(struct kgsl_device_private *dev_priv,
 
 	return 0;
 }
+
+static int timelines_show_one(int id, void *ptr, void *data)
+{
+	struct kgsl_timeline *timeline = ptr;
+	struct seq_file *s = data;
+
+	/* The id is allocated before the timeline pointer is committed */
+	if (!timeline)
+		return 0;
+
+	seq_printf(s, "%d: value=%llu fences=%u signals=%llu scanned=%llu max_scan=%u\n",
+		timeline->id, timeline->value, READ_ONCE(timeline->fence_count),
+		timeline->signal_count, timeline->scan_total,
+		timeline->scan_max);
+
+	return 0;
+}
+
+static int timelines_show(struct seq_file *s, void *unused)
+{
+	struct kgsl_device *device = s->private;
+
+	spin_lock(&device->timelines_lock);
+	idr_for_each(&device->timelines, timelines_show_one, s);
+	spin_unlock(&device->timelines_lock);
+
+	return 0;
+}
+
+DEFINE_SHOW_ATTRIBUTE(timelines);
+
+void kgsl_timeline_debugfs_init(struct kgsl_device *device)
+{
+	debugfs_create_file("timelines", 0444, device->d_debugfs, device,
+		&timelines_fops);
+}
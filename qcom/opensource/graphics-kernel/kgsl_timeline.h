@@ -23,8 +23,16 @@ struct kgsl_timeline {
 	spinlock_t lock;
 	/** @ref: Reference count for the struct */
 	struct kref ref;
-	/** @fences: sorted list of active fences */
+	/** @fences: list of active fences sorted by seqno */
 	struct list_head fences;
+	/** @fence_count: Number of fences on @fences */
+	u32 fence_count;
+	/** @signal_count: Number of times the timeline was advanced */
+	u64 signal_count;
+	/** @scan_total: Fences visited across all signals */
+	u64 scan_total;
+	/** @scan_max: Longest fence scan done by a single signal */
+	u32 scan_max;
 	/** @events: sorted list of events to be retired */
 	struct list_head events;
 	/** @name: Name of the timeline for debugging */
@@ -121,6 +129,15 @@ static inline void kgsl_timeline_put(struct kgsl_timeline *timeline)
 		kref_put(&timeline->ref, kgsl_timeline_destroy);
 }
 
+/**
+ * kgsl_timeline_debugfs_init - Create the timelines debugfs node
+ * @device: A KGSL device handle
+ *
+ * Add a node to the device debugfs directory that lists each timeline with
+ * its pending fences and the number of fences visited when it is signaled.
+ */
+void kgsl_timeline_debugfs_init(struct kgsl_device *device);
+
 /**
  * kgsl_timelines_to_fence_array - Return a dma-fence array of timeline fences
  * @device: A KGSL device handle
@@ -21,6 +21,9 @@
 #define HW_FENCE_HASH_A_MULT	4969 /* a multiplier for Hash algorithm */
 #define HW_FENCE_HASH_C_MULT	907  /* c multiplier for Hash algorithm */
 
+/* number of log2 buckets in the per-operation probe length histograms */
+#define HW_FENCE_PROBE_HIST_BUCKETS	8
+
 /* number of queues per type (i.e. ctrl or client queues) */
 #define HW_FENCE_CTRL_QUEUES	2 /* Rx and Tx Queues */
 #define HW_FENCE_CLIENT_QUEUES	2 /* Rx and Tx Queues */
@@ -82,7 +85,8 @@ enum hw_fence_lookup_ops {
 	HW_FENCE_LOOKUP_OP_CREATE = 0x1,
 	HW_FENCE_LOOKUP_OP_DESTROY,
 	HW_FENCE_LOOKUP_OP_CREATE_JOIN,
-	HW_FENCE_LOOKUP_OP_FIND_FENCE
+	HW_FENCE_LOOKUP_OP_FIND_FENCE,
+	HW_FENCE_LOOKUP_OP_MAX
 };
 
 /**
@@ -201,6 +205,10 @@ struct msm_hw_fence_mem_data {
  * @clients_list: list of debug clients registered
  * @clients_list_lock: lock to synchronize access to the clients list
  * @lock_wake_cnt: number of times that driver triggers wake-up ipcc to unlock inter-vm try-lock
+ * @probe_hist: per lookup operation histogram of probe lengths, bucket 'n' counts lookups that
+ *              needed between 2^n and 2^(n+1)-1 probes, last bucket also counts longer lookups
+ * @probe_max: per lookup operation longest probe length seen
+ * @probe_fail: per lookup operation number of lookups that failed after exhausting the probes
  */
 struct msm_hw_fence_dbg_data {
 	struct dentry *root;
@@ -216,6 +224,10 @@ struct msm_hw_fence_dbg_data {
 	struct mutex clients_list_lock;
 
 	u64 lock_wake_cnt;
+
+	u64 probe_hist[HW_FENCE_LOOKUP_OP_MAX][HW_FENCE_PROBE_HIST_BUCKETS];
+	u64 probe_max[HW_FENCE_LOOKUP_OP_MAX];
+	u64 probe_fail[HW_FENCE_LOOKUP_OP_MAX];
 };
 
 /**
@@ -271,6 +283,10 @@ struct hw_fence_client_queue_desc {
  * @dev: device driver pointer
  * @resources_ready: value set by driver at end of probe, once all resources are ready
  * @hw_fence_table_entries: total number of hw-fences in the global table
+ * @hw_fence_table_mask: mask used to index the table when its size is a power of two, zero
+ *                       otherwise
+ * @hw_fence_max_probe: maximum number of slots probed by any table lookup; the table is shared
+ *                      across VMs, so this must be the same in the device-tree of every VM
  * @hw_fence_mem_fences_table_size: hw-fences global table total size
  * @hw_fence_queue_entries: total number of entries that can be available in the queue
  * @hw_fence_ctrl_queue_size: size of the ctrl queue for the payload
@@ -323,6 +339,8 @@ struct hw_fence_driver_data {
 
 	/* Table & Queues info */
 	u32 hw_fence_table_entries;
+	u32 hw_fence_table_mask;
+	u32 hw_fence_max_probe;
 	u32 hw_fence_mem_fences_table_size;
 	u32 hw_fence_queue_entries;
 	/* ctrl queues */
@@ -529,5 +547,6 @@ struct msm_hw_fence *msm_hw_fence_find(struct hw_fence_driver_data *drv_data,
 	struct msm_hw_fence_client *hw_fence_client,
 	u64 context, u64 seqno, u64 *hash);
 enum hw_fence_client_data_id hw_fence_get_client_data_id(enum hw_fence_client_id client_id);
+int hw_fence_probe_self_test(struct hw_fence_driver_data *drv_data);
 
 #endif /* __HW_FENCE_DRV_INTERNAL_H */
@@ -986,6 +986,110 @@ static ssize_t hw_fence_dbg_dump_table_wr(struct file *file,
 
 
 
+static const char * const hw_fence_lookup_op_names[HW_FENCE_LOOKUP_OP_MAX] = {
+	[HW_FENCE_LOOKUP_OP_CREATE] = "create",
+	[HW_FENCE_LOOKUP_OP_DESTROY] = "destroy",
+	[HW_FENCE_LOOKUP_OP_CREATE_JOIN] = "create_join",
+	[HW_FENCE_LOOKUP_OP_FIND_FENCE] = "find",
+};
+
+/**
+ * hw_fence_dbg_probe_stats_rd() - debugfs read to dump the hw-fences table probe statistics.
+ * @file: file handler.
+ * @user_buf: user buffer content for debugfs.
+ * @user_buf_size: size of the user buffer.
+ * @ppos: position offset of the user buffer.
+ *
+ * This debugfs dumps, for each lookup operation, the histogram of the number of table slots
+ * probed, the longest probe and the number of failed lookups, after the table geometry.
+ * Writing to the node resets all the counters.
+ */
+static ssize_t hw_fence_dbg_probe_stats_rd(struct file *file, char __user *user_buf,
+	size_t user_buf_size, loff_t *ppos)
+{
+	struct hw_fence_driver_data *drv_data;
+	struct msm_hw_fence_dbg_data *dbg;
+	int max_size = SZ_4K, len = 0, op, i;
+	char *buf;
+	ssize_t ret;
+
+	if (!file || !file->private_data) {
+		HWFNC_ERR("unexpected data %d\n", file);
+		return -EINVAL;
+	}
+	drv_data = file->private_data;
+	dbg = &drv_data->debugfs_data;
+
+	buf = kzalloc(max_size, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	len += scnprintf(buf + len, max_size - len,
+		"entries:%u mask:0x%x max_probe:%u\n",
+		drv_data->hw_fence_table_entries, drv_data->hw_fence_table_mask,
+		drv_data->hw_fence_max_probe);
+
+	for (op = HW_FENCE_LOOKUP_OP_CREATE; op < HW_FENCE_LOOKUP_OP_MAX; op++) {
+		len += scnprintf(buf + len, max_size - len, "%-11s max:%llu fail:%llu hist:",
+			hw_fence_lookup_op_names[op], dbg->probe_max[op], dbg->probe_fail[op]);
+		for (i = 0; i < HW_FENCE_PROBE_HIST_BUCKETS; i++)
+			len += scnprintf(buf + len, max_size - len, " [%u%s]:%llu", 1 << i,
+				(i == HW_FENCE_PROBE_HIST_BUCKETS - 1) ? "+" : "",
+				dbg->probe_hist[op][i]);
+		len += scnprintf(buf + len, max_size - len, "\n");
+	}
+
+	ret = simple_read_from_buffer(user_buf, user_buf_size, ppos, buf, len);
+	kfree(buf);
+
+	return ret;
+}
+
+static ssize_t hw_fence_dbg_probe_stats_wr(struct file *file,
+	const char __user *user_buf, size_t user_buf_size, loff_t *ppos)
+{
+	struct hw_fence_driver_data *drv_data;
+
+	if (!file || !file->private_data) {
+		HWFNC_ERR("unexpected data %d\n", file);
+		return -EINVAL;
+	}
+	drv_data = file->private_data;
+
+	memset(drv_data->debugfs_data.probe_hist, 0, sizeof(drv_data->debugfs_data.probe_hist));
+	memset(drv_data->debugfs_data.probe_max, 0, sizeof(drv_data->debugfs_data.probe_max));
+	memset(drv_data->debugfs_data.probe_fail, 0, sizeof(drv_data->debugfs_data.probe_fail));
+
+	return user_buf_size;
+}
+
+/**
+ * hw_fence_dbg_probe_test_wr() - debugfs write to run the hw-fences table probing self-test.
+ * @file: file handler.
+ * @user_buf: user buffer content from debugfs.
+ * @user_buf_size: size of the user buffer.
+ * @ppos: position offset of the user buffer.
+ *
+ * The self-test runs on a private table and does not touch the global hw-fences table, the write
+ * fails if any of its checks fail.
+ */
+static ssize_t hw_fence_dbg_probe_test_wr(struct file *file,
+	const char __user *user_buf, size_t user_buf_size, loff_t *ppos)
+{
+	int ret;
+
+	if (!file || !file->private_data) {
+		HWFNC_ERR("unexpected data %d\n", file);
+		return -EINVAL;
+	}
+
+	ret = hw_fence_probe_self_test(file->private_data);
+	if (ret)
+		return ret;
+
+	return user_buf_size;
+}
+
 /**
  * hw_fence_dbg_create_join_fence() - debugfs write to simulate the lifecycle of a join hw-fence.
  * @file: file handler.
@@ -1196,6 +1300,17 @@ static const struct file_operations hw_fence_dump_events_fops = {
 	.read = hw_fence_dbg_dump_events_rd,
 };
 
+static const struct file_operations hw_fence_probe_stats_fops = {
+	.open = simple_open,
+	.write = hw_fence_dbg_probe_stats_wr,
+	.read = hw_fence_dbg_probe_stats_rd,
+};
+
+static const struct file_operations hw_fence_probe_test_fops = {
+	.open = simple_open,
+	.write = hw_fence_dbg_probe_test_wr,
+};
+
 static const struct file_operations hw_fence_create_join_fence_fops = {
 	.open = simple_open,
 	.write = hw_fence_dbg_create_join_fence,
@@ -1247,6 +1362,10 @@ int hw_fence_debug_debugfs_register(struct hw_fence_driver_data *drv_data)
 		&drv_data->debugfs_data.lock_wake_cnt);
 	debugfs_create_file("hw_fence_dump_events", 0600, debugfs_root, drv_data,
 		&hw_fence_dump_events_fops);
+	debugfs_create_file("hw_fence_probe_stats", 0600, debugfs_root, drv_data,
+		&hw_fence_probe_stats_fops);
+	debugfs_create_file("hw_fence_probe_test", 0600, debugfs_root, drv_data,
+		&hw_fence_probe_test_fops);
 
 	return 0;
 }
@@ -6,6 +6,7 @@
 #include <linux/uaccess.h>
 #include <linux/of_platform.h>
 #include <linux/of_address.h>
+#include <linux/log2.h>
 
 #include "hw_fence_drv_priv.h"
 #include "hw_fence_drv_utils.h"
@@ -868,45 +869,54 @@ void hw_fence_cleanup_client(struct hw_fence_driver_data *drv_data,
 	kfree(hw_fence_client);
 }
 
-static inline int _calculate_hash(u32 table_total_entries, u64 context, u64 seqno,
-	u64 step, u64 *hash)
+static inline u64 _calculate_hash(struct hw_fence_driver_data *drv_data, u64 context, u64 seqno,
+	u64 step, u64 prev_hash)
 {
-	u64 m_size = table_total_entries;
-	int val = 0;
+	u64 m_size = drv_data->hw_fence_table_entries;
+	u64 hash;
 
 	if (step == 0) {
 		u64 a_multiplier = HW_FENCE_HASH_A_MULT;
 		u64 c_multiplier = HW_FENCE_HASH_C_MULT;
 		u64 b_multiplier = context + (context - 1); /* odd multiplier */
 
-		/*
-		 * if m, is power of 2, we can optimize with right shift,
-		 * for now we don't do it, to avoid assuming a power of two
-		 */
-		*hash = (a_multiplier * seqno * b_multiplier + (c_multiplier * context)) % m_size;
-	} else {
-		if (step >= m_size) {
-			/*
-			 * If we already traversed the whole table, return failure since this means
-			 * there are not available spots, table is either full or full-enough
-			 * that we couldn't find an available spot after traverse the whole table.
-			 * Ideally table shouldn't be so full that we cannot find a value after some
-			 * iterations, so this maximum step size could be optimized to fail earlier.
-			 */
-			HWFNC_ERR("Fence Table tranversed and no available space!\n");
-			val = -EINVAL;
-		} else {
-			/*
-			 * Linearly increment the hash value to find next element in the table
-			 * note that this relies in the 'scrambled' data from the original hash
-			 * Also, add a mod division to wrap-around in case that we reached the
-			 * end of the table
-			 */
-			*hash = (*hash + 1) % m_size;
-		}
+		hash = a_multiplier * seqno * b_multiplier + (c_multiplier * context);
+
+		/* for power of two tables the mask gives the same result as the modulo */
+		if (drv_data->hw_fence_table_mask)
+			return hash & drv_data->hw_fence_table_mask;
+
+		return hash % m_size;
 	}
 
-	return val;
+	/*
+	 * Linearly increment the hash value to find next element in the table
+	 * note that this relies in the 'scrambled' data from the original hash
+	 * Also, wrap-around in case that we reached the end of the table
+	 */
+	if (drv_data->hw_fence_table_mask)
+		return (prev_hash + 1) & drv_data->hw_fence_table_mask;
+
+	hash = prev_hash + 1;
+
+	return (hash == m_size) ? 0 : hash;
+}
+
+static inline void _update_probe_stats(struct hw_fence_driver_data *drv_data,
+	enum hw_fence_lookup_ops op_code, u64 probes, bool found)
+{
+	struct msm_hw_fence_dbg_data *dbg = &drv_data->debugfs_data;
+	u32 bucket;
+
+	if (!found) {
+		dbg->probe_fail[op_code]++;
+		return;
+	}
+
+	bucket = min_t(u32, ilog2(probes), HW_FENCE_PROBE_HIST_BUCKETS - 1);
+	dbg->probe_hist[op_code][bucket]++;
+	if (probes > dbg->probe_max[op_code])
+		dbg->probe_max[op_code] = probes;
 }
 
 static inline struct msm_hw_fence *_get_hw_fence(u32 table_total_entries,
@@ -1059,7 +1069,7 @@ struct msm_hw_fence *_hw_fence_lookup_and_process(struct hw_fence_driver_data *d
 			u32 client_id, u64 context, u64 seqno, u32 hash, u32 pending);
 	struct msm_hw_fence *hw_fence = NULL;
 	u64 step = 0;
-	int ret = 0;
+	u32 max_probe;
 	bool hw_fence_found = false;
 
 	if (!hash | !drv_data | !hw_fences_tbl) {
@@ -1093,15 +1103,16 @@ struct msm_hw_fence *_hw_fence_lookup_and_process(struct hw_fence_driver_data *d
 		return NULL;
 	}
 
-	while (!hw_fence_found && (step < drv_data->hw_fence_table_entries)) {
+	/*
+	 * The table is shared with the other VMs, which may have placed a fence anywhere within the
+	 * max probe length from its home slot, so find and destroy have to cover the same window
+	 * that creation uses.
+	 */
+	max_probe = drv_data->hw_fence_max_probe;
+	while (!hw_fence_found && (step < max_probe)) {
 
 		/* Calculate the Hash for the Fence */
-		ret = _calculate_hash(drv_data->hw_fence_table_entries, context, seqno, step, hash);
-		if (ret) {
-			HWFNC_ERR("error calculating hash ctx:%llu seqno:%llu hash:%llu\n",
-				context, seqno, *hash);
-			break;
-		}
+		*hash = _calculate_hash(drv_data, context, seqno, step, *hash);
 		HWFNC_DBG_LUT("calculated hash:%llu [ctx:%llu seqno:%llu]\n", *hash, context,
 			seqno);
 
@@ -1154,9 +1165,12 @@ struct msm_hw_fence *_hw_fence_lookup_and_process(struct hw_fence_driver_data *d
 		step++;
 	}
 
-	/* If we iterated through the whole list and didn't find the fence, return null */
+	_update_probe_stats(drv_data, op_code, step, hw_fence_found);
+
+	/* If we iterated through the probe window and didn't find the fence, return null */
 	if (!hw_fence_found) {
-		HWFNC_ERR("fail to create hw-fence step:%llu\n", step);
+		HWFNC_ERR("fail to %s hw-fence step:%llu max_probe:%lu\n", _get_op_mode(op_code),
+			step, max_probe);
 		hw_fence = NULL;
 	}
 
@@ -1166,6 +1180,106 @@ struct msm_hw_fence *_hw_fence_lookup_and_process(struct hw_fence_driver_data *d
 	return hw_fence;
 }
 
+/* geometry of the private table used by the probing self-test */
+#define HW_FENCE_PROBE_TEST_ENTRIES	64
+#define HW_FENCE_PROBE_TEST_CHAIN	8
+
+static struct msm_hw_fence *_probe_test_lookup(struct hw_fence_driver_data *vm_data,
+	struct msm_hw_fence *tbl, u64 seqno, enum hw_fence_lookup_ops op_code, u64 *hash)
+{
+	return _hw_fence_lookup_and_process(vm_data, tbl, HW_FENCE_PROBE_TEST_CHAIN, seqno,
+		0, 0, op_code, hash);
+}
+
+/*
+ * Runs the table lookups on a private table shared by two copies of the driver data, standing in
+ * for two VMs: one VM creates a chain of fences colliding on the same home slot, the other finds
+ * and destroys them. The lookups only use the table geometry and debug counters of the copies.
+ */
+int hw_fence_probe_self_test(struct hw_fence_driver_data *drv_data)
+{
+	struct hw_fence_driver_data *vm_data[2] = {NULL, NULL};
+	u32 entries = HW_FENCE_PROBE_TEST_ENTRIES;
+	u32 mask = HW_FENCE_PROBE_TEST_ENTRIES - 1;
+	struct msm_hw_fence *tbl, *hw_fence;
+	u64 hash, home = 0;
+	int i, ret = 0;
+
+	tbl = kcalloc(entries, sizeof(*tbl), GFP_KERNEL);
+	if (!tbl)
+		return -ENOMEM;
+
+	for (i = 0; i < ARRAY_SIZE(vm_data); i++) {
+		vm_data[i] = kmemdup(drv_data, sizeof(*drv_data), GFP_KERNEL);
+		if (!vm_data[i]) {
+			ret = -ENOMEM;
+			goto exit;
+		}
+		vm_data[i]->hw_fence_table_entries = entries;
+		vm_data[i]->hw_fence_table_mask = mask;
+		vm_data[i]->hw_fence_max_probe = entries;
+	}
+
+	/* seqnos 'entries' apart share the home slot, so each fence lands one slot further */
+	for (i = 0; i < HW_FENCE_PROBE_TEST_CHAIN; i++) {
+		hw_fence = _probe_test_lookup(vm_data[0], tbl, (u64)i * entries,
+			HW_FENCE_LOOKUP_OP_CREATE, &hash);
+		if (!i)
+			home = hash;
+		if (!hw_fence || hash != ((home + i) & mask)) {
+			HWFNC_ERR("create %d failed hash:%llu home:%llu\n", i, hash, home);
+			ret = -EINVAL;
+			goto exit;
+		}
+	}
+
+	/* the other VM never created a fence, it must still reach the end of the chain */
+	hw_fence = _probe_test_lookup(vm_data[1], tbl,
+		(u64)(HW_FENCE_PROBE_TEST_CHAIN - 1) * entries, HW_FENCE_LOOKUP_OP_FIND_FENCE, &hash);
+	if (!hw_fence || hash != ((home + HW_FENCE_PROBE_TEST_CHAIN - 1) & mask)) {
+		HWFNC_ERR("find of chain tail failed hash:%llu home:%llu\n", hash, home);
+		ret = -EINVAL;
+		goto exit;
+	}
+
+	for (i = 0; i < HW_FENCE_PROBE_TEST_CHAIN; i += 2) {
+		if (!_probe_test_lookup(vm_data[1], tbl, (u64)i * entries,
+				HW_FENCE_LOOKUP_OP_DESTROY, &hash)) {
+			HWFNC_ERR("destroy %d failed\n", i);
+			ret = -EINVAL;
+			goto exit;
+		}
+	}
+
+	/* freed slots within the chain must not end the lookups of the fences behind them */
+	for (i = 0; i < HW_FENCE_PROBE_TEST_CHAIN; i++) {
+		hw_fence = _probe_test_lookup(vm_data[i % 2], tbl, (u64)i * entries,
+			HW_FENCE_LOOKUP_OP_FIND_FENCE, &hash);
+		if (!hw_fence != !(i % 2)) {
+			HWFNC_ERR("find %d returned:%pK hash:%llu\n", i, hw_fence, hash);
+			ret = -EINVAL;
+			goto exit;
+		}
+	}
+
+	/* a new fence reuses the first freed slot of the chain */
+	hw_fence = _probe_test_lookup(vm_data[1], tbl, (u64)HW_FENCE_PROBE_TEST_CHAIN * entries,
+		HW_FENCE_LOOKUP_OP_CREATE, &hash);
+	if (!hw_fence || hash != home) {
+		HWFNC_ERR("create in freed slot failed hash:%llu home:%llu\n", hash, home);
+		ret = -EINVAL;
+		goto exit;
+	}
+
+	HWFNC_DBG_INFO("probe self-test passed\n");
+exit:
+	for (i = 0; i < ARRAY_SIZE(vm_data); i++)
+		kfree(vm_data[i]);
+	kfree(tbl);
+
+	return ret;
+}
+
 int hw_fence_create(struct hw_fence_driver_data *drv_data,
 	struct msm_hw_fence_client *hw_fence_client,
 	u64 context, u64 seqno, u64 *hash)
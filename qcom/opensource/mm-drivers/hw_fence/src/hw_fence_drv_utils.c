@@ -6,6 +6,7 @@
 #include <linux/of_platform.h>
 #include <linux/of_address.h>
 #include <linux/io.h>
+#include <linux/log2.h>
 #include <linux/gunyah/gh_rm_drv.h>
 #include <linux/gunyah/gh_dbl.h>
 #include <linux/qcom_scm.h>
@@ -952,6 +953,18 @@ int hw_fence_utils_parse_dt_props(struct hw_fence_driver_data *drv_data)
 	drv_data->hw_fence_mem_fences_table_size = (sizeof(struct msm_hw_fence) *
 		drv_data->hw_fence_table_entries);
 
+	if (is_power_of_2(drv_data->hw_fence_table_entries))
+		drv_data->hw_fence_table_mask = drv_data->hw_fence_table_entries - 1;
+	else
+		HWFNC_WARN("table entries:%lu not a power of two, hash uses modulo\n",
+			drv_data->hw_fence_table_entries);
+
+	/* optional bound on the collision chain length, shared by all VMs using the table */
+	ret = of_property_read_u32(drv_data->dev->of_node, "qcom,hw-fence-max-probe", &val);
+	if (ret || !val || val > drv_data->hw_fence_table_entries)
+		val = drv_data->hw_fence_table_entries;
+	drv_data->hw_fence_max_probe = val;
+
 	ret = of_property_read_u32(drv_data->dev->of_node, "qcom,hw-fence-queue-entries", &val);
 	if (ret || !val) {
 		HWFNC_ERR("missing queue entries table entry or invalid ret:%d val:%d\n", ret, val);
@@ -993,9 +1006,9 @@ int hw_fence_utils_parse_dt_props(struct hw_fence_driver_data *drv_data)
 	if (!drv_data->clients)
 		return -ENOMEM;
 
-	HWFNC_DBG_INIT("table: entries=%lu mem_size=%lu queue: entries=%lu\b",
+	HWFNC_DBG_INIT("table: entries=%lu mem_size=%lu max_probe=%lu queue: entries=%lu\b",
 		drv_data->hw_fence_table_entries, drv_data->hw_fence_mem_fences_table_size,
-		drv_data->hw_fence_queue_entries);
+		drv_data->hw_fence_max_probe, drv_data->hw_fence_queue_entries);
 	HWFNC_DBG_INIT("ctrl queue: size=%lu mem_size=%lu\b",
 		drv_data->hw_fence_ctrl_queue_size, drv_data->hw_fence_mem_ctrl_queues_size);
 	HWFNC_DBG_INIT("clients_num: %lu, total_mem_size:%lu\n", drv_data->clients_num,
@@ -27,6 +27,8 @@
 #include <linux/interconnect.h>
 #include <linux/delay.h>
 #include <linux/version.h>
+#include <linux/mm.h>
+#include <linux/ktime.h>
 
 #include <crypto/hash.h>
 #include "qcedevi.h"
@@ -56,6 +58,7 @@ enum qcedev_req_status {
 	QCEDEV_REQ_WAITING = 1,
 	QCEDEV_REQ_SUBMITTED = 2,
 	QCEDEV_REQ_DONE = 3,
+	QCEDEV_REQ_ABORTED = 4,
 };
 
 static uint8_t  _std_init_vector_sha1_uint8[] =   {
@@ -78,6 +81,8 @@ static uint8_t _std_init_vector_sha256_uint8[] = {
 static DEFINE_MUTEX(send_cmd_lock);
 static DEFINE_MUTEX(qcedev_sent_bw_req);
 static DEFINE_MUTEX(hash_access_lock);
+static DEFINE_MUTEX(handles_lock);
+static LIST_HEAD(qcedev_handles);
 
 static dev_t qcedev_device_no;
 static struct class *driver_class;
@@ -225,10 +230,13 @@ exit_unlock_mutex:
 static int qcedev_open(struct inode *inode, struct file *file);
 static int qcedev_release(struct inode *inode, struct file *file);
 static int start_cipher_req(struct qcedev_control *podev,
+			    struct qcedev_async_req *qcedev_areq,
 			    int *current_req_info);
 static int start_offload_cipher_req(struct qcedev_control *podev,
+				struct qcedev_async_req *qcedev_areq,
 				int *current_req_info);
 static int start_sha_req(struct qcedev_control *podev,
+			 struct qcedev_async_req *qcedev_areq,
 			 int *current_req_info);
 
 static const struct file_operations qcedev_fops = {
@@ -262,6 +270,16 @@ static struct dentry *_debug_dent;
 static char _debug_read_buf[DEBUG_MAX_RW_BUF];
 static int _debug_qcedev;
 
+/*
+ * Number of requests kept in flight on the CE pipes, capped by the number
+ * of requests the CE driver can track. One services a single crypto request
+ * at a time.
+ */
+static u32 _qcedev_max_inflight = 1;
+
+/* Pin user pages into the cipher scatterlist instead of bouncing vbuf data */
+static bool _qcedev_zero_copy;
+
 static struct qcedev_control *qcedev_minor_to_control(unsigned int n)
 {
 	int i;
@@ -290,12 +308,18 @@ static int qcedev_open(struct inode *inode, struct file *file)
 		return -ENOMEM;
 
 	handle->cntl = podev;
+	handle->tgid = current->tgid;
+	spin_lock_init(&handle->stats.lock);
 	file->private_data = handle;
 
 	qcedev_ce_high_bw_req(podev, true);
 
 	mutex_init(&handle->registeredbufs.lock);
 	INIT_LIST_HEAD(&handle->registeredbufs.list);
+
+	mutex_lock(&handles_lock);
+	list_add_tail(&handle->node, &qcedev_handles);
+	mutex_unlock(&handles_lock);
 	return 0;
 }
 
@@ -317,38 +341,154 @@ static int qcedev_release(struct inode *inode, struct file *file)
 	if (qcedev_unmap_all_buffers(handle))
 		pr_err("%s: failed to unmap all ion buffers\n", __func__);
 
+	mutex_lock(&handles_lock);
+	list_del(&handle->node);
+	mutex_unlock(&handles_lock);
+
 	kfree_sensitive(handle);
 	file->private_data = NULL;
 	return 0;
 }
 
+static uint32_t qcedev_max_active(struct qcedev_control *podev)
+{
+	uint32_t max_active = READ_ONCE(_qcedev_max_inflight);
+
+	if (max_active > podev->ce_support.max_request)
+		max_active = podev->ce_support.max_request;
+
+	return max_active ? max_active : 1;
+}
+
+/* must be called with podev->lock held */
+static bool qcedev_can_activate_locked(struct qcedev_control *podev)
+{
+	return !podev->timeout_recovery &&
+		podev->active_count < qcedev_max_active(podev);
+}
+
+/* must be called with podev->lock held */
+static void qcedev_wake_ready_locked(struct qcedev_control *podev)
+{
+	struct qcedev_async_req *new_req;
+
+	/*
+	 * Look through queued requests and wake up the corresponding threads,
+	 * reserving a slot on the CE pipes for each of them.
+	 */
+	while (!list_empty(&podev->ready_commands) &&
+			qcedev_can_activate_locked(podev)) {
+		new_req = list_first_entry(&podev->ready_commands,
+					struct qcedev_async_req, list);
+		list_del_init(&new_req->list);
+		podev->active_count++;
+		new_req->state = QCEDEV_REQ_CURRENT;
+		wake_up_interruptible(&new_req->wait_q);
+	}
+}
+
+/* must be called with podev->lock held */
+static void qcedev_retire_req_locked(struct qcedev_control *podev,
+				struct qcedev_async_req *areq)
+{
+	if (areq->state == QCEDEV_REQ_DONE)
+		return;
+
+	list_del_init(&areq->list);
+	podev->active_count--;
+	areq->state = QCEDEV_REQ_DONE;
+	if (!areq->timed_out)
+		complete(&areq->complete);
+
+	qcedev_wake_ready_locked(podev);
+}
+
+/*
+ * qce_manage_timeout() resets the CE pipes shared by every request in
+ * flight, so the ones submitted alongside a timed out request will never
+ * see their callback. Their CE requests are released through qce as well,
+ * which stops their DMA and makes qce drop any late notification for them,
+ * before they are failed and completed. No request is activated until the
+ * recovery is over.
+ */
+static int qcedev_manage_timeout(struct qcedev_control *podev,
+				struct qcedev_async_req *timed_out)
+{
+	struct qcedev_async_req *areq, *tmp;
+	unsigned long flags = 0;
+	LIST_HEAD(aborted);
+	int ret;
+
+	mutex_lock(&podev->timeout_lock);
+
+	spin_lock_irqsave(&podev->lock, flags);
+	if (timed_out->state != QCEDEV_REQ_SUBMITTED) {
+		/* completed, or released with another timed out request */
+		spin_unlock_irqrestore(&podev->lock, flags);
+		mutex_unlock(&podev->timeout_lock);
+		return 0;
+	}
+	podev->timeout_recovery = true;
+	list_for_each_entry_safe(areq, tmp, &podev->active_commands, list) {
+		if (areq == timed_out || areq->state != QCEDEV_REQ_SUBMITTED)
+			continue;
+		areq->state = QCEDEV_REQ_ABORTED;
+		list_move_tail(&areq->list, &aborted);
+	}
+	spin_unlock_irqrestore(&podev->lock, flags);
+
+	ret = qce_manage_timeout(podev->qce, timed_out->req_info);
+	if (ret)
+		pr_err("%s: error during manage timeout", __func__);
+
+	list_for_each_entry(areq, &aborted, list) {
+		pr_err("%s: releasing in flight req info = %d\n", __func__,
+					areq->req_info);
+		if (qce_manage_timeout(podev->qce, areq->req_info))
+			pr_err("%s: failed to release req info = %d\n",
+					__func__, areq->req_info);
+	}
+
+	spin_lock_irqsave(&podev->lock, flags);
+	podev->timeout_recovery = false;
+	qcedev_retire_req_locked(podev, timed_out);
+	list_for_each_entry_safe(areq, tmp, &aborted, list) {
+		areq->err = -EIO;
+		qcedev_retire_req_locked(podev, areq);
+	}
+	spin_unlock_irqrestore(&podev->lock, flags);
+
+	mutex_unlock(&podev->timeout_lock);
+
+	return ret;
+}
+
 static void req_done(unsigned long data)
 {
 	struct qcedev_control *podev = (struct qcedev_control *)data;
 	struct qcedev_async_req *areq;
 	unsigned long flags = 0;
-	struct qcedev_async_req *new_req = NULL;
 
 	spin_lock_irqsave(&podev->lock, flags);
-	areq = podev->active_command;
-	podev->active_command = NULL;
-
-	if (areq) {
-		areq->state = QCEDEV_REQ_DONE;
-		if (!areq->timed_out)
-			complete(&areq->complete);
+	while (!list_empty(&podev->done_commands)) {
+		areq = list_first_entry(&podev->done_commands,
+					struct qcedev_async_req, list);
+		qcedev_retire_req_locked(podev, areq);
 	}
+	spin_unlock_irqrestore(&podev->lock, flags);
+}
 
-	/* Look through queued requests and wake up the corresponding thread */
-	if (!list_empty(&podev->ready_commands)) {
-		new_req = container_of(podev->ready_commands.next,
-						struct qcedev_async_req, list);
-		list_del(&new_req->list);
-		new_req->state = QCEDEV_REQ_CURRENT;
-		wake_up_interruptible(&new_req->wait_q);
-	}
+static void qcedev_req_cb_done(struct qcedev_control *podev,
+				struct qcedev_async_req *qcedev_areq)
+{
+	unsigned long flags = 0;
 
+	spin_lock_irqsave(&podev->lock, flags);
+	if (qcedev_areq->state == QCEDEV_REQ_SUBMITTED)
+		list_move_tail(&qcedev_areq->list, &podev->done_commands);
 	spin_unlock_irqrestore(&podev->lock, flags);
+
+	tasklet_schedule(&podev->done_tasklet);
 }
 
 void qcedev_sha_req_cb(void *cookie, unsigned char *digest,
@@ -380,7 +520,8 @@ void qcedev_sha_req_cb(void *cookie, unsigned char *digest,
 		handle->sha_ctxt.auth_data[1] = auth32[1];
 	}
 
-	tasklet_schedule(&pdev->done_tasklet);
+	qcedev_req_cb_done(pdev,
+		container_of(areq, struct qcedev_async_req, sha_req));
 };
 
 
@@ -403,24 +544,22 @@ void qcedev_cipher_req_cb(void *cookie, unsigned char *icv,
 	podev = handle->cntl;
 	if (!podev)
 		return;
-	qcedev_areq = podev->active_command;
+	qcedev_areq = container_of(areq, struct qcedev_async_req, cipher_req);
 
-	if (iv && qcedev_areq)
+	if (iv)
 		memcpy(&qcedev_areq->cipher_op_req.iv[0], iv,
 					qcedev_areq->cipher_op_req.ivlen);
-	tasklet_schedule(&podev->done_tasklet);
+	qcedev_req_cb_done(podev, qcedev_areq);
 };
 
 static int start_cipher_req(struct qcedev_control *podev,
+			    struct qcedev_async_req *qcedev_areq,
 			    int *current_req_info)
 {
-	struct qcedev_async_req *qcedev_areq;
 	struct qce_req creq;
 	int ret = 0;
 
 	memset(&creq, 0, sizeof(creq));
-	/* start the command on the podev->active_command */
-	qcedev_areq = podev->active_command;
 	qcedev_areq->cipher_req.cookie = qcedev_areq->handle;
 	if (qcedev_areq->cipher_op_req.use_pmem == QCEDEV_USE_PMEM) {
 		pr_err("%s: Use of PMEM is not supported\n", __func__);
@@ -531,26 +670,24 @@ void qcedev_offload_cipher_req_cb(void *cookie, unsigned char *icv,
 	podev = handle->cntl;
 	if (!podev)
 		return;
-	qcedev_areq = podev->active_command;
+	qcedev_areq = container_of(areq, struct qcedev_async_req, cipher_req);
 
-	if (iv && qcedev_areq)
+	if (iv)
 		memcpy(&qcedev_areq->offload_cipher_op_req.iv[0], iv,
 			qcedev_areq->offload_cipher_op_req.ivlen);
 
-	tasklet_schedule(&podev->done_tasklet);
+	qcedev_req_cb_done(podev, qcedev_areq);
 }
 
 static int start_offload_cipher_req(struct qcedev_control *podev,
+				struct qcedev_async_req *qcedev_areq,
 				int *current_req_info)
 {
-	struct qcedev_async_req *qcedev_areq;
 	struct qce_req creq;
 	u8 patt_sz = 0, proc_data_sz = 0;
 	int ret = 0;
 
 	memset(&creq, 0, sizeof(creq));
-	/* Start the command on the podev->active_command */
-	qcedev_areq = podev->active_command;
 	qcedev_areq->cipher_req.cookie = qcedev_areq->handle;
 
 	switch (qcedev_areq->offload_cipher_op_req.alg) {
@@ -633,15 +770,13 @@ static int start_offload_cipher_req(struct qcedev_control *podev,
 }
 
 static int start_sha_req(struct qcedev_control *podev,
+			 struct qcedev_async_req *qcedev_areq,
 			 int *current_req_info)
 {
-	struct qcedev_async_req *qcedev_areq;
 	struct qce_sha_req sreq;
 	int ret = 0;
 	struct qcedev_handle *handle;
 
-	/* start the command on the podev->active_command */
-	qcedev_areq = podev->active_command;
 	handle = qcedev_areq->handle;
 
 	switch (qcedev_areq->sha_op_req.alg) {
@@ -732,6 +867,38 @@ static void qcedev_check_crypto_status(
 
 #define MAX_RETRIES	333
 
+static void qcedev_update_handle_stats(struct qcedev_async_req *qcedev_areq,
+					struct qcedev_handle *handle)
+{
+	struct qcedev_handle_stats *stats = &handle->stats;
+	unsigned long flags = 0;
+	uint64_t bytes, delta;
+
+	switch (qcedev_areq->op_type) {
+	case QCEDEV_CRYPTO_OPER_CIPHER:
+		bytes = qcedev_areq->cipher_req.creq.cryptlen;
+		break;
+	case QCEDEV_CRYPTO_OPER_OFFLOAD_CIPHER:
+		bytes = qcedev_areq->offload_cipher_op_req.data_len;
+		break;
+	default:
+		bytes = qcedev_areq->sha_req.sreq.nbytes;
+		break;
+	}
+	delta = ktime_to_ns(ktime_sub(ktime_get(), qcedev_areq->submit_time));
+
+	spin_lock_irqsave(&stats->lock, flags);
+	stats->requests++;
+	if (qcedev_areq->err)
+		stats->failures++;
+	else
+		stats->bytes += bytes;
+	stats->total_ns += delta;
+	if (delta > stats->max_ns)
+		stats->max_ns = delta;
+	spin_unlock_irqrestore(&stats->lock, flags);
+}
+
 static int submit_req(struct qcedev_async_req *qcedev_areq,
 					struct qcedev_handle *handle)
 {
@@ -741,7 +908,6 @@ static int submit_req(struct qcedev_async_req *qcedev_areq,
 	struct qcedev_stat *pstat;
 	int current_req_info = 0;
 	int wait = MAX_CRYPTO_WAIT_TIME;
-	struct qcedev_async_req *new_req = NULL;
 	int retries = 0;
 	int req_wait = MAX_REQUEST_TIME;
 	unsigned int crypto_wait = 0;
@@ -749,75 +915,71 @@ static int submit_req(struct qcedev_async_req *qcedev_areq,
 	qcedev_areq->err = 0;
 	podev = handle->cntl;
 	init_waitqueue_head(&qcedev_areq->wait_q);
+	INIT_LIST_HEAD(&qcedev_areq->list);
 
 	spin_lock_irqsave(&podev->lock, flags);
 
 	/*
-	 * Service only one crypto request at a time.
-	 * Any other new requests are queued in ready_commands and woken up
-	 * only when the active command has finished successfully or when the
-	 * request times out or when the command failed when setting up.
+	 * Keep up to qcedev_max_active() crypto requests in flight on the CE
+	 * pipes. Any other new requests are queued in ready_commands and woken
+	 * up, with their slot already reserved, when an active command has
+	 * finished successfully or when the request times out or when the
+	 * command failed when setting up.
 	 */
-	do {
-		if (podev->active_command == NULL) {
-			podev->active_command = qcedev_areq;
-			qcedev_areq->state = QCEDEV_REQ_SUBMITTED;
-			switch (qcedev_areq->op_type) {
-			case QCEDEV_CRYPTO_OPER_CIPHER:
-				ret = start_cipher_req(podev,
-						&current_req_info);
-				crypto_wait = MAX_CRYPTO_WAIT_TIME;
-				break;
-			case QCEDEV_CRYPTO_OPER_OFFLOAD_CIPHER:
-				ret = start_offload_cipher_req(podev,
-						&current_req_info);
-				crypto_wait = MAX_OFFLOAD_CRYPTO_WAIT_TIME;
-				break;
-			default:
-				crypto_wait = MAX_CRYPTO_WAIT_TIME;
-
-				ret = start_sha_req(podev,
-						&current_req_info);
-				break;
-			}
-		} else {
-			list_add_tail(&qcedev_areq->list,
-					&podev->ready_commands);
-			qcedev_areq->state = QCEDEV_REQ_WAITING;
-			req_wait = wait_event_interruptible_lock_irq_timeout(
-				qcedev_areq->wait_q,
-				(qcedev_areq->state == QCEDEV_REQ_CURRENT),
-				podev->lock,
-				msecs_to_jiffies(MAX_REQUEST_TIME));
-			if ((req_wait == 0) || (req_wait == -ERESTARTSYS)) {
-				pr_err("%s: request timed out, req_wait = %d\n",
-						__func__, req_wait);
-				list_del(&qcedev_areq->list);
-				podev->active_command = NULL;
-				spin_unlock_irqrestore(&podev->lock, flags);
-				return qcedev_areq->err;
-			}
-		}
-	} while (qcedev_areq->state != QCEDEV_REQ_SUBMITTED);
+	if (list_empty(&podev->ready_commands) &&
+			qcedev_can_activate_locked(podev)) {
+		podev->active_count++;
+	} else {
+		list_add_tail(&qcedev_areq->list, &podev->ready_commands);
+		qcedev_areq->state = QCEDEV_REQ_WAITING;
+		req_wait = wait_event_interruptible_lock_irq_timeout(
+			qcedev_areq->wait_q,
+			(qcedev_areq->state == QCEDEV_REQ_CURRENT),
+			podev->lock,
+			msecs_to_jiffies(MAX_REQUEST_TIME));
+		if (qcedev_areq->state != QCEDEV_REQ_CURRENT) {
+			pr_err("%s: request timed out, req_wait = %d\n",
+					__func__, req_wait);
+			list_del_init(&qcedev_areq->list);
+			spin_unlock_irqrestore(&podev->lock, flags);
+			return qcedev_areq->err;
+		}
+	}
+
+	list_add_tail(&qcedev_areq->list, &podev->active_commands);
+	qcedev_areq->state = QCEDEV_REQ_SUBMITTED;
+	qcedev_areq->timed_out = false;
+	qcedev_areq->submit_time = ktime_get();
+	switch (qcedev_areq->op_type) {
+	case QCEDEV_CRYPTO_OPER_CIPHER:
+		ret = start_cipher_req(podev, qcedev_areq,
+				&current_req_info);
+		crypto_wait = MAX_CRYPTO_WAIT_TIME;
+		break;
+	case QCEDEV_CRYPTO_OPER_OFFLOAD_CIPHER:
+		ret = start_offload_cipher_req(podev, qcedev_areq,
+				&current_req_info);
+		crypto_wait = MAX_OFFLOAD_CRYPTO_WAIT_TIME;
+		break;
+	default:
+		crypto_wait = MAX_CRYPTO_WAIT_TIME;
+
+		ret = start_sha_req(podev, qcedev_areq,
+				&current_req_info);
+		break;
+	}
+	qcedev_areq->req_info = current_req_info;
 
 	if (ret != 0) {
-		podev->active_command = NULL;
-		/*
-		 * Look through queued requests and wake up the corresponding
-		 * thread.
-		 */
-		if (!list_empty(&podev->ready_commands)) {
-			new_req = container_of(podev->ready_commands.next,
-						struct qcedev_async_req, list);
-			list_del(&new_req->list);
-			new_req->state = QCEDEV_REQ_CURRENT;
-			wake_up_interruptible(&new_req->wait_q);
-		}
+		/* release the slot and wake up the next queued request */
+		list_del_init(&qcedev_areq->list);
+		podev->active_count--;
+		qcedev_areq->state = QCEDEV_REQ_DONE;
+		qcedev_wake_ready_locked(podev);
 	}
 
 	spin_unlock_irqrestore(&podev->lock, flags);
 
-	qcedev_areq->timed_out = false;
 	if (ret == 0)
 		wait = wait_for_completion_timeout(&qcedev_areq->complete,
 				msecs_to_jiffies(crypto_wait));
@@ -847,11 +1009,7 @@ static int submit_req(struct qcedev_async_req *qcedev_areq,
 			}
 			return 0;
 		}
-		ret = qce_manage_timeout(podev->qce, current_req_info);
-		if (ret)
-			pr_err("%s: error during manage timeout", __func__);
-
-		req_done((unsigned long) podev);
+		ret = qcedev_manage_timeout(podev, qcedev_areq);
 		if (qcedev_areq->offload_cipher_op_req.err !=
 						QCEDEV_OFFLOAD_NO_ERROR)
 			return 0;
@@ -860,6 +1018,8 @@ static int submit_req(struct qcedev_async_req *qcedev_areq,
 	if (ret)
 		qcedev_areq->err = -EIO;
 
+	qcedev_update_handle_stats(qcedev_areq, handle);
+
 	pstat = &_qcedev_stat;
 	if (qcedev_areq->op_type == QCEDEV_CRYPTO_OPER_CIPHER) {
 		switch (qcedev_areq->cipher_op_req.op) {
@@ -1548,6 +1708,153 @@ exit:
 	return err;
 };
 
+struct qcedev_user_sg {
+	struct page **pages;
+	unsigned int nr_pages;
+	struct scatterlist *sg;
+};
+
+static void qcedev_unpin_user_bufs(struct qcedev_user_sg *usg, bool dirty)
+{
+	if (usg->nr_pages)
+		unpin_user_pages_dirty_lock(usg->pages, usg->nr_pages, dirty);
+	kfree(usg->pages);
+	kfree(usg->sg);
+	memset(usg, 0, sizeof(*usg));
+}
+
+static int qcedev_pin_user_bufs(struct buf_info *bufs, uint32_t entries,
+				bool write, struct qcedev_user_sg *usg)
+{
+	unsigned int i, j, n, total_pages = 0, sg_idx = 0;
+	uintptr_t uaddr;
+	uint32_t len, off, seg;
+	int pinned;
+
+	for (i = 0; i < entries; i++) {
+		if (!bufs[i].len)
+			continue;
+		uaddr = (uintptr_t)bufs[i].vaddr;
+		total_pages += DIV_ROUND_UP(offset_in_page(uaddr) + bufs[i].len,
+					PAGE_SIZE);
+	}
+	if (!total_pages)
+		return -EINVAL;
+
+	usg->pages = kcalloc(total_pages, sizeof(*usg->pages), GFP_KERNEL);
+	usg->sg = kcalloc(total_pages, sizeof(*usg->sg), GFP_KERNEL);
+	if (!usg->pages || !usg->sg) {
+		qcedev_unpin_user_bufs(usg, false);
+		return -ENOMEM;
+	}
+	sg_init_table(usg->sg, total_pages);
+
+	for (i = 0; i < entries; i++) {
+		if (!bufs[i].len)
+			continue;
+		uaddr = (uintptr_t)bufs[i].vaddr;
+		len = bufs[i].len;
+		n = DIV_ROUND_UP(offset_in_page(uaddr) + len, PAGE_SIZE);
+
+		pinned = pin_user_pages_fast(uaddr & PAGE_MASK, n,
+				write ? FOLL_WRITE : 0,
+				usg->pages + usg->nr_pages);
+		if (pinned > 0)
+			usg->nr_pages += pinned;
+		if (pinned != n) {
+			pr_err("%s: failed to pin user buffer %d, pinned %d of %u\n",
+				__func__, i, pinned, n);
+			qcedev_unpin_user_bufs(usg, false);
+			return -EFAULT;
+		}
+
+		for (j = 0; j < n; j++) {
+			off = offset_in_page(uaddr);
+			seg = min_t(uint32_t, PAGE_SIZE - off, len);
+			sg_set_page(&usg->sg[sg_idx++],
+				usg->pages[usg->nr_pages - n + j], seg, off);
+			uaddr += seg;
+			len -= seg;
+		}
+	}
+	sg_mark_end(&usg->sg[sg_idx - 1]);
+
+	return 0;
+}
+
+static bool qcedev_vbuf_can_zero_copy(struct qcedev_async_req *areq,
+				struct qcedev_handle *handle)
+{
+	struct qcedev_cipher_op_req *creq = &areq->cipher_op_req;
+
+	if (!READ_ONCE(_qcedev_zero_copy) || handle->cntl->ce_support.aligned_only)
+		return false;
+
+	if (creq->byteoffset || creq->data_len > QCE_MAX_OPER_DATA)
+		return false;
+
+	/*
+	 * CBC chaining reads the IV back from the virtual address of a single
+	 * source segment, so only modes carrying the IV in the request can
+	 * use a scatterlist of pinned user pages.
+	 */
+	switch (creq->mode) {
+	case QCEDEV_AES_MODE_ECB:
+	case QCEDEV_DES_MODE_ECB:
+	case QCEDEV_AES_MODE_CTR:
+	case QCEDEV_AES_MODE_XTS:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static int qcedev_vbuf_ablk_cipher_zero_copy(struct qcedev_async_req *areq,
+				struct qcedev_handle *handle)
+{
+	struct qcedev_cipher_op_req *creq = &areq->cipher_op_req;
+	struct qcedev_user_sg src = {0}, dst = {0};
+	unsigned long flags = 0;
+	bool in_place;
+	int err;
+
+	in_place = !memcmp(creq->vbuf.src, creq->vbuf.dst,
+			creq->entries * sizeof(struct buf_info));
+
+	err = qcedev_pin_user_bufs(creq->vbuf.src, creq->entries, in_place,
+				&src);
+	if (err)
+		return err;
+
+	if (!in_place) {
+		err = qcedev_pin_user_bufs(creq->vbuf.dst, creq->entries, true,
+					&dst);
+		if (err)
+			goto unpin_src;
+	}
+
+	areq->cipher_req.creq.src = src.sg;
+	areq->cipher_req.creq.dst = in_place ? src.sg : dst.sg;
+	areq->cipher_req.creq.cryptlen = creq->data_len;
+	areq->cipher_req.creq.iv = creq->iv;
+
+	err = submit_req(areq, handle);
+	if (!err) {
+		spin_lock_irqsave(&handle->stats.lock, flags);
+		handle->stats.zero_copy_requests++;
+		spin_unlock_irqrestore(&handle->stats.lock, flags);
+	}
+
+	areq->cipher_req.creq.src = NULL;
+	areq->cipher_req.creq.dst = NULL;
+
+	if (!in_place)
+		qcedev_unpin_user_bufs(&dst, true);
+unpin_src:
+	qcedev_unpin_user_bufs(&src, in_place);
+	return err;
+}
+
 static int qcedev_vbuf_ablk_cipher(struct qcedev_async_req *areq,
 						struct qcedev_handle *handle)
 {
@@ -1568,6 +1875,9 @@ static int qcedev_vbuf_ablk_cipher(struct qcedev_async_req *areq,
 	uint32_t req_size = 0;
 	struct	qcedev_cipher_op_req *creq = &areq->cipher_op_req;
 
+	if (qcedev_vbuf_can_zero_copy(areq, handle))
+		return qcedev_vbuf_ablk_cipher_zero_copy(areq, handle);
+
 	total = 0;
 
 	if (areq->cipher_op_req.mode == QCEDEV_AES_MODE_CTR)
@@ -2559,11 +2869,15 @@ static int qcedev_probe_device(struct platform_device *pdev)
 
 	podev->high_bw_req_count = 0;
 	INIT_LIST_HEAD(&podev->ready_commands);
-	podev->active_command = NULL;
+	INIT_LIST_HEAD(&podev->active_commands);
+	INIT_LIST_HEAD(&podev->done_commands);
+	podev->active_count = 0;
 
 	INIT_LIST_HEAD(&podev->context_banks);
 
 	spin_lock_init(&podev->lock);
+	mutex_init(&podev->timeout_lock);
+	podev->timeout_recovery = false;
 
 	tasklet_init(&podev->done_tasklet, req_done, (unsigned long)podev);
 
@@ -2847,6 +3161,55 @@ static const struct file_operations _debug_stats_ops = {
 	.write =        _debug_stats_write,
 };
 
+static ssize_t _debug_handle_stats_read(struct file *file, char __user *buf,
+			size_t count, loff_t *ppos)
+{
+	struct qcedev_handle *handle;
+	u64 requests, failures, zero_copy_requests, bytes, total_ns, max_ns;
+	unsigned long flags = 0;
+	size_t max_size = SZ_4K;
+	char *dbuf;
+	int len = 0;
+	ssize_t rc;
+
+	dbuf = kzalloc(max_size, GFP_KERNEL);
+	if (!dbuf)
+		return -ENOMEM;
+
+	len += scnprintf(dbuf + len, max_size - len,
+			"max_inflight: %u zero_copy: %d\n",
+			_qcedev_max_inflight, _qcedev_zero_copy);
+
+	mutex_lock(&handles_lock);
+	list_for_each_entry(handle, &qcedev_handles, node) {
+		spin_lock_irqsave(&handle->stats.lock, flags);
+		requests = handle->stats.requests;
+		failures = handle->stats.failures;
+		zero_copy_requests = handle->stats.zero_copy_requests;
+		bytes = handle->stats.bytes;
+		total_ns = handle->stats.total_ns;
+		max_ns = handle->stats.max_ns;
+		spin_unlock_irqrestore(&handle->stats.lock, flags);
+
+		len += scnprintf(dbuf + len, max_size - len,
+			"tgid %d: reqs %llu fail %llu zero_copy %llu bytes %llu avg_us %llu max_us %llu\n",
+			handle->tgid, requests, failures, zero_copy_requests, bytes,
+			requests ? div64_u64(total_ns, requests * NSEC_PER_USEC) : 0,
+			div64_u64(max_ns, NSEC_PER_USEC));
+	}
+	mutex_unlock(&handles_lock);
+
+	rc = simple_read_from_buffer((void __user *) buf, count, ppos,
+			(void *) dbuf, len);
+	kfree(dbuf);
+	return rc;
+}
+
+static const struct file_operations _debug_handle_stats_ops = {
+	.open =         simple_open,
+	.read =         _debug_handle_stats_read,
+};
+
 static int _qcedev_debug_init(void)
 {
 	int rc;
@@ -2870,6 +3233,13 @@ static int _qcedev_debug_init(void)
 		rc = PTR_ERR(dent);
 		goto err;
 	}
+
+	debugfs_create_file("handle_stats", 0444, _debug_dent, NULL,
+			&_debug_handle_stats_ops);
+	debugfs_create_u32("max_inflight", 0644, _debug_dent,
+			&_qcedev_max_inflight);
+	debugfs_create_bool("zero_copy", 0644, _debug_dent,
+			&_qcedev_zero_copy);
 	return 0;
 err:
 	debugfs_remove_recursive(_debug_dent);
@@ -11,6 +11,7 @@
 
 #include <linux/interrupt.h>
 #include <linux/cdev.h>
+#include <linux/mutex.h>
 #include <crypto/hash.h>
 #include "qcom_crypto_device.h"
 #include "fips_status.h"
@@ -70,6 +71,8 @@ struct qcedev_async_req {
 	wait_queue_head_t			wait_q;
 	uint16_t				state;
 	bool					timed_out;
+	ktime_t					submit_time;
+	int					req_info;
 };
 
 /**********************************************************************
@@ -110,14 +113,32 @@ struct qcedev_control {
 
 	unsigned int magic;
 
+	/* requests waiting for a free slot on the CE pipes */
 	struct list_head ready_commands;
-	struct qcedev_async_req *active_command;
+	/* requests submitted to the CE and not yet completed */
+	struct list_head active_commands;
+	/* requests completed by the CE, retired by done_tasklet */
+	struct list_head done_commands;
+	uint32_t active_count;
 	spinlock_t lock;
+	/* serializes timeout recovery, no request is activated while set */
+	struct mutex timeout_lock;
+	bool timeout_recovery;
 	struct tasklet_struct done_tasklet;
 	struct list_head context_banks;
 	struct qcedev_mem_client *mem_client;
 };
 
+struct qcedev_handle_stats {
+	spinlock_t lock;
+	uint64_t requests;
+	uint64_t failures;
+	uint64_t zero_copy_requests;
+	uint64_t bytes;
+	uint64_t total_ns;
+	uint64_t max_ns;
+};
+
 struct qcedev_handle {
 	/* qcedev control handle */
 	struct qcedev_control *cntl;
@@ -125,6 +146,12 @@ struct qcedev_handle {
 	struct qcedev_sha_ctxt sha_ctxt;
 	/* qcedev mapped buffer list */
 	struct qcedev_buffer_list registeredbufs;
+	/* process that opened the handle */
+	pid_t tgid;
+	/* throughput and latency of the requests on this handle */
+	struct qcedev_handle_stats stats;
+	/* node in the list of open handles */
+	struct list_head node;
 };
 
 void qcedev_cipher_req_cb(void *cookie, unsigned char *icv,
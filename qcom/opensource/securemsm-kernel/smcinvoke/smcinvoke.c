@@ -15,6 +15,9 @@
 #include <linux/fs.h>
 #include <linux/anon_inodes.h>
 #include <linux/hashtable.h>
+#include <linux/idr.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
 #include <linux/cdev.h>
 #include <linux/uaccess.h>
 #include <linux/dma-buf.h>
@@ -194,9 +197,14 @@ enum worker_thread_type {
 };
 
 static DEFINE_HASHTABLE(g_cb_servers, 8);
-static LIST_HEAD(g_mem_objs);
+/*
+ * Memory objects indexed by the objid part of their MEM_RGN and MEM_MAP
+ * tzhandles. Both are protected by g_smcinvoke_lock, which also guards the
+ * kref lifetime of the objects they point at.
+ */
+static DEFINE_IDR(g_mem_rgn_idr);
+static DEFINE_IDR(g_mem_map_idr);
 static uint16_t g_last_cb_server_id = CBOBJ_SERVER_ID_START;
-static uint16_t g_last_mem_rgn_id, g_last_mem_map_obj_id;
 static size_t g_max_cb_buf_size = SMCINVOKE_TZ_MIN_BUF_SIZE;
 static unsigned int cb_reqs_inflight;
 static bool legacy_smc_call;
@@ -309,7 +317,9 @@ struct smcinvoke_cb_txn {
 	size_t cb_req_bytes;
 	struct file **filp_to_release;
 	struct hlist_node hash;
+	struct list_head list;
 	struct kref ref_cnt;
+	ktime_t placed_time;
 };
 
 struct smcinvoke_server_info {
@@ -320,7 +330,8 @@ struct smcinvoke_server_info {
 	wait_queue_head_t req_wait_q;
 	wait_queue_head_t rsp_wait_q;
 	size_t cb_buf_size;
-	DECLARE_HASHTABLE(reqs_table, 4);
+	/* placed requests, served by accept threads in arrival order */
+	struct list_head reqs_list;
 	DECLARE_HASHTABLE(responses_table, 4);
 	struct hlist_node hash;
 	struct list_head pending_cbobjs;
@@ -350,7 +361,6 @@ struct smcinvoke_mem_obj {
 	struct kref mem_map_obj_ref_cnt;
 	uint64_t p_addr;
 	size_t p_addr_len;
-	struct list_head list;
 	uint64_t shmbridge_handle;
 	struct smcinvoke_server_info *server;
 	int32_t mem_obj_user_fd;
@@ -359,6 +369,28 @@ struct smcinvoke_mem_obj {
 static LIST_HEAD(g_bridge_postprocess);
 DEFINE_MUTEX(bridge_postprocess_lock);
 
+#define SMCINVOKE_LAT_HIST_BUCKETS	16
+
+/*
+ * Latency summary for one kind of transaction. Bucket i counts samples in
+ * [2^(i-1), 2^i) microseconds, the last bucket collects everything slower.
+ */
+struct smcinvoke_lat_stats {
+	spinlock_t lock;
+	u64 count;
+	u64 total_us;
+	u64 max_us;
+	u64 hist[SMCINVOKE_LAT_HIST_BUCKETS];
+};
+
+static struct smcinvoke_lat_stats g_invoke_lat = {
+	.lock = __SPIN_LOCK_UNLOCKED(g_invoke_lat.lock),
+};
+static struct smcinvoke_lat_stats g_cb_lat = {
+	.lock = __SPIN_LOCK_UNLOCKED(g_cb_lat.lock),
+};
+static struct dentry *g_smcinvoke_debugfs;
+
 static LIST_HEAD(g_object_postprocess);
 DEFINE_MUTEX(object_postprocess_lock);
 
@@ -473,42 +505,60 @@ static inline void release_filp(struct file **filp_to_release, size_t arr_len)
 static struct smcinvoke_mem_obj *find_mem_obj_locked(uint16_t mem_obj_id,
 							bool is_mem_rgn_obj)
 {
-	struct smcinvoke_mem_obj *mem_obj = NULL;
+	return idr_find(is_mem_rgn_obj ? &g_mem_rgn_idr : &g_mem_map_idr,
+			mem_obj_id);
+}
 
-	if (list_empty(&g_mem_objs))
-		return NULL;
+/*
+ * Ids are handed out cyclically in [1, MAX_LOCAL_OBJ_ID] so that a freshly
+ * released id is not immediately reused for a different object.
+ */
+static int alloc_mem_region_obj_id_locked(struct smcinvoke_mem_obj *mem_obj)
+{
+	int id = idr_alloc_cyclic(&g_mem_rgn_idr, mem_obj, 1,
+			MAX_LOCAL_OBJ_ID + 1, GFP_KERNEL);
 
-	list_for_each_entry(mem_obj, &g_mem_objs, list) {
-		if ((is_mem_rgn_obj &&
-				(mem_obj->mem_region_id == mem_obj_id)) ||
-				(!is_mem_rgn_obj &&
-				(mem_obj->mem_map_obj_id == mem_obj_id)))
-				return mem_obj;
-	}
-	return NULL;
+	if (id < 0)
+		return id;
+
+	mem_obj->mem_region_id = id;
+	return 0;
 }
 
-static uint32_t next_mem_region_obj_id_locked(void)
+static int alloc_mem_map_obj_id_locked(struct smcinvoke_mem_obj *mem_obj)
 {
-	if (g_last_mem_rgn_id == MAX_LOCAL_OBJ_ID)
-		g_last_mem_rgn_id = 0;
+	int id = idr_alloc_cyclic(&g_mem_map_idr, mem_obj, 1,
+			MAX_LOCAL_OBJ_ID + 1, GFP_KERNEL);
 
-	while (find_mem_obj_locked(++g_last_mem_rgn_id, SMCINVOKE_MEM_RGN_OBJ))
-		;
+	if (id < 0)
+		return id;
 
-	return g_last_mem_rgn_id;
+	mem_obj->mem_map_obj_id = id;
+	return 0;
 }
 
-static uint32_t next_mem_map_obj_id_locked(void)
+static void remove_mem_map_obj_id_locked(struct smcinvoke_mem_obj *mem_obj)
 {
-	if (g_last_mem_map_obj_id == MAX_LOCAL_OBJ_ID)
-		g_last_mem_map_obj_id = 0;
+	if (mem_obj->mem_map_obj_id &&
+		idr_find(&g_mem_map_idr, mem_obj->mem_map_obj_id) == mem_obj)
+		idr_remove(&g_mem_map_idr, mem_obj->mem_map_obj_id);
+}
 
-	while (find_mem_obj_locked(++g_last_mem_map_obj_id,
-			SMCINVOKE_MEM_MAP_OBJ))
-		;
+static void smcinvoke_update_lat_stats(struct smcinvoke_lat_stats *stats,
+		ktime_t start)
+{
+	u64 lat_us = ktime_to_us(ktime_sub(ktime_get(), start));
+	unsigned int bucket = min_t(unsigned int, fls64(lat_us),
+			SMCINVOKE_LAT_HIST_BUCKETS - 1);
+	unsigned long flags;
 
-	return g_last_mem_map_obj_id;
+	spin_lock_irqsave(&stats->lock, flags);
+	stats->count++;
+	stats->total_us += lat_us;
+	if (lat_us > stats->max_us)
+		stats->max_us = lat_us;
+	stats->hist[bucket]++;
+	spin_unlock_irqrestore(&stats->lock, flags);
 }
 
 static void smcinvoke_shmbridge_post_process(void)
@@ -827,7 +877,8 @@ static inline void free_mem_obj_locked(struct smcinvoke_mem_obj *mem_obj)
 	uint64_t shmbridge_handle = mem_obj->shmbridge_handle;
 	struct smcinvoke_shmbridge_deregister_pending_list *entry = NULL;
 
-	list_del(&mem_obj->list);
+	idr_remove(&g_mem_rgn_idr, mem_obj->mem_region_id);
+	remove_mem_map_obj_id_locked(mem_obj);
 	kfree(mem_obj->server);
 	kfree(mem_obj);
 	mem_obj = NULL;
@@ -880,6 +931,7 @@ static void del_mem_map_obj_locked(struct kref *kref)
 	struct smcinvoke_mem_obj *mem_obj = container_of(kref,
 			struct smcinvoke_mem_obj, mem_map_obj_ref_cnt);
 
+	remove_mem_map_obj_id_locked(mem_obj);
 	mem_obj->p_addr_len = 0;
 	mem_obj->p_addr = 0;
 	if (mem_obj->sgt)
@@ -1025,6 +1077,7 @@ static void delete_cb_txn_locked(struct kref *kref)
 
 	kfree(cb_txn->cb_req);
 	hash_del(&cb_txn->hash);
+	list_del_init(&cb_txn->list);
 	kfree(cb_txn);
 }
 
@@ -1032,20 +1085,17 @@ static struct smcinvoke_cb_txn *find_cbtxn_locked(
 		struct smcinvoke_server_info *server,
 		uint32_t txn_id, int32_t state)
 {
-	int i = 0;
 	struct smcinvoke_cb_txn *cb_txn = NULL;
 
-	/*
-	 * Since HASH_BITS() does not work on pointers, we can't select hash
-	 * table using state and loop over it.
-	 */
 	if (state == SMCINVOKE_REQ_PLACED) {
-		/* pick up 1st req */
-		hash_for_each(server->reqs_table, i, cb_txn, hash) {
+		/* pick up oldest req */
+		cb_txn = list_first_entry_or_null(&server->reqs_list,
+				struct smcinvoke_cb_txn, list);
+		if (cb_txn) {
 			kref_get(&cb_txn->ref_cnt);
-			hash_del(&cb_txn->hash);
-			return cb_txn;
+			list_del_init(&cb_txn->list);
 		}
+		return cb_txn;
 	} else if (state == SMCINVOKE_REQ_PROCESSING) {
 		hash_for_each_possible(
 				server->responses_table, cb_txn, hash, txn_id) {
@@ -1248,7 +1298,11 @@ static int32_t smcinvoke_map_mem_region_locked(struct smcinvoke_mem_obj* mem_obj
 			return OBJECT_ERROR_BADOBJ;
 		}
 
-		mem_obj->mem_map_obj_id = next_mem_map_obj_id_locked();
+		if (alloc_mem_map_obj_id_locked(mem_obj)) {
+			ret = OBJECT_ERROR_KMEM;
+			pr_err("Unable to allocate mem map obj id\n");
+			goto out;
+		}
 	}
 
 out:
@@ -1276,12 +1330,18 @@ static int create_mem_obj(struct dma_buf *dma_buf, int32_t *tzhandle,
 	}
 	kref_init(&t_mem_obj->mem_regn_ref_cnt);
 	t_mem_obj->dma_buf = dma_buf;
-	mutex_lock(&g_smcinvoke_lock);
-	t_mem_obj->mem_region_id = next_mem_region_obj_id_locked();
 	server_i->server_id = server_id;
 	t_mem_obj->server = server_i;
 	t_mem_obj->mem_obj_user_fd = user_handle;
-	list_add_tail(&t_mem_obj->list, &g_mem_objs);
+	mutex_lock(&g_smcinvoke_lock);
+	if (alloc_mem_region_obj_id_locked(t_mem_obj)) {
+		mutex_unlock(&g_smcinvoke_lock);
+		pr_err("Unable to allocate mem region obj id\n");
+		kfree(server_i);
+		kfree(t_mem_obj);
+		dma_buf_put(dma_buf);
+		return -ENOMEM;
+	}
 	mutex_unlock(&g_smcinvoke_lock);
 	*mem_obj = t_mem_obj;
 	*tzhandle = TZHANDLE_MAKE_LOCAL(MEM_RGN_SRVR_ID,
@@ -1671,6 +1731,7 @@ static void process_tzcb_req(void *buf, size_t buf_len, struct file **arr_filp)
 		kfree(tmp_cb_req);
 		return;
 	}
+	INIT_LIST_HEAD(&cb_txn->list);
 	/* no need for memcpy as we did kmemdup() above */
 	cb_req = tmp_cb_req;
 
@@ -1711,7 +1772,8 @@ static void process_tzcb_req(void *buf, size_t buf_len, struct file **arr_filp)
 	}
 
 	cb_txn->txn_id = ++srvr_info->txn_id;
-	hash_add(srvr_info->reqs_table, &cb_txn->hash, cb_txn->txn_id);
+	cb_txn->placed_time = ktime_get();
+	list_add_tail(&cb_txn->list, &srvr_info->reqs_list);
 	mutex_unlock(&g_smcinvoke_lock);
 
 	trace_process_tzcb_req_wait(cb_req->hdr.tzhandle, cbobj_retries, cb_txn->txn_id,
@@ -1778,6 +1840,7 @@ out:
 	 */
 	mutex_lock(&g_smcinvoke_lock);
 	hash_del(&cb_txn->hash);
+	list_del_init(&cb_txn->list);
 	if (ret == 0) {
 		pr_err("CBObj timed out! No more retries\n");
 		cb_req->result = Object_ERROR_TIMEOUT;
@@ -1804,6 +1867,13 @@ out:
 	trace_process_tzcb_req_result(cb_req->result, cb_req->hdr.tzhandle, cb_req->hdr.op,
 			cb_req->hdr.counts, cb_reqs_inflight);
 
+	if (cb_txn->placed_time) {
+		trace_smcinvoke_cb_latency(cb_req->hdr.tzhandle, cb_req->hdr.op,
+				cb_req->result, ktime_to_us(ktime_sub(ktime_get(),
+				cb_txn->placed_time)));
+		smcinvoke_update_lat_stats(&g_cb_lat, cb_txn->placed_time);
+	}
+
 	memcpy(buf, cb_req, buf_len);
 
 	kref_put(&cb_txn->ref_cnt, delete_cb_txn_locked);
@@ -2561,7 +2631,7 @@ static long process_server_req(struct file *filp, unsigned int cmd,
 	init_waitqueue_head(&server_info->req_wait_q);
 	init_waitqueue_head(&server_info->rsp_wait_q);
 	server_info->cb_buf_size = server_req.cb_buf_size;
-	hash_init(server_info->reqs_table);
+	INIT_LIST_HEAD(&server_info->reqs_list);
 	hash_init(server_info->responses_table);
 	INIT_LIST_HEAD(&server_info->pending_cbobjs);
 	server_info->is_server_suspended = 0;
@@ -2683,7 +2753,7 @@ start_waiting_for_requests:
 	 */
 	do {
 		ret = wait_event_interruptible(server_info->req_wait_q,
-				!hash_empty(server_info->reqs_table));
+				!list_empty(&server_info->reqs_list));
 		if (ret) {
 			trace_process_accept_req_ret(current->pid, current->tgid, ret);
 			/*
@@ -2786,6 +2856,7 @@ static long process_invoke_req(struct file *filp, unsigned int cmd,
 	int32_t tzhandles_to_release[OBJECT_COUNTS_MAX_OO] = {0};
 	bool tz_acked = false;
 	uint32_t context_type = tzobj->context_type;
+	ktime_t start;
 
 	if (context_type == SMCINVOKE_OBJ_TYPE_TZ_OBJ &&
 			_IOC_SIZE(cmd) != sizeof(req)) {
@@ -2879,10 +2950,14 @@ static long process_invoke_req(struct file *filp, unsigned int cmd,
 		mutex_unlock(&g_smcinvoke_lock);
 	}
 
+	start = ktime_get();
 	ret = prepare_send_scm_msg(in_msg, in_shm.paddr, inmsg_size,
 			out_msg, out_shm.paddr, outmsg_size,
 			&req, args_buf, &tz_acked, context_type,
 			&in_shm, &out_shm, true);
+	trace_smcinvoke_invoke_latency(tzobj->tzhandle, req.op, req.result,
+			ktime_to_us(ktime_sub(ktime_get(), start)));
+	smcinvoke_update_lat_stats(&g_invoke_lat, start);
 
 	/*
 	 * If scm_call is success, TZ owns responsibility to release
@@ -3150,6 +3225,97 @@ static int smcinvoke_release(struct inode *nodp, struct file *filp)
 		return 0;
 }
 
+static int smcinvoke_print_lat_stats(char *buf, size_t size,
+		const char *name, struct smcinvoke_lat_stats *stats)
+{
+	struct smcinvoke_lat_stats snap;
+	unsigned long flags;
+	int len = 0, i;
+
+	spin_lock_irqsave(&stats->lock, flags);
+	snap = *stats;
+	spin_unlock_irqrestore(&stats->lock, flags);
+
+	len += scnprintf(buf + len, size - len,
+			"%s: count %llu avg_us %llu max_us %llu\n", name,
+			snap.count, snap.count ?
+				div64_u64(snap.total_us, snap.count) : 0,
+			snap.max_us);
+	for (i = 0; i < SMCINVOKE_LAT_HIST_BUCKETS; i++) {
+		if (!snap.hist[i])
+			continue;
+		if (i == SMCINVOKE_LAT_HIST_BUCKETS - 1)
+			len += scnprintf(buf + len, size - len,
+					"  >= %llu us: %llu\n",
+					1ULL << (i - 1), snap.hist[i]);
+		else
+			len += scnprintf(buf + len, size - len,
+					"  < %llu us: %llu\n",
+					1ULL << i, snap.hist[i]);
+	}
+	return len;
+}
+
+static ssize_t smcinvoke_latency_read(struct file *file, char __user *ubuf,
+		size_t count, loff_t *ppos)
+{
+	size_t size = SZ_2K;
+	char *buf;
+	int len = 0;
+	ssize_t rc;
+
+	buf = kzalloc(size, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	len += smcinvoke_print_lat_stats(buf + len, size - len, "invoke",
+			&g_invoke_lat);
+	len += smcinvoke_print_lat_stats(buf + len, size - len, "callback",
+			&g_cb_lat);
+
+	rc = simple_read_from_buffer(ubuf, count, ppos, buf, len);
+	kfree(buf);
+	return rc;
+}
+
+static void smcinvoke_reset_lat_stats(struct smcinvoke_lat_stats *stats)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&stats->lock, flags);
+	stats->count = 0;
+	stats->total_us = 0;
+	stats->max_us = 0;
+	memset(stats->hist, 0, sizeof(stats->hist));
+	spin_unlock_irqrestore(&stats->lock, flags);
+}
+
+static ssize_t smcinvoke_latency_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	smcinvoke_reset_lat_stats(&g_invoke_lat);
+	smcinvoke_reset_lat_stats(&g_cb_lat);
+	return count;
+}
+
+static const struct file_operations smcinvoke_latency_fops = {
+	.open = simple_open,
+	.read = smcinvoke_latency_read,
+	.write = smcinvoke_latency_write,
+};
+
+static void smcinvoke_debugfs_init(void)
+{
+	g_smcinvoke_debugfs = debugfs_create_dir(SMCINVOKE_DEV, NULL);
+	if (IS_ERR_OR_NULL(g_smcinvoke_debugfs)) {
+		g_smcinvoke_debugfs = NULL;
+		return;
+	}
+
+	debugfs_create_file("latency", 0600, g_smcinvoke_debugfs, NULL,
+			&smcinvoke_latency_fops);
+}
+
 static int smcinvoke_probe(struct platform_device *pdev)
 {
 	unsigned int baseminor = 0;
@@ -3215,6 +3381,7 @@ static int smcinvoke_probe(struct platform_device *pdev)
 	}
 #endif
 	__wakeup_postprocess_kthread(&smcinvoke[ADCI_WORKER_THREAD]);
+	smcinvoke_debugfs_init();
 	return 0;
 
 exit_destroy_device:
@@ -3232,6 +3399,8 @@ static int smcinvoke_remove(struct platform_device *pdev)
 {
 	int count = 1;
 
+	debugfs_remove_recursive(g_smcinvoke_debugfs);
+	g_smcinvoke_debugfs = NULL;
 	smcinvoke_destroy_kthreads();
 	cdev_del(&smcinvoke_cdev);
 	device_destroy(driver_class, smcinvoke_device_no);
@@ -484,6 +484,46 @@ TRACE_EVENT(smcinvoke_release,
 			__entry->private_data)
 );
 
+TRACE_EVENT(smcinvoke_invoke_latency,
+	TP_PROTO(uint32_t tzhandle, uint32_t op, int32_t result, uint64_t latency_us),
+	TP_ARGS(tzhandle, op, result, latency_us),
+	TP_STRUCT__entry(
+		__field(uint32_t,	tzhandle)
+		__field(uint32_t,	op)
+		__field(int32_t,	result)
+		__field(uint64_t,	latency_us)
+	),
+	TP_fast_assign(
+		__entry->tzhandle	= tzhandle;
+		__entry->op		= op;
+		__entry->result		= result;
+		__entry->latency_us	= latency_us;
+	),
+	TP_printk("tzhandle=0x%08x op=0x%02x result=%d latency_us=%llu",
+			__entry->tzhandle, __entry->op, __entry->result,
+			__entry->latency_us)
+);
+
+TRACE_EVENT(smcinvoke_cb_latency,
+	TP_PROTO(uint32_t tzhandle, uint32_t op, int32_t result, uint64_t latency_us),
+	TP_ARGS(tzhandle, op, result, latency_us),
+	TP_STRUCT__entry(
+		__field(uint32_t,	tzhandle)
+		__field(uint32_t,	op)
+		__field(int32_t,	result)
+		__field(uint64_t,	latency_us)
+	),
+	TP_fast_assign(
+		__entry->tzhandle	= tzhandle;
+		__entry->op		= op;
+		__entry->result		= result;
+		__entry->latency_us	= latency_us;
+	),
+	TP_printk("tzhandle=0x%08x op=0x%02x result=%d latency_us=%llu",
+			__entry->tzhandle, __entry->op, __entry->result,
+			__entry->latency_us)
+);
+
 #endif /* _TRACE_SMCINVOKE_H */
 /*
 * Path must be relative to location of 'define_trace.h' header in kernel
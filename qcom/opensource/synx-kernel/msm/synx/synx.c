@@ -2874,6 +2874,7 @@ static int __init synx_init(void)
 
 	mutex_init(&synx_dev->vtbl_lock);
 	mutex_init(&synx_dev->error_lock);
+	spin_lock_init(&synx_dev->cb_stats.lock);
 	INIT_LIST_HEAD(&synx_dev->error_list);
 	synx_dev->debugfs_root = synx_init_debugfs_dir(synx_dev);
 
@@ -146,6 +146,65 @@ static const struct file_operations synx_table_fops = {
 	.open = simple_open,
 };
 
+static ssize_t synx_cb_stats_read(struct file *file,
+		char *buf,
+		size_t count,
+		loff_t *ppos)
+{
+	struct synx_device *dev = file->private_data;
+	struct synx_cb_stats *stats = &dev->cb_stats;
+	u64 cb_count, total_ns, max_ns, batches, batched_cbs;
+	unsigned long flags;
+	char dbuf[256], *cur, *end;
+
+	spin_lock_irqsave(&stats->lock, flags);
+	cb_count = stats->count;
+	total_ns = stats->total_ns;
+	max_ns = stats->max_ns;
+	batches = stats->batches;
+	batched_cbs = stats->batched_cbs;
+	spin_unlock_irqrestore(&stats->lock, flags);
+
+	cur = dbuf;
+	end = cur + sizeof(dbuf);
+	SYNX_CONSOLE_LOG(cur, end, "signal to callback latency\n");
+	SYNX_CONSOLE_LOG(cur, end, "\tcallbacks : %llu\n", cb_count);
+	SYNX_CONSOLE_LOG(cur, end, "\tavg (ns)  : %llu\n",
+		cb_count ? div64_u64(total_ns, cb_count) : 0);
+	SYNX_CONSOLE_LOG(cur, end, "\tmax (ns)  : %llu\n", max_ns);
+	SYNX_CONSOLE_LOG(cur, end, "\tbatches   : %llu\n", batches);
+	SYNX_CONSOLE_LOG(cur, end, "\tbatched   : %llu\n", batched_cbs);
+
+	return simple_read_from_buffer(buf, count, ppos, dbuf, cur - dbuf);
+}
+
+static ssize_t synx_cb_stats_write(struct file *file,
+		const char __user *buf,
+		size_t count,
+		loff_t *ppos)
+{
+	struct synx_device *dev = file->private_data;
+	struct synx_cb_stats *stats = &dev->cb_stats;
+	unsigned long flags;
+
+	spin_lock_irqsave(&stats->lock, flags);
+	stats->count = 0;
+	stats->total_ns = 0;
+	stats->max_ns = 0;
+	stats->batches = 0;
+	stats->batched_cbs = 0;
+	spin_unlock_irqrestore(&stats->lock, flags);
+
+	return count;
+}
+
+static const struct file_operations synx_cb_stats_fops = {
+	.owner = THIS_MODULE,
+	.read = synx_cb_stats_read,
+	.write = synx_cb_stats_write,
+	.open = simple_open,
+};
+
 #ifdef ENABLE_DEBUGFS
 static ssize_t synx_help_read(struct file *file,
 		char *buf,
@@ -187,6 +246,12 @@ struct dentry *synx_init_debugfs_dir(struct synx_device *dev)
 		dprintk(SYNX_ERR, "Failed to create debugfs file for synx\n");
 		return NULL;
 	}
+
+	if (!debugfs_create_file("cb_latency",
+		0644, dir, dev, &synx_cb_stats_fops)) {
+		dprintk(SYNX_ERR, "Failed to create debugfs cb latency file for synx\n");
+		return NULL;
+	}
 #ifdef ENABLE_DEBUGFS
 	if (!debugfs_create_file("help",
 		0444, dir, dev, &synx_help_fops)) {
@@ -105,10 +105,25 @@ struct synx_cb_data {
 	u32 status;
 	struct timer_list synx_timer;
 	u64 timeout;
+	ktime_t signal_time;
 	struct work_struct cb_dispatch;
 	struct list_head node;
 };
 
+struct synx_cb_batch {
+	struct list_head cb_list;
+	struct work_struct cb_dispatch;
+};
+
+struct synx_cb_stats {
+	spinlock_t lock;
+	u64 count;
+	u64 total_ns;
+	u64 max_ns;
+	u64 batches;
+	u64 batched_cbs;
+};
+
 struct synx_client_cb {
 	bool is_valid;
 	u32 idx;
@@ -187,6 +202,7 @@ struct synx_client {
 	struct list_head event_q;
 	wait_queue_head_t event_wq;
 	DECLARE_BITMAP(cb_bitmap, SYNX_MAX_OBJS);
+	u32 cb_next_idx;
 	struct synx_client_cb cb_table[SYNX_MAX_OBJS];
 	DECLARE_HASHTABLE(handle_map, 8);
 	spinlock_t handle_map_lock;
@@ -206,6 +222,7 @@ struct synx_native {
 	spinlock_t csl_map_lock;
 	DECLARE_HASHTABLE(csl_fence_map, 8);
 	DECLARE_BITMAP(bitmap, SYNX_MAX_OBJS);
+	u32 next_idx;
 };
 
 struct synx_cdsp_ssr {
@@ -227,6 +244,7 @@ struct synx_device {
 	struct list_head error_list;
 	struct mutex error_lock;
 	struct synx_cdsp_ssr cdsp_ssr;
+	struct synx_cb_stats cb_stats;
 };
 
 int synx_signal_core(struct synx_coredata *synx_obj,
@@ -410,17 +410,38 @@ void synx_util_object_destroy(struct synx_coredata *synx_obj)
 	dprintk(SYNX_MEM, "released synx object %pK\n", synx_obj);
 }
 
-long synx_util_get_free_handle(unsigned long *bitmap, unsigned int size)
+long synx_util_get_free_handle(unsigned long *bitmap, unsigned int size,
+	u32 *next_idx)
 {
-	bool bit;
+	unsigned int start, origin;
+	bool wrapped = false;
 	long idx;
 
+	/*
+	 * next-fit search, resume after the last allocated index
+	 * instead of rescanning the populated prefix of the bitmap
+	 */
+	origin = READ_ONCE(*next_idx);
+	if (origin >= size)
+		origin = 0;
+	start = origin;
+
 	do {
-		idx = find_first_zero_bit(bitmap, size);
-		if (idx >= size)
+		idx = find_next_zero_bit(bitmap, size, start);
+		if (idx >= size) {
+			if (wrapped || !origin)
+				break;
+			wrapped = true;
+			start = 0;
+			continue;
+		}
+		if (!test_and_set_bit(idx, bitmap))
 			break;
-		bit = test_and_set_bit(idx, bitmap);
-	} while (bit);
+		start = idx + 1;
+	} while (true);
+
+	if (idx < size)
+		WRITE_ONCE(*next_idx, idx + 1);
 
 	return idx;
 }
@@ -466,7 +487,7 @@ int synx_alloc_local_handle(u32 *new_synx)
 	u32 idx;
 
 	idx = synx_util_get_free_handle(synx_dev->native->bitmap,
-		SYNX_MAX_OBJS);
+		SYNX_MAX_OBJS, &synx_dev->native->next_idx);
 	if (idx >= SYNX_MAX_OBJS)
 		return -SYNX_NOMEM;
 
@@ -1136,7 +1157,8 @@ int synx_util_alloc_cb_entry(struct synx_client *client,
 		IS_ERR_OR_NULL(cb_idx))
 		return -SYNX_INVALID;
 
-	idx = synx_util_get_free_handle(client->cb_bitmap, SYNX_MAX_OBJS);
+	idx = synx_util_get_free_handle(client->cb_bitmap, SYNX_MAX_OBJS,
+		&client->cb_next_idx);
 	if (idx >= SYNX_MAX_OBJS) {
 		dprintk(SYNX_ERR,
 			"[sess :%llu] free cb index not available\n",
@@ -1200,40 +1222,97 @@ void synx_util_default_user_callback(u32 h_synx,
 	}
 }
 
+static void synx_util_update_cb_stats(struct synx_cb_data *synx_cb)
+{
+	struct synx_cb_stats *stats = &synx_dev->cb_stats;
+	unsigned long flags;
+	u64 delta;
+
+	if (!synx_cb->signal_time)
+		return;
+
+	delta = ktime_to_ns(ktime_sub(ktime_get(), synx_cb->signal_time));
+	spin_lock_irqsave(&stats->lock, flags);
+	stats->count++;
+	stats->total_ns += delta;
+	if (delta > stats->max_ns)
+		stats->max_ns = delta;
+	spin_unlock_irqrestore(&stats->lock, flags);
+}
+
 void synx_util_callback_dispatch(struct synx_coredata *synx_obj, u32 status)
 {
 	struct synx_cb_data *synx_cb, *synx_cb_temp;
+	struct synx_cb_batch *batch;
+	unsigned long flags;
+	ktime_t now;
+	u32 num_cbs = 0;
 
 	if (IS_ERR_OR_NULL(synx_obj)) {
 		dprintk(SYNX_ERR, "invalid arguments\n");
 		return;
 	}
 
+	if (list_empty(&synx_obj->reg_cbs_list))
+		return;
+
+	/*
+	 * dispatch all callbacks without timer from a single work item,
+	 * fallback to one work per callback if allocation fails
+	 */
+	batch = kzalloc(sizeof(*batch), GFP_ATOMIC);
+	if (!IS_ERR_OR_NULL(batch)) {
+		INIT_LIST_HEAD(&batch->cb_list);
+		INIT_WORK(&batch->cb_dispatch, synx_util_cb_batch_dispatch);
+	}
+
+	now = ktime_get();
 	list_for_each_entry_safe(synx_cb,
 		synx_cb_temp, &synx_obj->reg_cbs_list, node) {
 		synx_cb->status = status;
+		synx_cb->signal_time = now;
 		if (synx_cb->timeout != SYNX_NO_TIMEOUT) {
 			dprintk(SYNX_VERB,
 				"Deleting timer synx_cb 0x%x, timeout 0x%llx\n",
 				synx_cb, synx_cb->timeout);
 			del_timer(&synx_cb->synx_timer);
+		} else if (!IS_ERR_OR_NULL(batch)) {
+			list_move_tail(&synx_cb->node, &batch->cb_list);
+			num_cbs++;
+			continue;
 		}
 		list_del_init(&synx_cb->node);
 		queue_work(synx_dev->wq_cb,
 			&synx_cb->cb_dispatch);
 		dprintk(SYNX_VERB, "dispatched callback\n");
 	}
+
+	if (IS_ERR_OR_NULL(batch))
+		return;
+
+	if (!num_cbs) {
+		kfree(batch);
+		return;
+	}
+
+	spin_lock_irqsave(&synx_dev->cb_stats.lock, flags);
+	synx_dev->cb_stats.batches++;
+	synx_dev->cb_stats.batched_cbs += num_cbs;
+	spin_unlock_irqrestore(&synx_dev->cb_stats.lock, flags);
+
+	queue_work(synx_dev->wq_cb, &batch->cb_dispatch);
+	dprintk(SYNX_VERB, "dispatched %u callbacks in batch\n", num_cbs);
 }
 
-void synx_util_cb_dispatch(struct work_struct *cb_dispatch)
+static void synx_util_cb_dispatch_one(struct synx_cb_data *synx_cb)
 {
-	struct synx_cb_data *synx_cb =
-		container_of(cb_dispatch, struct synx_cb_data, cb_dispatch);
 	struct synx_client *client;
 	struct synx_client_cb *cb;
 	struct synx_kernel_payload payload;
 	u32 status;
 
+	synx_util_update_cb_stats(synx_cb);
+
 	client = synx_get_client(synx_cb->session);
 	if (IS_ERR_OR_NULL(client)) {
 		dprintk(SYNX_ERR,
@@ -1292,6 +1371,29 @@ free:
 	kfree(synx_cb);
 }
 
+void synx_util_cb_dispatch(struct work_struct *cb_dispatch)
+{
+	struct synx_cb_data *synx_cb =
+		container_of(cb_dispatch, struct synx_cb_data, cb_dispatch);
+
+	synx_util_cb_dispatch_one(synx_cb);
+}
+
+void synx_util_cb_batch_dispatch(struct work_struct *cb_dispatch)
+{
+	struct synx_cb_batch *batch =
+		container_of(cb_dispatch, struct synx_cb_batch, cb_dispatch);
+	struct synx_cb_data *synx_cb, *synx_cb_temp;
+
+	list_for_each_entry_safe(synx_cb,
+		synx_cb_temp, &batch->cb_list, node) {
+		list_del_init(&synx_cb->node);
+		synx_util_cb_dispatch_one(synx_cb);
+	}
+
+	kfree(batch);
+}
+
 int synx_get_child_coredata(struct synx_coredata *synx_obj, struct synx_coredata ***child_synx_obj, int *num_fences)
 {
 	int rc = SYNX_SUCCESS;
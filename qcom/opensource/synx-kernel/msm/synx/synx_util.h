@@ -121,7 +121,8 @@ int synx_util_init_group_coredata(struct synx_coredata *synx_obj,
 /* handle related functions */
 int synx_alloc_global_handle(u32 *new_synx);
 int synx_alloc_local_handle(u32 *new_synx);
-long synx_util_get_free_handle(unsigned long *bitmap, unsigned int size);
+long synx_util_get_free_handle(unsigned long *bitmap, unsigned int size,
+	u32 *next_idx);
 int synx_util_init_handle(struct synx_client *client, struct synx_coredata *obj,
 			u32 *new_h_synx,
 			void *map_entry);
@@ -137,6 +138,7 @@ int synx_util_clear_cb_entry(struct synx_client *client,
 void synx_util_default_user_callback(u32 h_synx, int status, void *data);
 void synx_util_callback_dispatch(struct synx_coredata *synx_obj, u32 state);
 void synx_util_cb_dispatch(struct work_struct *cb_dispatch);
+void synx_util_cb_batch_dispatch(struct work_struct *cb_dispatch);
 
 /* external fence functions */
 int synx_util_activate(struct synx_coredata *synx_obj);
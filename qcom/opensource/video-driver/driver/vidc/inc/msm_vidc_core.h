@@ -50,6 +50,8 @@ struct msm_vidc_mem_addr {
 struct msm_vidc_iface_q_info {
 	void *q_hdr;
 	struct msm_vidc_mem_addr q_array;
+	u32 staged_write_idx;
+	u32 staged_pkts;
 };
 
 struct msm_video_device {
@@ -62,6 +64,13 @@ struct msm_vidc_core_power {
 	u64 clk_freq;
 	u64 bw_ddr;
 	u64 bw_llcc;
+	/* dcvs votes of active sessions, refreshed by walking instances */
+	u64 agg_freq;
+	u32 agg_incr_cnt;
+	u32 agg_no_decr_cnt;
+	u32 agg_steps;
+	u64 agg_refresh_ns;
+	bool agg_dirty;
 };
 
 struct msm_vidc_core {
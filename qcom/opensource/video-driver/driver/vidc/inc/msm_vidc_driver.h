@@ -507,6 +507,9 @@ int msm_vidc_allocate_buffers(struct msm_vidc_inst *inst,
 			  enum msm_vidc_buffer_type buf_type, u32 num_buffers);
 int msm_vidc_free_buffers(struct msm_vidc_inst *inst,
 			  enum msm_vidc_buffer_type buf_type);
+struct msm_vidc_buffer *msm_vidc_lookup_buffer_by_index(struct msm_vidc_buffers *buffers,
+							u32 index);
+int msm_vidc_buffers_self_test(u32 iterations);
 void msm_vidc_update_stats(struct msm_vidc_inst *inst,
 			   struct msm_vidc_buffer *buf,
 			   enum msm_vidc_debugfs_event etype);
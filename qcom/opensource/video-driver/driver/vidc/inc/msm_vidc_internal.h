@@ -140,6 +140,13 @@ enum msm_vidc_metadata_bits {
 #define HEIC_GRID_WIDTH                     512
 
 #define DCVS_WINDOW 16
+/* frame time dcvs: load in percent of the frame period */
+#define DCVS_FRAME_TIME_MIN_SAMPLES 8
+#define DCVS_LOAD_HIGH_PCT 90
+#define DCVS_LOAD_LOW_PCT 60
+#define DCVS_LOAD_STEP_PCT 20
+#define DCVS_MAX_STEPS 3
+#define DCVS_DECR_HOLD_FRAMES 8
 #define ENC_FPS_WINDOW 3
 #define DEC_FPS_WINDOW 10
 #define INPUT_TIMER_LIST_SIZE 30
@@ -895,6 +902,15 @@ struct msm_vidc_power {
 	u32                    ddr_bw;
 	u32                    sys_cache_bw;
 	u32                    dcvs_flags;
+	u32                    dcvs_steps;
+	u32                    dcvs_decr_hold;
+	u64                    last_done_ns;
+	u64                    avg_frame_ns;
+	u32                    frame_samples;
+	u64                    agg_freq;
+	u32                    agg_flags;
+	u32                    agg_steps;
+	bool                   agg_counted;
 	u32                    fw_cr;
 	u32                    fw_cf;
 	u32                    fw_av1_tile_rows;
@@ -982,10 +998,14 @@ struct msm_vidc_buffer {
 	u64                                fence_id;
 	u32                                start_time_ms;
 	u32                                end_time_ms;
+	u64                                fw_queue_ns;
 };
 
 struct msm_vidc_buffers {
 	struct list_head       list; // list of "struct msm_vidc_buffer"
+	/* index -> entry of "list", only for client (vb2) buffer types */
+	struct msm_vidc_buffer **index_map;
+	u32                    index_map_size;
 	u32                    min_count;
 	u32                    extra_count;
 	u32                    actual_count;
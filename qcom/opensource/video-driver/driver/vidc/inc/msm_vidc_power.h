@@ -252,6 +252,9 @@ static inline int __bpp(enum msm_vidc_colorformat_type f)
 
 u64 msm_vidc_max_freq(struct msm_vidc_inst *inst);
 int msm_vidc_scale_power(struct msm_vidc_inst *inst, bool scale_buses);
+void msm_vidc_update_frame_time(struct msm_vidc_inst *inst,
+				struct msm_vidc_buffer *buf);
 void msm_vidc_power_data_reset(struct msm_vidc_inst *inst);
+int msm_vidc_dcvs_agg_self_test(u32 steps);
 
 #endif
@@ -66,6 +66,10 @@ struct hfi_queue_header {
 	((void *)((ptr + sizeof(struct hfi_queue_table_header)) + \
 		(i * sizeof(struct hfi_queue_header))))
 
+/* retries, with the core lock dropped, while firmware drains a full cmdq */
+#define VIDC_IFACEQ_FULL_RETRY_US	100
+#define VIDC_IFACEQ_FULL_MAX_RETRIES	50
+
 #define QDSS_SIZE	4096
 #define SFR_SIZE	4096
 #define MMAP_BUF_SIZE	4096
@@ -87,6 +91,8 @@ struct msm_vidc_core;
 int venus_hfi_queue_cmd_write(struct msm_vidc_core *core, void *pkt);
 int venus_hfi_queue_cmd_write_intr(struct msm_vidc_core *core, void *pkt,
 				   bool allow_intr);
+void venus_hfi_queue_cmd_flush(struct msm_vidc_core *core);
+int venus_hfi_queue_self_test(u32 steps);
 int venus_hfi_queue_msg_read(struct msm_vidc_core *core, void *pkt);
 int venus_hfi_queue_dbg_read(struct msm_vidc_core *core, void *pkt);
 void venus_hfi_queue_deinit(struct msm_vidc_core *core);
@@ -12,6 +12,8 @@
 #include "msm_vidc_inst.h"
 #include "msm_vidc_internal.h"
 #include "msm_vidc_events.h"
+#include "msm_vidc_power.h"
+#include "venus_hfi_queue.h"
 
 extern struct msm_vidc_core *g_core;
 
@@ -20,6 +22,7 @@ extern struct msm_vidc_core *g_core;
 #define MAX_DEBUG_LEVEL_STRING_LEN 15
 #define MSM_VIDC_MIN_STATS_DELAY_MS     200
 #define MSM_VIDC_MAX_STATS_DELAY_MS     10000
+#define MSM_VIDC_MAX_SELF_TEST_STEPS    100000
 
 unsigned int msm_vidc_debug = DRV_LOG;
 unsigned int msm_fw_debug = FW_LOG;
@@ -480,6 +483,58 @@ static const struct file_operations stability_fops = {
 	.write = trigger_stability_write,
 };
 
+/* runs @test with the step count written by the user, capped */
+static ssize_t self_test_write(const char __user *buf, size_t count,
+	int (*test)(u32 steps))
+{
+	unsigned long steps = 0;
+	int rc = 0;
+
+	rc = kstrtoul_from_user(buf, count, 0, &steps);
+	if (rc) {
+		d_vpr_e("%s: returning error err %d\n", __func__, rc);
+		return -EINVAL;
+	}
+
+	rc = test(clamp_t(unsigned long, steps, 1,
+		MSM_VIDC_MAX_SELF_TEST_STEPS));
+
+	return rc ? rc : count;
+}
+
+static ssize_t test_cmdq_write(struct file *filp, const char __user *buf,
+	size_t count, loff_t *ppos)
+{
+	return self_test_write(buf, count, venus_hfi_queue_self_test);
+}
+
+static const struct file_operations test_cmdq_fops = {
+	.open = simple_open,
+	.write = test_cmdq_write,
+};
+
+static ssize_t test_buffers_write(struct file *filp, const char __user *buf,
+	size_t count, loff_t *ppos)
+{
+	return self_test_write(buf, count, msm_vidc_buffers_self_test);
+}
+
+static const struct file_operations test_buffers_fops = {
+	.open = simple_open,
+	.write = test_buffers_write,
+};
+
+static ssize_t test_dcvs_write(struct file *filp, const char __user *buf,
+	size_t count, loff_t *ppos)
+{
+	return self_test_write(buf, count, msm_vidc_dcvs_agg_self_test);
+}
+
+static const struct file_operations test_dcvs_fops = {
+	.open = simple_open,
+	.write = test_dcvs_write,
+};
+
 struct dentry *msm_vidc_debugfs_init_drv(void)
 {
 	struct dentry *dir = NULL;
@@ -548,6 +603,18 @@ struct dentry *msm_vidc_debugfs_init_core(struct msm_vidc_core *core)
 		d_vpr_e("debugfs_create_file: fail\n");
 		goto failed_create_dir;
 	}
+	if (!debugfs_create_file("test_cmdq", 0200, dir, core, &test_cmdq_fops)) {
+		d_vpr_e("test_cmdq debugfs_create_file: fail\n");
+		goto failed_create_dir;
+	}
+	if (!debugfs_create_file("test_buffers", 0200, dir, core, &test_buffers_fops)) {
+		d_vpr_e("test_buffers debugfs_create_file: fail\n");
+		goto failed_create_dir;
+	}
+	if (!debugfs_create_file("test_dcvs", 0200, dir, core, &test_dcvs_fops)) {
+		d_vpr_e("test_dcvs debugfs_create_file: fail\n");
+		goto failed_create_dir;
+	}
 failed_create_dir:
 	return dir;
 }
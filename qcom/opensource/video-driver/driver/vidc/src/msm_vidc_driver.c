@@ -5,6 +5,7 @@
  */
 
 #include <linux/iommu.h>
+#include <linux/random.h>
 #include <linux/workqueue.h>
 #include "msm_media_info.h"
 
@@ -2034,6 +2035,25 @@ struct msm_vidc_buffer *msm_vidc_get_driver_buf(struct msm_vidc_inst *inst,
 	return buf;
 }
 
+static int msm_vidc_alloc_index_map(struct msm_vidc_buffers *buffers,
+	u32 num_buffers)
+{
+	buffers->index_map = kcalloc(num_buffers, sizeof(*buffers->index_map),
+		GFP_KERNEL);
+	if (!buffers->index_map)
+		return -ENOMEM;
+	buffers->index_map_size = num_buffers;
+
+	return 0;
+}
+
+static void msm_vidc_free_index_map(struct msm_vidc_buffers *buffers)
+{
+	kfree(buffers->index_map);
+	buffers->index_map = NULL;
+	buffers->index_map_size = 0;
+}
+
 int msm_vidc_allocate_buffers(struct msm_vidc_inst *inst,
 	enum msm_vidc_buffer_type buf_type, u32 num_buffers)
 {
@@ -2049,6 +2069,20 @@ int msm_vidc_allocate_buffers(struct msm_vidc_inst *inst,
 	if (!buffers)
 		return -EINVAL;
 
+	if (!num_buffers)
+		return 0;
+
+	/*
+	 * client buffers keep their vb2 index for their whole lifetime, so
+	 * response handling can find them without walking the list
+	 */
+	msm_vidc_free_index_map(buffers);
+	rc = msm_vidc_alloc_index_map(buffers, num_buffers);
+	if (rc) {
+		i_vpr_e(inst, "%s: index map alloc failed\n", __func__);
+		return rc;
+	}
+
 	for (idx = 0; idx < num_buffers; idx++) {
 		buf = msm_vidc_pool_alloc(inst, MSM_MEM_POOL_BUFFER);
 		if (!buf) {
@@ -2060,6 +2094,7 @@ int msm_vidc_allocate_buffers(struct msm_vidc_inst *inst,
 		buf->type = buf_type;
 		buf->index = idx;
 		buf->region = call_mem_op(core, buffer_region, inst, buf_type);
+		buffers->index_map[idx] = buf;
 	}
 	i_vpr_h(inst, "%s: allocated %d buffers for type %s\n",
 		__func__, num_buffers, buf_name(buf_type));
@@ -2082,6 +2117,8 @@ int msm_vidc_free_buffers(struct msm_vidc_inst *inst,
 	if (!buffers)
 		return -EINVAL;
 
+	msm_vidc_free_index_map(buffers);
+
 	list_for_each_entry_safe(buf, dummy, &buffers->list, list) {
 		buf_count++;
 		print_vidc_buffer(VIDC_LOW, "low ", "free buffer", inst, buf);
@@ -2094,6 +2131,92 @@ int msm_vidc_free_buffers(struct msm_vidc_inst *inst,
 	return rc;
 }
 
+struct msm_vidc_buffer *msm_vidc_lookup_buffer_by_index(struct msm_vidc_buffers *buffers,
+							u32 index)
+{
+	if (!buffers->index_map || index >= buffers->index_map_size)
+		return NULL;
+
+	return buffers->index_map[index];
+}
+
+/*
+ * Builds buffer lists the way msm_vidc_allocate_buffers() does, in random
+ * list order, and checks that msm_vidc_lookup_buffer_by_index() returns
+ * what a walk of the list finds for every index, including out of range
+ * ones and after the map is freed.
+ */
+int msm_vidc_buffers_self_test(u32 iterations)
+{
+	struct msm_vidc_buffers buffers;
+	struct msm_vidc_buffer *bufs, *buf, *found;
+	u32 iter, num, idx, i, j;
+	u32 order[VIDEO_MAX_FRAME];
+	int rc = 0;
+
+	for (iter = 0; iter < iterations && !rc; iter++) {
+		num = 1 + (get_random_u32() % VIDEO_MAX_FRAME);
+		bufs = kcalloc(num, sizeof(*bufs), GFP_KERNEL);
+		if (!bufs)
+			return -ENOMEM;
+
+		memset(&buffers, 0, sizeof(buffers));
+		INIT_LIST_HEAD(&buffers.list);
+		rc = msm_vidc_alloc_index_map(&buffers, num);
+		if (rc) {
+			kfree(bufs);
+			return rc;
+		}
+
+		for (i = 0; i < num; i++)
+			order[i] = i;
+		for (i = num - 1; i > 0; i--) {
+			j = get_random_u32() % (i + 1);
+			swap(order[i], order[j]);
+		}
+		for (i = 0; i < num; i++) {
+			buf = &bufs[order[i]];
+			INIT_LIST_HEAD(&buf->list);
+			list_add_tail(&buf->list, &buffers.list);
+			buf->index = order[i];
+			buffers.index_map[order[i]] = buf;
+		}
+
+		for (idx = 0; idx < num + 8 && !rc; idx++) {
+			found = NULL;
+			list_for_each_entry(buf, &buffers.list, list) {
+				if (buf->index == idx) {
+					found = buf;
+					break;
+				}
+			}
+			if (msm_vidc_lookup_buffer_by_index(&buffers, idx) != found) {
+				d_vpr_e("%s: idx %u of %u mismatch\n",
+					__func__, idx, num);
+				rc = -EINVAL;
+			}
+		}
+
+		msm_vidc_free_index_map(&buffers);
+		for (idx = 0; idx < num && !rc; idx++) {
+			if (msm_vidc_lookup_buffer_by_index(&buffers, idx)) {
+				d_vpr_e("%s: idx %u found after free\n",
+					__func__, idx);
+				rc = -EINVAL;
+			}
+		}
+
+		kfree(bufs);
+	}
+
+	if (rc)
+		d_vpr_e("%s: failed at iteration %u\n", __func__, iter);
+	else
+		d_vpr_h("%s: %u iterations passed\n", __func__, iterations);
+
+	return rc;
+}
+
 struct msm_vidc_buffer *msm_vidc_fetch_buffer(struct msm_vidc_inst *inst,
 	struct vb2_buffer *vb2)
 {
@@ -2557,8 +2680,10 @@ static int msm_vidc_queue_buffer(struct msm_vidc_inst *inst, struct msm_vidc_buf
 			i_vpr_e(inst, "%s: insert timestamp failed\n", __func__);
 	}
 
-	if (is_input_buffer(buf->type))
+	if (is_input_buffer(buf->type)) {
 		inst->power.buffer_counter++;
+		buf->fw_queue_ns = ktime_get_ns();
+	}
 
 	if (is_input_buffer(buf->type))
 		etype = MSM_VIDC_DEBUGFS_EVENT_ETB;
@@ -3264,6 +3389,7 @@ int msm_vidc_remove_session(struct msm_vidc_inst *inst)
 	list_for_each_entry_safe(i, temp, &core->instances, list) {
 		if (i->session_id == inst->session_id) {
 			list_move_tail(&i->list, &core->dangling_instances);
+			core->power.agg_dirty = true;
 			i_vpr_h(inst, "%s: removed session %#x\n",
 				__func__, i->session_id);
 		}
@@ -3768,6 +3894,7 @@ int msm_vidc_core_deinit_locked(struct msm_vidc_core *core, bool force)
 		msm_vidc_change_state(inst, MSM_VIDC_ERROR, __func__);
 		list_move_tail(&inst->list, &core->dangling_instances);
 	}
+	core->power.agg_dirty = true;
 	msm_vidc_change_core_state(core, MSM_VIDC_CORE_DEINIT, __func__);
 
 	return rc;
@@ -4450,6 +4577,8 @@ void msm_vidc_destroy_buffers(struct msm_vidc_inst *inst)
 		if (!buffers)
 			continue;
 
+		msm_vidc_free_index_map(buffers);
+
 		list_for_each_entry_safe(buf, dummy, &buffers->list, list) {
 			if (buf->attach && buf->sg_table)
 				call_mem_op(core, dma_buf_unmap_attachment, core,
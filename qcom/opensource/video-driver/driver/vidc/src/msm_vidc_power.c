@@ -4,6 +4,8 @@
  * Copyright (c) 2022-2024 Qualcomm Innovation Center, Inc. All rights reserved.
  */
 
+#include <linux/random.h>
+
 #include "msm_vidc_power.h"
 #include "msm_vidc_internal.h"
 #include "msm_vidc_debug.h"
@@ -335,15 +337,125 @@ set_buses:
 	return 0;
 }
 
+static void msm_vidc_dcvs_agg_add(struct msm_vidc_core *core,
+				  struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_power *power = &inst->power;
+
+	power->agg_freq = power->min_freq;
+	power->agg_flags = power->dcvs_flags;
+	power->agg_steps = power->dcvs_steps;
+	power->agg_counted = true;
+
+	core->power.agg_freq += power->agg_freq;
+	/* increment even if one session requested for it */
+	if (power->agg_flags & MSM_VIDC_DCVS_INCR) {
+		core->power.agg_incr_cnt++;
+		core->power.agg_steps = max(core->power.agg_steps, power->agg_steps);
+	}
+	/* decrement only if all sessions requested for it */
+	if (!(power->agg_flags & MSM_VIDC_DCVS_DECR))
+		core->power.agg_no_decr_cnt++;
+}
+
+static void msm_vidc_dcvs_agg_del(struct msm_vidc_core *core,
+				  struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_power *power = &inst->power;
+	struct msm_vidc_inst *temp;
+
+	if (!power->agg_counted)
+		return;
+
+	core->power.agg_freq -= power->agg_freq;
+	if (power->agg_flags & MSM_VIDC_DCVS_INCR)
+		core->power.agg_incr_cnt--;
+	if (!(power->agg_flags & MSM_VIDC_DCVS_DECR))
+		core->power.agg_no_decr_cnt--;
+	power->agg_counted = false;
+
+	/* agg_steps is a max, recompute it if this session held it */
+	if (!(power->agg_flags & MSM_VIDC_DCVS_INCR) ||
+	    power->agg_steps < core->power.agg_steps)
+		return;
+
+	core->power.agg_steps = 0;
+	list_for_each_entry(temp, &core->instances, list) {
+		if (temp->power.agg_counted &&
+		    (temp->power.agg_flags & MSM_VIDC_DCVS_INCR))
+			core->power.agg_steps = max(core->power.agg_steps,
+						    temp->power.agg_steps);
+	}
+}
+
+/* Counts the session in the aggregate if it is active and has input */
+static void msm_vidc_dcvs_agg_count(struct msm_vidc_core *core,
+				    struct msm_vidc_inst *inst, u64 curr_time_ns)
+{
+	/* skip for session where no input is there to process */
+	if (!inst->max_input_data_size)
+		return;
+
+	/* skip inactive session clock rate */
+	if (!is_active_session(inst->last_qbuf_time_ns, curr_time_ns)) {
+		inst->active = false;
+		return;
+	}
+	msm_vidc_dcvs_agg_add(core, inst);
+}
+
+/*
+ * Rebuilds the dcvs aggregate from all active sessions. Inactive sessions
+ * are only detected here, so this runs whenever the session list changes
+ * and at least once per inactivity threshold.
+ */
+static void msm_vidc_dcvs_agg_refresh(struct msm_vidc_core *core, u64 curr_time_ns)
+{
+	struct msm_vidc_inst *temp;
+
+	core->power.agg_freq = 0;
+	core->power.agg_incr_cnt = 0;
+	core->power.agg_no_decr_cnt = 0;
+	core->power.agg_steps = 0;
+
+	list_for_each_entry(temp, &core->instances, list) {
+		temp->power.agg_counted = false;
+		msm_vidc_dcvs_agg_count(core, temp, curr_time_ns);
+	}
+
+	core->power.agg_refresh_ns = curr_time_ns;
+	core->power.agg_dirty = false;
+}
+
+/* Folds the new vote of @inst into the aggregate, core lock held */
+static void msm_vidc_dcvs_agg_update(struct msm_vidc_core *core,
+				     struct msm_vidc_inst *inst, u64 curr_time_ns)
+{
+	if (core->power.agg_dirty ||
+	    curr_time_ns - core->power.agg_refresh_ns >
+	    MSM_VIDC_SESSION_INACTIVE_THRESHOLD_MS * NSEC_PER_MSEC) {
+		msm_vidc_dcvs_agg_refresh(core, curr_time_ns);
+		return;
+	}
+
+	/*
+	 * only this session's vote changed, swap it in the aggregate. It
+	 * must pass the same checks as on refresh, or a session that went
+	 * idle would keep its vote until the next refresh.
+	 */
+	msm_vidc_dcvs_agg_del(core, inst);
+	msm_vidc_dcvs_agg_count(core, inst, curr_time_ns);
+}
+
 int msm_vidc_set_clocks(struct msm_vidc_inst *inst)
 {
 	int rc = 0;
 	struct msm_vidc_core *core;
-	struct msm_vidc_inst *temp;
 	u64 freq;
 	u64 rate = 0;
 	bool increment, decrement;
 	u64 curr_time_ns;
+	u32 steps = 0;
 	int i = 0;
 
 	core = inst->core;
@@ -355,34 +467,19 @@ int msm_vidc_set_clocks(struct msm_vidc_inst *inst)
 	}
 
 	mutex_lock(&core->lock);
-	increment = false;
-	decrement = true;
-	freq = 0;
 	curr_time_ns = ktime_get_ns();
-	list_for_each_entry(temp, &core->instances, list) {
-		/* skip for session where no input is there to process */
-		if (!temp->max_input_data_size)
-			continue;
-
-		/* skip inactive session clock rate */
-		if (!is_active_session(temp->last_qbuf_time_ns, curr_time_ns)) {
-			temp->active = false;
-			continue;
-		}
-		freq += temp->power.min_freq;
+	msm_vidc_dcvs_agg_update(core, inst, curr_time_ns);
 
-		if (msm_vidc_clock_voting) {
-			d_vpr_l("msm_vidc_clock_voting %d\n", msm_vidc_clock_voting);
-			freq = msm_vidc_clock_voting;
-			decrement = false;
-			break;
-		}
-		/* increment even if one session requested for it */
-		if (temp->power.dcvs_flags & MSM_VIDC_DCVS_INCR)
-			increment = true;
-		/* decrement only if all sessions requested for it */
-		if (!(temp->power.dcvs_flags & MSM_VIDC_DCVS_DECR))
-			decrement = false;
+	if (msm_vidc_clock_voting) {
+		d_vpr_l("msm_vidc_clock_voting %d\n", msm_vidc_clock_voting);
+		freq = msm_vidc_clock_voting;
+		increment = false;
+		decrement = false;
+	} else {
+		freq = core->power.agg_freq;
+		increment = !!core->power.agg_incr_cnt;
+		decrement = !core->power.agg_no_decr_cnt;
+		steps = max_t(u32, core->power.agg_steps, 1);
 	}
 
 	/*
@@ -397,16 +494,17 @@ int msm_vidc_set_clocks(struct msm_vidc_inst *inst)
 	if (i < 0)
 		i = 0;
 	if (increment) {
-		if (i > 0)
-			rate = core->resource->freq_set.freq_tbl[i - 1].freq;
+		/* frame time dcvs may ask for more than one level at once */
+		i = max_t(int, i - (int)steps, 0);
+		rate = core->resource->freq_set.freq_tbl[i].freq;
 	} else if (decrement) {
 		if (i < (int)(core->platform->data.freq_tbl_size - 1))
 			rate = core->resource->freq_set.freq_tbl[i + 1].freq;
 	}
 	core->power.clk_freq = (u32)rate;
 
-	i_vpr_p(inst, "%s: clock rate %llu requested %llu increment %d decrement %d\n",
-		__func__, rate, freq, increment, decrement);
+	i_vpr_p(inst, "%s: clock rate %llu requested %llu increment %d (steps %u) decrement %d\n",
+		__func__, rate, freq, increment, steps, decrement);
 	mutex_unlock(&core->lock);
 
 	rc = venus_hfi_scale_clocks(inst, rate);
@@ -416,11 +514,227 @@ int msm_vidc_set_clocks(struct msm_vidc_inst *inst)
 	return 0;
 }
 
+#define MSM_VIDC_DCVS_TEST_SESSIONS	8
+
+/* The aggregate must equal the snapshots of the sessions it counts */
+static int msm_vidc_dcvs_agg_test_check(struct msm_vidc_core *core)
+{
+	struct msm_vidc_inst *inst;
+	u64 freq = 0;
+	u32 incr_cnt = 0, no_decr_cnt = 0, steps = 0;
+
+	list_for_each_entry(inst, &core->instances, list) {
+		if (!inst->power.agg_counted)
+			continue;
+		freq += inst->power.agg_freq;
+		if (inst->power.agg_flags & MSM_VIDC_DCVS_INCR) {
+			incr_cnt++;
+			steps = max(steps, inst->power.agg_steps);
+		}
+		if (!(inst->power.agg_flags & MSM_VIDC_DCVS_DECR))
+			no_decr_cnt++;
+	}
+
+	if (freq != core->power.agg_freq ||
+	    incr_cnt != core->power.agg_incr_cnt ||
+	    no_decr_cnt != core->power.agg_no_decr_cnt ||
+	    steps != core->power.agg_steps) {
+		d_vpr_e("%s: agg freq %llu/%llu incr %u/%u no_decr %u/%u steps %u/%u\n",
+			__func__, core->power.agg_freq, freq,
+			core->power.agg_incr_cnt, incr_cnt,
+			core->power.agg_no_decr_cnt, no_decr_cnt,
+			core->power.agg_steps, steps);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static bool msm_vidc_dcvs_agg_test_expected(struct msm_vidc_inst *inst,
+					    u64 curr_time_ns)
+{
+	return inst->max_input_data_size &&
+		is_active_session(inst->last_qbuf_time_ns, curr_time_ns);
+}
+
+/*
+ * Replays random votes from a handful of sessions through the same
+ * aggregate update msm_vidc_set_clocks() does, with sessions going idle
+ * and the session list changing on the way. After every vote the
+ * aggregate must match the sessions it counts, the voting session must be
+ * counted only if it is active and has input, and after a refresh so must
+ * every other session.
+ */
+int msm_vidc_dcvs_agg_self_test(u32 steps)
+{
+	struct msm_vidc_inst *insts[MSM_VIDC_DCVS_TEST_SESSIONS] = { NULL };
+	struct msm_vidc_inst *inst;
+	struct msm_vidc_core *core;
+	u64 now = MSM_VIDC_SESSION_INACTIVE_THRESHOLD_MS * NSEC_PER_MSEC;
+	u32 step, i;
+	int rc = 0;
+
+	core = vzalloc(sizeof(*core));
+	if (!core)
+		return -ENOMEM;
+	INIT_LIST_HEAD(&core->instances);
+
+	for (i = 0; i < MSM_VIDC_DCVS_TEST_SESSIONS; i++) {
+		insts[i] = vzalloc(sizeof(*insts[i]));
+		if (!insts[i]) {
+			rc = -ENOMEM;
+			goto exit;
+		}
+		list_add_tail(&insts[i]->list, &core->instances);
+	}
+	core->power.agg_dirty = true;
+
+	for (step = 0; step < steps && !rc; step++) {
+		/* up to 400 ms between votes, sessions idle for 1 s drop out */
+		now += (get_random_u32() % 400) * NSEC_PER_MSEC;
+		inst = insts[get_random_u32() % MSM_VIDC_DCVS_TEST_SESSIONS];
+
+		inst->power.min_freq = (get_random_u32() % 1000) * 1000000ULL;
+		inst->power.dcvs_flags = get_random_u32() &
+			(MSM_VIDC_DCVS_INCR | MSM_VIDC_DCVS_DECR);
+		inst->power.dcvs_steps = get_random_u32() % 4;
+		inst->max_input_data_size = (get_random_u32() % 8) ? SZ_1M : 0;
+		if (get_random_u32() % 4)
+			inst->last_qbuf_time_ns = now;
+
+		/* session opened or closed somewhere else */
+		if (!(get_random_u32() % 16))
+			core->power.agg_dirty = true;
+
+		msm_vidc_dcvs_agg_update(core, inst, now);
+
+		rc = msm_vidc_dcvs_agg_test_check(core);
+		if (rc)
+			break;
+
+		if (inst->power.agg_counted !=
+		    msm_vidc_dcvs_agg_test_expected(inst, now)) {
+			d_vpr_e("%s: voting session counted %d\n",
+				__func__, inst->power.agg_counted);
+			rc = -EINVAL;
+			break;
+		}
+
+		if (core->power.agg_refresh_ns != now)
+			continue;
+
+		for (i = 0; i < MSM_VIDC_DCVS_TEST_SESSIONS; i++) {
+			if (insts[i]->power.agg_counted !=
+			    msm_vidc_dcvs_agg_test_expected(insts[i], now)) {
+				d_vpr_e("%s: session %u counted %d after refresh\n",
+					__func__, i, insts[i]->power.agg_counted);
+				rc = -EINVAL;
+				break;
+			}
+		}
+	}
+
+	if (rc)
+		d_vpr_e("%s: failed at step %u\n", __func__, step);
+	else
+		d_vpr_h("%s: %u steps passed\n", __func__, steps);
+
+exit:
+	for (i = 0; i < MSM_VIDC_DCVS_TEST_SESSIONS; i++)
+		vfree(insts[i]);
+	vfree(core);
+	return rc;
+}
+
+void msm_vidc_update_frame_time(struct msm_vidc_inst *inst,
+				struct msm_vidc_buffer *buf)
+{
+	struct msm_vidc_power *power = &inst->power;
+	u64 now_ns, start_ns, sample_ns;
+	u32 batch_size;
+
+	now_ns = ktime_get_ns();
+	if (!buf->fw_queue_ns)
+		goto exit;
+
+	/*
+	 * firmware works on one frame at a time, so a frame starts either
+	 * when it was queued or when the previous one completed, whichever
+	 * is later. This gives processing time without idle or queueing time.
+	 */
+	start_ns = max(buf->fw_queue_ns, power->last_done_ns);
+	if (now_ns <= start_ns)
+		goto exit;
+
+	sample_ns = now_ns - start_ns;
+	if (msm_vidc_is_super_buffer(inst)) {
+		batch_size = inst->capabilities[SUPER_FRAME].value;
+		if (batch_size)
+			sample_ns = div_u64(sample_ns, batch_size);
+	}
+
+	/* ewma with 1/8 weight for the new sample */
+	if (!power->frame_samples)
+		power->avg_frame_ns = sample_ns;
+	else
+		power->avg_frame_ns = power->avg_frame_ns - (power->avg_frame_ns >> 3) +
+			(sample_ns >> 3);
+	power->frame_samples++;
+
+exit:
+	buf->fw_queue_ns = 0;
+	power->last_done_ns = now_ns;
+}
+
+/*
+ * Votes based on how much of the frame period firmware needs per frame.
+ * Increments take effect immediately and may skip several levels when the
+ * deadline is missed by a wide margin, decrements must persist for
+ * DCVS_DECR_HOLD_FRAMES votes to avoid bouncing between adjacent levels.
+ * Returns false if there is no usable frame time yet.
+ */
+static bool msm_vidc_dcvs_frame_time_vote(struct msm_vidc_inst *inst,
+					  u32 *flags, u32 *steps)
+{
+	struct msm_vidc_power *power = &inst->power;
+	u64 period_ns;
+	u32 load;
+
+	*flags = 0;
+	*steps = 0;
+
+	if (power->frame_samples < DCVS_FRAME_TIME_MIN_SAMPLES || !inst->max_rate)
+		return false;
+
+	period_ns = div_u64(NSEC_PER_SEC, inst->max_rate);
+	load = (u32)min_t(u64, div64_u64(power->avg_frame_ns * 100, period_ns), U32_MAX);
+
+	if (load >= DCVS_LOAD_HIGH_PCT) {
+		*flags = MSM_VIDC_DCVS_INCR;
+		*steps = min_t(u32, 1 + (load - DCVS_LOAD_HIGH_PCT) / DCVS_LOAD_STEP_PCT,
+			       DCVS_MAX_STEPS);
+		power->dcvs_decr_hold = 0;
+	} else if (load <= DCVS_LOAD_LOW_PCT) {
+		if (power->dcvs_decr_hold < DCVS_DECR_HOLD_FRAMES)
+			power->dcvs_decr_hold++;
+		if (power->dcvs_decr_hold >= DCVS_DECR_HOLD_FRAMES)
+			*flags = MSM_VIDC_DCVS_DECR;
+	} else {
+		power->dcvs_decr_hold = 0;
+	}
+
+	i_vpr_p(inst, "dcvs: frame time %llu ns period %llu ns load %u%% hold %u\n",
+		power->avg_frame_ns, period_ns, load, power->dcvs_decr_hold);
+
+	return true;
+}
+
 static int msm_vidc_apply_dcvs(struct msm_vidc_inst *inst)
 {
 	int rc = 0;
 	int bufs_with_fw = 0;
 	struct msm_vidc_power *power;
+	u32 ft_flags, ft_steps;
 
 	/* skip dcvs */
 	if (!inst->power.dcvs_mode)
@@ -480,10 +794,25 @@ static int msm_vidc_apply_dcvs(struct msm_vidc_inst *inst)
 	}
 
 exit:
-	i_vpr_p(inst, "dcvs: bufs_with_fw %d th[%d %d %d] flags %#x\n",
+	/*
+	 * Combine with frame time: either signal can raise the clock, but it
+	 * is only lowered when firmware also has enough slack per frame.
+	 */
+	power->dcvs_steps = 1;
+	if (msm_vidc_dcvs_frame_time_vote(inst, &ft_flags, &ft_steps)) {
+		if (ft_flags & MSM_VIDC_DCVS_INCR) {
+			power->dcvs_flags = MSM_VIDC_DCVS_INCR;
+			power->dcvs_steps = ft_steps;
+		} else if (power->dcvs_flags & MSM_VIDC_DCVS_DECR &&
+			   !(ft_flags & MSM_VIDC_DCVS_DECR)) {
+			power->dcvs_flags = 0;
+		}
+	}
+
+	i_vpr_p(inst, "dcvs: bufs_with_fw %d th[%d %d %d] flags %#x steps %u\n",
 		bufs_with_fw, power->min_threshold,
 		power->nom_threshold, power->max_threshold,
-		power->dcvs_flags);
+		power->dcvs_flags, power->dcvs_steps);
 
 	return rc;
 }
@@ -591,9 +920,13 @@ int msm_vidc_scale_power(struct msm_vidc_inst *inst, bool scale_buses)
 	}
 	inst->max_rate = fps;
 
-	/* no pending inputs - skip scale power */
-	if (!inst->max_input_data_size)
+	/* no pending inputs - skip scale power and drop the clock vote */
+	if (!inst->max_input_data_size) {
+		mutex_lock(&core->lock);
+		msm_vidc_dcvs_agg_del(core, inst);
+		mutex_unlock(&core->lock);
 		return 0;
+	}
 
 	if (msm_vidc_scale_clocks(inst))
 		i_vpr_e(inst, "failed to scale clock\n");
@@ -642,6 +975,11 @@ void msm_vidc_dcvs_data_reset(struct msm_vidc_inst *inst)
 	dcvs->dcvs_window = min_count < max_count ? max_count - min_count : 0;
 	dcvs->nom_threshold = dcvs->min_threshold + (dcvs->dcvs_window / 2);
 	dcvs->dcvs_flags = 0;
+	dcvs->dcvs_steps = 0;
+	dcvs->dcvs_decr_hold = 0;
+	dcvs->last_done_ns = 0;
+	dcvs->avg_frame_ns = 0;
+	dcvs->frame_samples = 0;
 
 	i_vpr_p(inst, "%s: dcvs: thresholds [%d %d %d] flags %#x\n",
 		__func__, dcvs->min_threshold,
@@ -192,6 +192,41 @@ static int __cmdq_write_intr(struct msm_vidc_core *core, void *pkt, bool allow_i
 	return rc;
 }
 
+/*
+ * Writes inst->packet, retrying while the command queue is full. The core
+ * lock is dropped between attempts so the response path can run and
+ * firmware can drain the queue. inst->packet stays intact meanwhile as it
+ * belongs to the caller, who holds the inst lock.
+ */
+static int __cmdq_write_inst(struct msm_vidc_inst *inst, bool allow_intr)
+{
+	struct msm_vidc_core *core = inst->core;
+	u32 retries = 0;
+	int rc;
+
+	rc = __cmdq_write_intr(core, inst->packet, allow_intr);
+	while (rc == -EAGAIN && retries++ < VIDC_IFACEQ_FULL_MAX_RETRIES) {
+		core_unlock(core, __func__);
+		usleep_range(VIDC_IFACEQ_FULL_RETRY_US,
+			     VIDC_IFACEQ_FULL_RETRY_US + 50);
+		core_lock(core, __func__);
+
+		/* core may have been torn down while unlocked */
+		if (!__valdiate_session(core, inst, __func__))
+			return -EINVAL;
+
+		rc = __cmdq_write_intr(core, inst->packet, allow_intr);
+	}
+
+	if (rc == -EAGAIN) {
+		i_vpr_e(inst, "%s: cmd queue still full after %u retries\n",
+			__func__, VIDC_IFACEQ_FULL_MAX_RETRIES);
+		rc = -ENOTEMPTY;
+	}
+
+	return rc;
+}
+
 static int __sys_set_debug(struct msm_vidc_core *core, u32 debug)
 {
 	int rc = 0;
@@ -1685,9 +1720,11 @@ int venus_hfi_queue_super_buffer(struct msm_vidc_inst *inst,
 				goto unlock;
 		}
 
-		/* Raise interrupt only for last pkt in the batch */
-		rc = __cmdq_write_intr(inst->core, inst->packet,
-				       (cnt == batch_size - 1));
+		/*
+		 * Stage all packets and publish them with the last one, so the
+		 * batch costs one write index update and a single interrupt
+		 */
+		rc = __cmdq_write_inst(inst, (cnt == batch_size - 1));
 		if (rc)
 			goto unlock;
 
@@ -1697,6 +1734,12 @@ int venus_hfi_queue_super_buffer(struct msm_vidc_inst *inst,
 		cnt++;
 	}
 unlock:
+	/*
+	 * Packets are only published to firmware with the last one in the
+	 * batch, push out whatever was staged before the failure.
+	 */
+	if (rc)
+		venus_hfi_queue_cmd_flush(core);
 	core_unlock(core, __func__);
 	if (rc)
 		i_vpr_e(inst, "%s: queue super buffer failed: %d\n", __func__, rc);
@@ -1829,7 +1872,7 @@ int venus_hfi_queue_buffer(struct msm_vidc_inst *inst,
 	if (rc)
 		goto unlock;
 
-	rc = __cmdq_write(inst->core, inst->packet);
+	rc = __cmdq_write_inst(inst, true);
 	if (rc)
 		goto unlock;
 
@@ -4,6 +4,8 @@
  * Copyright (c) 2022-2023 Qualcomm Innovation Center, Inc. All rights reserved.
  */
 
+#include <linux/random.h>
+
 #include "venus_hfi_queue.h"
 #include "msm_vidc_core.h"
 #include "msm_vidc_debug.h"
@@ -55,8 +57,20 @@ static void __dump_packet(u8 *packet, const char *function, void *qinfo)
 	}
 }
 
-static int __write_queue(struct msm_vidc_iface_q_info *qinfo, u8 *packet,
-			 bool *rx_req_is_set)
+static u32 __queue_empty_space(struct msm_vidc_iface_q_info *qinfo,
+				u32 read_idx, u32 write_idx)
+{
+	return (write_idx >= read_idx) ?
+		((qinfo->q_array.mem_size >> 2) - (write_idx - read_idx)) :
+		(read_idx - write_idx);
+}
+
+/*
+ * Copies a packet into the queue without publishing it to firmware. The
+ * packet lands at the staged write index (or at qhdr_write_idx if nothing
+ * is staged) and only becomes visible once __publish_queue() is called.
+ */
+static int __write_queue(struct msm_vidc_iface_q_info *qinfo, u8 *packet)
 {
 	struct hfi_queue_header *queue;
 	u32 packet_size_in_words, new_write_idx;
@@ -93,15 +107,15 @@ static int __write_queue(struct msm_vidc_iface_q_info *qinfo, u8 *packet,
 	}
 
 	read_idx = queue->qhdr_read_idx;
-	write_idx = queue->qhdr_write_idx;
+	write_idx = qinfo->staged_pkts ?
+		qinfo->staged_write_idx : queue->qhdr_write_idx;
 
-	empty_space = (write_idx >=  read_idx) ?
-		((qinfo->q_array.mem_size>>2) - (write_idx -  read_idx)) :
-		(read_idx - write_idx);
+	empty_space = __queue_empty_space(qinfo, read_idx, write_idx);
 	if (empty_space <= packet_size_in_words) {
+		/* ask firmware to interrupt us once it drains the queue */
 		queue->qhdr_tx_req =  1;
-		d_vpr_e("Insufficient size (%d) to write (%d)\n",
-					  empty_space, packet_size_in_words);
+		d_vpr_l("Insufficient size (%d) to write (%d)\n",
+			empty_space, packet_size_in_words);
 		return -ENOTEMPTY;
 	}
 
@@ -128,20 +142,42 @@ static int __write_queue(struct msm_vidc_iface_q_info *qinfo, u8 *packet,
 			new_write_idx  << 2);
 	}
 
+	qinfo->staged_write_idx = new_write_idx;
+	qinfo->staged_pkts++;
+
+	return 0;
+}
+
+/*
+ * Publishes every staged packet with a single write index update. Reports
+ * through @rx_req_is_set whether firmware asked to be interrupted for new
+ * commands; when it is already polling the queue the doorbell is skipped.
+ */
+static void __publish_queue(struct msm_vidc_iface_q_info *qinfo,
+			    bool *rx_req_is_set)
+{
+	struct hfi_queue_header *queue;
+
+	if (!qinfo->staged_pkts)
+		return;
+
+	queue = (struct hfi_queue_header *)qinfo->q_hdr;
+
 	/*
-	 * Memory barrier to make sure packet is written before updating the
-	 * write index
+	 * Write barrier to make sure packets are written before updating
+	 * the write index
 	 */
-	mb();
-	queue->qhdr_write_idx = new_write_idx;
-	if (rx_req_is_set)
-		*rx_req_is_set = true;
+	wmb();
+	queue->qhdr_write_idx = qinfo->staged_write_idx;
 	/*
-	 * Memory barrier to make sure write index is updated before an
-	 * interrupt is raised on venus.
+	 * Memory barrier to make sure write index is updated before rx_req
+	 * is sampled and an interrupt is raised on venus.
 	 */
 	mb();
-	return 0;
+	qinfo->staged_pkts = 0;
+
+	if (rx_req_is_set)
+		*rx_req_is_set = !!queue->qhdr_rx_req;
 }
 
 static int __read_queue(struct msm_vidc_iface_q_info *qinfo, u8 *packet,
@@ -262,68 +298,239 @@ static int __read_queue(struct msm_vidc_iface_q_info *qinfo, u8 *packet,
 	return rc;
 }
 
-/* Writes into cmdq without raising an interrupt */
-static int __iface_cmdq_write_relaxed(struct msm_vidc_core *core,
-				      void *pkt, bool *requires_interrupt)
+static struct msm_vidc_iface_q_info *__iface_cmdq_get(
+	struct msm_vidc_core *core, const char *func)
 {
 	struct msm_vidc_iface_q_info *q_info;
-	//struct vidc_hal_cmd_pkt_hdr *cmd_packet;
-	int rc = -E2BIG;
 
-	rc = __strict_check(core, __func__);
-	if (rc)
-		return rc;
+	if (__strict_check(core, func))
+		return NULL;
 
 	if (!core_in_valid_state(core)) {
-		d_vpr_e("%s: fw not in init state\n", __func__);
-		rc = -EINVAL;
-		goto err_q_null;
+		d_vpr_e("%s: fw not in init state\n", func);
+		return NULL;
 	}
 
-	//cmd_packet = (struct vidc_hal_cmd_pkt_hdr *)pkt;
-	//core->last_packet_type = cmd_packet->packet_type;
-
 	q_info = &core->iface_queues[VIDC_IFACEQ_CMDQ_IDX];
-	if (!q_info) {
-		d_vpr_e("cannot write to shared Q's\n");
-		goto err_q_null;
-	}
-
 	if (!q_info->q_array.align_virtual_addr) {
-		d_vpr_e("cannot write to shared CMD Q's\n");
-		rc = -ENODATA;
-		goto err_q_null;
+		d_vpr_e("%s: cannot write to shared CMD Q's\n", func);
+		return NULL;
 	}
 
-	if (!__write_queue(q_info, (u8 *)pkt, requires_interrupt))
-		rc = 0;
-	else
-		d_vpr_e("queue full\n");
+	return q_info;
+}
 
-err_q_null:
-	return rc;
+/*
+ * Stages a packet into cmdq. When the queue is full, whatever is staged is
+ * handed to firmware and -EAGAIN is returned without waiting: qhdr_tx_req
+ * was set by __write_queue(), so firmware interrupts us once it drains the
+ * queue. Callers retry after dropping the core lock, which the response
+ * path needs to make progress.
+ */
+static int __iface_cmdq_stage(struct msm_vidc_core *core,
+			      struct msm_vidc_iface_q_info *q_info, void *pkt)
+{
+	int rc;
+
+	rc = __write_queue(q_info, (u8 *)pkt);
+	if (rc != -ENOTEMPTY)
+		return rc;
+
+	__publish_queue(q_info, NULL);
+	call_venus_op(core, raise_interrupt, core);
+
+	return -EAGAIN;
 }
 
 int venus_hfi_queue_cmd_write(struct msm_vidc_core *core, void *pkt)
 {
+	return venus_hfi_queue_cmd_write_intr(core, pkt, true);
+}
+
+int venus_hfi_queue_cmd_write_intr(struct msm_vidc_core *core, void *pkt,
+				   bool allow_intr)
+{
+	struct msm_vidc_iface_q_info *q_info;
 	bool needs_interrupt = false;
-	int rc = __iface_cmdq_write_relaxed(core, pkt, &needs_interrupt);
+	int rc;
+
+	q_info = __iface_cmdq_get(core, __func__);
+	if (!q_info)
+		return -EINVAL;
 
-	if (!rc && needs_interrupt)
+	rc = __iface_cmdq_stage(core, q_info, pkt);
+	if (rc || !allow_intr)
+		return rc;
+
+	__publish_queue(q_info, &needs_interrupt);
+	if (needs_interrupt)
 		call_venus_op(core, raise_interrupt, core);
 
-	return rc;
+	return 0;
 }
 
-int venus_hfi_queue_cmd_write_intr(struct msm_vidc_core *core, void *pkt,
-				   bool allow_intr)
+void venus_hfi_queue_cmd_flush(struct msm_vidc_core *core)
 {
+	struct msm_vidc_iface_q_info *q_info;
 	bool needs_interrupt = false;
-	int rc = __iface_cmdq_write_relaxed(core, pkt, &needs_interrupt);
 
-	if (!rc && allow_intr && needs_interrupt)
+	q_info = &core->iface_queues[VIDC_IFACEQ_CMDQ_IDX];
+	if (!q_info->staged_pkts)
+		return;
+
+	__publish_queue(q_info, &needs_interrupt);
+	if (needs_interrupt)
 		call_venus_op(core, raise_interrupt, core);
+}
+
+/* Small ring so that wrap around and queue full happen often */
+#define VIDC_CMDQ_TEST_Q_SIZE		SZ_4K
+#define VIDC_CMDQ_TEST_MAX_PKT_WORDS	64
+
+static u32 __cmdq_test_rand(u32 *state)
+{
+	/* xorshift32, the state must never be 0 */
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
 
+	return *state;
+}
+
+static void __cmdq_test_fill(u32 *pkt, u32 words, u32 seq)
+{
+	u32 i;
+
+	pkt[0] = words << 2;
+	pkt[1] = seq;
+	for (i = 2; i < words; i++)
+		pkt[i] = seq * 31 + i;
+}
+
+/*
+ * Simulates host and firmware on a private ring: the host stages packets
+ * of random size and publishes them at random points, treating queue full
+ * the way __iface_cmdq_stage() does, while firmware reads them back with
+ * __read_queue(). Firmware must see exactly the published packets, intact
+ * and in order, and queue full must be reported only when the ring
+ * really has no room.
+ */
+int venus_hfi_queue_self_test(u32 steps)
+{
+	struct msm_vidc_iface_q_info *q_info;
+	struct hfi_queue_header *queue;
+	u32 *pkt = NULL, *rd_pkt = NULL, *sizes = NULL;
+	u32 staged = 0, published = 0, read = 0, used_words = 0;
+	u32 max_pkts, q_words, words, free_words, tx_req, i, step;
+	u32 seed = get_random_u32() | 1, state = seed;
+	int rc = 0;
+
+	q_info = kzalloc(sizeof(*q_info), GFP_KERNEL);
+	queue = kzalloc(sizeof(*queue), GFP_KERNEL);
+	pkt = kzalloc(VIDC_CMDQ_TEST_MAX_PKT_WORDS << 2, GFP_KERNEL);
+	rd_pkt = kzalloc(VIDC_IFACEQ_VAR_HUGE_PKT_SIZE, GFP_KERNEL);
+	max_pkts = VIDC_CMDQ_TEST_Q_SIZE >> 3;
+	sizes = kcalloc(max_pkts, sizeof(*sizes), GFP_KERNEL);
+	if (!q_info || !queue || !pkt || !rd_pkt || !sizes) {
+		rc = -ENOMEM;
+		goto exit;
+	}
+
+	q_info->q_array.align_virtual_addr = kzalloc(VIDC_CMDQ_TEST_Q_SIZE,
+						     GFP_KERNEL);
+	if (!q_info->q_array.align_virtual_addr) {
+		rc = -ENOMEM;
+		goto exit;
+	}
+	q_info->q_array.mem_size = VIDC_CMDQ_TEST_Q_SIZE;
+	q_info->q_hdr = queue;
+	__set_queue_hdr_defaults(queue);
+	q_words = VIDC_CMDQ_TEST_Q_SIZE >> 2;
+
+	for (step = 0; step < steps && !rc; step++) {
+		switch (__cmdq_test_rand(&state) % 4) {
+		case 0:
+		case 1:
+			words = 2 + __cmdq_test_rand(&state) %
+				(VIDC_CMDQ_TEST_MAX_PKT_WORDS - 1);
+			__cmdq_test_fill(pkt, words, staged);
+			free_words = q_words - used_words;
+
+			rc = __write_queue(q_info, (u8 *)pkt);
+			if (rc == -ENOTEMPTY) {
+				tx_req = queue->qhdr_tx_req;
+				if (free_words > words || !tx_req) {
+					d_vpr_e("%s: bogus full, free %u pkt %u tx_req %u\n",
+						__func__, free_words, words, tx_req);
+					rc = -EINVAL;
+					break;
+				}
+				/* what __iface_cmdq_stage() does before -EAGAIN */
+				__publish_queue(q_info, NULL);
+				published = staged;
+				rc = 0;
+				break;
+			}
+			if (rc || free_words <= words) {
+				d_vpr_e("%s: write rc %d, free %u pkt %u\n",
+					__func__, rc, free_words, words);
+				rc = rc ? rc : -EINVAL;
+				break;
+			}
+			sizes[staged % max_pkts] = words;
+			used_words += words;
+			staged++;
+			break;
+		case 2:
+			__publish_queue(q_info, NULL);
+			if (queue->qhdr_write_idx != q_info->staged_write_idx) {
+				d_vpr_e("%s: write idx %u staged idx %u\n",
+					__func__, queue->qhdr_write_idx,
+					q_info->staged_write_idx);
+				rc = -EINVAL;
+				break;
+			}
+			published = staged;
+			break;
+		default:
+			/* firmware drains a few packets */
+			for (i = __cmdq_test_rand(&state) % 8; i > 0; i--) {
+				rc = __read_queue(q_info, (u8 *)rd_pkt, &tx_req);
+				if (rc == -ENODATA && read == published) {
+					rc = 0;
+					break;
+				}
+				words = sizes[read % max_pkts];
+				__cmdq_test_fill(pkt, words, read);
+				if (rc || read >= published ||
+				    memcmp(rd_pkt, pkt, words << 2)) {
+					d_vpr_e("%s: read rc %d pkt %u published %u\n",
+						__func__, rc, read, published);
+					rc = -EINVAL;
+					break;
+				}
+				used_words -= words;
+				read++;
+			}
+			break;
+		}
+	}
+
+	if (rc)
+		d_vpr_e("%s: failed at step %u seed %#x: %d\n",
+			__func__, step, seed, rc);
+	else
+		d_vpr_h("%s: %u steps, %u pkts staged, %u read\n",
+			__func__, steps, staged, read);
+
+exit:
+	if (q_info)
+		kfree(q_info->q_array.align_virtual_addr);
+	kfree(sizes);
+	kfree(rd_pkt);
+	kfree(pkt);
+	kfree(queue);
+	kfree(q_info);
 	return rc;
 }
 
@@ -455,6 +662,8 @@ int venus_hfi_reset_queue_header(struct msm_vidc_core *core)
 	for (i = 0; i < VIDC_IFACEQ_NUMQ; i++) {
 		iface_q = &core->iface_queues[i];
 		__set_queue_hdr_defaults(iface_q->q_hdr);
+		iface_q->staged_write_idx = 0;
+		iface_q->staged_pkts = 0;
 	}
 
 	iface_q = &core->iface_queues[VIDC_IFACEQ_CMDQ_IDX];
@@ -566,6 +775,8 @@ int venus_hfi_queue_init(struct msm_vidc_core *core)
 		iface_q->q_hdr = VIDC_IFACEQ_GET_QHDR_START_ADDR(
 				core->iface_q_table.align_virtual_addr, i);
 		__set_queue_hdr_defaults(iface_q->q_hdr);
+		iface_q->staged_write_idx = 0;
+		iface_q->staged_pkts = 0;
 	}
 
 	q_tbl_hdr = (struct hfi_queue_table_header *)
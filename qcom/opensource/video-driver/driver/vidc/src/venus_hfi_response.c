@@ -4,7 +4,9 @@
  * Copyright (c) 2022-2024 Qualcomm Innovation Center, Inc. All rights reserved.
  */
 
+#include <linux/bsearch.h>
 #include <linux/of_address.h>
+#include <linux/sort.h>
 
 #include "hfi_packet.h"
 #include "venus_hfi.h"
@@ -15,6 +17,7 @@
 #include "msm_vidc_memory.h"
 #include "msm_vidc_fence.h"
 #include "msm_vidc_platform.h"
+#include "msm_vidc_power.h"
 
 #define in_range(range, val) (((range.begin) < (val)) && ((range.end) > (val)))
 
@@ -686,21 +689,14 @@ static int handle_input_buffer(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffer *buf;
 	struct msm_vidc_core *core;
 	u32 frame_size, batch_size;
-	bool found;
 
 	core = inst->core;
 	buffers = msm_vidc_get_buffers(inst, MSM_VIDC_BUF_INPUT, __func__);
 	if (!buffers)
 		return -EINVAL;
 
-	found = false;
-	list_for_each_entry(buf, &buffers->list, list) {
-		if (buf->index == buffer->index) {
-			found = true;
-			break;
-		}
-	}
-	if (!found) {
+	buf = msm_vidc_lookup_buffer_by_index(buffers, buffer->index);
+	if (!buf) {
 		i_vpr_e(inst, "%s: invalid buffer idx %d addr %#llx data_offset %d\n",
 			__func__, buffer->index, buffer->base_address,
 			buffer->data_offset);
@@ -759,6 +755,7 @@ static int handle_input_buffer(struct msm_vidc_inst *inst,
 
 	print_vidc_buffer(VIDC_HIGH, "high", "dqbuf", inst, buf);
 	msm_vidc_update_stats(inst, buf, MSM_VIDC_DEBUGFS_EVENT_EBD);
+	msm_vidc_update_frame_time(inst, buf);
 
 	/* ebd: update end timestamp and flags in stats entry */
 	msm_vidc_remove_buffer_stats(inst, buf, buffer->timestamp);
@@ -842,7 +839,7 @@ static int handle_output_buffer(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffers *buffers;
 	struct msm_vidc_buffer *buf;
 	struct msm_vidc_core *core;
-	bool found, fatal = false;
+	bool fatal = false;
 
 	core = inst->core;
 
@@ -875,21 +872,14 @@ static int handle_output_buffer(struct msm_vidc_inst *inst,
 	if (!buffers)
 		return -EINVAL;
 
-	found = false;
-	list_for_each_entry(buf, &buffers->list, list) {
-		if (!(buf->attr & MSM_VIDC_ATTR_QUEUED))
-			continue;
-		if (is_decode_session(inst))
-			found = (buf->index == buffer->index &&
-				buf->device_addr == buffer->base_address &&
-				buf->data_offset == buffer->data_offset);
-		else
-			found = (buf->index == buffer->index);
-
-		if (found)
-			break;
-	}
-	if (!found) {
+	buf = msm_vidc_lookup_buffer_by_index(buffers, buffer->index);
+	if (buf && !(buf->attr & MSM_VIDC_ATTR_QUEUED))
+		buf = NULL;
+	if (buf && is_decode_session(inst) &&
+	    (buf->device_addr != buffer->base_address ||
+	     buf->data_offset != buffer->data_offset))
+		buf = NULL;
+	if (!buf) {
 		i_vpr_l(inst, "%s: invalid idx %d daddr %#llx\n",
 			__func__, buffer->index, buffer->base_address);
 		return 0;
@@ -1005,21 +995,14 @@ static int handle_input_metadata_buffer(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffer *buf;
 	struct msm_vidc_core *core;
 	u32 frame_size, batch_size;
-	bool found;
 
 	core = inst->core;
 	buffers = msm_vidc_get_buffers(inst, MSM_VIDC_BUF_INPUT_META, __func__);
 	if (!buffers)
 		return -EINVAL;
 
-	found = false;
-	list_for_each_entry(buf, &buffers->list, list) {
-		if (buf->index == buffer->index) {
-			found = true;
-			break;
-		}
-	}
-	if (!found) {
+	buf = msm_vidc_lookup_buffer_by_index(buffers, buffer->index);
+	if (!buf) {
 		i_vpr_e(inst, "%s: invalid idx %d daddr %#llx data_offset %d\n",
 			__func__, buffer->index, buffer->base_address,
 			buffer->data_offset);
@@ -1071,20 +1054,13 @@ static int handle_output_metadata_buffer(struct msm_vidc_inst *inst,
 	int rc = 0;
 	struct msm_vidc_buffers *buffers;
 	struct msm_vidc_buffer *buf;
-	bool found;
 
 	buffers = msm_vidc_get_buffers(inst, MSM_VIDC_BUF_OUTPUT_META, __func__);
 	if (!buffers)
 		return -EINVAL;
 
-	found = false;
-	list_for_each_entry(buf, &buffers->list, list) {
-		if (buf->index == buffer->index) {
-			found = true;
-			break;
-		}
-	}
-	if (!found) {
+	buf = msm_vidc_lookup_buffer_by_index(buffers, buffer->index);
+	if (!buf) {
 		i_vpr_e(inst, "%s: invalid idx %d daddr %#llx data_offset %d\n",
 			__func__, buffer->index, buffer->base_address,
 			buffer->data_offset);
@@ -1550,6 +1526,13 @@ static int handle_session_command(struct msm_vidc_inst *inst,
 	return 0;
 }
 
+static int cmp_dpb_addr(const void *a, const void *b)
+{
+	u64 l = *(const u64 *)a, r = *(const u64 *)b;
+
+	return l < r ? -1 : l > r;
+}
+
 static int handle_dpb_list_property(struct msm_vidc_inst *inst,
 				    struct hfi_packet *pkt)
 {
@@ -1558,7 +1541,8 @@ static int handle_dpb_list_property(struct msm_vidc_inst *inst,
 	int i = 0;
 	struct msm_vidc_buffer *ro_buf;
 	bool found = false;
-	u64 device_addr;
+	u64 dpb_addrs[MAX_DPB_LIST_ARRAY_SIZE / 4];
+	u32 num_dpb_addrs = 0;
 
 	if (!is_decode_session(inst)) {
 		i_vpr_e(inst,
@@ -1593,8 +1577,12 @@ static int handle_dpb_list_property(struct msm_vidc_inst *inst,
 			inst->dpb_list_payload[i + 2], inst->dpb_list_payload[i + 3]);
 	}
 
+	/* sort dpb addresses once so each read only buffer is a binary search */
+	for (i = 0; (i + 3) < num_words_in_payload; i = i + 4)
+		dpb_addrs[num_dpb_addrs++] = *((u64 *)(&inst->dpb_list_payload[i]));
+	sort(dpb_addrs, num_dpb_addrs, sizeof(*dpb_addrs), cmp_dpb_addr, NULL);
+
 	list_for_each_entry(ro_buf, &inst->buffers.read_only.list, list) {
-		found = false;
 		/* do not mark RELEASE_ELIGIBLE for non-read only buffers */
 		if (!(ro_buf->attr & MSM_VIDC_ATTR_READ_ONLY))
 			continue;
@@ -1607,13 +1595,8 @@ static int handle_dpb_list_property(struct msm_vidc_inst *inst,
 		 */
 		if (ro_buf->attr & MSM_VIDC_ATTR_PENDING_RELEASE)
 			continue;
-		for (i = 0; (i + 3) < num_words_in_payload; i = i + 4) {
-			device_addr = *((u64 *)(&inst->dpb_list_payload[i]));
-			if (ro_buf->device_addr == device_addr) {
-				found = true;
-				break;
-			}
-		}
+		found = bsearch(&ro_buf->device_addr, dpb_addrs, num_dpb_addrs,
+				sizeof(*dpb_addrs), cmp_dpb_addr);
 		/* mark a buffer as RELEASE_ELIGIBLE if not found in dpb list */
 		if (!found)
 			ro_buf->attr |= MSM_VIDC_ATTR_RELEASE_ELIGIBLE;